@@ -0,0 +1,570 @@
+#include "aabb_tree.h"
+
+#include "hashtable.h"
+#include "heap.h"
+#include "vec3f_wide.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#define AABB_TREE_INITIAL_CAPACITY 64
+#define AABB_TREE_STACK_SIZE 256					// nodes waiting during a traversal, balanced trees stay far below it (asserted)
+
+typedef struct aabb_tree_node_t {
+	vec3f_t min;									// fat box for leaves
+	vec3f_t max;
+	int parent;										// next free node while on the free list
+	int child_a;									// AABB_TREE_NULL for leaves
+	int child_b;
+	int height;										// 0 for leaves, -1 for free nodes
+	int user;
+	bool moved;										// added or left its fat box since the last pair update
+	bool removed;									// out of the tree, freed once the next pair update dropped its pairs
+} aabb_tree_node_t;
+
+typedef struct aabb_tree_t {
+	heap_t* heap;
+	float margin;
+
+	// proxies are leaf nodes, a leaf keeps its index when it is inserted again
+	aabb_tree_node_t* nodes;
+	int node_capacity;
+	int root;
+	int free_list;
+	int removed_list;								// removed proxies chained through parent, freed on the next pair update
+
+	// proxies to query on the next pair update, including ones removed since
+	int* moved;
+	vec3f_t* moved_mins;
+	vec3f_t* moved_maxs;
+	int moved_count;
+	int moved_capacity;
+
+	aabb_tree_pair_t* pairs;
+	int pair_count;
+	int pair_capacity;
+	hasht_t* pair_indices;							// pair key -> index in pairs
+} aabb_tree_t;
+
+static int aabbTreeNodeAlloc(aabb_tree_t* tree);
+static void aabbTreeNodeFree(aabb_tree_t* tree, int node);
+static void aabbTreeInsertLeaf(aabb_tree_t* tree, int leaf);
+static void aabbTreeRemoveLeaf(aabb_tree_t* tree, int leaf);
+static void aabbTreeRefit(aabb_tree_t* tree, int node);
+static int aabbTreeBalance(aabb_tree_t* tree, int node);
+static void aabbTreeMovedPush(aabb_tree_t* tree, int proxy);
+static void aabbTreePairRemoveAt(aabb_tree_t* tree, int index);
+
+aabb_tree_t* aabbTreeCreate(heap_t* heap, float margin) {
+	aabb_tree_t* tree = heapAlloc(heap, sizeof(aabb_tree_t), 8);
+	memset(tree, 0, sizeof(*tree));
+	tree->heap = heap;
+	tree->margin = margin;
+	tree->root = AABB_TREE_NULL;
+	tree->free_list = AABB_TREE_NULL;
+	tree->removed_list = AABB_TREE_NULL;
+	tree->pair_indices = hashTableCreate(heap, sizeof(uint64_t), sizeof(int), 0);
+	return tree;
+}
+
+void aabbTreeDestroy(aabb_tree_t* tree) {
+	hashTableDestroy(tree->pair_indices);
+	heapFree(tree->heap, tree->pairs);
+	heapFree(tree->heap, tree->moved);
+	heapFree(tree->heap, tree->moved_mins);
+	heapFree(tree->heap, tree->moved_maxs);
+	heapFree(tree->heap, tree->nodes);
+	heapFree(tree->heap, tree);
+}
+
+//  --------------------------------------------------------------------------
+//								     BOXES
+//
+
+static inline bool aabbOverlap(vec3f_t min_a, vec3f_t max_a, vec3f_t min_b, vec3f_t max_b) {
+	return min_a.x <= max_b.x && min_b.x <= max_a.x
+		&& min_a.y <= max_b.y && min_b.y <= max_a.y
+		&& min_a.z <= max_b.z && min_b.z <= max_a.z;
+}
+
+static inline bool aabbContains(vec3f_t outer_min, vec3f_t outer_max, vec3f_t min, vec3f_t max) {
+	return outer_min.x <= min.x && outer_min.y <= min.y && outer_min.z <= min.z
+		&& max.x <= outer_max.x && max.y <= outer_max.y && max.z <= outer_max.z;
+}
+
+// Half the surface area, the insertion cost.
+static inline float aabbArea(vec3f_t min, vec3f_t max) {
+	vec3f_t size = vec3fSub(max, min);
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+static inline float aabbUnionArea(vec3f_t min_a, vec3f_t max_a, vec3f_t min_b, vec3f_t max_b) {
+	return aabbArea(vec3fMin(min_a, min_b), vec3fMax(max_a, max_b));
+}
+
+static inline void aabbTreeNodeUnion(aabb_tree_t* tree, int node, int a, int b) {
+	tree->nodes[node].min = vec3fMin(tree->nodes[a].min, tree->nodes[b].min);
+	tree->nodes[node].max = vec3fMax(tree->nodes[a].max, tree->nodes[b].max);
+}
+
+//  --------------------------------------------------------------------------
+//								    PROXIES
+//
+
+int aabbTreeProxyAdd(aabb_tree_t* tree, vec3f_t min, vec3f_t max, int user) {
+	int proxy = aabbTreeNodeAlloc(tree);
+	aabb_tree_node_t* node = &tree->nodes[proxy];
+	vec3f_t margin = { tree->margin, tree->margin, tree->margin };
+	node->min = vec3fSub(min, margin);
+	node->max = vec3fAdd(max, margin);
+	node->user = user;
+	aabbTreeInsertLeaf(tree, proxy);
+	aabbTreeMovedPush(tree, proxy);
+	return proxy;
+}
+
+void aabbTreeProxyRemove(aabb_tree_t* tree, int proxy) {
+	assert(tree->nodes[proxy].height == 0 && !tree->nodes[proxy].removed);
+	aabbTreeRemoveLeaf(tree, proxy);
+
+	// the pair update walks every pair anyway, it drops the pairs of the proxy and frees it, until then
+	// the proxy is not reused so the pairs still name it
+	tree->nodes[proxy].removed = true;
+	tree->nodes[proxy].parent = tree->removed_list;
+	tree->removed_list = proxy;
+}
+
+bool aabbTreeProxyMove(aabb_tree_t* tree, int proxy, vec3f_t min, vec3f_t max) {
+	aabb_tree_node_t* node = &tree->nodes[proxy];
+	if (aabbContains(node->min, node->max, min, max)) {
+		return false;
+	}
+
+	aabbTreeRemoveLeaf(tree, proxy);
+	vec3f_t margin = { tree->margin, tree->margin, tree->margin };
+	node->min = vec3fSub(min, margin);
+	node->max = vec3fAdd(max, margin);
+	aabbTreeInsertLeaf(tree, proxy);
+	aabbTreeMovedPush(tree, proxy);
+	return true;
+}
+
+int aabbTreeProxyGetUser(aabb_tree_t* tree, int proxy) {
+	return tree->nodes[proxy].user;
+}
+
+void aabbTreeProxyGetBounds(aabb_tree_t* tree, int proxy, vec3f_t* min, vec3f_t* max) {
+	*min = tree->nodes[proxy].min;
+	*max = tree->nodes[proxy].max;
+}
+
+int aabbTreeGetHeight(aabb_tree_t* tree) {
+	return tree->root == AABB_TREE_NULL ? -1 : tree->nodes[tree->root].height;
+}
+
+static void aabbTreeMovedPush(aabb_tree_t* tree, int proxy) {
+	if (tree->nodes[proxy].moved) {
+		return;
+	}
+	if (tree->moved_count == tree->moved_capacity) {
+		int capacity = __max(tree->moved_capacity * 2, AABB_TREE_INITIAL_CAPACITY);
+		int* moved = heapAlloc(tree->heap, sizeof(int) * capacity, 16);
+		if (tree->moved) {
+			memcpy(moved, tree->moved, sizeof(int) * tree->moved_count);
+			heapFree(tree->heap, tree->moved);
+		}
+		heapFree(tree->heap, tree->moved_mins);
+		heapFree(tree->heap, tree->moved_maxs);
+		tree->moved = moved;
+		tree->moved_mins = heapAlloc(tree->heap, sizeof(vec3f_t) * capacity, 16);
+		tree->moved_maxs = heapAlloc(tree->heap, sizeof(vec3f_t) * capacity, 16);
+		tree->moved_capacity = capacity;
+	}
+	tree->nodes[proxy].moved = true;
+	tree->moved[tree->moved_count++] = proxy;
+}
+
+//  --------------------------------------------------------------------------
+//								    QUERIES
+//
+
+int aabbTreeQuery(aabb_tree_t* tree, vec3f_t min, vec3f_t max, int* results, int max_results) {
+	if (tree->root == AABB_TREE_NULL) {
+		return 0;
+	}
+
+	int stack[AABB_TREE_STACK_SIZE];
+	int stack_count = 0;
+	stack[stack_count++] = tree->root;
+	int found = 0;
+	while (stack_count) {
+		const aabb_tree_node_t* node = &tree->nodes[stack[--stack_count]];
+		if (!aabbOverlap(node->min, node->max, min, max)) {
+			continue;
+		}
+		if (node->child_a == AABB_TREE_NULL) {
+			if (found < max_results) {
+				results[found] = (int) (node - tree->nodes);
+			}
+			found++;
+			continue;
+		}
+		assert(stack_count + 2 <= AABB_TREE_STACK_SIZE);
+		stack[stack_count++] = node->child_b;
+		stack[stack_count++] = node->child_a;
+	}
+	return found;
+}
+
+void aabbTreeQueryBatch(aabb_tree_t* tree, const vec3f_t* mins, const vec3f_t* maxs, int count, aabb_tree_query_func_t func, void* user) {
+	if (tree->root == AABB_TREE_NULL) {
+		return;
+	}
+
+#if VEC3F_XN_WIDTH
+	// a packet of boxes walks the tree together, every node is tested against all of them at once and a
+	// subtree is entered with the mask of the boxes that overlap it
+	for (int first = 0; first < count; first += VEC3F_XN_WIDTH) {
+		int lane_count = __min(VEC3F_XN_WIDTH, count - first);
+		vec3f_t packet_mins[VEC3F_XN_WIDTH];
+		vec3f_t packet_maxs[VEC3F_XN_WIDTH];
+		for (int lane = 0; lane < VEC3F_XN_WIDTH; lane++) {
+			packet_mins[lane] = lane < lane_count ? mins[first + lane] : (vec3f_t) { FLT_MAX, FLT_MAX, FLT_MAX };
+			packet_maxs[lane] = lane < lane_count ? maxs[first + lane] : (vec3f_t) { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		}
+		vec3f_xn_t query_min = vec3fxnLoad(packet_mins);
+		vec3f_xn_t query_max = vec3fxnLoad(packet_maxs);
+
+		int stack[AABB_TREE_STACK_SIZE];
+		int stack_masks[AABB_TREE_STACK_SIZE];
+		int stack_count = 0;
+		stack[stack_count] = tree->root;
+		stack_masks[stack_count++] = (1 << lane_count) - 1;
+		while (stack_count) {
+			int index = stack[--stack_count];
+			const aabb_tree_node_t* node = &tree->nodes[index];
+			float_xn_t overlap_x = floatxnAnd(floatxnCmpGe(floatxnSplat(node->max.x), query_min.x), floatxnCmpGe(query_max.x, floatxnSplat(node->min.x)));
+			float_xn_t overlap_y = floatxnAnd(floatxnCmpGe(floatxnSplat(node->max.y), query_min.y), floatxnCmpGe(query_max.y, floatxnSplat(node->min.y)));
+			float_xn_t overlap_z = floatxnAnd(floatxnCmpGe(floatxnSplat(node->max.z), query_min.z), floatxnCmpGe(query_max.z, floatxnSplat(node->min.z)));
+			int mask = stack_masks[stack_count] & floatxnMaskBits(floatxnAnd(floatxnAnd(overlap_x, overlap_y), overlap_z));
+			if (!mask) {
+				continue;
+			}
+			if (node->child_a == AABB_TREE_NULL) {
+				for (int lane = 0; lane < lane_count; lane++) {
+					if (mask & (1 << lane)) {
+						func(user, first + lane, index);
+					}
+				}
+				continue;
+			}
+			assert(stack_count + 2 <= AABB_TREE_STACK_SIZE);
+			stack[stack_count] = node->child_b;
+			stack_masks[stack_count++] = mask;
+			stack[stack_count] = node->child_a;
+			stack_masks[stack_count++] = mask;
+		}
+	}
+#else
+	for (int query = 0; query < count; query++) {
+		int stack[AABB_TREE_STACK_SIZE];
+		int stack_count = 0;
+		stack[stack_count++] = tree->root;
+		while (stack_count) {
+			int index = stack[--stack_count];
+			const aabb_tree_node_t* node = &tree->nodes[index];
+			if (!aabbOverlap(node->min, node->max, mins[query], maxs[query])) {
+				continue;
+			}
+			if (node->child_a == AABB_TREE_NULL) {
+				func(user, query, index);
+				continue;
+			}
+			assert(stack_count + 2 <= AABB_TREE_STACK_SIZE);
+			stack[stack_count++] = node->child_b;
+			stack[stack_count++] = node->child_a;
+		}
+	}
+#endif
+}
+
+//  --------------------------------------------------------------------------
+//								     PAIRS
+//
+
+static inline uint64_t aabbTreePairKey(int proxy_a, int proxy_b) {
+	return ((uint64_t) (uint32_t) proxy_a << 32) | (uint32_t) proxy_b;
+}
+
+static void aabbTreePairRemoveAt(aabb_tree_t* tree, int index) {
+	aabb_tree_pair_t pair = tree->pairs[index];
+	uint64_t key = aabbTreePairKey(pair.proxy_a, pair.proxy_b);
+	hashTableRemove(tree->pair_indices, &key);
+
+	// the last pair takes its place
+	int last = --tree->pair_count;
+	if (index != last) {
+		tree->pairs[index] = tree->pairs[last];
+		uint64_t last_key = aabbTreePairKey(tree->pairs[index].proxy_a, tree->pairs[index].proxy_b);
+		*(int*) hashTableGet(tree->pair_indices, &last_key) = index;
+	}
+}
+
+static void aabbTreePairFound(void* user, int query, int proxy) {
+	aabb_tree_t* tree = user;
+	int moved = tree->moved[query];
+	// two moved proxies find each other, the lower one adds the pair
+	if (proxy == moved || (tree->nodes[proxy].moved && proxy < moved)) {
+		return;
+	}
+
+	int proxy_a = __min(proxy, moved);
+	int proxy_b = __max(proxy, moved);
+	uint64_t key = aabbTreePairKey(proxy_a, proxy_b);
+	bool inserted = false;
+	int* index = hashTableInsert(tree->pair_indices, &key, &inserted);
+	if (!inserted) {
+		return;
+	}
+
+	if (tree->pair_count == tree->pair_capacity) {
+		int capacity = __max(tree->pair_capacity * 2, AABB_TREE_INITIAL_CAPACITY);
+		aabb_tree_pair_t* pairs = heapAlloc(tree->heap, sizeof(aabb_tree_pair_t) * capacity, 8);
+		if (tree->pairs) {
+			memcpy(pairs, tree->pairs, sizeof(aabb_tree_pair_t) * tree->pair_count);
+			heapFree(tree->heap, tree->pairs);
+		}
+		tree->pairs = pairs;
+		tree->pair_capacity = capacity;
+	}
+	*index = tree->pair_count;
+	tree->pairs[tree->pair_count++] = (aabb_tree_pair_t) { .proxy_a = proxy_a, .proxy_b = proxy_b };
+}
+
+int aabbTreeUpdatePairs(aabb_tree_t* tree) {
+	// pairs of proxies that did not leave their fat box still overlap, only moved ones are checked
+	for (int x = 0; x < tree->pair_count;) {
+		const aabb_tree_node_t* a = &tree->nodes[tree->pairs[x].proxy_a];
+		const aabb_tree_node_t* b = &tree->nodes[tree->pairs[x].proxy_b];
+		if (a->removed || b->removed || ((a->moved || b->moved) && !aabbOverlap(a->min, a->max, b->min, b->max))) {
+			aabbTreePairRemoveAt(tree, x);
+			continue;
+		}
+		x++;
+	}
+
+	// removed proxies leave holes in the moved list
+	int moved_count = 0;
+	for (int x = 0; x < tree->moved_count; x++) {
+		int proxy = tree->moved[x];
+		if (!tree->nodes[proxy].removed) {
+			tree->moved[moved_count] = proxy;
+			tree->moved_mins[moved_count] = tree->nodes[proxy].min;
+			tree->moved_maxs[moved_count] = tree->nodes[proxy].max;
+			moved_count++;
+		}
+	}
+	aabbTreeQueryBatch(tree, tree->moved_mins, tree->moved_maxs, moved_count, aabbTreePairFound, tree);
+
+	for (int x = 0; x < moved_count; x++) {
+		tree->nodes[tree->moved[x]].moved = false;
+	}
+	tree->moved_count = 0;
+
+	// no pair names a removed proxy anymore
+	while (tree->removed_list != AABB_TREE_NULL) {
+		int proxy = tree->removed_list;
+		tree->removed_list = tree->nodes[proxy].parent;
+		aabbTreeNodeFree(tree, proxy);
+	}
+	return tree->pair_count;
+}
+
+const aabb_tree_pair_t* aabbTreeGetPairs(aabb_tree_t* tree) {
+	return tree->pairs;
+}
+
+//  --------------------------------------------------------------------------
+//								      TREE
+//
+
+static int aabbTreeNodeAlloc(aabb_tree_t* tree) {
+	if (tree->free_list == AABB_TREE_NULL) {
+		int capacity = __max(tree->node_capacity * 2, AABB_TREE_INITIAL_CAPACITY);
+		aabb_tree_node_t* nodes = heapAlloc(tree->heap, sizeof(aabb_tree_node_t) * capacity, 16);
+		if (tree->nodes) {
+			memcpy(nodes, tree->nodes, sizeof(aabb_tree_node_t) * tree->node_capacity);
+			heapFree(tree->heap, tree->nodes);
+		}
+		for (int x = tree->node_capacity; x < capacity; x++) {
+			nodes[x].parent = x + 1 < capacity ? x + 1 : AABB_TREE_NULL;
+			nodes[x].height = -1;
+		}
+		tree->free_list = tree->node_capacity;
+		tree->nodes = nodes;
+		tree->node_capacity = capacity;
+	}
+
+	int index = tree->free_list;
+	aabb_tree_node_t* node = &tree->nodes[index];
+	tree->free_list = node->parent;
+	memset(node, 0, sizeof(*node));
+	node->parent = AABB_TREE_NULL;
+	node->child_a = AABB_TREE_NULL;
+	node->child_b = AABB_TREE_NULL;
+	node->user = -1;
+	return index;
+}
+
+static void aabbTreeNodeFree(aabb_tree_t* tree, int node) {
+	tree->nodes[node].parent = tree->free_list;
+	tree->nodes[node].height = -1;
+	tree->free_list = node;
+}
+
+static void aabbTreeInsertLeaf(aabb_tree_t* tree, int leaf) {
+	if (tree->root == AABB_TREE_NULL) {
+		tree->root = leaf;
+		tree->nodes[leaf].parent = AABB_TREE_NULL;
+		return;
+	}
+
+	// walk down to the sibling that grows the total area the least, the area a node grows by is paid
+	// by all of its ancestors too
+	vec3f_t leaf_min = tree->nodes[leaf].min;
+	vec3f_t leaf_max = tree->nodes[leaf].max;
+	int index = tree->root;
+	while (tree->nodes[index].child_a != AABB_TREE_NULL) {
+		const aabb_tree_node_t* node = &tree->nodes[index];
+		float area = aabbArea(node->min, node->max);
+		float combined_area = aabbUnionArea(node->min, node->max, leaf_min, leaf_max);
+		// a new parent for this node and the leaf
+		float cost = 2.0f * combined_area;
+		float inheritance_cost = 2.0f * (combined_area - area);
+
+		float child_costs[2];
+		int children[2] = { node->child_a, node->child_b };
+		for (int c = 0; c < 2; c++) {
+			const aabb_tree_node_t* child = &tree->nodes[children[c]];
+			float child_area = aabbUnionArea(child->min, child->max, leaf_min, leaf_max);
+			if (child->child_a != AABB_TREE_NULL) {
+				child_area -= aabbArea(child->min, child->max);
+			}
+			child_costs[c] = child_area + inheritance_cost;
+		}
+		if (cost < child_costs[0] && cost < child_costs[1]) {
+			break;
+		}
+		index = child_costs[0] < child_costs[1] ? children[0] : children[1];
+	}
+
+	// the sibling and the leaf share a new parent (allocating can move the nodes)
+	int sibling = index;
+	int new_parent = aabbTreeNodeAlloc(tree);
+	int old_parent = tree->nodes[sibling].parent;
+	aabb_tree_node_t* parent = &tree->nodes[new_parent];
+	parent->parent = old_parent;
+	parent->child_a = sibling;
+	parent->child_b = leaf;
+	parent->height = tree->nodes[sibling].height + 1;
+	aabbTreeNodeUnion(tree, new_parent, sibling, leaf);
+	if (old_parent == AABB_TREE_NULL) {
+		tree->root = new_parent;
+	} else if (tree->nodes[old_parent].child_a == sibling) {
+		tree->nodes[old_parent].child_a = new_parent;
+	} else {
+		tree->nodes[old_parent].child_b = new_parent;
+	}
+	tree->nodes[sibling].parent = new_parent;
+	tree->nodes[leaf].parent = new_parent;
+
+	aabbTreeRefit(tree, new_parent);
+}
+
+static void aabbTreeRemoveLeaf(aabb_tree_t* tree, int leaf) {
+	if (leaf == tree->root) {
+		tree->root = AABB_TREE_NULL;
+		return;
+	}
+
+	// the sibling takes the place of the parent
+	int parent = tree->nodes[leaf].parent;
+	int grand_parent = tree->nodes[parent].parent;
+	int sibling = tree->nodes[parent].child_a == leaf ? tree->nodes[parent].child_b : tree->nodes[parent].child_a;
+	tree->nodes[sibling].parent = grand_parent;
+	if (grand_parent == AABB_TREE_NULL) {
+		tree->root = sibling;
+	} else if (tree->nodes[grand_parent].child_a == parent) {
+		tree->nodes[grand_parent].child_a = sibling;
+	} else {
+		tree->nodes[grand_parent].child_b = sibling;
+	}
+	aabbTreeNodeFree(tree, parent);
+	aabbTreeRefit(tree, grand_parent);
+}
+
+// Walks up from node to the root, balancing every node and fixing its height and box.
+static void aabbTreeRefit(aabb_tree_t* tree, int node) {
+	while (node != AABB_TREE_NULL) {
+		node = aabbTreeBalance(tree, node);
+		int child_a = tree->nodes[node].child_a;
+		int child_b = tree->nodes[node].child_b;
+		tree->nodes[node].height = 1 + __max(tree->nodes[child_a].height, tree->nodes[child_b].height);
+		aabbTreeNodeUnion(tree, node, child_a, child_b);
+		node = tree->nodes[node].parent;
+	}
+}
+
+// Rotates the higher child of a up when the heights of its children differ by more than one:
+// with children b and c where c is higher, c takes the place of a with the children a and the
+// higher child of c, and a keeps b next to the lower child of c.
+//
+// RETURN: the node that took the place of a
+static int aabbTreeBalance(aabb_tree_t* tree, int a) {
+	aabb_tree_node_t* nodes = tree->nodes;
+	if (nodes[a].child_a == AABB_TREE_NULL || nodes[a].height < 2) {
+		return a;
+	}
+
+	int b = nodes[a].child_a;
+	int c = nodes[a].child_b;
+	int balance = nodes[c].height - nodes[b].height;
+	if (balance >= -1 && balance <= 1) {
+		return a;
+	}
+
+	// the same rotation for either side, up is the higher child and stay the other one
+	int up = balance > 1 ? c : b;
+	int stay = balance > 1 ? b : c;
+	int f = nodes[up].child_a;
+	int g = nodes[up].child_b;
+
+	nodes[up].child_a = a;
+	nodes[up].parent = nodes[a].parent;
+	nodes[a].parent = up;
+	if (nodes[up].parent == AABB_TREE_NULL) {
+		tree->root = up;
+	} else if (nodes[nodes[up].parent].child_a == a) {
+		nodes[nodes[up].parent].child_a = up;
+	} else {
+		nodes[nodes[up].parent].child_b = up;
+	}
+
+	// the higher grandchild stays with up, the lower one moves down to a in place of up
+	int keep = nodes[f].height > nodes[g].height ? f : g;
+	int move = keep == f ? g : f;
+	nodes[up].child_b = keep;
+	if (balance > 1) {
+		nodes[a].child_b = move;
+	} else {
+		nodes[a].child_a = move;
+	}
+	nodes[move].parent = a;
+
+	aabbTreeNodeUnion(tree, a, stay, move);
+	nodes[a].height = 1 + __max(nodes[stay].height, nodes[move].height);
+	aabbTreeNodeUnion(tree, up, a, keep);
+	nodes[up].height = 1 + __max(nodes[a].height, nodes[keep].height);
+	return up;
+}
@@ -0,0 +1,94 @@
+#ifndef __AABB_TREE_H__
+#define __AABB_TREE_H__
+
+#include "vec3f.h"
+
+#include <stdbool.h>
+
+/* DYNAMIC AABB TREE
+*	- a binary bounding volume hierarchy of axis aligned boxes (proxies) for bodies of any size,
+*	  where a uniform grid would need one cell size for all of them
+*	- the leaves store fattened boxes (grown by a margin), a proxy that moves inside its fat box
+*	  does not touch the tree at all
+*	- a proxy that leaves its fat box is removed and inserted again, the boxes of its ancestors are
+*	  refit on the way up and subtrees are rotated whenever their heights differ by more than one
+*	- overlap queries for many boxes run as packets of 8 (AVX) or 4 (SSE) boxes that walk the tree
+*	  together, every node is tested against the whole packet at once
+*	- the pair list of overlapping proxies is kept between updates, only proxies that were added or
+*	  left their fat box since the last update are queried again, the pairs of removed proxies are
+*	  dropped in the same pass
+*/
+
+typedef struct aabb_tree_t aabb_tree_t;
+
+typedef struct heap_t heap_t;
+
+// Not a proxy.
+#define AABB_TREE_NULL -1
+
+// Two proxies with overlapping fat boxes, proxy_a < proxy_b.
+typedef struct aabb_tree_pair_t {
+	int proxy_a;
+	int proxy_b;
+} aabb_tree_pair_t;
+
+// Called for every proxy a query box overlaps.
+typedef void (*aabb_tree_query_func_t)(void* user, int query, int proxy);
+
+// Creates an empty tree, the fat boxes are margin larger than the boxes of the proxies on every side.
+//
+// RETURN: the new tree
+aabb_tree_t* aabbTreeCreate(heap_t* heap, float margin);
+
+// Destroys the tree.
+//
+void aabbTreeDestroy(aabb_tree_t* tree);
+
+// Adds a box, user is handed back with aabbTreeProxyGetUser (e.g. an entity index).
+//
+// RETURN: the proxy of the box
+int aabbTreeProxyAdd(aabb_tree_t* tree, vec3f_t min, vec3f_t max, int user);
+
+// Removes a proxy, its pairs are dropped and the proxy is freed for reuse on the next aabbTreeUpdatePairs.
+//
+void aabbTreeProxyRemove(aabb_tree_t* tree, int proxy);
+
+// Moves the box of a proxy.
+//
+// RETURN: true if the box left its fat box and the proxy was inserted again
+bool aabbTreeProxyMove(aabb_tree_t* tree, int proxy, vec3f_t min, vec3f_t max);
+
+// Get the user value of a proxy.
+//
+// RETURN: the value given to aabbTreeProxyAdd
+int aabbTreeProxyGetUser(aabb_tree_t* tree, int proxy);
+
+// Get the fat box of a proxy.
+//
+void aabbTreeProxyGetBounds(aabb_tree_t* tree, int proxy, vec3f_t* min, vec3f_t* max);
+
+// Finds the proxies whose fat box overlaps the box.
+//
+// RETURN: the number of proxies found, only the first max_results are written to results
+int aabbTreeQuery(aabb_tree_t* tree, vec3f_t min, vec3f_t max, int* results, int max_results);
+
+// Finds the proxies that overlap each of count boxes, func gets the index of the box and the proxy.
+//
+void aabbTreeQueryBatch(aabb_tree_t* tree, const vec3f_t* mins, const vec3f_t* maxs, int count, aabb_tree_query_func_t func, void* user);
+
+// Brings the pair list up to date with the proxies added, moved and removed since the last update.
+//
+// RETURN: the number of pairs
+int aabbTreeUpdatePairs(aabb_tree_t* tree);
+
+// Get the pairs of the last aabbTreeUpdatePairs.
+//
+// RETURN: the pair list (valid until the next update or any proxy change)
+const aabb_tree_pair_t* aabbTreeGetPairs(aabb_tree_t* tree);
+
+// Get the height of the tree, 0 for a single leaf.
+//
+// RETURN: height, -1 for an empty tree
+int aabbTreeGetHeight(aabb_tree_t* tree);
+
+#endif
@@ -0,0 +1,1180 @@
+#include "bench.h"
+
+#include "atomic.h"
+#include "debug.h"
+#include "deque.h"
+#include "ecs.h"
+#include "event.h"
+#include "fs.h"
+#include "gpu.h"
+#include "hashtable.h"
+#include "heap.h"
+#include "job.h"
+#include "mat4f.h"
+#include "physics.h"
+#include "quatf.h"
+#include "renderer.h"
+#include "thread.h"
+#include "timer.h"
+#include "transform.h"
+#include "vec3f.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_THREAD_COUNT 4
+#define BENCH_HEAP_OPS 1000000
+#define BENCH_HEAP_BATCH 1024
+#define BENCH_HEAP_ROUNDS 256
+#define BENCH_DEQUE_OPS 250000
+#define BENCH_DEQUE_CAPACITY 64
+#define BENCH_ATOMIC_OPS 1000000
+#define BENCH_ECS_ENTITIES 1000
+#define BENCH_ECS_ROUNDS 64
+#define BENCH_HASHTABLE_KEYS (1 << 20)
+#define BENCH_MATH_COUNT 1024
+#define BENCH_MATH_ROUNDS 1024
+#define BENCH_LZ4_SIZE (1024 * 1024)
+#define BENCH_LZ4_ROUNDS 16
+#define BENCH_PHYSICS_ROPE_LENGTH 64
+#define BENCH_PHYSICS_STACK_HEIGHT 4
+#define BENCH_PHYSICS_COMPLIANCE 1e-6f
+#define BENCH_PHYSICS_MU 1e6f							// Lame parameters of the Neo-Hookean tets
+#define BENCH_PHYSICS_LAMBDA 1e7f
+#define BENCH_PHYSICS_FLOOR_QUADS 32					// quads per side of the floor mesh
+#define BENCH_RENDERER_MODELS 512
+#define BENCH_RENDERER_INSTANCES 4096
+#define BENCH_RENDERER_MATERIALS 8		// shaders and meshes of the material case, 64 combinations
+
+typedef struct bench_result_t {
+	char name[64];
+	uint64_t ops;
+	uint64_t ticks;
+	size_t allocations;
+	size_t bytes;
+	int threads;
+	double efficiency;
+} bench_result_t;
+
+typedef struct bench_t {
+	heap_t* heap;
+	bench_result_t* results;
+	int result_count;
+	int result_capacity;
+} bench_t;
+
+typedef void (*bench_scene_func_t)(heap_t* heap, physics_t* physics, int particle_count);
+
+typedef struct bench_scene_t {
+	const char* name;
+	bench_scene_func_t build;
+	int reorder_interval;							// updates between Morton reorders of the particles, 0 never
+} bench_scene_t;
+
+typedef struct bench_thread_info_t {
+	deque_t* deque;
+	event_t* start;
+	int* counter;
+	int ops;
+} bench_thread_info_t;
+
+// keeps the math results alive so the compiler cannot remove the loops
+static volatile float s_bench_sink = 0.0f;
+static uint32_t s_bench_seed = 0x9e3779b9;
+
+static uint32_t benchRandom() {
+	s_bench_seed ^= s_bench_seed << 13;
+	s_bench_seed ^= s_bench_seed >> 17;
+	s_bench_seed ^= s_bench_seed << 5;
+	return s_bench_seed;
+}
+
+static float benchRandomFloat() {
+	return (benchRandom() & 0xffff) / 65535.0f * 2.0f - 1.0f;
+}
+
+static double benchNsPerOp(const bench_result_t* result) {
+	if (result->ops == 0) { return 0.0; }
+	return (double) result->ticks * 1000000000.0 / (double) timerGetTicksPerSecond() / (double) result->ops;
+}
+
+static double benchOpsPerSecond(const bench_result_t* result) {
+	if (result->ticks == 0) { return 0.0; }
+	return (double) result->ops * (double) timerGetTicksPerSecond() / (double) result->ticks;
+}
+
+//  --------------------------------------------------------------------------
+//								    REPORT
+//
+
+bench_t* benchCreate(heap_t* heap, int result_capacity) {
+	bench_t* bench = heapAlloc(heap, sizeof(bench_t), 8);
+	bench->heap = heap;
+	bench->results = heapAlloc(heap, sizeof(bench_result_t) * result_capacity, 8);
+	bench->result_count = 0;
+	bench->result_capacity = result_capacity;
+	return bench;
+}
+
+void benchDestroy(bench_t* bench) {
+	heapFree(bench->heap, bench->results);
+	heapFree(bench->heap, bench);
+}
+
+void benchRecord(bench_t* bench, const char* name, uint64_t ops, uint64_t ticks, size_t allocations, size_t bytes) {
+	if (bench->result_count >= bench->result_capacity) {
+		debugPrint(DEBUG_PRINT_WARNING, "Bench Record: out of result space, dropping '%s'.\n", name);
+		return;
+	}
+	bench_result_t* result = &bench->results[bench->result_count++];
+	strcpy_s(result->name, sizeof(result->name), name);
+	result->ops = ops;
+	result->ticks = ticks;
+	result->allocations = allocations;
+	result->bytes = bytes;
+	result->threads = 1;
+	result->efficiency = 1.0;
+}
+
+void benchRecordThreaded(bench_t* bench, const char* name, uint64_t ops, uint64_t ticks, size_t allocations, int threads, double efficiency) {
+	benchRecord(bench, name, ops, ticks, allocations, 0);
+	if (bench->result_count > 0 && strcmp(bench->results[bench->result_count - 1].name, name) == 0) {
+		bench->results[bench->result_count - 1].threads = threads;
+		bench->results[bench->result_count - 1].efficiency = efficiency;
+	}
+}
+
+void benchPrint(bench_t* bench) {
+	for (int x = 0; x < bench->result_count; x++) {
+		bench_result_t* result = &bench->results[x];
+		debugPrintConsole("[ %-28s ] %12.3f ns/op ---- %14.1f ops/s ---- allocs: %zu ---- threads: %d (%.0f%%)\n",
+			result->name, benchNsPerOp(result), benchOpsPerSecond(result), result->allocations,
+			result->threads, result->efficiency * 100.0);
+	}
+}
+
+// Append formatted text to a json buffer, text that does not fit is truncated.
+//
+// RETURN: the new length, never more than capacity - 1
+static size_t benchJsonAppend(char* json, size_t capacity, size_t length, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	int written = vsnprintf(json + length, capacity - length, format, args);
+	va_end(args);
+	return written > 0 ? __min(length + (size_t) written, capacity - 1) : length;
+}
+
+int benchWriteJson(bench_t* bench, fs_t* fs, const char* path) {
+	// each result line is well under 256 characters
+	size_t capacity = 256 + (size_t) bench->result_count * 256;
+	char* json = heapAlloc(bench->heap, capacity, 8);
+	size_t length = 0;
+
+	length = benchJsonAppend(json, capacity, length,
+		"{\n\t\"version\": %d,\n\t\"ticks_per_second\": %llu,\n\t\"results\": [\n",
+		BENCH_REPORT_VERSION, (unsigned long long) timerGetTicksPerSecond());
+
+	for (int x = 0; x < bench->result_count; x++) {
+		bench_result_t* result = &bench->results[x];
+		length = benchJsonAppend(json, capacity, length,
+			"\t\t{\"name\": \"%s\", \"ops\": %llu, \"ns_per_op\": %.3f, \"ops_per_sec\": %.1f, \"allocations\": %zu, \"bytes_per_op\": %zu, \"threads\": %d, \"efficiency\": %.3f}%s\n",
+			result->name, (unsigned long long) result->ops, benchNsPerOp(result), benchOpsPerSecond(result),
+			result->allocations, result->bytes, result->threads, result->efficiency, x + 1 < bench->result_count ? "," : "");
+	}
+
+	length = benchJsonAppend(json, capacity, length, "\t]\n}\n");
+
+	// NOTE: the file system takes ownership of the buffer and frees it once written
+	fs_work_t* work = fsWrite(fs, path, json, length, false);
+	int result = fsWorkGetErrorCode(work);
+	fsWorkDestroy(work);
+	return result;
+}
+
+//  --------------------------------------------------------------------------
+//								     HEAP
+//
+
+static void benchHeap(bench_t* bench) {
+	heap_t* heap = heapCreate(2 * 1024 * 1024);
+	// warm the pool so the first grow is not measured
+	heapFree(heap, heapAlloc(heap, 64, 8));
+
+	size_t allocs = heapGetAllocationCount(heap);
+	uint64_t start = timerGetTicks();
+	for (int x = 0; x < BENCH_HEAP_OPS; x++) {
+		void* block = heapAlloc(heap, 64, 8);
+		heapFree(heap, block);
+	}
+	benchRecord(bench, "heap_alloc_free_64", BENCH_HEAP_OPS, timerGetTicks() - start,
+		heapGetAllocationCount(heap) - allocs, 0);
+
+	void** blocks = heapAlloc(bench->heap, sizeof(void*) * BENCH_HEAP_BATCH, 8);
+	allocs = heapGetAllocationCount(heap);
+	start = timerGetTicks();
+	for (int round = 0; round < BENCH_HEAP_ROUNDS; round++) {
+		for (int x = 0; x < BENCH_HEAP_BATCH; x++) {
+			blocks[x] = heapAlloc(heap, 16 + (x * 37) % 1024, 16);
+		}
+		for (int x = 0; x < BENCH_HEAP_BATCH; x++) {
+			heapFree(heap, blocks[x]);
+		}
+	}
+	benchRecord(bench, "heap_alloc_free_mixed_batch", BENCH_HEAP_ROUNDS * BENCH_HEAP_BATCH, timerGetTicks() - start,
+		heapGetAllocationCount(heap) - allocs, 0);
+	heapFree(bench->heap, blocks);
+
+	heapDestroy(heap);
+}
+
+//  --------------------------------------------------------------------------
+//								    DEQUE
+//
+
+static int benchDequeProducerFunc(void* user) {
+	bench_thread_info_t* info = user;
+	eventWait(info->start);
+	for (int x = 0; x < info->ops; x++) {
+		dequePushBack(info->deque, (void*) (intptr_t) (x + 1));
+	}
+	return 0;
+}
+
+static int benchDequeConsumerFunc(void* user) {
+	bench_thread_info_t* info = user;
+	eventWait(info->start);
+	for (int x = 0; x < info->ops; x++) {
+		dequePopFront(info->deque);
+	}
+	return 0;
+}
+
+static void benchDeque(bench_t* bench, heap_t* heap) {
+	bench_thread_info_t info = {
+		.deque = dequeCreate(heap, BENCH_DEQUE_CAPACITY),
+		.start = eventCreate(),
+		.ops = BENCH_DEQUE_OPS
+	};
+
+	thread_t* threads[BENCH_THREAD_COUNT * 2];
+	for (int x = 0; x < BENCH_THREAD_COUNT; x++) {
+		threads[x * 2] = threadCreate(benchDequeProducerFunc, &info);
+		threads[x * 2 + 1] = threadCreate(benchDequeConsumerFunc, &info);
+	}
+
+	size_t allocs = heapGetAllocationCount(heap);
+	uint64_t start = timerGetTicks();
+	eventSignal(info.start);
+	for (int x = 0; x < _countof(threads); x++) {
+		threadRun(threads[x]);
+	}
+	uint64_t ticks = timerGetTicks() - start;
+
+	// one op is a push and its matching pop
+	benchRecord(bench, "deque_push_pop_contended", (uint64_t) BENCH_DEQUE_OPS * BENCH_THREAD_COUNT, ticks,
+		heapGetAllocationCount(heap) - allocs, 0);
+
+	eventDestroy(info.start);
+	dequeDestroy(info.deque);
+}
+
+//  --------------------------------------------------------------------------
+//								   ATOMICS
+//
+
+static int benchAtomicIncFunc(void* user) {
+	bench_thread_info_t* info = user;
+	eventWait(info->start);
+	for (int x = 0; x < info->ops; x++) {
+		atomicInc(info->counter);
+	}
+	return 0;
+}
+
+static void benchAtomics(bench_t* bench) {
+	int counter = 0;
+	bench_thread_info_t info = {
+		.start = eventCreate(),
+		.counter = &counter,
+		.ops = BENCH_ATOMIC_OPS
+	};
+
+	thread_t* threads[BENCH_THREAD_COUNT];
+	for (int x = 0; x < _countof(threads); x++) {
+		threads[x] = threadCreate(benchAtomicIncFunc, &info);
+	}
+
+	uint64_t start = timerGetTicks();
+	eventSignal(info.start);
+	for (int x = 0; x < _countof(threads); x++) {
+		threadRun(threads[x]);
+	}
+	benchRecord(bench, "atomic_inc_contended", (uint64_t) BENCH_ATOMIC_OPS * BENCH_THREAD_COUNT, timerGetTicks() - start, 0, 0);
+	eventDestroy(info.start);
+
+	counter = 0;
+	start = timerGetTicks();
+	for (int x = 0; x < BENCH_ATOMIC_OPS; x++) {
+		atomicInc(&counter);
+	}
+	benchRecord(bench, "atomic_inc_uncontended", BENCH_ATOMIC_OPS, timerGetTicks() - start, 0, 0);
+
+	counter = 0;
+	start = timerGetTicks();
+	for (int x = 0; x < BENCH_ATOMIC_OPS; x++) {
+		atomicCompareAssign(&counter, x + 1, x);
+	}
+	benchRecord(bench, "atomic_compare_assign", BENCH_ATOMIC_OPS, timerGetTicks() - start, 0, 0);
+
+	counter = 0;
+	start = timerGetTicks();
+	for (int x = 0; x < BENCH_ATOMIC_OPS; x++) {
+		atomicWrite(&counter, atomicRead(&counter) + 1);
+	}
+	benchRecord(bench, "atomic_read_write", BENCH_ATOMIC_OPS, timerGetTicks() - start, 0, 0);
+}
+
+//  --------------------------------------------------------------------------
+//								     ECS
+//
+
+static void benchEcs(bench_t* bench, heap_t* heap) {
+	ecs_t* ecs = ecsCreate(heap);
+	int position_type = ecsComponentRegister(ecs, "position", sizeof(vec3f_t), _Alignof(vec3f_t));
+	int velocity_type = ecsComponentRegister(ecs, "velocity", sizeof(vec3f_t), _Alignof(vec3f_t));
+	uint64_t mask = (1ULL << position_type) | (1ULL << velocity_type);
+
+	ecs_entity_t* entities = heapAlloc(heap, sizeof(ecs_entity_t) * BENCH_ECS_ENTITIES, 8);
+	uint64_t add_ticks = 0;
+	uint64_t query_ticks = 0;
+	uint64_t remove_ticks = 0;
+	uint64_t queried = 0;
+
+	size_t allocs = heapGetAllocationCount(heap);
+	for (int round = 0; round < BENCH_ECS_ROUNDS; round++) {
+		uint64_t start = timerGetTicks();
+		for (int x = 0; x < BENCH_ECS_ENTITIES; x++) {
+			entities[x] = ecsEntityAdd(ecs, mask);
+		}
+		add_ticks += timerGetTicks() - start;
+
+		ecsUpdate(ecs);
+
+		start = timerGetTicks();
+		for (ecs_query_t query = ecsQueryCreate(ecs, mask); ecsQueryValid(ecs, &query); ecsQueryNext(ecs, &query)) {
+			vec3f_t* position = ecsQueryGetComponent(ecs, &query, position_type);
+			vec3f_t* velocity = ecsQueryGetComponent(ecs, &query, velocity_type);
+			*position = vec3fAdd(*position, *velocity);
+			queried++;
+		}
+		query_ticks += timerGetTicks() - start;
+
+		start = timerGetTicks();
+		for (int x = 0; x < BENCH_ECS_ENTITIES; x++) {
+			ecsEntityRemove(ecs, entities[x], false);
+		}
+		remove_ticks += timerGetTicks() - start;
+
+		ecsUpdate(ecs);
+	}
+	size_t allocations = heapGetAllocationCount(heap) - allocs;
+
+	benchRecord(bench, "ecs_entity_add", (uint64_t) BENCH_ECS_ENTITIES * BENCH_ECS_ROUNDS, add_ticks, allocations, 0);
+	benchRecord(bench, "ecs_query_iterate", queried, query_ticks, 0, 0);
+	benchRecord(bench, "ecs_entity_remove", (uint64_t) BENCH_ECS_ENTITIES * BENCH_ECS_ROUNDS, remove_ticks, 0, 0);
+
+	heapFree(heap, entities);
+	ecsDestroy(ecs);
+}
+
+//  --------------------------------------------------------------------------
+//								   HASH TABLE
+//
+
+static void benchHashTable(bench_t* bench, heap_t* heap) {
+	uint64_t* keys = heapAlloc(heap, sizeof(uint64_t) * BENCH_HASHTABLE_KEYS, 8);
+	for (int x = 0; x < BENCH_HASHTABLE_KEYS; x++) {
+		keys[x] = ((uint64_t) benchRandom() << 32) | (uint64_t) x;
+	}
+
+	hasht_t* ht = hashTableCreate(heap, sizeof(uint64_t), sizeof(int), 0);
+	size_t allocs = heapGetAllocationCount(heap);
+	uint64_t start = timerGetTicks();
+	for (int x = 0; x < BENCH_HASHTABLE_KEYS; x++) {
+		hashTableSet(ht, &keys[x], &x);
+	}
+	uint64_t insert_ticks = timerGetTicks() - start;
+	size_t allocations = heapGetAllocationCount(heap) - allocs;
+
+	int found = 0;
+	start = timerGetTicks();
+	for (int x = 0; x < BENCH_HASHTABLE_KEYS; x++) {
+		found += hashTableGet(ht, &keys[x]) != NULL;
+	}
+	uint64_t hit_ticks = timerGetTicks() - start;
+
+	// the low half of a key is its index, so flipping the top bit never hits
+	start = timerGetTicks();
+	for (int x = 0; x < BENCH_HASHTABLE_KEYS; x++) {
+		uint64_t key = keys[x] ^ (1ULL << 63);
+		found += hashTableGet(ht, &key) != NULL;
+	}
+	uint64_t miss_ticks = timerGetTicks() - start;
+
+	start = timerGetTicks();
+	for (int x = 0; x < BENCH_HASHTABLE_KEYS; x++) {
+		found += hashTableRemove(ht, &keys[x]);
+	}
+	uint64_t remove_ticks = timerGetTicks() - start;
+	s_bench_sink += (float) found;
+
+	benchRecord(bench, "hashtable_insert", BENCH_HASHTABLE_KEYS, insert_ticks, allocations, sizeof(uint64_t) + sizeof(int));
+	benchRecord(bench, "hashtable_get_hit", BENCH_HASHTABLE_KEYS, hit_ticks, 0, sizeof(uint64_t));
+	benchRecord(bench, "hashtable_get_miss", BENCH_HASHTABLE_KEYS, miss_ticks, 0, sizeof(uint64_t));
+	benchRecord(bench, "hashtable_remove", BENCH_HASHTABLE_KEYS, remove_ticks, 0, sizeof(uint64_t));
+
+	hashTableDestroy(ht);
+	heapFree(heap, keys);
+}
+
+//  --------------------------------------------------------------------------
+//								     MATH
+//
+
+static void benchMath(bench_t* bench, heap_t* heap) {
+	vec3f_t* vecs = heapAlloc(heap, sizeof(vec3f_t) * BENCH_MATH_COUNT, 16);
+	quatf_t* quats = heapAlloc(heap, sizeof(quatf_t) * BENCH_MATH_COUNT, 16);
+	mat4f_t* mats = heapAlloc(heap, sizeof(mat4f_t) * BENCH_MATH_COUNT, 16);
+
+	for (int x = 0; x < BENCH_MATH_COUNT; x++) {
+		vecs[x] = (vec3f_t){ .x = benchRandomFloat(), .y = benchRandomFloat(), .z = benchRandomFloat() };
+		quats[x] = quatfFromEuler(vecs[x]);
+		mat4fMakeRotation(&mats[x], &quats[x]);
+		mats[x].mat[3][0] = vecs[x].x;
+		mats[x].mat[3][1] = vecs[x].y;
+		mats[x].mat[3][2] = vecs[x].z;
+	}
+
+	const uint64_t ops = (uint64_t) BENCH_MATH_COUNT * BENCH_MATH_ROUNDS;
+	vec3f_t v_acc = vec3fZero();
+	uint64_t start = timerGetTicks();
+	for (int round = 0; round < BENCH_MATH_ROUNDS; round++) {
+		for (int x = 0; x < BENCH_MATH_COUNT; x++) {
+			v_acc = vec3fAdd(v_acc, vecs[x]);
+		}
+	}
+	benchRecord(bench, "vec3f_add", ops, timerGetTicks() - start, 0, 0);
+
+	start = timerGetTicks();
+	for (int round = 0; round < BENCH_MATH_ROUNDS; round++) {
+		for (int x = 1; x < BENCH_MATH_COUNT; x++) {
+			v_acc = vec3fAdd(v_acc, vec3fCross(vecs[x - 1], vecs[x]));
+		}
+	}
+	benchRecord(bench, "vec3f_cross", ops - BENCH_MATH_ROUNDS, timerGetTicks() - start, 0, 0);
+
+	start = timerGetTicks();
+	for (int round = 0; round < BENCH_MATH_ROUNDS; round++) {
+		for (int x = 0; x < BENCH_MATH_COUNT; x++) {
+			v_acc = vec3fAdd(v_acc, vec3fNorm(vecs[x]));
+		}
+	}
+	benchRecord(bench, "vec3f_norm", ops, timerGetTicks() - start, 0, 0);
+
+	quatf_t q_acc = quatfIdentity();
+	start = timerGetTicks();
+	for (int round = 0; round < BENCH_MATH_ROUNDS; round++) {
+		for (int x = 0; x < BENCH_MATH_COUNT; x++) {
+			q_acc = quatfMul(q_acc, quats[x]);
+		}
+	}
+	benchRecord(bench, "quatf_mul", ops, timerGetTicks() - start, 0, 0);
+
+	start = timerGetTicks();
+	for (int round = 0; round < BENCH_MATH_ROUNDS; round++) {
+		for (int x = 0; x < BENCH_MATH_COUNT; x++) {
+			v_acc = vec3fAdd(v_acc, quatfRotateVec(quats[x], vecs[x]));
+		}
+	}
+	benchRecord(bench, "quatf_rotate_vec", ops, timerGetTicks() - start, 0, 0);
+
+	mat4f_t m_acc;
+	start = timerGetTicks();
+	for (int round = 0; round < BENCH_MATH_ROUNDS; round++) {
+		for (int x = 1; x < BENCH_MATH_COUNT; x++) {
+			mat4fMul(&m_acc, &mats[x - 1], &mats[x]);
+			s_bench_sink += m_acc.mat[0][0];
+		}
+	}
+	benchRecord(bench, "mat4f_mul", ops - BENCH_MATH_ROUNDS, timerGetTicks() - start, 0, 0);
+
+	start = timerGetTicks();
+	for (int round = 0; round < BENCH_MATH_ROUNDS; round++) {
+		for (int x = 0; x < BENCH_MATH_COUNT; x++) {
+			mat4fInverse(&mats[x], &m_acc);
+			s_bench_sink += m_acc.mat[3][3];
+		}
+	}
+	benchRecord(bench, "mat4f_inverse", ops, timerGetTicks() - start, 0, 0);
+
+	transform_t* transforms = heapAlloc(heap, sizeof(transform_t) * BENCH_MATH_COUNT, 16);
+	for (int x = 0; x < BENCH_MATH_COUNT; x++) {
+		transforms[x] = (transform_t){ .translation = vecs[x], .scale = vec3fOne(), .rotation = quats[x] };
+	}
+
+	start = timerGetTicks();
+	for (int round = 0; round < BENCH_MATH_ROUNDS; round++) {
+		for (int x = 0; x < BENCH_MATH_COUNT; x++) {
+			transformConvertToMatrix(&transforms[x], &mats[x]);
+		}
+		s_bench_sink += mats[round % BENCH_MATH_COUNT].mat[3][0];
+	}
+	benchRecord(bench, "transform_to_matrix", ops, timerGetTicks() - start, 0, 0);
+
+	start = timerGetTicks();
+	for (int round = 0; round < BENCH_MATH_ROUNDS; round++) {
+		transformConvertToMatrices(transforms, sizeof(transform_t), mats, BENCH_MATH_COUNT);
+		s_bench_sink += mats[round % BENCH_MATH_COUNT].mat[3][0];
+	}
+	benchRecord(bench, "transform_to_matrix_batch", ops, timerGetTicks() - start, 0, 0);
+
+	heapFree(heap, transforms);
+
+	s_bench_sink += v_acc.x + v_acc.y + v_acc.z + q_acc.w;
+
+	heapFree(heap, mats);
+	heapFree(heap, quats);
+	heapFree(heap, vecs);
+}
+
+//  --------------------------------------------------------------------------
+//								      LZ4
+//
+
+static void benchLz4(bench_t* bench, heap_t* heap, fs_t* fs) {
+	static const char* words[] = {
+		"position ", "based ", "dynamics ", "compliant ", "constraint ", "particle ",
+		"solver ", "substep ", "lambda ", "gradient ", "mass ", "cloth\n"
+	};
+
+	// build a text-like (compressible) buffer
+	char* data = heapAlloc(heap, BENCH_LZ4_SIZE, 8);
+	size_t size = 0;
+	while (size < BENCH_LZ4_SIZE) {
+		const char* word = words[benchRandom() % _countof(words)];
+		size_t length = __min(strlen(word), BENCH_LZ4_SIZE - size);
+		memcpy(data + size, word, length);
+		size += length;
+	}
+
+	const char* path = "bench_lz4.bin";
+	uint64_t write_ticks = 0;
+	uint64_t read_ticks = 0;
+	size_t write_allocs = 0;
+	size_t read_allocs = 0;
+
+	for (int round = 0; round < BENCH_LZ4_ROUNDS; round++) {
+		size_t allocs = heapGetAllocationCount(heap);
+		uint64_t start = timerGetTicks();
+		fs_work_t* write_work = fsWrite(fs, path, data, size, true);
+		fsWorkBlock(write_work);
+		write_ticks += timerGetTicks() - start;
+		write_allocs += heapGetAllocationCount(heap) - allocs;
+
+		if (fsWorkGetErrorCode(write_work) != 0) {
+			debugPrint(DEBUG_PRINT_ERROR, "Bench LZ4: unable to write '%s'.\n", path);
+			fsWorkDestroy(write_work);
+			heapFree(heap, data);
+			return;
+		}
+		fsWorkDestroy(write_work);
+
+		allocs = heapGetAllocationCount(heap);
+		start = timerGetTicks();
+		fs_work_t* read_work = fsRead(fs, path, heap, false, true);
+		fsWorkBlock(read_work);
+		read_ticks += timerGetTicks() - start;
+		read_allocs += heapGetAllocationCount(heap) - allocs;
+
+		if (fsWorkGetErrorCode(read_work) != 0 || fsWorkGetSize(read_work) != size ||
+			memcmp(fsWorkGetBuffer(read_work), data, size) != 0) {
+			debugPrint(DEBUG_PRINT_ERROR, "Bench LZ4: read back data does not match.\n");
+		}
+		fsWorkDestroy(read_work);
+	}
+
+	benchRecord(bench, "lz4_compress_write", BENCH_LZ4_ROUNDS, write_ticks, write_allocs, size);
+	benchRecord(bench, "lz4_read_decompress", BENCH_LZ4_ROUNDS, read_ticks, read_allocs, size);
+
+	heapFree(heap, data);
+}
+
+//  --------------------------------------------------------------------------
+//								   PHYSICS
+//
+
+// Square cloth with structural, shear and bend constraints, the top row is pinned.
+static void benchSceneCloth(heap_t* heap, physics_t* physics, int particle_count) {
+	int side = __max((int) sqrtf((float) particle_count), 2);
+	physicsReserve(physics, side * side, side * side * 6);
+
+	for (int y = 0; y < side; y++) {
+		for (int x = 0; x < side; x++) {
+			vec3f_t position = { .x = x * 0.1f, .y = 0.0f, .z = y * 0.1f };
+			physicsParticleAdd(physics, position, y == 0 ? 0.0f : 1.0f);
+		}
+	}
+	for (int y = 0; y < side; y++) {
+		for (int x = 0; x < side; x++) {
+			int p = y * side + x;
+			if (x + 1 < side) { physicsDistanceConstraintAdd(physics, p, p + 1, 0.0f); }
+			if (y + 1 < side) { physicsDistanceConstraintAdd(physics, p, p + side, 0.0f); }
+			if (x + 1 < side && y + 1 < side) {
+				physicsDistanceConstraintAdd(physics, p, p + side + 1, BENCH_PHYSICS_COMPLIANCE);
+				physicsDistanceConstraintAdd(physics, p + 1, p + side, BENCH_PHYSICS_COMPLIANCE);
+			}
+			if (x + 2 < side) { physicsDistanceConstraintAdd(physics, p, p + 2, BENCH_PHYSICS_COMPLIANCE); }
+			if (y + 2 < side) { physicsDistanceConstraintAdd(physics, p, p + side * 2, BENCH_PHYSICS_COMPLIANCE); }
+		}
+	}
+}
+
+// The cloth solved with Jacobi iterations instead of colored batches.
+static void benchSceneClothJacobi(heap_t* heap, physics_t* physics, int particle_count) {
+	benchSceneCloth(heap, physics, particle_count);
+	physicsSetSolverMode(physics, PHYSICS_CONSTRAINT_DISTANCE, PHYSICS_SOLVER_JACOBI);
+}
+
+// The cloth swinging down onto a static floor mesh half its size below the pinned row.
+static void benchSceneClothFloor(heap_t* heap, physics_t* physics, int particle_count) {
+	benchSceneCloth(heap, physics, particle_count);
+	int side = __max((int) sqrtf((float) particle_count), 2);
+	float size = side * 0.1f;
+
+	const int vertex_side = BENCH_PHYSICS_FLOOR_QUADS + 1;
+	vec3f_t* vertices = heapAlloc(heap, sizeof(vec3f_t) * vertex_side * vertex_side, 8);
+	uint16_t* indices = heapAlloc(heap, sizeof(uint16_t) * BENCH_PHYSICS_FLOOR_QUADS * BENCH_PHYSICS_FLOOR_QUADS * 6, 8);
+	for (int z = 0; z < vertex_side; z++) {
+		for (int x = 0; x < vertex_side; x++) {
+			float u = (float) x / BENCH_PHYSICS_FLOOR_QUADS;
+			float v = (float) z / BENCH_PHYSICS_FLOOR_QUADS;
+			vertices[z * vertex_side + x] = (vec3f_t) { .x = (u * 3.0f - 1.0f) * size, .y = size * -0.5f, .z = (v * 3.0f - 1.5f) * size };
+		}
+	}
+	uint16_t* index = indices;
+	for (int z = 0; z < BENCH_PHYSICS_FLOOR_QUADS; z++) {
+		for (int x = 0; x < BENCH_PHYSICS_FLOOR_QUADS; x++) {
+			uint16_t v = (uint16_t) (z * vertex_side + x);
+			*index++ = v;
+			*index++ = v + 1;
+			*index++ = v + vertex_side + 1;
+			*index++ = v;
+			*index++ = v + vertex_side + 1;
+			*index++ = v + vertex_side;
+		}
+	}
+
+	gpu_mesh_info_t floor = {
+		.layout = GPU_MESH_LAYOUT_TRI_P444_I2,
+		.vtx_data = vertices,
+		.idx_data = indices,
+		.vtx_data_size = sizeof(vec3f_t) * vertex_side * vertex_side,
+		.idx_data_size = sizeof(uint16_t) * BENCH_PHYSICS_FLOOR_QUADS * BENCH_PHYSICS_FLOOR_QUADS * 6,
+	};
+	physicsStaticMeshAdd(physics, &floor, NULL);
+
+	heapFree(heap, indices);
+	heapFree(heap, vertices);
+}
+
+// Square cloth with structural and shear constraints and a dihedral bending constraint on every
+// interior edge, the top row is pinned.
+static void benchSceneClothBending(heap_t* heap, physics_t* physics, int particle_count) {
+	int side = __max((int) sqrtf((float) particle_count), 2);
+	physicsReserve(physics, side * side, side * side * 4);
+
+	for (int y = 0; y < side; y++) {
+		for (int x = 0; x < side; x++) {
+			vec3f_t position = { .x = x * 0.1f, .y = 0.0f, .z = y * 0.1f };
+			physicsParticleAdd(physics, position, y == 0 ? 0.0f : 1.0f);
+		}
+	}
+
+	// every quad is split along its diagonal p, p + side + 1, its wings are the other corners
+	for (int y = 0; y < side; y++) {
+		for (int x = 0; x < side; x++) {
+			int p = y * side + x;
+			if (x + 1 < side) { physicsDistanceConstraintAdd(physics, p, p + 1, 0.0f); }
+			if (y + 1 < side) { physicsDistanceConstraintAdd(physics, p, p + side, 0.0f); }
+			if (x + 1 >= side || y + 1 >= side) {
+				continue;
+			}
+			physicsDistanceConstraintAdd(physics, p, p + side + 1, BENCH_PHYSICS_COMPLIANCE);
+			physicsDistanceConstraintAdd(physics, p + 1, p + side, BENCH_PHYSICS_COMPLIANCE);
+			physicsBendingConstraintAdd(physics, p, p + side + 1, p + 1, p + side, BENCH_PHYSICS_COMPLIANCE);
+			if (x + 2 < side) { physicsBendingConstraintAdd(physics, p + 1, p + side + 1, p, p + side + 2, BENCH_PHYSICS_COMPLIANCE); }
+			if (y + 2 < side) { physicsBendingConstraintAdd(physics, p + side, p + side + 1, p, p + side * 2 + 1, BENCH_PHYSICS_COMPLIANCE); }
+		}
+	}
+}
+
+// Hanging ropes with neighbor and bend constraints, the first particle of every rope is pinned.
+static void benchSceneRope(heap_t* heap, physics_t* physics, int particle_count) {
+	int rope_count = __max(particle_count / BENCH_PHYSICS_ROPE_LENGTH, 1);
+	physicsReserve(physics, rope_count * BENCH_PHYSICS_ROPE_LENGTH, rope_count * BENCH_PHYSICS_ROPE_LENGTH * 2);
+
+	for (int rope = 0; rope < rope_count; rope++) {
+		int first = physicsGetParticleCount(physics);
+		for (int x = 0; x < BENCH_PHYSICS_ROPE_LENGTH; x++) {
+			vec3f_t position = { .x = (rope % 1024) * 0.5f, .y = 0.0f, .z = (rope / 1024) * 0.5f + x * 0.1f };
+			physicsParticleAdd(physics, position, x == 0 ? 0.0f : 1.0f);
+		}
+		for (int x = 0; x + 1 < BENCH_PHYSICS_ROPE_LENGTH; x++) {
+			physicsDistanceConstraintAdd(physics, first + x, first + x + 1, 0.0f);
+			if (x + 2 < BENCH_PHYSICS_ROPE_LENGTH) {
+				physicsDistanceConstraintAdd(physics, first + x, first + x + 2, BENCH_PHYSICS_COMPLIANCE);
+			}
+		}
+	}
+}
+
+// Cube of tetrahedra (Kuhn split of every cell) connected by their edges if edges is set, the top face
+// is pinned. The particles of the grid points are added in the order of spawn_points and point_ids maps
+// every grid point to its particle, NULL for both adds them in grid order.
+static void benchSceneTetGrid(physics_t* physics, int side, const int* spawn_points, const int* point_ids, bool edges) {
+	physicsReserve(physics, side * side * side, side * side * side * 7);
+
+	for (int p = 0; p < side * side * side; p++) {
+		int point = spawn_points ? spawn_points[p] : p;
+		int x = point % side;
+		int y = point / side % side;
+		int z = point / (side * side);
+		vec3f_t position = { .x = x * 0.1f, .y = y * 0.1f, .z = z * 0.1f };
+		physicsParticleAdd(physics, position, y == side - 1 ? 0.0f : 1.0f);
+	}
+
+	if (!edges) {
+		return;
+	}
+
+	// every tet edge of the Kuhn split goes along an axis or a positive diagonal
+	static const int offsets[][3] = { {1,0,0}, {0,1,0}, {0,0,1}, {1,1,0}, {1,0,1}, {0,1,1}, {1,1,1} };
+	for (int z = 0; z < side; z++) {
+		for (int y = 0; y < side; y++) {
+			for (int x = 0; x < side; x++) {
+				for (int o = 0; o < _countof(offsets); o++) {
+					int nx = x + offsets[o][0];
+					int ny = y + offsets[o][1];
+					int nz = z + offsets[o][2];
+					if (nx >= side || ny >= side || nz >= side) {
+						continue;
+					}
+					int a = (z * side + y) * side + x;
+					int b = (nz * side + ny) * side + nx;
+					physicsDistanceConstraintAdd(physics, point_ids ? point_ids[a] : a, point_ids ? point_ids[b] : b, BENCH_PHYSICS_COMPLIANCE);
+				}
+			}
+		}
+	}
+}
+
+static void benchSceneTetBlock(heap_t* heap, physics_t* physics, int particle_count) {
+	benchSceneTetGrid(physics, __max((int) cbrtf((float) particle_count), 2), NULL, NULL, true);
+}
+
+// Calls func with the particles of the 6 tets of every cell of a tet grid, every tet goes from the low
+// to the high corner of its cell along the 3 axes in one of their orders.
+static void benchSceneTetForEach(physics_t* physics, int side, void (*func)(physics_t* physics, int a, int b, int c, int d)) {
+	static const int axis_orders[][3] = { {0,1,2}, {0,2,1}, {1,0,2}, {1,2,0}, {2,0,1}, {2,1,0} };
+	const int strides[3] = { 1, side, side * side };
+	for (int z = 0; z + 1 < side; z++) {
+		for (int y = 0; y + 1 < side; y++) {
+			for (int x = 0; x + 1 < side; x++) {
+				int corner = (z * side + y) * side + x;
+				for (int o = 0; o < _countof(axis_orders); o++) {
+					int b = corner + strides[axis_orders[o][0]];
+					int c = b + strides[axis_orders[o][1]];
+					func(physics, corner, b, c, c + strides[axis_orders[o][2]]);
+				}
+			}
+		}
+	}
+}
+
+static void benchSceneTetAddVolume(physics_t* physics, int a, int b, int c, int d) {
+	physicsVolumeConstraintAdd(physics, a, b, c, d, 0.0f);
+}
+
+static void benchSceneTetAddNeoHookean(physics_t* physics, int a, int b, int c, int d) {
+	physicsNeoHookeanConstraintAdd(physics, a, b, c, d, 1.0f / BENCH_PHYSICS_MU, 1.0f / BENCH_PHYSICS_LAMBDA);
+}
+
+// The tet block with an incompressible volume constraint on every tet.
+static void benchSceneTetVolume(heap_t* heap, physics_t* physics, int particle_count) {
+	int side = __max((int) cbrtf((float) particle_count), 2);
+	benchSceneTetGrid(physics, side, NULL, NULL, true);
+	benchSceneTetForEach(physics, side, benchSceneTetAddVolume);
+}
+
+// The tet block held together only by Neo-Hookean tets.
+static void benchSceneTetNeoHookean(heap_t* heap, physics_t* physics, int particle_count) {
+	int side = __max((int) cbrtf((float) particle_count), 2);
+	benchSceneTetGrid(physics, side, NULL, NULL, false);
+	benchSceneTetForEach(physics, side, benchSceneTetAddNeoHookean);
+}
+
+// The tet block with its particles added in random order, as if they were spawned one by one.
+static void benchSceneTetShuffled(heap_t* heap, physics_t* physics, int particle_count) {
+	int side = __max((int) cbrtf((float) particle_count), 2);
+	int point_count = side * side * side;
+	int* spawn_points = heapAlloc(heap, sizeof(int) * point_count, 8);
+	int* point_ids = heapAlloc(heap, sizeof(int) * point_count, 8);
+	for (int p = 0; p < point_count; p++) {
+		spawn_points[p] = p;
+	}
+	uint32_t state = 12345;
+	for (int p = point_count - 1; p > 0; p--) {
+		state = state * 1664525u + 1013904223u;
+		int other = (int) (state % (uint32_t) (p + 1));
+		int swap = spawn_points[p];
+		spawn_points[p] = spawn_points[other];
+		spawn_points[other] = swap;
+	}
+	for (int p = 0; p < point_count; p++) {
+		point_ids[spawn_points[p]] = p;
+	}
+
+	benchSceneTetGrid(physics, side, spawn_points, point_ids, true);
+	heapFree(heap, point_ids);
+	heapFree(heap, spawn_points);
+}
+
+// Rigid boxes of 3x3x3 particles as shape matching clusters, every box swings from a pinned corner.
+static void benchSceneClusters(heap_t* heap, physics_t* physics, int particle_count) {
+	int box_count = __max(particle_count / 27, 1);
+	physicsReserve(physics, box_count * 27, 0);
+
+	for (int box = 0; box < box_count; box++) {
+		vec3f_t corner = { .x = (box % 1024) * 0.5f, .y = 0.0f, .z = (box / 1024) * 0.5f };
+		int particles[27];
+		for (int x = 0; x < 27; x++) {
+			vec3f_t position = vec3fAdd(corner, (vec3f_t) { .x = (x % 3) * 0.1f, .y = (x / 3 % 3) * 0.1f, .z = (x / 9) * 0.1f });
+			particles[x] = physicsParticleAdd(physics, position, x == 0 ? 0.0f : 1.0f);
+		}
+		physicsClusterAdd(physics, particles, 27, 1.0f, NULL);
+	}
+}
+
+// Block of loose particles resting on a pinned floor layer, held together only by particle collisions.
+static void benchSceneGranular(heap_t* heap, physics_t* physics, int particle_count) {
+	const float radius = 0.05f;
+	int side = __max((int) cbrtf((float) particle_count), 2);
+	physicsReserve(physics, side * side * side, 0);
+	physicsSetParticleCollision(physics, radius, 0.0f);
+
+	for (int z = 0; z < side; z++) {
+		for (int x = 0; x < side; x++) {
+			vec3f_t position = { .x = x * radius * 2.0f, .y = 0.0f, .z = z * radius * 2.0f };
+			physicsParticleAdd(physics, position, 0.0f);
+		}
+	}
+
+	// slightly overlapping and shifted by half a particle, so the block settles into the floor gaps
+	for (int y = 1; y < side; y++) {
+		for (int z = 0; z < side; z++) {
+			for (int x = 0; x < side; x++) {
+				vec3f_t position = { .x = (x + 0.5f) * radius * 1.9f, .y = y * radius * 1.9f, .z = (z + 0.5f) * radius * 1.9f };
+				physicsParticleAdd(physics, position, 1.0f);
+			}
+		}
+	}
+}
+
+// Short stacks of particles resting on pinned ones, with gaps between them so every stack is an island.
+static void benchSceneStacks(heap_t* heap, physics_t* physics, int particle_count) {
+	const float radius = 0.05f;
+	int side = __max((int) sqrtf(particle_count / (float) BENCH_PHYSICS_STACK_HEIGHT), 1);
+	physicsReserve(physics, side * side * BENCH_PHYSICS_STACK_HEIGHT, 0);
+	physicsSetParticleCollision(physics, radius, 0.0f);
+
+	for (int z = 0; z < side; z++) {
+		for (int x = 0; x < side; x++) {
+			for (int y = 0; y < BENCH_PHYSICS_STACK_HEIGHT; y++) {
+				vec3f_t position = { .x = x * radius * 3.0f, .y = y * radius * 2.0f, .z = z * radius * 3.0f };
+				physicsParticleAdd(physics, position, y == 0 ? 0.0f : 1.0f);
+			}
+		}
+	}
+}
+
+// The stacks, settled until they fall asleep.
+static void benchSceneStacksSleeping(heap_t* heap, physics_t* physics, int particle_count) {
+	benchSceneStacks(heap, physics, particle_count);
+	physicsSetSleeping(physics, 1e-4f, 10);
+	for (int frame = 0; frame < 30; frame++) {
+		physicsUpdate(physics, 1.0f / 60.0f);
+	}
+}
+
+static uint64_t benchPhysicsRun(heap_t* heap, job_pool_t* pool, const bench_scene_t* scene, int particle_count, int substeps, int frames, uint64_t* ops) {
+	physics_t* physics = physicsCreate(heap);
+	physicsSetJobPool(physics, pool);
+	physicsSetSubsteps(physics, substeps);
+	physicsSetReorderInterval(physics, scene->reorder_interval);
+	scene->build(heap, physics, particle_count);
+
+	// the first update colors (and reorders) the constraints, keep it out of the timing
+	const float dt = 1.0f / 60.0f;
+	physicsUpdate(physics, dt);
+
+	uint64_t start = timerGetTicks();
+	for (int frame = 0; frame < frames; frame++) {
+		physicsUpdate(physics, dt);
+	}
+	uint64_t ticks = timerGetTicks() - start;
+
+	*ops = (uint64_t) physicsGetConstraintCount(physics) * substeps * frames;
+	s_bench_sink += physicsParticleGetPosition(physics, physicsGetParticleCount(physics) - 1).y;
+	physicsDestroy(physics);
+	return ticks;
+}
+
+void benchPhysicsScaling(heap_t* heap, fs_t* fs, const char* path, int frames, int max_particles) {
+	static const bench_scene_t scenes[] = {
+		{ "cloth", benchSceneCloth, 0 },
+		{ "cloth_jacobi", benchSceneClothJacobi, 0 },
+		{ "cloth_bending", benchSceneClothBending, 0 },
+		{ "cloth_floor", benchSceneClothFloor, 0 },
+		{ "rope", benchSceneRope, 0 },
+		{ "tet", benchSceneTetBlock, 0 },
+		{ "tet_volume", benchSceneTetVolume, 0 },
+		{ "tet_neohookean", benchSceneTetNeoHookean, 0 },
+		{ "tet_shuffled", benchSceneTetShuffled, 0 },
+		{ "tet_shuffled_morton", benchSceneTetShuffled, 64 },
+		{ "clusters", benchSceneClusters, 0 },
+		{ "granular", benchSceneGranular, 0 },
+		{ "stacks", benchSceneStacks, 0 },
+		{ "stacks_sleeping", benchSceneStacksSleeping, 0 },
+	};
+	static const int particle_counts[] = { 1000, 10000, 100000, 1000000 };
+	static const int substep_counts[] = { 1, 4, 8 };
+
+	int core_count = __max(threadGetCoreCount(), 1);
+	int thread_counts[32];
+	int thread_count_count = 0;
+	for (int threads = 1; threads < core_count && thread_count_count < _countof(thread_counts) - 1; threads *= 2) {
+		thread_counts[thread_count_count++] = threads;
+	}
+	thread_counts[thread_count_count++] = core_count;
+
+	int size_count = 0;
+	while (size_count < _countof(particle_counts) && particle_counts[size_count] <= max_particles) {
+		size_count++;
+	}
+
+	bench_t* bench = benchCreate(heap, _countof(scenes) * size_count * _countof(substep_counts) * thread_count_count);
+
+	for (int t = 0; t < thread_count_count; t++) {
+		job_pool_t* pool = jobPoolCreate(heap, thread_counts[t]);
+		for (int s = 0; s < _countof(scenes); s++) {
+			for (int p = 0; p < size_count; p++) {
+				for (int k = 0; k < _countof(substep_counts); k++) {
+					uint64_t ops = 0;
+					size_t allocs = heapGetAllocationCount(heap);
+					uint64_t ticks = benchPhysicsRun(heap, pool, &scenes[s], particle_counts[p], substep_counts[k], frames, &ops);
+					allocs = heapGetAllocationCount(heap) - allocs;
+
+					// the single thread run of the same case comes first, scale against it
+					char name[64];
+					snprintf(name, sizeof(name), "xpbd_%s_%dk_s%d_t%d", scenes[s].name, particle_counts[p] / 1000, substep_counts[k], thread_counts[t]);
+					double efficiency = 1.0;
+					if (t > 0) {
+						int base = (s * size_count + p) * _countof(substep_counts) + k;
+						uint64_t base_ticks = bench->results[base].ticks;
+						efficiency = ticks ? (double) base_ticks / (double) ticks / thread_counts[t] : 0.0;
+					}
+					benchRecordThreaded(bench, name, ops, ticks, allocs, thread_counts[t], efficiency);
+				}
+			}
+		}
+		jobPoolDestroy(pool);
+	}
+
+	benchPrint(bench);
+	if (benchWriteJson(bench, fs, path) != 0) {
+		debugPrint(DEBUG_PRINT_ERROR, "Bench Physics Scaling: unable to write the report to '%s'.\n", path);
+	}
+
+	benchDestroy(bench);
+}
+
+//  --------------------------------------------------------------------------
+//								    RENDERER
+//
+
+typedef struct bench_model_uniform_t {
+	mat4f_t projection;
+	mat4f_t view;
+	mat4f_t model;
+} bench_model_uniform_t;
+
+typedef struct bench_instance_uniform_t {
+	mat4f_t projection;
+	mat4f_t view;
+} bench_instance_uniform_t;
+
+// Draw x uses mesh x % mesh_count and shader (x / mesh_count) % shader_count, so consecutive draws never share both.
+static void benchRendererFrames(renderer_t* render, int frames, bool instanced, gpu_mesh_info_t* meshes, int mesh_count, gpu_shader_info_t* shaders, int shader_count) {
+	int draw_count = instanced ? BENCH_RENDERER_INSTANCES : BENCH_RENDERER_MODELS;
+	for (int frame = 0; frame < frames; frame++) {
+		bench_model_uniform_t uniform_data;
+		mat4fMakeIdentity(&uniform_data.projection);
+		mat4fMakeIdentity(&uniform_data.view);
+		for (int x = 0; x < draw_count; x++) {
+			gpu_mesh_info_t* mesh = &meshes[x % mesh_count];
+			gpu_shader_info_t* shader = &shaders[(x / mesh_count) % shader_count];
+			vec3f_t position = { (float) (x % 64) * 3.0f, (float) (x / 64) * 3.0f, (float) frame };
+			mat4fMakeTranslation(&uniform_data.model, &position);
+			if (instanced) {
+				gpu_uniform_buffer_info_t uniform_info = { .data = &uniform_data, .size = sizeof(bench_instance_uniform_t) };
+				rendererModelInstanceAdd(render, mesh, shader, &uniform_info, &uniform_data.model);
+			} else {
+				ecs_entity_t entity = { .entity = x, .sequence = 1 };
+				gpu_uniform_buffer_info_t uniform_info = { .data = &uniform_data, .size = sizeof(uniform_data) };
+				rendererModelAdd(render, &entity, mesh, shader, &uniform_info, vec3fMagnitude(position));
+			}
+		}
+		rendererFrameDone(render);
+	}
+}
+
+static void benchRendererCase(bench_t* bench, heap_t* heap, fs_t* fs, wm_window_t* window, const char* name, int frames, bool instanced, gpu_mesh_info_t* meshes, int mesh_count, gpu_shader_info_t* shaders, int shader_count) {
+	renderer_t* render = rendererCreate(heap, fs, window);
+	rendererSetDrawHashEnabled(render, true);
+
+	// the first frame creates every gpu resource, keep it out of the timing
+	benchRendererFrames(render, 1, instanced, meshes, mesh_count, shaders, shader_count);
+	while (rendererGetFrameCount(render) < 1) {
+		threadSleep(1);
+	}
+	gpu_stats_t before;
+	rendererGetGpuStats(render, &before);
+
+	size_t allocs = heapGetAllocationCount(heap);
+	uint64_t start = timerGetTicks();
+	benchRendererFrames(render, frames, instanced, meshes, mesh_count, shaders, shader_count);
+	while (rendererGetFrameCount(render) < frames + 1) {
+		threadSleep(0);
+	}
+	uint64_t ticks = timerGetTicks() - start;
+	allocs = heapGetAllocationCount(heap) - allocs;
+
+	gpu_stats_t after;
+	rendererGetGpuStats(render, &after);
+	rendererDestroy(render);
+
+	uint64_t ops = (uint64_t) (instanced ? BENCH_RENDERER_INSTANCES : BENCH_RENDERER_MODELS) * frames;
+	benchRecord(bench, name, ops, ticks, allocs, (size_t) ((after.upload_bytes - before.upload_bytes) / ops));
+	debugPrint(DEBUG_PRINT_INFO, "%s: %llu draws, %llu pipeline binds, %llu mesh binds, draw hash %016llx\n", name,
+		(unsigned long long) (after.draws - before.draws), (unsigned long long) (after.pipeline_binds - before.pipeline_binds),
+		(unsigned long long) (after.mesh_binds - before.mesh_binds), (unsigned long long) after.draw_hash);
+}
+
+void benchRenderer(heap_t* heap, fs_t* fs, wm_window_t* window, const char* path, int frames) {
+	bench_t* bench = benchCreate(heap, 3);
+
+	// a missing shader only matters to the vulkan backend
+	fs_work_t* shader_work[3] = {
+		fsRead(fs, "shaders/triangle.vert.spv", heap, false, false),
+		fsRead(fs, "shaders/triangle.frag.spv", heap, false, false),
+		fsRead(fs, "shaders/triangle_instanced.vert.spv", heap, false, false),
+	};
+	for (int x = 0; x < _countof(shader_work); x++) {
+		fsWorkBlock(shader_work[x]);
+	}
+
+	gpu_shader_info_t model_shader = {
+		.vtx_shader_data = fsWorkGetBuffer(shader_work[0]),
+		.vtx_shader_size = fsWorkGetSize(shader_work[0]),
+		.frag_shader_data = fsWorkGetBuffer(shader_work[1]),
+		.frag_shader_size = fsWorkGetSize(shader_work[1]),
+		.uniform_buffer_count = 1
+	};
+	gpu_shader_info_t instance_shader = model_shader;
+	instance_shader.vtx_shader_data = fsWorkGetBuffer(shader_work[2]);
+	instance_shader.vtx_shader_size = fsWorkGetSize(shader_work[2]);
+	instance_shader.instance_stride = sizeof(mat4f_t);
+
+	static vec3f_t cube_vtx[] = {
+		{ -1.0f, -1.0f,  1.0f }, { 0.0f, 1.0f,  1.0f },
+		{  1.0f, -1.0f,  1.0f }, { 1.0f, 0.0f,  1.0f },
+		{  1.0f,  1.0f,  1.0f }, { 1.0f, 1.0f,  0.0f },
+		{ -1.0f,  1.0f,  1.0f }, { 1.0f, 0.0f,  0.0f },
+		{ -1.0f, -1.0f, -1.0f }, { 0.0f, 1.0f,  0.0f },
+		{  1.0f, -1.0f, -1.0f }, { 0.0f, 0.0f,  1.0f },
+		{  1.0f,  1.0f, -1.0f }, { 1.0f, 1.0f,  1.0f },
+		{ -1.0f,  1.0f, -1.0f }, { 0.0f, 0.0f,  0.0f },
+	};
+	static uint16_t cube_idx[] = {
+		0, 1, 2, 2, 3, 0,
+		1, 5, 6, 6, 2, 1,
+		7, 6, 5, 5, 4, 7,
+		4, 0, 3, 3, 7, 4,
+		4, 5, 1, 1, 0, 4,
+		3, 2, 6, 6, 7, 3
+	};
+	gpu_mesh_info_t cube_mesh = {
+		.layout = GPU_MESH_LAYOUT_TRI_P444_C444_I2,
+		.vtx_data = cube_vtx,
+		.vtx_data_size = sizeof(cube_vtx),
+		.idx_data = cube_idx,
+		.idx_data_size = sizeof(cube_idx),
+	};
+
+	// copies are separate materials and meshes to the renderer, it caches by info pointer
+	gpu_shader_info_t material_shaders[BENCH_RENDERER_MATERIALS];
+	gpu_mesh_info_t material_meshes[BENCH_RENDERER_MATERIALS];
+	for (int x = 0; x < BENCH_RENDERER_MATERIALS; x++) {
+		material_shaders[x] = model_shader;
+		material_meshes[x] = cube_mesh;
+	}
+
+	benchRendererCase(bench, heap, fs, window, "renderer_model_draw", frames, false, &cube_mesh, 1, &model_shader, 1);
+	benchRendererCase(bench, heap, fs, window, "renderer_material_draw", frames, false, material_meshes, BENCH_RENDERER_MATERIALS, material_shaders, BENCH_RENDERER_MATERIALS);
+	benchRendererCase(bench, heap, fs, window, "renderer_instanced_draw", frames, true, &cube_mesh, 1, &instance_shader, 1);
+
+	for (int x = 0; x < _countof(shader_work); x++) {
+		fsWorkDestroy(shader_work[x]);
+	}
+
+	benchPrint(bench);
+	if (benchWriteJson(bench, fs, path) != 0) {
+		debugPrint(DEBUG_PRINT_ERROR, "Bench Renderer: unable to write the report to '%s'.\n", path);
+	}
+
+	benchDestroy(bench);
+}
+
+//  --------------------------------------------------------------------------
+//								     SUITE
+//
+
+void benchPrimitives(heap_t* heap, fs_t* fs, const char* path) {
+	bench_t* bench = benchCreate(heap, 64);
+
+	benchHeap(bench);
+	benchDeque(bench, heap);
+	benchAtomics(bench);
+	benchEcs(bench, heap);
+	benchHashTable(bench, heap);
+	benchMath(bench, heap);
+	benchLz4(bench, heap, fs);
+
+	benchPrint(bench);
+	if (benchWriteJson(bench, fs, path) != 0) {
+		debugPrint(DEBUG_PRINT_ERROR, "Bench Primitives: unable to write the report to '%s'.\n", path);
+	}
+
+	benchDestroy(bench);
+}
@@ -0,0 +1,73 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* BENCHMARKING SUITE
+*	- times a case over a number of operations and records ns/op, ops/s and
+*	  the heap allocations made while the case was running
+*	- results are written as JSON so every performance change can be compared
+*	  against a previous run
+*/
+
+typedef struct bench_t bench_t;
+
+typedef struct heap_t heap_t;
+typedef struct fs_t fs_t;
+typedef struct wm_window_t wm_window_t;
+
+// Version of the JSON report layout, bump this whenever a field changes.
+#define BENCH_REPORT_VERSION 2
+
+// Creates a benchmark report that can hold up to result_capacity results.
+//
+// RETURN: the new benchmark report
+bench_t* benchCreate(heap_t* heap, int result_capacity);
+
+// Destroys the benchmark report.
+//
+void benchDestroy(bench_t* bench);
+
+// Records a result to the report.
+// Ticks are OS-defined ticks (see timer.h), bytes is the amount of data processed per operation (0 if none).
+//
+void benchRecord(bench_t* bench, const char* name, uint64_t ops, uint64_t ticks, size_t allocations, size_t bytes);
+
+// Records a result of a case that ran on several threads.
+// Efficiency is the speedup over the single thread run divided by the thread count (1 is perfect scaling).
+//
+void benchRecordThreaded(bench_t* bench, const char* name, uint64_t ops, uint64_t ticks, size_t allocations, int threads, double efficiency);
+
+// Prints every recorded result to the console.
+//
+void benchPrint(bench_t* bench);
+
+// Writes every recorded result to the path as JSON.
+// The JSON buffer is handed to fsWrite, which frees it out of the file system heap,
+// so the report has to be created from the same heap as fs.
+//
+// RETURN: 0 on success, the file error code otherwise
+int benchWriteJson(bench_t* bench, fs_t* fs, const char* path);
+
+// Runs every engine primitive benchmark: heap, deque, atomics, ecs, hash table, math and lz4 (through fs_t).
+// The report is written to path as JSON.
+//
+void benchPrimitives(heap_t* heap, fs_t* fs, const char* path);
+
+// Runs the XPBD scaling sweep: cloth, rope and tet block scenes from 1K up to max_particles particles,
+// every scene at 1, 4 and 8 substeps on 1, 2, 4 ... up to every core.
+// Each case is stepped headless for frames frames, one op is a single constraint solve.
+// The report is written to path as JSON.
+//
+void benchPhysicsScaling(heap_t* heap, fs_t* fs, const char* path, int frames, int max_particles);
+
+// Runs the render thread for frames frames of separate model draws (of one and of 8 x 8 shader/mesh
+// combinations) and then of one instanced batch, one op is a single model/instance. Built with GPU_NULL
+// the window can be NULL and the cases measure only the cpu side of the renderer, the draw stream hash
+// is printed so two builds can be compared.
+// The report is written to path as JSON.
+//
+void benchRenderer(heap_t* heap, fs_t* fs, wm_window_t* window, const char* path, int frames);
+
+#endif
@@ -6,6 +6,7 @@
 // predef
 typedef struct transform_t transform_t;
 typedef struct mat4f_t mat4f_t;
+typedef struct vec3f_t vec3f_t;
 typedef struct gpu_mesh_info_t gpu_mesh_info_t;
 typedef struct gpu_shader_info_t gpu_shader_info_t;
 
@@ -19,9 +20,13 @@ typedef struct camera_component_t {
 	mat4f_t view;
 } camera_component_t;
 
+// a model whose shader has an instance stride of one mat4f_t is drawn instanced: the shader gets the
+// projection and view matrices as its uniform and the model matrix per instance
 typedef struct model_component_t {
 	gpu_mesh_info_t* mesh_info;
 	gpu_shader_info_t* shader_info;
+	vec3f_t bounds_center;		// local space bounding sphere of the mesh (cullMeshBounds)
+	float bounds_radius;
 } model_component_t;
 
 typedef struct model_texture_component_t {
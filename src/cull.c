@@ -0,0 +1,280 @@
+#include "cull.h"
+
+#include "gpu.h"
+#include "heap.h"
+#include "job.h"
+#include "mat4f.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__AVX__)
+#define CULL_AVX 1
+#define CULL_SSE 1
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#define CULL_AVX 0
+#define CULL_SSE 1
+#include <xmmintrin.h>
+#else
+#define CULL_AVX 0
+#define CULL_SSE 0
+#endif
+
+#define CULL_INITIAL_CAPACITY 256
+#define CULL_CHUNK_SIZE 1024				// spheres per chunk, a multiple of the SIMD width
+
+typedef struct cull_t {
+	heap_t* heap;
+
+	// SoA bounding spheres
+	float* center_x;
+	float* center_y;
+	float* center_z;
+	float* radius;
+	int count;
+	int capacity;
+
+	int* visible;							// capacity entries, chunks write their visible indices at their own offset
+	int visible_count;
+	int* chunk_visible;						// visible count per chunk
+	int chunk_capacity;
+
+	const cull_frustum_t* frustum;			// frustum of the running cull
+} cull_t;
+
+static void cullChunkFunc(void* user, int begin, int end, int worker);
+static int cullChunk(cull_t* cull, int begin, int end);
+
+cull_t* cullCreate(heap_t* heap) {
+	cull_t* cull = heapAlloc(heap, sizeof(cull_t), 8);
+	memset(cull, 0, sizeof(*cull));
+	cull->heap = heap;
+	return cull;
+}
+
+void cullDestroy(cull_t* cull) {
+	heapFree(cull->heap, cull->center_x);
+	heapFree(cull->heap, cull->center_y);
+	heapFree(cull->heap, cull->center_z);
+	heapFree(cull->heap, cull->radius);
+	heapFree(cull->heap, cull->visible);
+	heapFree(cull->heap, cull->chunk_visible);
+	heapFree(cull->heap, cull);
+}
+
+void cullClear(cull_t* cull) {
+	cull->count = 0;
+	cull->visible_count = 0;
+}
+
+static float* cullGrowArray(cull_t* cull, float* array, int capacity) {
+	float* new_array = heapAlloc(cull->heap, sizeof(float) * capacity, 32);
+	if (array) {
+		memcpy(new_array, array, sizeof(float) * cull->count);
+		heapFree(cull->heap, array);
+	}
+	return new_array;
+}
+
+int cullSphereAdd(cull_t* cull, vec3f_t center, float radius) {
+	if (cull->count == cull->capacity) {
+		int capacity = __max(cull->capacity * 2, CULL_INITIAL_CAPACITY);
+		cull->center_x = cullGrowArray(cull, cull->center_x, capacity);
+		cull->center_y = cullGrowArray(cull, cull->center_y, capacity);
+		cull->center_z = cullGrowArray(cull, cull->center_z, capacity);
+		cull->radius = cullGrowArray(cull, cull->radius, capacity);
+		heapFree(cull->heap, cull->visible);
+		cull->visible = heapAlloc(cull->heap, sizeof(int) * capacity, 32);
+		cull->visible_count = 0;
+		cull->capacity = capacity;
+	}
+
+	cull->center_x[cull->count] = center.x;
+	cull->center_y[cull->count] = center.y;
+	cull->center_z[cull->count] = center.z;
+	cull->radius[cull->count] = radius;
+	return cull->count++;
+}
+
+int cullBoxAdd(cull_t* cull, vec3f_t min, vec3f_t max) {
+	vec3f_t center = vec3fScale(vec3fAdd(min, max), 0.5f);
+	return cullSphereAdd(cull, center, vec3fDistance(center, max));
+}
+
+int cullGetCount(cull_t* cull) {
+	return cull->count;
+}
+
+int cullRun(cull_t* cull, const cull_frustum_t* frustum, job_pool_t* pool) {
+	int chunk_count = (cull->count + CULL_CHUNK_SIZE - 1) / CULL_CHUNK_SIZE;
+	if (chunk_count > cull->chunk_capacity) {
+		heapFree(cull->heap, cull->chunk_visible);
+		cull->chunk_capacity = __max(cull->chunk_capacity * 2, chunk_count);
+		cull->chunk_visible = heapAlloc(cull->heap, sizeof(int) * cull->chunk_capacity, 8);
+	}
+
+	cull->frustum = frustum;
+	jobPoolParallelFor(pool, cull->count, CULL_CHUNK_SIZE, cullChunkFunc, cull);
+	cull->frustum = NULL;
+
+	// the first chunk already starts at 0, the others are moved down behind it
+	int visible_count = chunk_count ? cull->chunk_visible[0] : 0;
+	for (int x = 1; x < chunk_count; x++) {
+		memmove(cull->visible + visible_count, cull->visible + x * CULL_CHUNK_SIZE, sizeof(int) * cull->chunk_visible[x]);
+		visible_count += cull->chunk_visible[x];
+	}
+	cull->visible_count = visible_count;
+	return visible_count;
+}
+
+const int* cullGetVisible(cull_t* cull) {
+	return cull->visible;
+}
+
+// A pool that runs inline hands over the whole range, it is split into chunks again here.
+static void cullChunkFunc(void* user, int begin, int end, int worker) {
+	cull_t* cull = user;
+	for (int chunk_begin = begin; chunk_begin < end; chunk_begin += CULL_CHUNK_SIZE) {
+		int chunk_end = __min(chunk_begin + CULL_CHUNK_SIZE, end);
+		cull->chunk_visible[chunk_begin / CULL_CHUNK_SIZE] = cullChunk(cull, chunk_begin, chunk_end);
+	}
+}
+
+// Tests the spheres [begin, end) and writes the visible ones to visible[begin...].
+//
+// RETURN: the number of visible spheres
+static int cullChunk(cull_t* cull, int begin, int end) {
+	const float (*planes)[4] = cull->frustum->planes;
+	int* visible = cull->visible + begin;
+	int visible_count = 0;
+	int x = begin;
+
+#if CULL_AVX
+	__m256 plane_avx[6][4];
+	for (int p = 0; p < 6; p++) {
+		for (int c = 0; c < 4; c++) {
+			plane_avx[p][c] = _mm256_set1_ps(planes[p][c]);
+		}
+	}
+	for (; x + 8 <= end; x += 8) {
+		__m256 cx = _mm256_loadu_ps(cull->center_x + x);
+		__m256 cy = _mm256_loadu_ps(cull->center_y + x);
+		__m256 cz = _mm256_loadu_ps(cull->center_z + x);
+		__m256 neg_radius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(cull->radius + x));
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++) {
+			__m256 distance = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(plane_avx[p][0], cx), _mm256_mul_ps(plane_avx[p][1], cy)),
+				_mm256_add_ps(_mm256_mul_ps(plane_avx[p][2], cz), plane_avx[p][3]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, neg_radius, _CMP_GE_OQ));
+		}
+
+		// branchless compaction, every lane is written and only the visible ones advance the count
+		int mask = _mm256_movemask_ps(inside);
+		for (int lane = 0; lane < 8; lane++) {
+			visible[visible_count] = x + lane;
+			visible_count += (mask >> lane) & 1;
+		}
+	}
+#elif CULL_SSE
+	__m128 plane_sse[6][4];
+	for (int p = 0; p < 6; p++) {
+		for (int c = 0; c < 4; c++) {
+			plane_sse[p][c] = _mm_set1_ps(planes[p][c]);
+		}
+	}
+	for (; x + 4 <= end; x += 4) {
+		__m128 cx = _mm_loadu_ps(cull->center_x + x);
+		__m128 cy = _mm_loadu_ps(cull->center_y + x);
+		__m128 cz = _mm_loadu_ps(cull->center_z + x);
+		__m128 neg_radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(cull->radius + x));
+
+		__m128 inside = _mm_cmpeq_ps(cx, cx);
+		for (int p = 0; p < 6; p++) {
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(plane_sse[p][0], cx), _mm_mul_ps(plane_sse[p][1], cy)),
+				_mm_add_ps(_mm_mul_ps(plane_sse[p][2], cz), plane_sse[p][3]));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, neg_radius));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (int lane = 0; lane < 4; lane++) {
+			visible[visible_count] = x + lane;
+			visible_count += (mask >> lane) & 1;
+		}
+	}
+#endif
+
+	for (; x < end; x++) {
+		bool inside = true;
+		for (int p = 0; p < 6; p++) {
+			float distance = planes[p][0] * cull->center_x[x] + planes[p][1] * cull->center_y[x] + planes[p][2] * cull->center_z[x] + planes[p][3];
+			inside &= distance >= -cull->radius[x];
+		}
+		visible[visible_count] = x;
+		visible_count += inside;
+	}
+	return visible_count;
+}
+
+void cullFrustumFromMatrices(cull_frustum_t* frustum, const mat4f_t* projection, const mat4f_t* view) {
+	// clip = projection * view, mat[column][row] like the shaders see them
+	mat4f_t clip_matrix;
+	mat4fMul(&clip_matrix, projection, view);
+	const float (*clip)[4] = clip_matrix.mat;
+
+	// planes are sums of the w row with the x, y and z rows (Gribb/Hartmann), the depth range is the
+	// 0 <= z <= w of Vulkan clip space, so the near plane is the z row alone
+	for (int axis = 0; axis < 3; axis++) {
+		for (int c = 0; c < 4; c++) {
+			frustum->planes[axis * 2 + 0][c] = axis == 2 ? clip[c][2] : clip[c][3] + clip[c][axis];
+			frustum->planes[axis * 2 + 1][c] = clip[c][3] - clip[c][axis];
+		}
+	}
+
+	for (int p = 0; p < 6; p++) {
+		float* plane = frustum->planes[p];
+		float length = sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		// a degenerate plane (no camera set up yet) keeps everything
+		float inv_length = length > 0.0f ? 1.0f / length : 0.0f;
+		for (int c = 0; c < 4; c++) {
+			plane[c] = length > 0.0f ? plane[c] * inv_length : 0.0f;
+		}
+	}
+}
+
+float cullFrustumDepth(const cull_frustum_t* frustum, vec3f_t point) {
+	const float* near = frustum->planes[4];
+	return near[0] * point.x + near[1] * point.y + near[2] * point.z + near[3];
+}
+
+void cullMeshBounds(const gpu_mesh_info_t* mesh, vec3f_t* center, float* radius) {
+	// every layout starts its vertices with the position
+	size_t stride = mesh->layout == GPU_MESH_LAYOUT_TRI_P444_C444_I2 ? 2 * sizeof(vec3f_t) : sizeof(vec3f_t);
+	size_t vtx_count = mesh->vtx_data_size / stride;
+	const char* vtx_data = mesh->vtx_data;
+	if (vtx_count == 0) {
+		*center = vec3fZero();
+		*radius = 0.0f;
+		return;
+	}
+
+	// center of the bounding box, then the farthest vertex from it
+	vec3f_t min = *(const vec3f_t*) vtx_data;
+	vec3f_t max = min;
+	for (size_t x = 1; x < vtx_count; x++) {
+		vec3f_t position = *(const vec3f_t*) (vtx_data + x * stride);
+		min = vec3fMin(min, position);
+		max = vec3fMax(max, position);
+	}
+	*center = vec3fScale(vec3fAdd(min, max), 0.5f);
+
+	float radius_sqrd = 0.0f;
+	for (size_t x = 0; x < vtx_count; x++) {
+		radius_sqrd = __max(radius_sqrd, vec3fDistanceSqrd(*center, *(const vec3f_t*) (vtx_data + x * stride)));
+	}
+	*radius = sqrtf(radius_sqrd);
+}
@@ -0,0 +1,79 @@
+#ifndef __CULL_H__
+#define __CULL_H__
+
+#include "vec3f.h"
+
+/* FRUSTUM CULLING
+*	- world space bounding spheres are stored as SoA arrays (center x, y, z and radius)
+*	- spheres are tested against the 6 frustum planes 8 (AVX) or 4 (SSE) at a time, with a scalar tail
+*	- a cull runs in chunks on a job pool, every chunk writes its visible indices in place and the
+*	  chunks are compacted afterwards, so the visible list is in ascending index order
+*	- boxes are culled through their bounding sphere, which is conservative
+*/
+
+typedef struct cull_t cull_t;
+
+typedef struct heap_t heap_t;
+typedef struct job_pool_t job_pool_t;
+typedef struct mat4f_t mat4f_t;
+typedef struct gpu_mesh_info_t gpu_mesh_info_t;
+
+// Normalized planes (nx, ny, nz, d) facing inwards, a point p is inside a plane when dot(n, p) + d >= 0.
+// Order: left, right, bottom, top, near, far.
+typedef struct cull_frustum_t {
+	float planes[6][4];
+} cull_frustum_t;
+
+// Creates an empty set of bounding spheres.
+//
+// RETURN: the new cull set
+cull_t* cullCreate(heap_t* heap);
+
+// Destroys the cull set.
+//
+void cullDestroy(cull_t* cull);
+
+// Removes every sphere, the memory is kept for the next frame.
+//
+void cullClear(cull_t* cull);
+
+// Adds a world space bounding sphere.
+//
+// RETURN: index of the sphere, the visible list refers to spheres by it
+int cullSphereAdd(cull_t* cull, vec3f_t center, float radius);
+
+// Adds a world space axis aligned box, it is culled through its bounding sphere.
+//
+// RETURN: index of the box
+int cullBoxAdd(cull_t* cull, vec3f_t min, vec3f_t max);
+
+// Get the number of spheres added since the last clear.
+//
+// RETURN: sphere count
+int cullGetCount(cull_t* cull);
+
+// Tests every sphere against the frustum on the job pool (NULL runs on the calling thread).
+//
+// RETURN: the number of visible spheres
+int cullRun(cull_t* cull, const cull_frustum_t* frustum, job_pool_t* pool);
+
+// Get the indices of the spheres that passed the last cullRun, in ascending order.
+//
+// RETURN: the visible list (valid until the next cullRun or cullDestroy)
+const int* cullGetVisible(cull_t* cull);
+
+// Extracts the frustum of a camera from its projection and view matrices, combined in the order
+// the shaders apply them (projection * view * position, column major).
+//
+void cullFrustumFromMatrices(cull_frustum_t* frustum, const mat4f_t* projection, const mat4f_t* view);
+
+// Get the distance of a point in front of the near plane.
+//
+// RETURN: the distance, negative behind the near plane
+float cullFrustumDepth(const cull_frustum_t* frustum, vec3f_t point);
+
+// Computes a local space bounding sphere of a mesh from its vertex positions.
+//
+void cullMeshBounds(const gpu_mesh_info_t* mesh, vec3f_t* center, float* radius);
+
+#endif
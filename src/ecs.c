@@ -16,15 +16,15 @@ typedef struct ecs_t {
 	heap_t* heap;
 	int count;
 
-	int sequences[MAX_COMPONENT_TYPES];
+	int sequences[MAX_ENTITIES_ALLOWED];
 	ecs_entity_state_t entity_states[MAX_ENTITIES_ALLOWED];
-	uint64_t components_mask[MAX_COMPONENT_TYPES];
+	uint64_t components_mask[MAX_ENTITIES_ALLOWED];
 	ecs_component_t components[MAX_COMPONENT_TYPES];
-};
+} ecs_t;
 
 ecs_t* ecsCreate(heap_t* heap) {
 	ecs_t* ecs = heapAlloc(heap, sizeof(ecs_t), 8);
-	memset(ecs, 0, sizeof(ecs));
+	memset(ecs, 0, sizeof(*ecs));
 	ecs->heap = heap;
 	ecs->count = 1;
 	return ecs;
@@ -44,7 +44,7 @@ void ecsUpdate(ecs_t* ecs) {
 		if (ecs->entity_states[x] == ECS_ENTITY_ADD) {
 			ecs->entity_states[x] = ECS_ENTITY_ACTIVE;
 		} else if (ecs->entity_states[x] == ECS_ENTITY_REMOVE) {
-			ecs->entity_states[x] = ECS_ENTITY_REMOVE;
+			ecs->entity_states[x] = ECS_ENTITY_INACTIVE;
 		}
 	}
 }
@@ -100,7 +100,10 @@ bool ecsEntityValid(ecs_t* ecs, ecs_entity_t ref, bool allow_pending_add) {
 }
 
 void* ecsEntityGet(ecs_t* ecs, ecs_entity_t ref, int component_type, bool allow_pending_add) {
-	return ecsEntityValid(ecs, ref, allow_pending_add) ? ecs->components[component_type].data : NULL;
+	if (!ecsEntityValid(ecs, ref, allow_pending_add) || !(ecs->components_mask[ref.entity] & (1ULL << component_type))) {
+		return NULL;
+	}
+	return (char*) ecs->components[component_type].data + ecs->components[component_type].size * ref.entity;
 }
 
 ecs_query_t ecsQueryCreate(ecs_t* ecs, uint64_t mask) {
@@ -118,18 +121,18 @@ bool ecsQueryValid(ecs_t* ecs, ecs_query_t* query) {
 
 void ecsQueryNext(ecs_t* ecs, ecs_query_t* query) {
 	for (int x = query->entity + 1; x < _countof(ecs->components_mask); x++) {
-		if ((ecs->components_mask[x] & query->component_mask) == 
-			(query->component_mask && ecs->entity_states[x] >= ECS_ENTITY_ACTIVE)) {
+		if ((ecs->components_mask[x] & query->component_mask) == query->component_mask &&
+			ecs->entity_states[x] >= ECS_ENTITY_ACTIVE) {
 			query->entity = x;
 			return;
 		}
 	}
-	debugPrint(DEBUG_PRINT_WARNING, "Unable to get the next query.");
+	// reached the end of the entities, the query is finished
 	query->entity = -1;
 }
 
 void* ecsQueryGetComponent(ecs_t* ecs, ecs_query_t* query, int component_type) {
-	return ecs->components[ecs->components[component_type].size * query->entity].data;
+	return (char*) ecs->components[component_type].data + ecs->components[component_type].size * query->entity;
 }
 
 ecs_entity_t ecsQueryGetEntity(ecs_t* ecs, ecs_query_t* query) {
@@ -148,8 +148,9 @@ void fsWorkDestroy(fs_work_t* work) {
 
 static void fileRead(fs_t* fs, fs_work_t* work) {
 	wchar_t w_path[1024] = { 0 };
-	if (MultiByteToWideChar(CP_UTF8, 0, work->path, -1, w_path, 0) <= 0) {
+	if (MultiByteToWideChar(CP_UTF8, 0, work->path, -1, w_path, _countof(w_path)) <= 0) {
 		work->result = -1;
+		eventSignal(work->done);
 		return;
 	}
 
@@ -157,12 +158,14 @@ static void fileRead(fs_t* fs, fs_work_t* work) {
 		FILE_ATTRIBUTE_NORMAL, NULL);
 	if (file == INVALID_HANDLE_VALUE) {
 		work->result = GetLastError();
+		eventSignal(work->done);
 		return;
 	}
 
 	if (!GetFileSizeEx(file, (PLARGE_INTEGER)&work->size)) {
 		work->result = GetLastError();
 		CloseHandle(file);
+		eventSignal(work->done);
 		return;
 	}
 
@@ -173,6 +176,7 @@ static void fileRead(fs_t* fs, fs_work_t* work) {
 	if (!read_result || bytes_read != work->size) {
 		work->result = GetLastError();
 		CloseHandle(file);
+		eventSignal(work->done);
 		return;
 	}
 
@@ -194,8 +198,9 @@ static void fileRead(fs_t* fs, fs_work_t* work) {
 
 static void fileWrite(fs_work_t* work) {
 	wchar_t w_path[1024] = { 0 };
-	if (MultiByteToWideChar(CP_UTF8, 0, work->path, -1, w_path, 0) <= 0) {
+	if (MultiByteToWideChar(CP_UTF8, 0, work->path, -1, w_path, _countof(w_path)) <= 0) {
 		work->result = -1;
+		eventSignal(work->done);
 		return;
 	}
 
@@ -203,6 +208,7 @@ static void fileWrite(fs_work_t* work) {
 		CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
 	if (file == INVALID_HANDLE_VALUE) {
 		work->result = GetLastError();
+		eventSignal(work->done);
 		return;
 	}
 
@@ -210,6 +216,7 @@ static void fileWrite(fs_work_t* work) {
 	if (!WriteFile(file, work->buffer, (DWORD)work->size, &bytes_written, NULL)) {
 		work->result = GetLastError();
 		CloseHandle(file);
+		eventSignal(work->done);
 		return;
 	}
 
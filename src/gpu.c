@@ -1,16 +1,28 @@
 #include "gpu.h"
 
+#if !defined(GPU_NULL)
+
 #include "heap.h"
 #include "debug.h"
+#include "fs.h"
 #include "wm.h"
 
 #include <malloc.h>
 
+#define GPU_MAX_UNIFORM_BUFFERS 8						// per descriptor set
+#define GPU_UNIFORM_RING_FRAME_SIZE (4 * 1024 * 1024)	// uniform and instance data that can be written per frame
+#define GPU_MAX_INSTANCE_ATTRIBUTES 8					// vec4 attributes per instance
+#define GPU_STAGING_RING_SIZE (16 * 1024 * 1024)		// mesh data in flight to device local memory
+#define GPU_MAX_UPLOAD_BATCHES 4						// upload submissions in flight
+#define GPU_PIPELINE_CACHE_PATH "pipeline.cache"
+
 typedef struct gpu_cmd_buff_t {
 	VkCommandBuffer buffer;
 	VkPipelineLayout pipeline_layout;
+	gpu_stats_t* stats;
 	int idx_count;
 	int vtx_count;
+	gpu_stats_t local_stats;							// secondaries count here and are merged when executed
 } gpu_cmd_buff_t;
 
 typedef struct gpu_pipeline_t {
@@ -20,21 +32,25 @@ typedef struct gpu_pipeline_t {
 
 typedef struct gpu_descriptor_t {
 	VkDescriptorSet set;
+	gpu_uniform_buffer_t* uniform_buffers[GPU_MAX_UNIFORM_BUFFERS];
+	int uniform_buffer_count;
 } gpu_descriptor_t;
 
 typedef struct gpu_shader_t {
 	VkShaderModule vtx_module;
 	VkShaderModule frag_module;
 	VkDescriptorSetLayout descriptor_set_layout;
+	uint32_t instance_stride;
 } gpu_shader_t;
 
 typedef struct gpu_uniform_buffer_t {
-	VkBuffer buffer;
-	VkDeviceMemory dev_mem;
 	VkDescriptorBufferInfo descriptor;
+	uint32_t offset;									// dynamic offset of the latest update in the uniform ring
 } gpu_uniform_buffer_t;
 
 typedef struct gpu_mesh_t {
+	uint64_t upload_id;									// upload batch that copies the data, drawable once it completes
+
 	VkBuffer idx_buff;
 	VkDeviceMemory idx_mem;
 	int idx_count;
@@ -45,20 +61,41 @@ typedef struct gpu_mesh_t {
 	int vtx_count;
 } gpu_mesh_t;
 
+// Secondary command buffers of one worker for one frame, the pool is only used by that worker
+// and is reset as a whole once the frame's fence has signaled.
+typedef struct gpu_record_worker_t {
+	VkCommandPool pool;
+	gpu_cmd_buff_t** buffers;
+	int count;
+	int capacity;
+	int used;
+} gpu_record_worker_t;
+
 typedef struct gpu_frame_t {
 	VkImage img;
 	VkImageView view;
 	VkFramebuffer frame_buff;
 	VkFence fence;
 	gpu_cmd_buff_t* cmd_buff;
+	gpu_record_worker_t workers[GPU_MAX_RECORD_WORKERS];
 } gpu_frame_t;
 
+typedef struct gpu_upload_batch_t {
+	VkCommandBuffer cmd_buff;
+	VkFence fence;
+	VkDeviceSize staging_end;							// staging ring head when submitted, freed up to here on completion
+	bool recording;
+} gpu_upload_batch_t;
+
 typedef struct gpu_t {
 	VkInstance inst;
 	VkPhysicalDevice phys_dev;
 	VkDevice logic_dev;
 	VkPhysicalDeviceMemoryProperties mem_prop;
 	VkQueue queue;
+	VkQueue transfer_queue;								// dedicated transfer queue if the device has one, otherwise queue
+	uint32_t queue_family_idx;
+	uint32_t transfer_family_idx;
 	VkSurfaceKHR surface;
 	VkSwapchainKHR swap_chain;
 
@@ -73,6 +110,27 @@ typedef struct gpu_t {
 	VkSemaphore present_comp_sem;
 	VkSemaphore render_comp_sem;
 
+	// uniform ring: one persistently mapped buffer split into a region per frame,
+	// uniform updates and instance data are bump allocated from the region of the frame being recorded
+	VkBuffer ub_ring;
+	VkDeviceMemory ub_ring_mem;
+	char* ub_ring_data;
+	VkDeviceSize ub_ring_frame_size;
+	VkDeviceSize ub_ring_offset;
+	VkDeviceSize ub_alignment;
+
+	// staging ring: mesh data is copied here and then into device local buffers on the transfer queue,
+	// the copies are grouped in batches that complete in submission order (batch ids start at 1)
+	VkBuffer staging_ring;
+	VkDeviceMemory staging_ring_mem;
+	char* staging_ring_data;
+	VkDeviceSize staging_head;							// both grow forever, the ring offset is head % size
+	VkDeviceSize staging_tail;
+	VkCommandPool upload_cmd_pool;
+	gpu_upload_batch_t upload_batches[GPU_MAX_UPLOAD_BATCHES];
+	uint64_t upload_submitted;
+	uint64_t upload_completed;
+
 	uint32_t frame_width;
 	uint32_t frame_height;
 
@@ -85,22 +143,50 @@ typedef struct gpu_t {
 	gpu_frame_t* frames;
 	uint32_t frame_count;
 	uint32_t frame_idx;
+	uint32_t image_idx;
+
+	gpu_stats_t stats;
+
+	// pipelines compiled in earlier runs, saved on destroy
+	VkPipelineCache pipeline_cache;
+	fs_work_t* pipeline_cache_work;						// cache file read, until the cache is created
+	VkPhysicalDeviceProperties device_prop;
 
 	heap_t* heap;
+	fs_t* fs;
 } gpu_t;
 
 static uint32_t gpuGetMemoryTypeIndex(gpu_t* gpu, uint32_t bits, VkMemoryPropertyFlags property_flags);
+static void* gpuRingAlloc(gpu_t* gpu, size_t size, VkDeviceSize* offset);
+static void gpuUploadBuffer(gpu_t* gpu, VkBuffer buffer, const void* data, size_t size);
+static void gpuUploadSubmit(gpu_t* gpu);
+static void gpuUploadPoll(gpu_t* gpu);
+static void gpuUploadWait(gpu_t* gpu, uint64_t id);
 static void gpuCreateMeshLayouts(gpu_t* gpu);
+static void gpuCreatePipelineCache(gpu_t* gpu, fs_work_t* cache_work);
+static void gpuSavePipelineCache(gpu_t* gpu);
 static void gpuDestroyMeshLayouts(gpu_t* gpu);
 
+static void gpuStatsAdd(gpu_stats_t* stats, const gpu_stats_t* add) {
+	stats->draws += add->draws;
+	stats->instances += add->instances;
+	stats->pipeline_binds += add->pipeline_binds;
+	stats->mesh_binds += add->mesh_binds;
+	stats->descriptor_binds += add->descriptor_binds;
+}
+
 //  --------------------------------------------------------------------------
 //								INIT/DESTROY GPU
 // 
 
-gpu_t* gpuCreate(heap_t* heap, wm_window_t* window) {
+gpu_t* gpuCreate(heap_t* heap, fs_t* fs, wm_window_t* window) {
 	gpu_t* gpu = heapAlloc(heap, sizeof(gpu_t), 8);
 	memset(gpu, 0, sizeof(*gpu));
 	gpu->heap = heap;
+	gpu->fs = fs;
+
+	// the cache file is read while the device is being set up
+	gpu->pipeline_cache_work = fsRead(fs, GPU_PIPELINE_CACHE_PATH, heap, false, false);
 
 	//
 	// ================== Creating an instance ==================
@@ -191,6 +277,18 @@ gpu_t* gpuCreate(heap_t* heap, wm_window_t* window) {
 		}
 	}
 
+	// a transfer only family maps to the copy engines, uploads there run next to rendering
+	uint32_t transfer_family_idx = queue_family_idx;
+	for (uint32_t x = 0; x < queue_family_count; x++) {
+		if (queue_family[x].queueCount > 0 &&
+			(queue_family[x].queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+			!(queue_family[x].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+
+			transfer_family_idx = x;
+			break;
+		}
+	}
+
 	heapFree(heap, queue_family);
 
 	if (queue_family_idx == UINT32_MAX || queue_count == UINT32_MAX) {
@@ -202,12 +300,23 @@ gpu_t* gpuCreate(heap_t* heap, wm_window_t* window) {
 	//
 
 	float* queue_priorities = _alloca(sizeof(float) * queue_count);
+	for (uint32_t x = 0; x < queue_count; x++) {
+		queue_priorities[x] = 1.0f;
+	}
 
-	VkDeviceQueueCreateInfo queue_info = {
-		.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-		.queueFamilyIndex = queue_family_idx,
-		.queueCount = queue_count,
-		.pQueuePriorities = queue_priorities
+	VkDeviceQueueCreateInfo queue_info[2] = {
+		{
+			.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+			.queueFamilyIndex = queue_family_idx,
+			.queueCount = queue_count,
+			.pQueuePriorities = queue_priorities
+		},
+		{
+			.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+			.queueFamilyIndex = transfer_family_idx,
+			.queueCount = 1,
+			.pQueuePriorities = queue_priorities
+		}
 	};
 
 	const char* device_extensions[] = {
@@ -220,8 +329,8 @@ gpu_t* gpuCreate(heap_t* heap, wm_window_t* window) {
 
 	VkDeviceCreateInfo device_info = {
 		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-		.queueCreateInfoCount = 1,
-		.pQueueCreateInfos = &queue_info,
+		.queueCreateInfoCount = transfer_family_idx != queue_family_idx ? 2 : 1,
+		.pQueueCreateInfos = queue_info,
 		.enabledExtensionCount = _countof(device_extensions),
 		.ppEnabledExtensionNames = device_extensions
 	};
@@ -232,9 +341,15 @@ gpu_t* gpuCreate(heap_t* heap, wm_window_t* window) {
 	}
 
 	vkGetPhysicalDeviceMemoryProperties(gpu->phys_dev, &gpu->mem_prop);
+
+	vkGetPhysicalDeviceProperties(gpu->phys_dev, &gpu->device_prop);
+	gpu->ub_alignment = __max(gpu->device_prop.limits.minUniformBufferOffsetAlignment, 16);
 	
 	// Retrieving queue handles
 	vkGetDeviceQueue(gpu->logic_dev, queue_family_idx, 0, &gpu->queue);
+	vkGetDeviceQueue(gpu->logic_dev, transfer_family_idx, 0, &gpu->transfer_queue);
+	gpu->queue_family_idx = queue_family_idx;
+	gpu->transfer_family_idx = transfer_family_idx;
 
 	//
 	// ================== Creating a window surface for rendering ==================
@@ -509,7 +624,7 @@ gpu_t* gpuCreate(heap_t* heap, wm_window_t* window) {
 	
 	VkDescriptorPoolSize descriptor_pool_sizes[1] = {
 		{
-			.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
 			.descriptorCount = 512
 		}
 	};
@@ -547,6 +662,7 @@ gpu_t* gpuCreate(heap_t* heap, wm_window_t* window) {
 	for (uint32_t x = 0; x < gpu->frame_count; x++) {
 		gpu->frames[x].cmd_buff = heapAlloc(gpu->heap, sizeof(gpu_cmd_buff_t), 8);
 		memset(gpu->frames[x].cmd_buff, 0, sizeof(gpu_cmd_buff_t));
+		gpu->frames[x].cmd_buff->stats = &gpu->stats;
 
 		VkCommandBufferAllocateInfo cmd_buff_alloc_info = {
 			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
@@ -567,9 +683,128 @@ gpu_t* gpuCreate(heap_t* heap, wm_window_t* window) {
 		if (vk_result != VK_SUCCESS) {
 			return gpuError(gpu, "vkCreate Fence", "Unable to create a fence for allocating command buffers.");
 		}
+
+		// command pools are externally synchronized, every recording worker gets its own per frame
+		for (int w = 0; w < GPU_MAX_RECORD_WORKERS; w++) {
+			VkCommandPoolCreateInfo worker_pool_info = {
+				.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+				.queueFamilyIndex = queue_family_idx,
+				.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT
+			};
+			vk_result = vkCreateCommandPool(gpu->logic_dev, &worker_pool_info, NULL, &gpu->frames[x].workers[w].pool);
+			if (vk_result != VK_SUCCESS) {
+				return gpuError(gpu, "vkCreateCommandPool", "Unable to create a recording worker command pool.");
+			}
+		}
+	}
+
+	//
+	// ================== Create the uniform ring ==================
+	//
+
+	gpu->ub_ring_frame_size = GPU_UNIFORM_RING_FRAME_SIZE;
+	VkBufferCreateInfo ub_ring_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		.size = gpu->ub_ring_frame_size * gpu->frame_count
+	};
+	vk_result = vkCreateBuffer(gpu->logic_dev, &ub_ring_info, NULL, &gpu->ub_ring);
+	if (vk_result != VK_SUCCESS) {
+		return gpuError(gpu, "vkCreateBuffer", "Unable to create the uniform ring buffer.");
+	}
+
+	VkMemoryRequirements ub_ring_mem_req;
+	vkGetBufferMemoryRequirements(gpu->logic_dev, gpu->ub_ring, &ub_ring_mem_req);
+	VkMemoryAllocateInfo ub_ring_alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.allocationSize = ub_ring_mem_req.size,
+		.memoryTypeIndex = gpuGetMemoryTypeIndex(gpu, ub_ring_mem_req.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+	};
+	vk_result = vkAllocateMemory(gpu->logic_dev, &ub_ring_alloc_info, NULL, &gpu->ub_ring_mem);
+	if (vk_result != VK_SUCCESS) {
+		return gpuError(gpu, "vkAllocateMemory", "Unable to allocate memory for the uniform ring buffer.");
+	}
+
+	vk_result = vkBindBufferMemory(gpu->logic_dev, gpu->ub_ring, gpu->ub_ring_mem, 0);
+	if (vk_result != VK_SUCCESS) {
+		return gpuError(gpu, "vkBindBufferMemory", "Unable to bind memory for the uniform ring buffer.");
+	}
+
+	// stays mapped until the gpu is destroyed
+	vk_result = vkMapMemory(gpu->logic_dev, gpu->ub_ring_mem, 0, VK_WHOLE_SIZE, 0, (void**) &gpu->ub_ring_data);
+	if (vk_result != VK_SUCCESS) {
+		return gpuError(gpu, "vkMapMemory", "Unable to map the uniform ring buffer.");
+	}
+
+	//
+	// ================== Create the staging ring and upload batches ==================
+	//
+
+	VkBufferCreateInfo staging_ring_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		.size = GPU_STAGING_RING_SIZE
+	};
+	vk_result = vkCreateBuffer(gpu->logic_dev, &staging_ring_info, NULL, &gpu->staging_ring);
+	if (vk_result != VK_SUCCESS) {
+		return gpuError(gpu, "vkCreateBuffer", "Unable to create the staging ring buffer.");
+	}
+
+	VkMemoryRequirements staging_ring_mem_req;
+	vkGetBufferMemoryRequirements(gpu->logic_dev, gpu->staging_ring, &staging_ring_mem_req);
+	VkMemoryAllocateInfo staging_ring_alloc_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.allocationSize = staging_ring_mem_req.size,
+		.memoryTypeIndex = gpuGetMemoryTypeIndex(gpu, staging_ring_mem_req.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+	};
+	vk_result = vkAllocateMemory(gpu->logic_dev, &staging_ring_alloc_info, NULL, &gpu->staging_ring_mem);
+	if (vk_result != VK_SUCCESS) {
+		return gpuError(gpu, "vkAllocateMemory", "Unable to allocate memory for the staging ring buffer.");
+	}
+
+	vk_result = vkBindBufferMemory(gpu->logic_dev, gpu->staging_ring, gpu->staging_ring_mem, 0);
+	if (vk_result != VK_SUCCESS) {
+		return gpuError(gpu, "vkBindBufferMemory", "Unable to bind memory for the staging ring buffer.");
+	}
+
+	vk_result = vkMapMemory(gpu->logic_dev, gpu->staging_ring_mem, 0, VK_WHOLE_SIZE, 0, (void**) &gpu->staging_ring_data);
+	if (vk_result != VK_SUCCESS) {
+		return gpuError(gpu, "vkMapMemory", "Unable to map the staging ring buffer.");
+	}
+
+	VkCommandPoolCreateInfo upload_cmd_pool_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.queueFamilyIndex = transfer_family_idx,
+		.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT
+	};
+	vk_result = vkCreateCommandPool(gpu->logic_dev, &upload_cmd_pool_info, NULL, &gpu->upload_cmd_pool);
+	if (vk_result != VK_SUCCESS) {
+		return gpuError(gpu, "vkCreateCommandPool", "Unable to create the upload command pool.");
+	}
+
+	for (int x = 0; x < GPU_MAX_UPLOAD_BATCHES; x++) {
+		VkCommandBufferAllocateInfo upload_alloc_info = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.commandPool = gpu->upload_cmd_pool,
+			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1
+		};
+		vk_result = vkAllocateCommandBuffers(gpu->logic_dev, &upload_alloc_info, &gpu->upload_batches[x].cmd_buff);
+		if (vk_result != VK_SUCCESS) {
+			return gpuError(gpu, "vkAllocateCommandBuffers", "Unable to allocate an upload command buffer.");
+		}
+
+		VkFenceCreateInfo upload_fence_info = {
+			.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO
+		};
+		vk_result = vkCreateFence(gpu->logic_dev, &upload_fence_info, NULL, &gpu->upload_batches[x].fence);
+		if (vk_result != VK_SUCCESS) {
+			return gpuError(gpu, "vkCreateFence", "Unable to create an upload fence.");
+		}
 	}
 
 	gpuCreateMeshLayouts(gpu);
+	gpuCreatePipelineCache(gpu, gpu->pipeline_cache_work);
 
 	return gpu;
 }
@@ -578,9 +813,32 @@ void gpuDestroy(gpu_t* gpu) {
 	if (gpu) {
 		if (gpu->queue)
 			vkQueueWaitIdle(gpu->queue);
+		if (gpu->transfer_queue)
+			vkQueueWaitIdle(gpu->transfer_queue);
 
 		gpuDestroyMeshLayouts(gpu);
 
+		if (gpu->pipeline_cache_work)
+			fsWorkDestroy(gpu->pipeline_cache_work);
+		if (gpu->pipeline_cache) {
+			gpuSavePipelineCache(gpu);
+			vkDestroyPipelineCache(gpu->logic_dev, gpu->pipeline_cache, NULL);
+		}
+
+		for (int x = 0; x < GPU_MAX_UPLOAD_BATCHES; x++) {
+			if (gpu->upload_batches[x].fence)
+				vkDestroyFence(gpu->logic_dev, gpu->upload_batches[x].fence, NULL);
+		}
+		if (gpu->upload_cmd_pool)
+			vkDestroyCommandPool(gpu->logic_dev, gpu->upload_cmd_pool, NULL);
+
+		if (gpu->staging_ring_data)
+			vkUnmapMemory(gpu->logic_dev, gpu->staging_ring_mem);
+		if (gpu->staging_ring)
+			vkDestroyBuffer(gpu->logic_dev, gpu->staging_ring, NULL);
+		if (gpu->staging_ring_mem)
+			vkFreeMemory(gpu->logic_dev, gpu->staging_ring_mem, NULL);
+
 		if (gpu->depth_stencil_img)
 			vkDestroyImage(gpu->logic_dev, gpu->depth_stencil_img, NULL);
 		if (gpu->depth_stencil_view)
@@ -589,6 +847,13 @@ void gpuDestroy(gpu_t* gpu) {
 			vkFreeMemory(gpu->logic_dev, gpu->depth_stencil_mem, NULL);
 			
 
+		if (gpu->ub_ring_data)
+			vkUnmapMemory(gpu->logic_dev, gpu->ub_ring_mem);
+		if (gpu->ub_ring)
+			vkDestroyBuffer(gpu->logic_dev, gpu->ub_ring, NULL);
+		if (gpu->ub_ring_mem)
+			vkFreeMemory(gpu->logic_dev, gpu->ub_ring_mem, NULL);
+
 		if (gpu->present_comp_sem)
 			vkDestroySemaphore(gpu->logic_dev, gpu->present_comp_sem, NULL);
 		if (gpu->render_comp_sem)
@@ -616,6 +881,17 @@ void gpuDestroy(gpu_t* gpu) {
 					vkFreeCommandBuffers(gpu->logic_dev, gpu->cmd_pool, 1, &frame->cmd_buff->buffer);
 					heapFree(gpu->heap, frame->cmd_buff);
 				}
+				for (int w = 0; w < GPU_MAX_RECORD_WORKERS; w++) {
+					gpu_record_worker_t* worker = &frame->workers[w];
+					// destroying the pool frees its command buffers
+					if (worker->pool)
+						vkDestroyCommandPool(gpu->logic_dev, worker->pool, NULL);
+					for (int b = 0; b < worker->count; b++) {
+						heapFree(gpu->heap, worker->buffers[b]);
+					}
+					if (worker->buffers)
+						heapFree(gpu->heap, worker->buffers);
+				}
 			}
 			heapFree(gpu->heap, gpu->frames);
 		}
@@ -639,10 +915,30 @@ gpu_cmd_buff_t* gpuBeginFrameUpdate(gpu_t* gpu) {
 	
 	gpu_frame_t* frame = &gpu->frames[gpu->frame_idx];
 
+	// the command buffer and uniform ring region of this frame are reused once the gpu is done with them
+	vkWaitForFences(gpu->logic_dev, 1, &frame->fence, VK_TRUE, UINT64_MAX);
+	gpu->ub_ring_offset = 0;
+	for (int x = 0; x < GPU_MAX_RECORD_WORKERS; x++) {
+		gpu_record_worker_t* worker = &frame->workers[x];
+		if (worker->used) {
+			vkResetCommandPool(gpu->logic_dev, worker->pool, 0);
+			worker->used = 0;
+		}
+	}
+
+	// meshes created since the last frame start copying now, finished copies make their meshes drawable
+	gpuUploadSubmit(gpu);
+	gpuUploadPoll(gpu);
+
+	VkResult vk_result = vkAcquireNextImageKHR(gpu->logic_dev, gpu->swap_chain, UINT64_MAX, gpu->present_comp_sem, VK_NULL_HANDLE, &gpu->image_idx);
+	if (vk_result != VK_SUCCESS && vk_result != VK_SUBOPTIMAL_KHR) {
+		return gpuError(gpu, "vkAcquireNextImageKHR", "Unable to acquire the next image on begin frame update.");
+	}
+
 	VkCommandBufferBeginInfo command_buff_info = {
 		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO
 	};
-	VkResult vk_result = vkBeginCommandBuffer(frame->cmd_buff->buffer, &command_buff_info);
+	vk_result = vkBeginCommandBuffer(frame->cmd_buff->buffer, &command_buff_info);
 	if (vk_result != VK_SUCCESS) { // NOTE: as long as this works, everything else should be fine
 		return gpuError(gpu, "vkBeginCommandBuffer", "Unable to create a command buffer on begin frame update.");
 	}
@@ -658,26 +954,116 @@ gpu_cmd_buff_t* gpuBeginFrameUpdate(gpu_t* gpu) {
 		.renderArea.extent.height = gpu->frame_height,
 		.renderArea.extent.width = gpu->frame_width,
 		.clearValueCount = _countof(clear_value),
-		.framebuffer = frame->frame_buff
+		.pClearValues = clear_value,
+		.framebuffer = gpu->frames[gpu->image_idx].frame_buff
 	};
 
-	vkCmdBeginRenderPass(frame->cmd_buff->buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+	// draws are recorded into secondaries, the primary only executes them
+	vkCmdBeginRenderPass(frame->cmd_buff->buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+	return frame->cmd_buff;
+}
+
+gpu_cmd_buff_t* gpuCommandBeginSecondary(gpu_t* gpu, int worker_idx) {
+	gpu_record_worker_t* worker = &gpu->frames[gpu->frame_idx].workers[worker_idx];
+
+	// buffers are kept across frames, a new one is only allocated when a frame records more chunks than before
+	if (worker->used == worker->count) {
+		if (worker->count == worker->capacity) {
+			int capacity = __max(worker->capacity * 2, 8);
+			gpu_cmd_buff_t** buffers = heapAlloc(gpu->heap, sizeof(gpu_cmd_buff_t*) * capacity, 8);
+			if (worker->buffers) {
+				memcpy(buffers, worker->buffers, sizeof(gpu_cmd_buff_t*) * worker->count);
+				heapFree(gpu->heap, worker->buffers);
+			}
+			worker->buffers = buffers;
+			worker->capacity = capacity;
+		}
+
+		gpu_cmd_buff_t* cmd_buff = heapAlloc(gpu->heap, sizeof(gpu_cmd_buff_t), 8);
+		memset(cmd_buff, 0, sizeof(gpu_cmd_buff_t));
+		cmd_buff->stats = &cmd_buff->local_stats;
+
+		VkCommandBufferAllocateInfo cmd_buff_alloc_info = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.commandPool = worker->pool,
+			.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+			.commandBufferCount = 1
+		};
+		VkResult vk_result = vkAllocateCommandBuffers(gpu->logic_dev, &cmd_buff_alloc_info, &cmd_buff->buffer);
+		if (vk_result != VK_SUCCESS) {
+			heapFree(gpu->heap, cmd_buff);
+			debugPrint(DEBUG_PRINT_ERROR, "gpuCommandBeginSecondary: Unable to allocate a secondary command buffer.\n");
+			return NULL;
+		}
+		worker->buffers[worker->count++] = cmd_buff;
+	}
+
+	gpu_cmd_buff_t* cmd_buff = worker->buffers[worker->used++];
+	memset(&cmd_buff->local_stats, 0, sizeof(cmd_buff->local_stats));
+	cmd_buff->pipeline_layout = VK_NULL_HANDLE;
+	cmd_buff->idx_count = 0;
+	cmd_buff->vtx_count = 0;
+
+	VkCommandBufferInheritanceInfo inheritance_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		.renderPass = gpu->render_pass,
+		.subpass = 0,
+		.framebuffer = gpu->frames[gpu->image_idx].frame_buff
+	};
+	VkCommandBufferBeginInfo command_buff_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = &inheritance_info
+	};
+	VkResult vk_result = vkBeginCommandBuffer(cmd_buff->buffer, &command_buff_info);
+	if (vk_result != VK_SUCCESS) {
+		debugPrint(DEBUG_PRINT_ERROR, "gpuCommandBeginSecondary: Unable to begin a secondary command buffer.\n");
+		worker->used--;
+		return NULL;
+	}
 
+	// dynamic state is not inherited from the primary
 	VkViewport viewport = {
 		.height = (float) gpu->frame_height,
 		.width = (float) gpu->frame_width,
 		.minDepth = 0.0f,
 		.maxDepth = 1.0f,
 	};
-	vkCmdSetViewport(frame->cmd_buff->buffer, 0, 1, &viewport);
+	vkCmdSetViewport(cmd_buff->buffer, 0, 1, &viewport);
 
 	VkRect2D scissor = {
 		.extent.width = gpu->frame_width,
 		.extent.height = gpu->frame_height,
 	};
-	vkCmdSetScissor(frame->cmd_buff->buffer, 0, 1, &scissor);
+	vkCmdSetScissor(cmd_buff->buffer, 0, 1, &scissor);
 
-	return frame->cmd_buff;
+	return cmd_buff;
+}
+
+void gpuCommandEndSecondary(gpu_t* gpu, gpu_cmd_buff_t* cmd_buff) {
+	if (vkEndCommandBuffer(cmd_buff->buffer) != VK_SUCCESS) {
+		debugPrint(DEBUG_PRINT_ERROR, "gpuCommandEndSecondary: Unable to end a secondary command buffer.\n");
+	}
+}
+
+void gpuCommandExecuteSecondaries(gpu_t* gpu, gpu_cmd_buff_t* cmd_buff, gpu_cmd_buff_t** secondaries, int count) {
+	if (count <= 0) {
+		return;
+	}
+
+	VkCommandBuffer* buffers = _alloca(sizeof(VkCommandBuffer) * count);
+	int buffer_count = 0;
+	for (int x = 0; x < count; x++) {
+		if (secondaries[x] == NULL) {
+			continue;
+		}
+		buffers[buffer_count++] = secondaries[x]->buffer;
+		gpuStatsAdd(cmd_buff->stats, &secondaries[x]->local_stats);
+	}
+	if (buffer_count) {
+		vkCmdExecuteCommands(cmd_buff->buffer, buffer_count, buffers);
+	}
 }
 
 void gpuEndFrameUpdate(gpu_t* gpu) {
@@ -691,15 +1077,8 @@ void gpuEndFrameUpdate(gpu_t* gpu) {
 		return;
 	}
 
-	uint32_t image_idx;
-	result = vkAcquireNextImageKHR(gpu->logic_dev, gpu->swap_chain, UINT64_MAX, gpu->present_comp_sem, VK_NULL_HANDLE, &image_idx);
-	if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-		gpuError(gpu, "vkAcquireNextImageKHR", "Unable to acquire the next image during ending the frame update.");
-		return;
-	}
-
-	vkWaitForFences(gpu->logic_dev, 1, &frame->fence, VK_TRUE, UINT64_MAX);
 	vkResetFences(gpu->logic_dev, 1, &frame->fence);
+	gpu->stats.frames++;
 
 	VkPipelineStageFlags wait_stage_mask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 	VkSubmitInfo submit_info = {
@@ -723,7 +1102,7 @@ void gpuEndFrameUpdate(gpu_t* gpu) {
 		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
 		.swapchainCount = 1,
 		.pSwapchains = &gpu->swap_chain,
-		.pImageIndices = &image_idx,
+		.pImageIndices = &gpu->image_idx,
 		.pWaitSemaphores = &gpu->render_comp_sem,
 		.waitSemaphoreCount = 1
 	};
@@ -739,6 +1118,11 @@ void gpuEndFrameUpdate(gpu_t* gpu) {
 // 
 
 gpu_descriptor_t* gpuCreateDescriptorSets(gpu_t* gpu, const gpu_descriptor_info_t* descriptor_info) {
+	if (descriptor_info->uniform_buffer_count > GPU_MAX_UNIFORM_BUFFERS) {
+		debugPrint(DEBUG_PRINT_ERROR, "gpuCreateDescriptorSets: %d uniform buffers requested, the limit is %d.\n", descriptor_info->uniform_buffer_count, GPU_MAX_UNIFORM_BUFFERS);
+		return NULL;
+	}
+
 	gpu_descriptor_t* descriptor = heapAlloc(gpu->heap, sizeof(gpu_descriptor_t), 8);
 	memset(descriptor, 0, sizeof(*descriptor));
 	
@@ -753,18 +1137,22 @@ gpu_descriptor_t* gpuCreateDescriptorSets(gpu_t* gpu, const gpu_descriptor_info_
 		return gpuError(gpu, "vkAllocateDescriptorSets", "Unalbe to allocate for a descriptor set.");
 	}
 
+	// the sets point at the uniform ring, every bind passes the latest offset of each uniform buffer
 	VkWriteDescriptorSet* write_descriptor_set = _alloca(sizeof(VkWriteDescriptorSet) * descriptor_info->uniform_buffer_count);
 	for (int x = 0; x < descriptor_info->uniform_buffer_count; x++) {
+		descriptor->uniform_buffers[x] = descriptor_info->uniform_buffers[x];
 		write_descriptor_set[x] = (VkWriteDescriptorSet){
 			.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
 			.dstSet = descriptor->set,
 			.descriptorCount = 1,
-			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
 			.pBufferInfo = &descriptor_info->uniform_buffers[x]->descriptor,
 			.dstBinding = x
 		};
 	}
 	vkUpdateDescriptorSets(gpu->logic_dev, descriptor_info->uniform_buffer_count, write_descriptor_set, 0, NULL);
+	descriptor->uniform_buffer_count = descriptor_info->uniform_buffer_count;
+	gpu->stats.resources_created++;
 	
 	return descriptor;
 }
@@ -774,11 +1162,17 @@ void gpuDestroyDescriptorSets(gpu_t* gpu, gpu_descriptor_t* descriptor) {
 		if (descriptor->set)
 			vkFreeDescriptorSets(gpu->logic_dev, gpu->desc_pool, 1, &descriptor->set);
 		heapFree(gpu->heap, descriptor);
+		gpu->stats.resources_destroyed++;
 	}
 }
 
 void gpuCommandBindDescriptorSets(gpu_cmd_buff_t* cmd_buff, gpu_descriptor_t* descriptor) {
-	vkCmdBindDescriptorSets(cmd_buff->buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, cmd_buff->pipeline_layout, 0, 1, &descriptor->set, 0, NULL);
+	uint32_t offsets[GPU_MAX_UNIFORM_BUFFERS];
+	for (int x = 0; x < descriptor->uniform_buffer_count; x++) {
+		offsets[x] = descriptor->uniform_buffers[x]->offset;
+	}
+	vkCmdBindDescriptorSets(cmd_buff->buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, cmd_buff->pipeline_layout, 0, 1, &descriptor->set, descriptor->uniform_buffer_count, offsets);
+	cmd_buff->stats->descriptor_binds++;
 }
 
 //  --------------------------------------------------------------------------
@@ -856,6 +1250,40 @@ gpu_pipeline_t* gpuCreatePipeline(gpu_t* gpu, const gpu_pipeline_info_t* pipelin
 		.pDynamicStates = dynamic_state
 	};
 
+	// instanced shaders read a second, per instance, vertex stream from binding 1
+	VkPipelineVertexInputStateCreateInfo vtx_input_info = gpu->mesh_vtx_input_info[pipeline_info->mesh_layout];
+	VkVertexInputBindingDescription vtx_bindings[2];
+	VkVertexInputAttributeDescription vtx_attributes[GPU_MAX_INSTANCE_ATTRIBUTES + 4];
+	uint32_t instance_attribute_count = pipeline_info->shader->instance_stride / 16;
+	if (instance_attribute_count > 0) {
+		if (instance_attribute_count > GPU_MAX_INSTANCE_ATTRIBUTES ||
+			vtx_input_info.vertexAttributeDescriptionCount > _countof(vtx_attributes) - instance_attribute_count) {
+			heapFree(gpu->heap, pipeline);
+			debugPrint(DEBUG_PRINT_ERROR, "gpuCreatePipeline: too many vertex attributes for an instanced pipeline.\n");
+			return NULL;
+		}
+
+		vtx_bindings[0] = vtx_input_info.pVertexBindingDescriptions[0];
+		vtx_bindings[1] = (VkVertexInputBindingDescription){
+			.binding = 1,
+			.stride = pipeline_info->shader->instance_stride,
+			.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE
+		};
+		memcpy(vtx_attributes, vtx_input_info.pVertexAttributeDescriptions, sizeof(VkVertexInputAttributeDescription) * vtx_input_info.vertexAttributeDescriptionCount);
+		for (uint32_t x = 0; x < instance_attribute_count; x++) {
+			vtx_attributes[vtx_input_info.vertexAttributeDescriptionCount + x] = (VkVertexInputAttributeDescription){
+				.binding = 1,
+				.location = 2 + x,
+				.format = VK_FORMAT_R32G32B32A32_SFLOAT,
+				.offset = 16 * x
+			};
+		}
+		vtx_input_info.vertexBindingDescriptionCount = 2;
+		vtx_input_info.pVertexBindingDescriptions = vtx_bindings;
+		vtx_input_info.vertexAttributeDescriptionCount += instance_attribute_count;
+		vtx_input_info.pVertexAttributeDescriptions = vtx_attributes;
+	}
+
 	VkPipelineLayoutCreateInfo pipeline_layout_info = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
 		.setLayoutCount = 1,
@@ -878,19 +1306,84 @@ gpu_pipeline_t* gpuCreatePipeline(gpu_t* gpu, const gpu_pipeline_info_t* pipelin
 		.pRasterizationState = &raster_state_info,
 		.pColorBlendState = &color_blend_state_info,
 		.pViewportState = &viewport_state_info,
-		.pVertexInputState = &gpu->mesh_vtx_input_info[pipeline_info->mesh_layout],
+		.pVertexInputState = &vtx_input_info,
 		.pInputAssemblyState = &gpu->mesh_input_asm_info[pipeline_info->mesh_layout],
 		.pMultisampleState = &multisample_state_info,
 		.renderPass = gpu->render_pass,
 	};
-	vk_result = vkCreateGraphicsPipelines(gpu->logic_dev, NULL, 1, &graphics_pipeline_info, NULL, &pipeline->pipeline);
+	vk_result = vkCreateGraphicsPipelines(gpu->logic_dev, gpu->pipeline_cache, 1, &graphics_pipeline_info, NULL, &pipeline->pipeline);
 	if (vk_result != VK_SUCCESS) {
 		return gpuError(gpu, "vkCreateGraphicsPipelines", "Unable to create a graphics pipeline.");
 	}
 
+	gpu->stats.resources_created++;
 	return pipeline;
 }
 
+// Creates the pipeline cache, seeded with the data of the cache file if it was saved by the same driver and device.
+static void gpuCreatePipelineCache(gpu_t* gpu, fs_work_t* cache_work) {
+	const char* data = fsWorkGetBuffer(cache_work);
+	size_t size = fsWorkGetSize(cache_work);
+
+	// header layout of VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+	bool valid = false;
+	if (fsWorkGetErrorCode(cache_work) == 0 && data && size >= 16 + VK_UUID_SIZE) {
+		uint32_t header[4];
+		memcpy(header, data, sizeof(header));
+		valid = header[0] >= 16 + VK_UUID_SIZE && header[0] <= size &&
+			header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+			header[2] == gpu->device_prop.vendorID &&
+			header[3] == gpu->device_prop.deviceID &&
+			memcmp(data + 16, gpu->device_prop.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+		if (!valid) {
+			debugPrint(DEBUG_PRINT_WARNING, "gpuCreatePipelineCache: '%s' is from another device or driver, starting with an empty cache.\n", GPU_PIPELINE_CACHE_PATH);
+		}
+	}
+
+	VkPipelineCacheCreateInfo cache_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.initialDataSize = valid ? size : 0,
+		.pInitialData = valid ? data : NULL
+	};
+	VkResult vk_result = vkCreatePipelineCache(gpu->logic_dev, &cache_info, NULL, &gpu->pipeline_cache);
+	if (vk_result != VK_SUCCESS && valid) {
+		// the driver can still reject data that passed the header check
+		cache_info.initialDataSize = 0;
+		cache_info.pInitialData = NULL;
+		vk_result = vkCreatePipelineCache(gpu->logic_dev, &cache_info, NULL, &gpu->pipeline_cache);
+	}
+	if (vk_result != VK_SUCCESS) {
+		debugPrint(DEBUG_PRINT_WARNING, "gpuCreatePipelineCache: Unable to create a pipeline cache, pipelines are built without one.\n");
+		gpu->pipeline_cache = VK_NULL_HANDLE;
+	}
+
+	// the work owns the file buffer
+	fsWorkDestroy(cache_work);
+	gpu->pipeline_cache_work = NULL;
+}
+
+static void gpuSavePipelineCache(gpu_t* gpu) {
+	size_t size = 0;
+	VkResult vk_result = vkGetPipelineCacheData(gpu->logic_dev, gpu->pipeline_cache, &size, NULL);
+	if (vk_result != VK_SUCCESS || size == 0) {
+		return;
+	}
+
+	void* data = heapAlloc(gpu->heap, size, 8);
+	vk_result = vkGetPipelineCacheData(gpu->logic_dev, gpu->pipeline_cache, &size, data);
+	if (vk_result != VK_SUCCESS) {
+		heapFree(gpu->heap, data);
+		return;
+	}
+
+	// NOTE: the file system takes ownership of the buffer and frees it once written
+	fs_work_t* work = fsWrite(gpu->fs, GPU_PIPELINE_CACHE_PATH, data, size, false);
+	if (fsWorkGetErrorCode(work) != 0) {
+		debugPrint(DEBUG_PRINT_WARNING, "gpuSavePipelineCache: Unable to write '%s'.\n", GPU_PIPELINE_CACHE_PATH);
+	}
+	fsWorkDestroy(work);
+}
+
 void gpuDestroyPipeline(gpu_t* gpu, gpu_pipeline_t* pipeline) {
 	if (pipeline) {
 		if (pipeline->pipeline_layout)
@@ -899,12 +1392,14 @@ void gpuDestroyPipeline(gpu_t* gpu, gpu_pipeline_t* pipeline) {
 			vkDestroyPipeline(gpu->logic_dev, pipeline->pipeline, NULL);
 
 		heapFree(gpu->heap, pipeline);
+		gpu->stats.resources_destroyed++;
 	}
 }
 
 void gpuCommandBindPipeline(gpu_cmd_buff_t* cmd_buff, gpu_pipeline_t* pipeline) {
 	vkCmdBindPipeline(cmd_buff->buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
 	cmd_buff->pipeline_layout = pipeline->pipeline_layout;
+	cmd_buff->stats->pipeline_binds++;
 }
 
 //  --------------------------------------------------------------------------
@@ -915,59 +1410,42 @@ gpu_uniform_buffer_t* gpuCreateUniformBuffer(gpu_t* gpu, const gpu_uniform_buffe
 	gpu_uniform_buffer_t* ub = heapAlloc(gpu->heap, sizeof(gpu_uniform_buffer_t), 8);
 	memset(ub, 0, sizeof(*ub));
 
-	VkBufferCreateInfo buffer_info = {
-		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-		.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-		.size = ub_info->size
-	};
-	VkResult vk_result = vkCreateBuffer(gpu->logic_dev, &buffer_info, NULL, &ub->buffer);
-	if (vk_result != VK_SUCCESS) {
-		return gpuError(gpu, "vkCreateBuffer", "Unable to create the uniform buffer.");
-	}
-
-	VkMemoryRequirements mem_req;
-	vkGetBufferMemoryRequirements(gpu->logic_dev, ub->buffer, &mem_req);
-
-	VkMemoryAllocateInfo mem_alloc = {
-		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-		.allocationSize = mem_req.size,
-		.memoryTypeIndex = gpuGetMemoryTypeIndex(gpu, mem_req.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
-	};
-	vk_result = vkAllocateMemory(gpu->logic_dev, &mem_alloc, NULL, &ub->dev_mem);
-	if (vk_result != VK_SUCCESS) {
-		return gpuError(gpu, "vkAllocateMemory", "Unable to allocate memory for the uniform buffer.");
-	}
-
-	vk_result = vkBindBufferMemory(gpu->logic_dev, ub->buffer, ub->dev_mem, 0);
-	if (vk_result != VK_SUCCESS) {
-		return gpuError(gpu, "vkBindBufferMemory", "Unable to bind memory for the uniform buffer.");
-	}
-
-	ub->descriptor.buffer = ub->buffer;
+	ub->descriptor.buffer = gpu->ub_ring;
 	ub->descriptor.range = ub_info->size;
 
 	gpuUpdateUniformBuffer(gpu, ub, ub_info->data, ub_info->size);
 
+	gpu->stats.resources_created++;
 	return ub;
 }
 
 void gpuUpdateUniformBuffer(gpu_t* gpu, gpu_uniform_buffer_t* ub, const void* data, size_t size) {
-	void* mem_alloc = NULL;
-	VkResult vk_result = vkMapMemory(gpu->logic_dev, ub->dev_mem, 0, size, 0, &mem_alloc);
-	if (vk_result == VK_SUCCESS) {
-		memcpy(mem_alloc, data, size);
-		vkUnmapMemory(gpu->logic_dev, ub->dev_mem);
+	VkDeviceSize offset;
+	void* dest = gpuRingAlloc(gpu, size, &offset);
+	if (dest == NULL) {
+		debugPrint(DEBUG_PRINT_ERROR, "gpuUpdateUniformBuffer: the uniform ring is full for this frame, the update is dropped.\n");
+		return;
+	}
+	memcpy(dest, data, size);
+	ub->offset = (uint32_t) offset;
+}
+
+static void* gpuRingAlloc(gpu_t* gpu, size_t size, VkDeviceSize* offset) {
+	VkDeviceSize aligned_size = (size + gpu->ub_alignment - 1) & ~(gpu->ub_alignment - 1);
+	if (gpu->ub_ring_offset + aligned_size > gpu->ub_ring_frame_size) {
+		return NULL;
 	}
+
+	*offset = gpu->ub_ring_frame_size * gpu->frame_idx + gpu->ub_ring_offset;
+	gpu->ub_ring_offset += aligned_size;
+	gpu->stats.upload_bytes += size;
+	return gpu->ub_ring_data + *offset;
 }
 
 void gpuDestroyUniformBuffer(gpu_t* gpu, gpu_uniform_buffer_t* ub) {
 	if (ub) {
-		if (ub->buffer)
-			vkDestroyBuffer(gpu->logic_dev, ub->buffer, NULL);
-		if (ub->dev_mem)
-			vkFreeMemory(gpu->logic_dev, ub->dev_mem, NULL);
-
 		heapFree(gpu->heap, ub);
+		gpu->stats.resources_destroyed++;
 	}
 }
 
@@ -984,6 +1462,10 @@ gpu_mesh_t* gpuCreateMesh(gpu_t* gpu, gpu_mesh_info_t* mesh_info) {
 	mesh->idx_count = (int) mesh_info->idx_data_size / gpu->mesh_idx_size[mesh_info->layout];
 	mesh->vtx_count = (int) mesh_info->vtx_data_size / gpu->mesh_vtx_size[mesh_info->layout];
 	
+	// both queues use the buffers, concurrent sharing saves the queue family ownership transfers
+	uint32_t families[2] = { gpu->queue_family_idx, gpu->transfer_family_idx };
+	VkSharingMode sharing_mode = families[0] != families[1] ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+
 	//
 	// ================== Vertex Data ==================
 	//
@@ -991,7 +1473,10 @@ gpu_mesh_t* gpuCreateMesh(gpu_t* gpu, gpu_mesh_info_t* mesh_info) {
 	VkBufferCreateInfo vtx_buffer_info = {
 		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
 		.size = mesh_info->vtx_data_size,
-		.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+		.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		.sharingMode = sharing_mode,
+		.queueFamilyIndexCount = sharing_mode == VK_SHARING_MODE_CONCURRENT ? 2 : 0,
+		.pQueueFamilyIndices = families
 	};
 	VkResult vk_result = vkCreateBuffer(gpu->logic_dev, &vtx_buffer_info, NULL, &mesh->vtx_buff);
 	if (vk_result != VK_SUCCESS) {
@@ -1003,24 +1488,18 @@ gpu_mesh_t* gpuCreateMesh(gpu_t* gpu, gpu_mesh_info_t* mesh_info) {
 	VkMemoryAllocateInfo mem_alloc = {
 		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
 		.allocationSize = mem_req.size,
-		.memoryTypeIndex = gpuGetMemoryTypeIndex(gpu, mem_req.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		.memoryTypeIndex = gpuGetMemoryTypeIndex(gpu, mem_req.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
 	};
 	vk_result = vkAllocateMemory(gpu->logic_dev, &mem_alloc, NULL, &mesh->vtx_mem);
 	if (vk_result != VK_SUCCESS) {
 		return gpuError(gpu, "vkAllocateMemory", "Unable to allocate memory for a vertex (during mesh).");
 	}
-	void* mem_dest = 0;
-	vk_result = vkMapMemory(gpu->logic_dev, mesh->vtx_mem, 0, mem_alloc.allocationSize, 0, &mem_dest);
-	if (vk_result != VK_SUCCESS) {
-		return gpuError(gpu, "vkMapMemory", "Unable to map memory");
-	}
-	memcpy(mem_dest, mesh_info->vtx_data, mesh_info->vtx_data_size);
-	vkUnmapMemory(gpu->logic_dev, mesh->vtx_mem);
 
 	vk_result = vkBindBufferMemory(gpu->logic_dev, mesh->vtx_buff, mesh->vtx_mem, 0);
 	if (vk_result) {
 		return gpuError(gpu, "vkBindBufferMemory", "Unable to bind buffer memory for a vertex (during mesh).");
 	}
+	gpuUploadBuffer(gpu, mesh->vtx_buff, mesh_info->vtx_data, mesh_info->vtx_data_size);
 	
 	//
 	// ================== Index Data ==================
@@ -1029,7 +1508,10 @@ gpu_mesh_t* gpuCreateMesh(gpu_t* gpu, gpu_mesh_info_t* mesh_info) {
 	VkBufferCreateInfo idx_buffer_info = {
 		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
 		.size = mesh_info->idx_data_size,
-		.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+		.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		.sharingMode = sharing_mode,
+		.queueFamilyIndexCount = sharing_mode == VK_SHARING_MODE_CONCURRENT ? 2 : 0,
+		.pQueueFamilyIndices = families
 	};
 	vk_result = vkCreateBuffer(gpu->logic_dev, &idx_buffer_info, NULL, &mesh->idx_buff);
 	if (vk_result != VK_SUCCESS) {
@@ -1041,30 +1523,33 @@ gpu_mesh_t* gpuCreateMesh(gpu_t* gpu, gpu_mesh_info_t* mesh_info) {
 	VkMemoryAllocateInfo mem_alloc_index = {
 		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
 		.allocationSize = mem_req_index.size,
-		.memoryTypeIndex = gpuGetMemoryTypeIndex(gpu, mem_req_index.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		.memoryTypeIndex = gpuGetMemoryTypeIndex(gpu, mem_req_index.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
 	};
 	vk_result = vkAllocateMemory(gpu->logic_dev, &mem_alloc_index, NULL, &mesh->idx_mem);
 	if (vk_result != VK_SUCCESS) {
 		return gpuError(gpu, "vkAllocateMemory", "Unable to allocate memory for an index (during mesh).");
 	}
-	mem_dest = 0;
-	vk_result = vkMapMemory(gpu->logic_dev, mesh->idx_mem, 0, mem_alloc_index.allocationSize, 0, &mem_dest);
-	if (vk_result != VK_SUCCESS) {
-		return gpuError(gpu, "vkMapMemory", "Unable to map memory");
-	}
-	memcpy(mem_dest, mesh_info->idx_data, mesh_info->idx_data_size);
-	vkUnmapMemory(gpu->logic_dev, mesh->idx_mem);
 
 	vk_result = vkBindBufferMemory(gpu->logic_dev, mesh->idx_buff, mesh->idx_mem, 0);
 	if (vk_result) {
 		return gpuError(gpu, "vkBindBufferMemory", "Unable to bind buffer memory for an index (during mesh).");
 	}
+	gpuUploadBuffer(gpu, mesh->idx_buff, mesh_info->idx_data, mesh_info->idx_data_size);
+
+	// the copies land in the batch being recorded (an empty mesh only waits for what is already in flight)
+	bool recording = gpu->upload_batches[(gpu->upload_submitted + 1) % GPU_MAX_UPLOAD_BATCHES].recording;
+	mesh->upload_id = recording ? gpu->upload_submitted + 1 : gpu->upload_submitted;
 
+	gpu->stats.upload_bytes += mesh_info->vtx_data_size + mesh_info->idx_data_size;
+	gpu->stats.resources_created++;
 	return mesh;
 }
 
 void gpuDestroyMesh(gpu_t* gpu, gpu_mesh_t* mesh) {
 	if (mesh) {
+		// the copies into the buffers have to finish first
+		gpuUploadWait(gpu, mesh->upload_id);
+
 		if (mesh->idx_buff)
 			vkDestroyBuffer(gpu->logic_dev, mesh->idx_buff, NULL);
 		if (mesh->vtx_buff)
@@ -1076,9 +1561,14 @@ void gpuDestroyMesh(gpu_t* gpu, gpu_mesh_t* mesh) {
 			vkFreeMemory(gpu->logic_dev, mesh->vtx_mem, NULL);
 
 		heapFree(gpu->heap, mesh);
+		gpu->stats.resources_destroyed++;
 	}
 }
 
+bool gpuMeshIsReady(gpu_t* gpu, gpu_mesh_t* mesh) {
+	return mesh->upload_id <= gpu->upload_completed;
+}
+
 void gpuCommandBindMesh(gpu_t* gpu, gpu_cmd_buff_t* cmd_buff, gpu_mesh_t* mesh) {
 	if (mesh->vtx_count > 0) {
 		VkDeviceSize dev_size = 0;
@@ -1094,14 +1584,129 @@ void gpuCommandBindMesh(gpu_t* gpu, gpu_cmd_buff_t* cmd_buff, gpu_mesh_t* mesh)
 	} else {
 		cmd_buff->idx_count = 0;
 	}
+	cmd_buff->stats->mesh_binds++;
 }
 
 void gpuCommandDraw(gpu_t* gpu, gpu_cmd_buff_t* cmd_buff) {
+	gpuCommandDrawInstanced(gpu, cmd_buff, 1);
+}
+
+void* gpuCommandBindInstanceData(gpu_t* gpu, gpu_cmd_buff_t* cmd_buff, size_t size) {
+	VkDeviceSize offset;
+	void* dest = gpuRingAlloc(gpu, size, &offset);
+	if (dest == NULL) {
+		debugPrint(DEBUG_PRINT_ERROR, "gpuCommandBindInstanceData: the uniform ring is full for this frame.\n");
+		return NULL;
+	}
+	vkCmdBindVertexBuffers(cmd_buff->buffer, 1, 1, &gpu->ub_ring, &offset);
+	return dest;
+}
+
+void gpuCommandDrawInstanced(gpu_t* gpu, gpu_cmd_buff_t* cmd_buff, uint32_t instance_count) {
+	cmd_buff->stats->draws++;
+	cmd_buff->stats->instances += instance_count;
 	if (cmd_buff->idx_count) {
-		vkCmdDrawIndexed(cmd_buff->buffer, cmd_buff->idx_count, 1, 0, 0, 0);
+		vkCmdDrawIndexed(cmd_buff->buffer, cmd_buff->idx_count, instance_count, 0, 0, 0);
 	}
 	else {
-		vkCmdDraw(cmd_buff->buffer, cmd_buff->vtx_count, 1, 0, 0);
+		vkCmdDraw(cmd_buff->buffer, cmd_buff->vtx_count, instance_count, 0, 0);
+	}
+}
+
+//  --------------------------------------------------------------------------
+//								     UPLOADS
+// 
+
+// Copies data into a device local buffer through the staging ring, in as many pieces as needed.
+// Only waits when the ring has no free space left.
+static void gpuUploadBuffer(gpu_t* gpu, VkBuffer buffer, const void* data, size_t size) {
+	VkDeviceSize dst_offset = 0;
+	while (dst_offset < size) {
+		VkDeviceSize ring_offset = gpu->staging_head % GPU_STAGING_RING_SIZE;
+		VkDeviceSize chunk = size - dst_offset;
+		chunk = __min(chunk, GPU_STAGING_RING_SIZE - (gpu->staging_head - gpu->staging_tail));
+		chunk = __min(chunk, GPU_STAGING_RING_SIZE - ring_offset);
+		if (chunk == 0) {
+			// full: make sure the oldest copies are on their way and wait for them
+			if (gpu->upload_submitted == gpu->upload_completed) {
+				gpuUploadSubmit(gpu);
+			}
+			gpuUploadWait(gpu, gpu->upload_completed + 1);
+			continue;
+		}
+
+		gpu_upload_batch_t* batch = &gpu->upload_batches[(gpu->upload_submitted + 1) % GPU_MAX_UPLOAD_BATCHES];
+		if (!batch->recording) {
+			// the slot is reused once the batch GPU_MAX_UPLOAD_BATCHES before it is done
+			if (gpu->upload_submitted - gpu->upload_completed >= GPU_MAX_UPLOAD_BATCHES) {
+				gpuUploadWait(gpu, gpu->upload_completed + 1);
+			}
+			VkCommandBufferBeginInfo begin_info = {
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+				.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+			};
+			vkBeginCommandBuffer(batch->cmd_buff, &begin_info);
+			batch->recording = true;
+		}
+
+		memcpy(gpu->staging_ring_data + ring_offset, (const char*) data + dst_offset, chunk);
+		VkBufferCopy region = {
+			.srcOffset = ring_offset,
+			.dstOffset = dst_offset,
+			.size = chunk
+		};
+		vkCmdCopyBuffer(batch->cmd_buff, gpu->staging_ring, buffer, 1, &region);
+
+		gpu->staging_head += chunk;
+		dst_offset += chunk;
+	}
+}
+
+// Submits the batch being recorded, if any.
+static void gpuUploadSubmit(gpu_t* gpu) {
+	gpu_upload_batch_t* batch = &gpu->upload_batches[(gpu->upload_submitted + 1) % GPU_MAX_UPLOAD_BATCHES];
+	if (!batch->recording) {
+		return;
+	}
+
+	vkEndCommandBuffer(batch->cmd_buff);
+	vkResetFences(gpu->logic_dev, 1, &batch->fence);
+	VkSubmitInfo submit_info = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &batch->cmd_buff
+	};
+	VkResult vk_result = vkQueueSubmit(gpu->transfer_queue, 1, &submit_info, batch->fence);
+	if (vk_result != VK_SUCCESS) {
+		debugPrint(DEBUG_PRINT_ERROR, "gpuUploadSubmit: Unable to submit an upload batch.\n");
+	}
+	batch->staging_end = gpu->staging_head;
+	batch->recording = false;
+	gpu->upload_submitted++;
+}
+
+// Retires every upload batch that has finished, without waiting.
+static void gpuUploadPoll(gpu_t* gpu) {
+	while (gpu->upload_completed < gpu->upload_submitted) {
+		gpu_upload_batch_t* batch = &gpu->upload_batches[(gpu->upload_completed + 1) % GPU_MAX_UPLOAD_BATCHES];
+		if (vkGetFenceStatus(gpu->logic_dev, batch->fence) != VK_SUCCESS) {
+			break;
+		}
+		gpu->staging_tail = batch->staging_end;
+		gpu->upload_completed++;
+	}
+}
+
+// Waits until the upload batch id (and every batch before it) has finished.
+static void gpuUploadWait(gpu_t* gpu, uint64_t id) {
+	if (id > gpu->upload_submitted) {
+		gpuUploadSubmit(gpu);
+	}
+	while (gpu->upload_completed < id && gpu->upload_completed < gpu->upload_submitted) {
+		gpu_upload_batch_t* batch = &gpu->upload_batches[(gpu->upload_completed + 1) % GPU_MAX_UPLOAD_BATCHES];
+		vkWaitForFences(gpu->logic_dev, 1, &batch->fence, VK_TRUE, UINT64_MAX);
+		gpu->staging_tail = batch->staging_end;
+		gpu->upload_completed++;
 	}
 }
 
@@ -1212,6 +1817,7 @@ static void gpuDestroyMeshLayouts(gpu_t* gpu) {
 gpu_shader_t* gpuCreateShader(gpu_t* gpu, gpu_shader_info_t* shader_info) {
 	gpu_shader_t* shader = heapAlloc(gpu->heap, sizeof(gpu_shader_t), 8);
 	memset(shader, 0, sizeof(*shader));
+	shader->instance_stride = (uint32_t) shader_info->instance_stride;
 
 	VkShaderModuleCreateInfo vertex_module_create_info = {
 		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
@@ -1239,7 +1845,7 @@ gpu_shader_t* gpuCreateShader(gpu_t* gpu, gpu_shader_info_t* shader_info) {
 	for (int x = 0; x < shader_info->uniform_buffer_count; x++) {
 		descriptor_set_layout_bindings[x] = (VkDescriptorSetLayoutBinding){
 			.binding = x,
-			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
 			.descriptorCount = 1,
 			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT
 		};
@@ -1255,6 +1861,7 @@ gpu_shader_t* gpuCreateShader(gpu_t* gpu, gpu_shader_info_t* shader_info) {
 		return gpuError(gpu, "vkCreateDescriptorSetLayout", "Unable to create the descriptor set layout.");
 	}
 
+	gpu->stats.resources_created++;
 	return shader;
 }
 
@@ -1267,6 +1874,7 @@ void gpuDestroyShader(gpu_t* gpu, gpu_shader_t* shader) {
 		if (shader->descriptor_set_layout)
 			vkDestroyDescriptorSetLayout(gpu->logic_dev, shader->descriptor_set_layout, NULL);
 		heapFree(gpu->heap, shader);
+		gpu->stats.resources_destroyed++;
 	}
 }
 
@@ -1275,6 +1883,7 @@ void gpuDestroyShader(gpu_t* gpu, gpu_shader_t* shader) {
 // 
 
 void gpuQueueWaitIdle(gpu_t* gpu) {
+	gpuUploadWait(gpu, gpu->upload_submitted + 1);
 	vkQueueWaitIdle(gpu->queue);
 }
 
@@ -1282,8 +1891,18 @@ uint32_t gpuGetFrameCount(gpu_t* gpu) {
 	return gpu->frame_count;
 }
 
+void gpuGetStats(gpu_t* gpu, gpu_stats_t* stats) {
+	*stats = gpu->stats;
+}
+
+void gpuSetDrawHashEnabled(gpu_t* gpu, bool enabled) {
+	// NOTE: the Vulkan backend does not hash the draw stream, see gpu_null.c
+}
+
 void* gpuError(gpu_t* gpu, const char* fn_name, const char* reason) {
 	debugPrint(DEBUG_PRINT_ERROR, "%s: %s\n", fn_name, reason);
 	gpuDestroy(gpu);
 	return NULL;
 }
+
+#endif // !GPU_NULL
@@ -1,15 +1,18 @@
 #ifndef __GPU_H__
 #define __GPU_H__
 
+#if !defined(GPU_NULL)
 #define VK_USE_PLATFORM_WIN32_KHR
 #include <vulkan\vulkan.h>
+#endif
 
 #include <stdint.h>
 #include <stdbool.h>
 
 /* GPU
-
-
+*	- gpu.c implements the API on Vulkan (Win32 surface)
+*	- gpu_null.c implements it without a device when GPU_NULL is defined, commands and uploads
+*	  are only counted (and optionally hashed) so the renderer can run on machines without a GPU
 */
 
 typedef struct gpu_t gpu_t;								// Holds GPU data
@@ -21,6 +24,8 @@ typedef struct gpu_descriptor_t gpu_descriptor_t;		// Holds descriptor sets
 typedef struct gpu_shader_t gpu_shader_t;
 typedef struct gpu_uniform_buffer_t gpu_uniform_buffer_t;
 
+#define GPU_MAX_RECORD_WORKERS 8		// threads that can record secondary command buffers at the same time
+
 // MESH LAYOUTS
 typedef enum gpu_mesh_layout_t {
 	GPU_MESH_LAYOUT_TRI_P444_I2,
@@ -35,6 +40,7 @@ typedef struct gpu_shader_info_t {
 	void* frag_shader_data;
 	size_t frag_shader_size;
 	int uniform_buffer_count;
+	size_t instance_stride;		// bytes of per instance vertex data (binding 1, one vec4 per 16 bytes from location 2), 0 if not instanced
 } gpu_shader_info_t;
 
 // PIPELINE
@@ -65,8 +71,23 @@ typedef struct gpu_mesh_info_t {
 	size_t idx_data_size;
 } gpu_mesh_info_t;
 
+// STATS
+typedef struct gpu_stats_t {
+	uint64_t frames;
+	uint64_t draws;						// draw calls
+	uint64_t instances;					// instances drawn, 1 per non instanced draw
+	uint64_t pipeline_binds;
+	uint64_t mesh_binds;
+	uint64_t descriptor_binds;
+	uint64_t upload_bytes;				// uniform, instance and mesh data written for the gpu
+	uint64_t resources_created;
+	uint64_t resources_destroyed;
+	uint64_t draw_hash;					// FNV-1a of the draw stream, only computed by the null backend when enabled
+} gpu_stats_t;
+
 // others
 typedef struct heap_t heap_t;
+typedef struct fs_t fs_t;
 typedef struct wm_window_t wm_window_t;
 
 
@@ -76,12 +97,33 @@ typedef struct wm_window_t wm_window_t;
 void* gpuError(gpu_t* gpu, const char* fn_name, const char* reason);
 
 
-gpu_t* gpuCreate(heap_t* heap, wm_window_t* window);
+// Creates the device and swapchain for the window.
+// Pipelines are built through a pipeline cache that is loaded from disk through fs (if a valid one exists)
+// and saved back by gpuDestroy. The saved cache is handed to fsWrite, so heap has to be the heap fs was created with.
+//
+// RETURN: the gpu, NULL on failure
+gpu_t* gpuCreate(heap_t* heap, fs_t* fs, wm_window_t* window);
 void gpuDestroy(gpu_t* gpu);
 
+// Draws are never recorded into the command buffer returned by gpuBeginFrameUpdate, the render pass
+// takes its contents from secondary command buffers that are executed into it.
 gpu_cmd_buff_t* gpuBeginFrameUpdate(gpu_t* gpu);
 void gpuEndFrameUpdate(gpu_t* gpu);
 
+// Begins a secondary command buffer for the frame being recorded from the pool of the given worker
+// (0 to GPU_MAX_RECORD_WORKERS - 1). Different workers can record at the same time as long as every
+// worker index is used by one thread at a time, the gpuCommand* functions are safe to call on them
+// except gpuCommandBindInstanceData. Everything else stays on the thread that begins the frame.
+//
+// RETURN: the secondary to record draws into, NULL on failure
+gpu_cmd_buff_t* gpuCommandBeginSecondary(gpu_t* gpu, int worker);
+void gpuCommandEndSecondary(gpu_t* gpu, gpu_cmd_buff_t* cmd_buff);
+
+// Executes ended secondaries into the frame's command buffer in array order (NULL entries are skipped)
+// and adds their counters to the stats.
+//
+void gpuCommandExecuteSecondaries(gpu_t* gpu, gpu_cmd_buff_t* cmd_buff, gpu_cmd_buff_t** secondaries, int count);
+
 gpu_pipeline_t* gpuCreatePipeline(gpu_t* gpu, const gpu_pipeline_info_t* pipeline_info);
 void gpuCommandBindPipeline(gpu_cmd_buff_t* cmd_buff, gpu_pipeline_t* pipeline);
 void gpuDestroyPipeline(gpu_t* gpu, gpu_pipeline_t* pipeline);
@@ -90,12 +132,22 @@ gpu_descriptor_t* gpuCreateDescriptorSets(gpu_t* gpu, const gpu_descriptor_info_
 void gpuCommandBindDescriptorSets(gpu_cmd_buff_t* cmd_buff, gpu_descriptor_t* descriptor);
 void gpuDestroyDescriptorSets(gpu_t* gpu, gpu_descriptor_t* descriptor);
 
+// Uniform buffers are sub-allocated from a persistently mapped ring with a region per frame.
+// Every update writes a new copy into the region of the frame being recorded, so create/update
+// between gpuBeginFrameUpdate and gpuEndFrameUpdate and update every frame the buffer is drawn.
 gpu_uniform_buffer_t* gpuCreateUniformBuffer(gpu_t* gpu, const gpu_uniform_buffer_info_t* ub_info);
 void gpuUpdateUniformBuffer(gpu_t* gpu, gpu_uniform_buffer_t* ub, const void* data, size_t size);
 void gpuDestroyUniformBuffer(gpu_t* gpu, gpu_uniform_buffer_t* ub);
 
+// Mesh data is copied into device local memory through a staging ring on the transfer queue,
+// creation does not wait for the copy. Check gpuMeshIsReady before drawing a mesh.
 gpu_mesh_t* gpuCreateMesh(gpu_t* gpu, gpu_mesh_info_t* mesh_info);
 void gpuDestroyMesh(gpu_t* gpu, gpu_mesh_t* mesh);
+
+// Checks if the upload of a mesh has finished, uploads are retired in gpuBeginFrameUpdate.
+//
+// RETURN: true if the mesh can be drawn
+bool gpuMeshIsReady(gpu_t* gpu, gpu_mesh_t* mesh);
 void gpuCommandBindMesh(gpu_t* gpu, gpu_cmd_buff_t* cmd_buff, gpu_mesh_t* mesh);
 
 gpu_shader_t* gpuCreateShader(gpu_t* gpu, gpu_shader_info_t* shader_info);
@@ -103,7 +155,25 @@ void gpuDestroyShader(gpu_t* gpu, gpu_shader_t* shader);
 
 void gpuCommandDraw(gpu_t* gpu, gpu_cmd_buff_t* cmd_buff);
 
+// Allocates size bytes of per instance data for this frame and binds it for the next instanced draw.
+//
+// RETURN: memory to write the instance data to (valid until the frame ends), NULL if the frame is out of space
+void* gpuCommandBindInstanceData(gpu_t* gpu, gpu_cmd_buff_t* cmd_buff, size_t size);
+
+// Draws the bound mesh once per instance, the pipeline's shader has to have an instance stride.
+//
+void gpuCommandDrawInstanced(gpu_t* gpu, gpu_cmd_buff_t* cmd_buff, uint32_t instance_count);
+
 void gpuQueueWaitIdle(gpu_t* gpu);
 
 uint32_t gpuGetFrameCount(gpu_t* gpu);
+
+// Get the counters accumulated since the gpu was created.
+//
+void gpuGetStats(gpu_t* gpu, gpu_stats_t* stats);
+
+// Enables hashing every recorded command and its data into gpu_stats_t.draw_hash, two runs that
+// record the same draw stream end up with the same hash. Only the null backend hashes.
+//
+void gpuSetDrawHashEnabled(gpu_t* gpu, bool enabled);
 #endif
\ No newline at end of file
@@ -0,0 +1,431 @@
+#include "gpu.h"
+
+#if defined(GPU_NULL)
+
+#include "heap.h"
+#include "debug.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Mirrors gpu.c so a frame runs out of ring space at the same point on both backends.
+#define GPU_NULL_FRAME_COUNT 3
+#define GPU_MAX_UNIFORM_BUFFERS 8
+#define GPU_UNIFORM_RING_FRAME_SIZE (4 * 1024 * 1024)
+#define GPU_UNIFORM_ALIGNMENT 256
+
+#define GPU_HASH_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define GPU_HASH_PRIME 0x100000001b3ULL
+
+typedef enum gpu_null_op_t {
+	GPU_NULL_OP_BEGIN_FRAME = 1,
+	GPU_NULL_OP_END_FRAME,
+	GPU_NULL_OP_BIND_PIPELINE,
+	GPU_NULL_OP_BIND_MESH,
+	GPU_NULL_OP_BIND_DESCRIPTOR,
+	GPU_NULL_OP_BIND_INSTANCE_DATA,
+	GPU_NULL_OP_DRAW,
+	GPU_NULL_OP_UPDATE_UNIFORM,
+	GPU_NULL_OP_EXECUTE
+} gpu_null_op_t;
+
+typedef struct gpu_cmd_buff_t {
+	gpu_t* gpu;
+	int idx_count;
+	int vtx_count;
+	const void* instance_data;
+	size_t instance_size;
+	gpu_stats_t* stats;
+	gpu_stats_t local_stats;		// secondaries hash into their own stream, folded in when executed
+} gpu_cmd_buff_t;
+
+typedef struct gpu_pipeline_t {
+	uint32_t instance_stride;
+	gpu_mesh_layout_t mesh_layout;
+} gpu_pipeline_t;
+
+typedef struct gpu_descriptor_t {
+	gpu_uniform_buffer_t* uniform_buffers[GPU_MAX_UNIFORM_BUFFERS];
+	int uniform_buffer_count;
+} gpu_descriptor_t;
+
+typedef struct gpu_shader_t {
+	uint32_t instance_stride;
+} gpu_shader_t;
+
+typedef struct gpu_uniform_buffer_t {
+	uint32_t offset;
+} gpu_uniform_buffer_t;
+
+typedef struct gpu_mesh_t {
+	void* vtx_data;
+	void* idx_data;
+	int idx_count;
+	int vtx_count;
+} gpu_mesh_t;
+
+typedef struct gpu_record_worker_t {
+	gpu_cmd_buff_t** buffers;
+	int count;
+	int capacity;
+	int used;
+} gpu_record_worker_t;
+
+typedef struct gpu_t {
+	heap_t* heap;
+	gpu_cmd_buff_t cmd_buff;
+	gpu_record_worker_t workers[GPU_MAX_RECORD_WORKERS];
+
+	// stands in for the mapped uniform ring, writes cost the same memcpy as on a device
+	char* ring_data;
+	size_t ring_offset;
+	uint32_t frame_idx;
+
+	gpu_stats_t stats;
+	bool hash_enabled;
+} gpu_t;
+
+static const size_t s_mesh_vtx_size[GPU_MESH_LAYOUT_COUNT] = { 12, 24 };
+static const size_t s_mesh_idx_size[GPU_MESH_LAYOUT_COUNT] = { 2, 2 };
+
+static void* gpuRingAlloc(gpu_t* gpu, size_t size, uint32_t* offset);
+
+static void gpuHash(gpu_stats_t* stats, const void* data, size_t size) {
+	const uint8_t* bytes = data;
+	uint64_t hash = stats->draw_hash;
+	for (size_t x = 0; x < size; x++) {
+		hash = (hash ^ bytes[x]) * GPU_HASH_PRIME;
+	}
+	stats->draw_hash = hash;
+}
+
+static void gpuHashOp(gpu_t* gpu, gpu_stats_t* stats, gpu_null_op_t op, uint64_t value) {
+	if (gpu->hash_enabled) {
+		uint64_t record[2] = { op, value };
+		gpuHash(stats, record, sizeof(record));
+	}
+}
+
+static void gpuStatsAdd(gpu_stats_t* stats, const gpu_stats_t* add) {
+	stats->draws += add->draws;
+	stats->instances += add->instances;
+	stats->pipeline_binds += add->pipeline_binds;
+	stats->mesh_binds += add->mesh_binds;
+	stats->descriptor_binds += add->descriptor_binds;
+}
+
+//  --------------------------------------------------------------------------
+//								INIT/DESTROY GPU
+//
+
+gpu_t* gpuCreate(heap_t* heap, fs_t* fs, wm_window_t* window) {
+	gpu_t* gpu = heapAlloc(heap, sizeof(gpu_t), 8);
+	memset(gpu, 0, sizeof(*gpu));
+	gpu->heap = heap;
+	gpu->cmd_buff.gpu = gpu;
+	gpu->cmd_buff.stats = &gpu->stats;
+	gpu->stats.draw_hash = GPU_HASH_OFFSET_BASIS;
+	gpu->ring_data = heapAlloc(heap, (size_t) GPU_UNIFORM_RING_FRAME_SIZE * GPU_NULL_FRAME_COUNT, GPU_UNIFORM_ALIGNMENT);
+	return gpu;
+}
+
+void gpuDestroy(gpu_t* gpu) {
+	if (gpu) {
+		for (int x = 0; x < GPU_MAX_RECORD_WORKERS; x++) {
+			gpu_record_worker_t* worker = &gpu->workers[x];
+			for (int b = 0; b < worker->count; b++) {
+				heapFree(gpu->heap, worker->buffers[b]);
+			}
+			if (worker->buffers)
+				heapFree(gpu->heap, worker->buffers);
+		}
+		heapFree(gpu->heap, gpu->ring_data);
+		heapFree(gpu->heap, gpu);
+	}
+}
+
+//  --------------------------------------------------------------------------
+//								FRAME UPDATES
+//
+
+gpu_cmd_buff_t* gpuBeginFrameUpdate(gpu_t* gpu) {
+	gpu->ring_offset = 0;
+	for (int x = 0; x < GPU_MAX_RECORD_WORKERS; x++) {
+		gpu->workers[x].used = 0;
+	}
+	gpuHashOp(gpu, &gpu->stats, GPU_NULL_OP_BEGIN_FRAME, gpu->stats.frames);
+	return &gpu->cmd_buff;
+}
+
+gpu_cmd_buff_t* gpuCommandBeginSecondary(gpu_t* gpu, int worker_idx) {
+	gpu_record_worker_t* worker = &gpu->workers[worker_idx];
+	if (worker->used == worker->count) {
+		if (worker->count == worker->capacity) {
+			int capacity = __max(worker->capacity * 2, 8);
+			gpu_cmd_buff_t** buffers = heapAlloc(gpu->heap, sizeof(gpu_cmd_buff_t*) * capacity, 8);
+			if (worker->buffers) {
+				memcpy(buffers, worker->buffers, sizeof(gpu_cmd_buff_t*) * worker->count);
+				heapFree(gpu->heap, worker->buffers);
+			}
+			worker->buffers = buffers;
+			worker->capacity = capacity;
+		}
+		gpu_cmd_buff_t* cmd_buff = heapAlloc(gpu->heap, sizeof(gpu_cmd_buff_t), 8);
+		memset(cmd_buff, 0, sizeof(*cmd_buff));
+		cmd_buff->gpu = gpu;
+		cmd_buff->stats = &cmd_buff->local_stats;
+		worker->buffers[worker->count++] = cmd_buff;
+	}
+
+	gpu_cmd_buff_t* cmd_buff = worker->buffers[worker->used++];
+	memset(&cmd_buff->local_stats, 0, sizeof(cmd_buff->local_stats));
+	cmd_buff->local_stats.draw_hash = GPU_HASH_OFFSET_BASIS;
+	cmd_buff->idx_count = 0;
+	cmd_buff->vtx_count = 0;
+	cmd_buff->instance_data = NULL;
+	cmd_buff->instance_size = 0;
+	return cmd_buff;
+}
+
+void gpuCommandEndSecondary(gpu_t* gpu, gpu_cmd_buff_t* cmd_buff) {
+}
+
+void gpuCommandExecuteSecondaries(gpu_t* gpu, gpu_cmd_buff_t* cmd_buff, gpu_cmd_buff_t** secondaries, int count) {
+	// the hash only depends on the order the secondaries are executed in, not on which worker recorded them
+	for (int x = 0; x < count; x++) {
+		if (secondaries[x]) {
+			gpuStatsAdd(cmd_buff->stats, &secondaries[x]->local_stats);
+			gpuHashOp(gpu, cmd_buff->stats, GPU_NULL_OP_EXECUTE, secondaries[x]->local_stats.draw_hash);
+		}
+	}
+}
+
+void gpuEndFrameUpdate(gpu_t* gpu) {
+	gpu->frame_idx = (gpu->frame_idx + 1) % GPU_NULL_FRAME_COUNT;
+	gpu->stats.frames++;
+	gpuHashOp(gpu, &gpu->stats, GPU_NULL_OP_END_FRAME, gpu->stats.frames);
+}
+
+//  --------------------------------------------------------------------------
+//								DESCRIPTOR SETS
+//
+
+gpu_descriptor_t* gpuCreateDescriptorSets(gpu_t* gpu, const gpu_descriptor_info_t* descriptor_info) {
+	if (descriptor_info->uniform_buffer_count > GPU_MAX_UNIFORM_BUFFERS) {
+		debugPrint(DEBUG_PRINT_ERROR, "gpuCreateDescriptorSets: %d uniform buffers requested, the limit is %d.\n", descriptor_info->uniform_buffer_count, GPU_MAX_UNIFORM_BUFFERS);
+		return NULL;
+	}
+
+	gpu_descriptor_t* descriptor = heapAlloc(gpu->heap, sizeof(gpu_descriptor_t), 8);
+	memset(descriptor, 0, sizeof(*descriptor));
+	for (int x = 0; x < descriptor_info->uniform_buffer_count; x++) {
+		descriptor->uniform_buffers[x] = descriptor_info->uniform_buffers[x];
+	}
+	descriptor->uniform_buffer_count = descriptor_info->uniform_buffer_count;
+	gpu->stats.resources_created++;
+	return descriptor;
+}
+
+void gpuDestroyDescriptorSets(gpu_t* gpu, gpu_descriptor_t* descriptor) {
+	if (descriptor) {
+		heapFree(gpu->heap, descriptor);
+		gpu->stats.resources_destroyed++;
+	}
+}
+
+void gpuCommandBindDescriptorSets(gpu_cmd_buff_t* cmd_buff, gpu_descriptor_t* descriptor) {
+	gpu_t* gpu = cmd_buff->gpu;
+	for (int x = 0; x < descriptor->uniform_buffer_count; x++) {
+		gpuHashOp(gpu, cmd_buff->stats, GPU_NULL_OP_BIND_DESCRIPTOR, descriptor->uniform_buffers[x]->offset);
+	}
+	cmd_buff->stats->descriptor_binds++;
+}
+
+//  --------------------------------------------------------------------------
+//								    PIPELINE
+//
+
+gpu_pipeline_t* gpuCreatePipeline(gpu_t* gpu, const gpu_pipeline_info_t* pipeline_info) {
+	gpu_pipeline_t* pipeline = heapAlloc(gpu->heap, sizeof(gpu_pipeline_t), 8);
+	pipeline->instance_stride = pipeline_info->shader->instance_stride;
+	pipeline->mesh_layout = pipeline_info->mesh_layout;
+	gpu->stats.resources_created++;
+	return pipeline;
+}
+
+void gpuDestroyPipeline(gpu_t* gpu, gpu_pipeline_t* pipeline) {
+	if (pipeline) {
+		heapFree(gpu->heap, pipeline);
+		gpu->stats.resources_destroyed++;
+	}
+}
+
+void gpuCommandBindPipeline(gpu_cmd_buff_t* cmd_buff, gpu_pipeline_t* pipeline) {
+	gpuHashOp(cmd_buff->gpu, cmd_buff->stats, GPU_NULL_OP_BIND_PIPELINE, ((uint64_t) pipeline->instance_stride << 32) | pipeline->mesh_layout);
+	cmd_buff->stats->pipeline_binds++;
+}
+
+//  --------------------------------------------------------------------------
+//								 UNIFORM BUFFER
+//
+
+gpu_uniform_buffer_t* gpuCreateUniformBuffer(gpu_t* gpu, const gpu_uniform_buffer_info_t* ub_info) {
+	gpu_uniform_buffer_t* ub = heapAlloc(gpu->heap, sizeof(gpu_uniform_buffer_t), 8);
+	memset(ub, 0, sizeof(*ub));
+	gpuUpdateUniformBuffer(gpu, ub, ub_info->data, ub_info->size);
+	gpu->stats.resources_created++;
+	return ub;
+}
+
+void gpuUpdateUniformBuffer(gpu_t* gpu, gpu_uniform_buffer_t* ub, const void* data, size_t size) {
+	uint32_t offset;
+	void* dest = gpuRingAlloc(gpu, size, &offset);
+	if (dest == NULL) {
+		debugPrint(DEBUG_PRINT_ERROR, "gpuUpdateUniformBuffer: the uniform ring is full for this frame, the update is dropped.\n");
+		return;
+	}
+	memcpy(dest, data, size);
+	ub->offset = offset;
+
+	if (gpu->hash_enabled) {
+		gpuHashOp(gpu, &gpu->stats, GPU_NULL_OP_UPDATE_UNIFORM, offset);
+		gpuHash(&gpu->stats, data, size);
+	}
+}
+
+void gpuDestroyUniformBuffer(gpu_t* gpu, gpu_uniform_buffer_t* ub) {
+	if (ub) {
+		heapFree(gpu->heap, ub);
+		gpu->stats.resources_destroyed++;
+	}
+}
+
+static void* gpuRingAlloc(gpu_t* gpu, size_t size, uint32_t* offset) {
+	size_t aligned_size = (size + GPU_UNIFORM_ALIGNMENT - 1) & ~(size_t) (GPU_UNIFORM_ALIGNMENT - 1);
+	if (gpu->ring_offset + aligned_size > GPU_UNIFORM_RING_FRAME_SIZE) {
+		return NULL;
+	}
+
+	*offset = (uint32_t) (GPU_UNIFORM_RING_FRAME_SIZE * gpu->frame_idx + gpu->ring_offset);
+	gpu->ring_offset += aligned_size;
+	gpu->stats.upload_bytes += size;
+	return gpu->ring_data + *offset;
+}
+
+//  --------------------------------------------------------------------------
+//								      MESH
+//
+
+gpu_mesh_t* gpuCreateMesh(gpu_t* gpu, gpu_mesh_info_t* mesh_info) {
+	gpu_mesh_t* mesh = heapAlloc(gpu->heap, sizeof(gpu_mesh_t), 8);
+	memset(mesh, 0, sizeof(*mesh));
+
+	mesh->idx_count = (int) (mesh_info->idx_data_size / s_mesh_idx_size[mesh_info->layout]);
+	mesh->vtx_count = (int) (mesh_info->vtx_data_size / s_mesh_vtx_size[mesh_info->layout]);
+
+	// copied like an upload would, so mesh creation is not free on this backend either
+	mesh->vtx_data = heapAlloc(gpu->heap, __max(mesh_info->vtx_data_size, 1), 16);
+	mesh->idx_data = heapAlloc(gpu->heap, __max(mesh_info->idx_data_size, 1), 16);
+	memcpy(mesh->vtx_data, mesh_info->vtx_data, mesh_info->vtx_data_size);
+	memcpy(mesh->idx_data, mesh_info->idx_data, mesh_info->idx_data_size);
+
+	gpu->stats.upload_bytes += mesh_info->vtx_data_size + mesh_info->idx_data_size;
+	gpu->stats.resources_created++;
+	return mesh;
+}
+
+void gpuDestroyMesh(gpu_t* gpu, gpu_mesh_t* mesh) {
+	if (mesh) {
+		heapFree(gpu->heap, mesh->idx_data);
+		heapFree(gpu->heap, mesh->vtx_data);
+		heapFree(gpu->heap, mesh);
+		gpu->stats.resources_destroyed++;
+	}
+}
+
+bool gpuMeshIsReady(gpu_t* gpu, gpu_mesh_t* mesh) {
+	return true;
+}
+
+void gpuCommandBindMesh(gpu_t* gpu, gpu_cmd_buff_t* cmd_buff, gpu_mesh_t* mesh) {
+	cmd_buff->vtx_count = mesh->vtx_count;
+	cmd_buff->idx_count = mesh->idx_count;
+	gpuHashOp(gpu, cmd_buff->stats, GPU_NULL_OP_BIND_MESH, ((uint64_t) mesh->vtx_count << 32) | (uint32_t) mesh->idx_count);
+	cmd_buff->stats->mesh_binds++;
+}
+
+void gpuCommandDraw(gpu_t* gpu, gpu_cmd_buff_t* cmd_buff) {
+	gpuCommandDrawInstanced(gpu, cmd_buff, 1);
+}
+
+void* gpuCommandBindInstanceData(gpu_t* gpu, gpu_cmd_buff_t* cmd_buff, size_t size) {
+	uint32_t offset;
+	void* dest = gpuRingAlloc(gpu, size, &offset);
+	if (dest == NULL) {
+		debugPrint(DEBUG_PRINT_ERROR, "gpuCommandBindInstanceData: the uniform ring is full for this frame.\n");
+		return NULL;
+	}
+	// the data is written after this returns, it is hashed when drawn
+	cmd_buff->instance_data = dest;
+	cmd_buff->instance_size = size;
+	gpuHashOp(gpu, cmd_buff->stats, GPU_NULL_OP_BIND_INSTANCE_DATA, offset);
+	return dest;
+}
+
+void gpuCommandDrawInstanced(gpu_t* gpu, gpu_cmd_buff_t* cmd_buff, uint32_t instance_count) {
+	cmd_buff->stats->draws++;
+	cmd_buff->stats->instances += instance_count;
+
+	if (gpu->hash_enabled) {
+		gpuHashOp(gpu, cmd_buff->stats, GPU_NULL_OP_DRAW, ((uint64_t) instance_count << 32) | (uint32_t) (cmd_buff->idx_count ? cmd_buff->idx_count : cmd_buff->vtx_count));
+		// a batch of one instance still reads its instance data
+		if (cmd_buff->instance_data) {
+			gpuHash(cmd_buff->stats, cmd_buff->instance_data, cmd_buff->instance_size);
+		}
+	}
+}
+
+//  --------------------------------------------------------------------------
+//								    SHADERS
+//
+
+gpu_shader_t* gpuCreateShader(gpu_t* gpu, gpu_shader_info_t* shader_info) {
+	gpu_shader_t* shader = heapAlloc(gpu->heap, sizeof(gpu_shader_t), 8);
+	shader->instance_stride = (uint32_t) shader_info->instance_stride;
+	gpu->stats.resources_created++;
+	return shader;
+}
+
+void gpuDestroyShader(gpu_t* gpu, gpu_shader_t* shader) {
+	if (shader) {
+		heapFree(gpu->heap, shader);
+		gpu->stats.resources_destroyed++;
+	}
+}
+
+//  --------------------------------------------------------------------------
+//								    MISC
+//
+
+void gpuQueueWaitIdle(gpu_t* gpu) {
+}
+
+uint32_t gpuGetFrameCount(gpu_t* gpu) {
+	return GPU_NULL_FRAME_COUNT;
+}
+
+void gpuGetStats(gpu_t* gpu, gpu_stats_t* stats) {
+	*stats = gpu->stats;
+}
+
+void gpuSetDrawHashEnabled(gpu_t* gpu, bool enabled) {
+	gpu->hash_enabled = enabled;
+}
+
+void* gpuError(gpu_t* gpu, const char* fn_name, const char* reason) {
+	debugPrint(DEBUG_PRINT_ERROR, "%s: %s\n", fn_name, reason);
+	gpuDestroy(gpu);
+	return NULL;
+}
+
+#endif // GPU_NULL
@@ -1,11 +1,308 @@
 #include "hashtable.h"
 
-/*
-typedef struct hasht_item_t {
+#include "heap.h"
 
-} hasht_item_t;
+#include <lz4/xxhash.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define HASHTABLE_SSE2 1
+#include <emmintrin.h>
+#else
+#define HASHTABLE_SSE2 0
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Every slot has a control byte: the top bit set means the slot is free (empty or deleted),
+// otherwise the low 7 bits are the top 7 bits of the key's hash (h2).
+#define HASHTABLE_CTRL_EMPTY ((int8_t) -128)
+#define HASHTABLE_CTRL_DELETED ((int8_t) -2)
+
+#define HASHTABLE_GROUP_SIZE 16
+#define HASHTABLE_MIN_CAPACITY 16
+#define HASHTABLE_SEED 0
 
 typedef struct hasht_t {
+	heap_t* heap;
+	size_t key_size;
+	size_t value_size;
+	size_t value_offset;	// key rounded up to 8 bytes
+	size_t slot_size;		// key then value, both rounded up to 8 bytes
 
+	int8_t* ctrl;			// capacity control bytes, 16 byte aligned
+	char* slots;
+	int capacity;			// power of two, multiple of HASHTABLE_GROUP_SIZE
+	int count;
+	int growth_left;		// empty slots that can still be filled before the table is 7/8 full
 } hasht_t;
-*/
\ No newline at end of file
+
+//  --------------------------------------------------------------------------
+//								  GROUP MATCHING
+//
+
+// Bit x of a mask is set when control byte x of the group matches.
+typedef uint32_t hasht_mask_t;
+
+#if HASHTABLE_SSE2
+static inline hasht_mask_t hashTableGroupMatch(const int8_t* group, int8_t h2) {
+	__m128i ctrl = _mm_load_si128((const __m128i*) group);
+	return (hasht_mask_t) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2)));
+}
+
+static inline hasht_mask_t hashTableGroupMatchEmpty(const int8_t* group) {
+	return hashTableGroupMatch(group, HASHTABLE_CTRL_EMPTY);
+}
+
+static inline hasht_mask_t hashTableGroupMatchFree(const int8_t* group) {
+	// empty and deleted are the only control bytes with the top bit set
+	return (hasht_mask_t) _mm_movemask_epi8(_mm_load_si128((const __m128i*) group));
+}
+#else
+static inline hasht_mask_t hashTableGroupMatch(const int8_t* group, int8_t h2) {
+	hasht_mask_t mask = 0;
+	for (int x = 0; x < HASHTABLE_GROUP_SIZE; x++) {
+		mask |= (hasht_mask_t) (group[x] == h2) << x;
+	}
+	return mask;
+}
+
+static inline hasht_mask_t hashTableGroupMatchEmpty(const int8_t* group) {
+	return hashTableGroupMatch(group, HASHTABLE_CTRL_EMPTY);
+}
+
+static inline hasht_mask_t hashTableGroupMatchFree(const int8_t* group) {
+	hasht_mask_t mask = 0;
+	for (int x = 0; x < HASHTABLE_GROUP_SIZE; x++) {
+		mask |= (hasht_mask_t) (group[x] < 0) << x;
+	}
+	return mask;
+}
+#endif
+
+static inline int hashTableMaskFirst(hasht_mask_t mask) {
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int) index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+//  --------------------------------------------------------------------------
+//								     SLOTS
+//
+
+static inline uint64_t hashTableHash(const hasht_t* ht, const void* key) {
+	return XXH64(key, ht->key_size, HASHTABLE_SEED);
+}
+
+static inline int8_t hashTableH2(uint64_t hash) {
+	return (int8_t) (hash >> 57);
+}
+
+static inline char* hashTableSlotKey(const hasht_t* ht, int slot) {
+	return ht->slots + ht->slot_size * slot;
+}
+
+static inline char* hashTableSlotValue(const hasht_t* ht, int slot) {
+	return ht->slots + ht->slot_size * slot + ht->value_offset;
+}
+
+static inline int hashTableMaxLoad(int capacity) {
+	return capacity - capacity / 8;
+}
+
+static void hashTableAllocate(hasht_t* ht, int capacity) {
+	ht->capacity = capacity;
+	ht->count = 0;
+	ht->growth_left = hashTableMaxLoad(capacity);
+	ht->ctrl = heapAlloc(ht->heap, capacity, HASHTABLE_GROUP_SIZE);
+	ht->slots = heapAlloc(ht->heap, ht->slot_size * capacity, 8);
+	memset(ht->ctrl, HASHTABLE_CTRL_EMPTY, capacity);
+}
+
+// Groups are probed in triangular steps, which visits every group once when the group count is a power of two.
+// A lookup stops at the first group holding an empty slot, the key would have been placed there or earlier.
+//
+// RETURN: the slot holding the key, -1 if missing
+static int hashTableFind(const hasht_t* ht, const void* key, uint64_t hash) {
+	int group_mask = ht->capacity / HASHTABLE_GROUP_SIZE - 1;
+	int group = (int) (hash & group_mask);
+	int8_t h2 = hashTableH2(hash);
+	for (int step = 1; ; step++) {
+		const int8_t* ctrl = ht->ctrl + group * HASHTABLE_GROUP_SIZE;
+		hasht_mask_t match = hashTableGroupMatch(ctrl, h2);
+		while (match) {
+			int slot = group * HASHTABLE_GROUP_SIZE + hashTableMaskFirst(match);
+			if (memcmp(hashTableSlotKey(ht, slot), key, ht->key_size) == 0) {
+				return slot;
+			}
+			match &= match - 1;
+		}
+		if (hashTableGroupMatchEmpty(ctrl) || step > group_mask) {
+			return -1;
+		}
+		group = (group + step) & group_mask;
+	}
+}
+
+// RETURN: the first empty or deleted slot on the key's probe sequence
+static int hashTableFindFree(const hasht_t* ht, uint64_t hash) {
+	int group_mask = ht->capacity / HASHTABLE_GROUP_SIZE - 1;
+	int group = (int) (hash & group_mask);
+	for (int step = 1; ; step++) {
+		hasht_mask_t free = hashTableGroupMatchFree(ht->ctrl + group * HASHTABLE_GROUP_SIZE);
+		if (free) {
+			return group * HASHTABLE_GROUP_SIZE + hashTableMaskFirst(free);
+		}
+		group = (group + step) & group_mask;
+	}
+}
+
+static void hashTableRehash(hasht_t* ht, int capacity) {
+	int8_t* ctrl = ht->ctrl;
+	char* slots = ht->slots;
+	int old_capacity = ht->capacity;
+
+	hashTableAllocate(ht, capacity);
+	for (int x = 0; x < old_capacity; x++) {
+		if (ctrl[x] >= 0) {
+			const char* key = slots + ht->slot_size * x;
+			uint64_t hash = hashTableHash(ht, key);
+			int slot = hashTableFindFree(ht, hash);
+			ht->ctrl[slot] = hashTableH2(hash);
+			memcpy(hashTableSlotKey(ht, slot), key, ht->slot_size);
+			ht->count++;
+		}
+	}
+	ht->growth_left = hashTableMaxLoad(capacity) - ht->count;
+
+	heapFree(ht->heap, slots);
+	heapFree(ht->heap, ctrl);
+}
+
+static int hashTableCapacityFor(int count) {
+	int capacity = HASHTABLE_MIN_CAPACITY;
+	while (hashTableMaxLoad(capacity) < count) {
+		capacity *= 2;
+	}
+	return capacity;
+}
+
+//  --------------------------------------------------------------------------
+//								      API
+//
+
+hasht_t* hashTableCreate(heap_t* heap, size_t key_size, size_t value_size, int capacity) {
+	hasht_t* ht = heapAlloc(heap, sizeof(hasht_t), 8);
+	ht->heap = heap;
+	ht->key_size = key_size;
+	ht->value_size = value_size;
+	ht->value_offset = (key_size + 7) & ~(size_t) 7;
+	ht->slot_size = ht->value_offset + ((value_size + 7) & ~(size_t) 7);
+	hashTableAllocate(ht, hashTableCapacityFor(capacity));
+	return ht;
+}
+
+void hashTableDestroy(hasht_t* ht) {
+	heapFree(ht->heap, ht->slots);
+	heapFree(ht->heap, ht->ctrl);
+	heapFree(ht->heap, ht);
+}
+
+void hashTableReserve(hasht_t* ht, int capacity) {
+	if (capacity > hashTableMaxLoad(ht->capacity)) {
+		hashTableRehash(ht, hashTableCapacityFor(capacity));
+	}
+}
+
+void* hashTableGet(hasht_t* ht, const void* key) {
+	int slot = hashTableFind(ht, key, hashTableHash(ht, key));
+	return slot >= 0 ? hashTableSlotValue(ht, slot) : NULL;
+}
+
+void* hashTableInsert(hasht_t* ht, const void* key, bool* inserted) {
+	uint64_t hash = hashTableHash(ht, key);
+	int slot = hashTableFind(ht, key, hash);
+	if (slot >= 0) {
+		if (inserted) {
+			*inserted = false;
+		}
+		return hashTableSlotValue(ht, slot);
+	}
+
+	slot = hashTableFindFree(ht, hash);
+	if (ht->growth_left == 0 && ht->ctrl[slot] == HASHTABLE_CTRL_EMPTY) {
+		// out of empty slots: grow, or only drop the deleted slots when they are what fills the table
+		hashTableRehash(ht, ht->count * 2 >= hashTableMaxLoad(ht->capacity) ? ht->capacity * 2 : ht->capacity);
+		slot = hashTableFindFree(ht, hash);
+	}
+
+	ht->growth_left -= ht->ctrl[slot] == HASHTABLE_CTRL_EMPTY;
+	ht->ctrl[slot] = hashTableH2(hash);
+	memcpy(hashTableSlotKey(ht, slot), key, ht->key_size);
+	ht->count++;
+	if (inserted) {
+		*inserted = true;
+	}
+	return hashTableSlotValue(ht, slot);
+}
+
+void hashTableSet(hasht_t* ht, const void* key, const void* value) {
+	memcpy(hashTableInsert(ht, key, NULL), value, ht->value_size);
+}
+
+bool hashTableRemove(hasht_t* ht, const void* key) {
+	int slot = hashTableFind(ht, key, hashTableHash(ht, key));
+	if (slot < 0) {
+		return false;
+	}
+
+	// a group that still has an empty slot ends every probe that reaches it, so the slot can go back to empty
+	const int8_t* group = ht->ctrl + (slot & ~(HASHTABLE_GROUP_SIZE - 1));
+	if (hashTableGroupMatchEmpty(group)) {
+		ht->ctrl[slot] = HASHTABLE_CTRL_EMPTY;
+		ht->growth_left++;
+	} else {
+		ht->ctrl[slot] = HASHTABLE_CTRL_DELETED;
+	}
+	ht->count--;
+	return true;
+}
+
+void hashTableClear(hasht_t* ht) {
+	memset(ht->ctrl, HASHTABLE_CTRL_EMPTY, ht->capacity);
+	ht->count = 0;
+	ht->growth_left = hashTableMaxLoad(ht->capacity);
+}
+
+int hashTableGetCount(hasht_t* ht) {
+	return ht->count;
+}
+
+bool hashTableIterate(hasht_t* ht, int* iterator, void** key, void** value) {
+	for (int slot = *iterator; slot < ht->capacity; slot++) {
+		if (ht->ctrl[slot] >= 0) {
+			if (key) {
+				*key = hashTableSlotKey(ht, slot);
+			}
+			if (value) {
+				*value = hashTableSlotValue(ht, slot);
+			}
+			*iterator = slot + 1;
+			return true;
+		}
+	}
+	*iterator = ht->capacity;
+	return false;
+}
+
+uint64_t hashTableHashBytes(const void* data, size_t size) {
+	return XXH64(data, size, HASHTABLE_SEED);
+}
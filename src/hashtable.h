@@ -1,14 +1,76 @@
 #ifndef __HASHTABLE_H__
 #define __HASHTABLE_H__
-/* TODO LATER: when i have an idea of why i need to use this
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* HASH TABLE
+*	- open addressing SwissTable style: slots are probed in groups of 16 control bytes that hold
+*	  7 bits of the key's hash, a whole group is matched at once with SSE2
+*	- keys are hashed with XXH64 (lib/lz4/xxhash.c)
+*	- keys and values are fixed size blobs copied into heap_t storage, keys are compared bytewise
+*	  so clear any padding in key structs before using them (hash strings with hashTableHashBytes
+*	  or intern them to fixed size ids)
+*	- grows (doubles) once the table is 7/8 full
+*	- not thread safe
+*/
+
 typedef struct hasht_t hasht_t;
 
-typedef struct hasht_item_t hasht_item_t;
+typedef struct heap_t heap_t;
 
-hasht_t* hashTableCreate();
+// Creates a hash table of key_size byte keys that map to value_size byte values,
+// room for capacity entries is reserved up front.
+//
+// RETURN: the new hash table
+hasht_t* hashTableCreate(heap_t* heap, size_t key_size, size_t value_size, int capacity);
 
+// Destroys the hash table.
+//
 void hashTableDestroy(hasht_t* ht);
 
-void* hashTableGet(hasht_t* ht, void* key);
-*/
-#endif
\ No newline at end of file
+// Makes room so that up to capacity keys can be stored without growing.
+//
+void hashTableReserve(hasht_t* ht, int capacity);
+
+// Looks up a key.
+//
+// RETURN: the value stored for the key (valid until the table is modified), NULL if the key is not in the table
+void* hashTableGet(hasht_t* ht, const void* key);
+
+// Inserts a key if it is not in the table yet, the value of a new key is left uninitialized.
+//
+// RETURN: the value stored for the key (valid until the table is modified)
+void* hashTableInsert(hasht_t* ht, const void* key, bool* inserted);
+
+// Inserts or overwrites the value of a key.
+//
+void hashTableSet(hasht_t* ht, const void* key, const void* value);
+
+// Removes a key.
+//
+// RETURN: true if the key was in the table
+bool hashTableRemove(hasht_t* ht, const void* key);
+
+// Removes every key, the slots stay allocated.
+//
+void hashTableClear(hasht_t* ht);
+
+// Get the number of keys in the table.
+//
+// RETURN: key count
+int hashTableGetCount(hasht_t* ht);
+
+// Steps through every key in the table in no particular order, start with *iterator = 0.
+// The table must not be modified while iterating.
+//
+// RETURN: false once every key has been visited
+bool hashTableIterate(hasht_t* ht, int* iterator, void** key, void** value);
+
+// Hashes bytes with the same function the tables use.
+//
+// RETURN: 64 bit hash
+uint64_t hashTableHashBytes(const void* data, size_t size);
+
+#endif
@@ -24,6 +24,7 @@ typedef struct heap_t {
 	size_t grow_increment;
 	heap_obj_t* object;
 	mutex_t* mutex;
+	size_t alloc_count;
 } heap_t;
 
 heap_t* heapCreate(size_t grow_increment) {
@@ -39,6 +40,7 @@ heap_t* heapCreate(size_t grow_increment) {
 	heap->tlsf = tlsf_create(heap + 1);
 	heap->grow_increment = grow_increment;
 	heap->object = NULL;
+	heap->alloc_count = 0;
 
 	return heap;
 }
@@ -54,6 +56,7 @@ void* heapAlloc(heap_t* heap, size_t size, size_t alignment) {
 			MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
 		if (!object) { // cannot allocate enough for the object 
 			debugPrint(DEBUG_PRINT_ERROR, "Heap Allocation Error: unable to allocate enough memory for the object.\n");
+			mutexUnlock(heap->mutex);
 			return NULL;
 		}
 		object->pool = tlsf_add_pool(heap->tlsf, object + 1, object_size);
@@ -65,6 +68,8 @@ void* heapAlloc(heap_t* heap, size_t size, size_t alignment) {
 
 	}
 
+	heap->alloc_count++;
+
 	mutexUnlock(heap->mutex);
 
 	return address;
@@ -76,6 +81,13 @@ void heapFree(heap_t* heap, void* address) {
 	mutexUnlock(heap->mutex);
 }
 
+size_t heapGetAllocationCount(heap_t* heap) {
+	mutexLock(heap->mutex);
+	size_t count = heap->alloc_count;
+	mutexUnlock(heap->mutex);
+	return count;
+}
+
 void heapDestroy(heap_t* heap) {
 	tlsf_destroy(heap->tlsf);
 
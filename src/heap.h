@@ -28,4 +28,9 @@ void* heapAlloc(heap_t* heap, size_t size, size_t alignment);
 // Free memory previously allocated from a heap.
 void heapFree(heap_t* heap, void* address);
 
+// Get the total number of allocations made from a heap since it was created.
+//
+// RETURN: allocation count
+size_t heapGetAllocationCount(heap_t* heap);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include "hierarchy.h"
+
+#include "heap.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define HIERARCHY_INITIAL_CAPACITY 64
+
+typedef struct hierarchy_t {
+	heap_t* heap;
+
+	// nodes in breadth-first order, a parent index is always lower than the index of its children
+	int* parents;					// index of the parent, -1 for roots
+	int* handles;					// handle of the node at this index
+	uint8_t* dirty;
+	transform_t* locals;
+	transform_t* worlds;
+	transform_t** world_outs;
+	int count;
+	int capacity;
+
+	// handle -> index, freed handles are reused
+	int* handle_indices;
+	int* free_handles;
+	int handle_count;
+	int free_handle_count;
+
+	bool reorder;					// nodes were added since the last update, they are appended in add order
+} hierarchy_t;
+
+static void hierarchyGrow(hierarchy_t* hierarchy);
+static void hierarchyReorder(hierarchy_t* hierarchy);
+
+hierarchy_t* hierarchyCreate(heap_t* heap) {
+	hierarchy_t* hierarchy = heapAlloc(heap, sizeof(hierarchy_t), 8);
+	memset(hierarchy, 0, sizeof(*hierarchy));
+	hierarchy->heap = heap;
+	return hierarchy;
+}
+
+void hierarchyDestroy(hierarchy_t* hierarchy) {
+	heapFree(hierarchy->heap, hierarchy->parents);
+	heapFree(hierarchy->heap, hierarchy->handles);
+	heapFree(hierarchy->heap, hierarchy->dirty);
+	heapFree(hierarchy->heap, hierarchy->locals);
+	heapFree(hierarchy->heap, hierarchy->worlds);
+	heapFree(hierarchy->heap, hierarchy->world_outs);
+	heapFree(hierarchy->heap, hierarchy->handle_indices);
+	heapFree(hierarchy->heap, hierarchy->free_handles);
+	heapFree(hierarchy->heap, hierarchy);
+}
+
+int hierarchyNodeAdd(hierarchy_t* hierarchy, int parent, const transform_t* local, transform_t* world_out) {
+	if (hierarchy->count == hierarchy->capacity) {
+		hierarchyGrow(hierarchy);
+	}
+
+	int handle = hierarchy->free_handle_count ? hierarchy->free_handles[--hierarchy->free_handle_count] : hierarchy->handle_count++;
+	int index = hierarchy->count++;
+	hierarchy->handle_indices[handle] = index;
+
+	// appending keeps the parent in front of the child, the breadth-first order is restored on update
+	hierarchy->parents[index] = parent == HIERARCHY_NODE_NONE ? -1 : hierarchy->handle_indices[parent];
+	hierarchy->handles[index] = handle;
+	hierarchy->dirty[index] = 1;
+	hierarchy->locals[index] = *local;
+	hierarchy->worlds[index] = *local;
+	hierarchy->world_outs[index] = world_out;
+	hierarchy->reorder = true;
+	return handle;
+}
+
+void hierarchyNodeRemove(hierarchy_t* hierarchy, int node) {
+	int removed_index = hierarchy->handle_indices[node];
+
+	// descendants always come after their ancestors, so a single pass from the node finds the whole
+	// subtree while the rest is moved down. remap holds the new index of every visited node, -1 if removed.
+	int* remap = heapAlloc(hierarchy->heap, sizeof(int) * (hierarchy->count - removed_index), 8);
+	int new_count = removed_index;
+	for (int x = removed_index; x < hierarchy->count; x++) {
+		int parent = hierarchy->parents[x];
+		int handle = hierarchy->handles[x];
+		int new_parent = parent >= removed_index ? remap[parent - removed_index] : parent;
+		if (x == removed_index || (parent >= removed_index && new_parent < 0)) {
+			remap[x - removed_index] = -1;
+			hierarchy->handle_indices[handle] = -1;
+			hierarchy->free_handles[hierarchy->free_handle_count++] = handle;
+			continue;
+		}
+
+		int new_index = new_count++;
+		remap[x - removed_index] = new_index;
+		hierarchy->parents[new_index] = new_parent;
+		hierarchy->handles[new_index] = handle;
+		hierarchy->dirty[new_index] = hierarchy->dirty[x];
+		hierarchy->locals[new_index] = hierarchy->locals[x];
+		hierarchy->worlds[new_index] = hierarchy->worlds[x];
+		hierarchy->world_outs[new_index] = hierarchy->world_outs[x];
+		hierarchy->handle_indices[handle] = new_index;
+	}
+	hierarchy->count = new_count;
+	heapFree(hierarchy->heap, remap);
+}
+
+int hierarchyNodeGetParent(hierarchy_t* hierarchy, int node) {
+	int parent = hierarchy->parents[hierarchy->handle_indices[node]];
+	return parent >= 0 ? hierarchy->handles[parent] : HIERARCHY_NODE_NONE;
+}
+
+void hierarchySetLocal(hierarchy_t* hierarchy, int node, const transform_t* local) {
+	int index = hierarchy->handle_indices[node];
+	hierarchy->locals[index] = *local;
+	hierarchy->dirty[index] = 1;
+}
+
+const transform_t* hierarchyGetLocal(hierarchy_t* hierarchy, int node) {
+	return &hierarchy->locals[hierarchy->handle_indices[node]];
+}
+
+const transform_t* hierarchyGetWorld(hierarchy_t* hierarchy, int node) {
+	return &hierarchy->worlds[hierarchy->handle_indices[node]];
+}
+
+int hierarchyUpdate(hierarchy_t* hierarchy) {
+	if (hierarchy->reorder) {
+		hierarchyReorder(hierarchy);
+		hierarchy->reorder = false;
+	}
+
+	// parents are visited first, so their dirty flag has already been handed down from above
+	int updated = 0;
+	for (int x = 0; x < hierarchy->count; x++) {
+		int parent = hierarchy->parents[x];
+		if (parent >= 0) {
+			hierarchy->dirty[x] |= hierarchy->dirty[parent];
+		}
+		if (!hierarchy->dirty[x]) {
+			continue;
+		}
+
+		hierarchy->worlds[x] = hierarchy->locals[x];
+		if (parent >= 0) {
+			transformMul(&hierarchy->worlds[parent], &hierarchy->worlds[x]);
+		}
+		if (hierarchy->world_outs[x]) {
+			*hierarchy->world_outs[x] = hierarchy->worlds[x];
+		}
+		updated++;
+	}
+	memset(hierarchy->dirty, 0, hierarchy->count);
+	return updated;
+}
+
+static void* hierarchyGrowArray(hierarchy_t* hierarchy, void* array, size_t element_size, int count, int capacity) {
+	void* new_array = heapAlloc(hierarchy->heap, element_size * capacity, 16);
+	if (array) {
+		memcpy(new_array, array, element_size * count);
+		heapFree(hierarchy->heap, array);
+	}
+	return new_array;
+}
+
+static void hierarchyGrow(hierarchy_t* hierarchy) {
+	int count = hierarchy->count;
+	int capacity = __max(hierarchy->capacity * 2, HIERARCHY_INITIAL_CAPACITY);
+	hierarchy->parents = hierarchyGrowArray(hierarchy, hierarchy->parents, sizeof(int), count, capacity);
+	hierarchy->handles = hierarchyGrowArray(hierarchy, hierarchy->handles, sizeof(int), count, capacity);
+	hierarchy->dirty = hierarchyGrowArray(hierarchy, hierarchy->dirty, sizeof(uint8_t), count, capacity);
+	hierarchy->locals = hierarchyGrowArray(hierarchy, hierarchy->locals, sizeof(transform_t), count, capacity);
+	hierarchy->worlds = hierarchyGrowArray(hierarchy, hierarchy->worlds, sizeof(transform_t), count, capacity);
+	hierarchy->world_outs = hierarchyGrowArray(hierarchy, hierarchy->world_outs, sizeof(transform_t*), count, capacity);
+	hierarchy->capacity = capacity;
+
+	// there are never more handles than nodes
+	hierarchy->handle_indices = hierarchyGrowArray(hierarchy, hierarchy->handle_indices, sizeof(int), hierarchy->handle_count, capacity);
+	hierarchy->free_handles = hierarchyGrowArray(hierarchy, hierarchy->free_handles, sizeof(int), hierarchy->free_handle_count, capacity);
+}
+
+// Sorts the nodes by depth (stable counting sort), which turns any parent first order into breadth-first order.
+static void hierarchyReorder(hierarchy_t* hierarchy) {
+	int count = hierarchy->count;
+	int* depths = heapAlloc(hierarchy->heap, sizeof(int) * (count * 2 + 1), 8);
+	int* depth_offsets = depths + count;
+	int max_depth = 0;
+	for (int x = 0; x < count; x++) {
+		int parent = hierarchy->parents[x];
+		depths[x] = parent >= 0 ? depths[parent] + 1 : 0;
+		max_depth = __max(max_depth, depths[x]);
+	}
+
+	memset(depth_offsets, 0, sizeof(int) * (max_depth + 1));
+	for (int x = 0; x < count; x++) {
+		depth_offsets[depths[x]]++;
+	}
+	int offset = 0;
+	for (int depth = 0; depth <= max_depth; depth++) {
+		int depth_count = depth_offsets[depth];
+		depth_offsets[depth] = offset;
+		offset += depth_count;
+	}
+
+	int* parents = heapAlloc(hierarchy->heap, sizeof(int) * hierarchy->capacity, 16);
+	int* handles = heapAlloc(hierarchy->heap, sizeof(int) * hierarchy->capacity, 16);
+	uint8_t* dirty = heapAlloc(hierarchy->heap, sizeof(uint8_t) * hierarchy->capacity, 16);
+	transform_t* locals = heapAlloc(hierarchy->heap, sizeof(transform_t) * hierarchy->capacity, 16);
+	transform_t* worlds = heapAlloc(hierarchy->heap, sizeof(transform_t) * hierarchy->capacity, 16);
+	transform_t** world_outs = heapAlloc(hierarchy->heap, sizeof(transform_t*) * hierarchy->capacity, 16);
+
+	// parents are moved before their children, so handle_indices already holds the new parent index
+	for (int x = 0; x < count; x++) {
+		int new_index = depth_offsets[depths[x]]++;
+		int parent = hierarchy->parents[x];
+		int handle = hierarchy->handles[x];
+		parents[new_index] = parent >= 0 ? hierarchy->handle_indices[hierarchy->handles[parent]] : -1;
+		handles[new_index] = handle;
+		dirty[new_index] = hierarchy->dirty[x];
+		locals[new_index] = hierarchy->locals[x];
+		worlds[new_index] = hierarchy->worlds[x];
+		world_outs[new_index] = hierarchy->world_outs[x];
+		hierarchy->handle_indices[handle] = new_index;
+	}
+
+	heapFree(hierarchy->heap, hierarchy->parents);
+	heapFree(hierarchy->heap, hierarchy->handles);
+	heapFree(hierarchy->heap, hierarchy->dirty);
+	heapFree(hierarchy->heap, hierarchy->locals);
+	heapFree(hierarchy->heap, hierarchy->worlds);
+	heapFree(hierarchy->heap, hierarchy->world_outs);
+	heapFree(hierarchy->heap, depths);
+	hierarchy->parents = parents;
+	hierarchy->handles = handles;
+	hierarchy->dirty = dirty;
+	hierarchy->locals = locals;
+	hierarchy->worlds = worlds;
+	hierarchy->world_outs = world_outs;
+}
@@ -0,0 +1,66 @@
+#ifndef __HIERARCHY_H__
+#define __HIERARCHY_H__
+
+#include "transform.h"
+
+/* TRANSFORM HIERARCHY
+*	- nodes hold a local transform relative to their parent and the composed world transform
+*	- node data is kept in SoA arrays in breadth-first order, so a parent always comes before its
+*	  children and every world transform can be recomputed in one linear pass
+*	- changing a local transform only marks the node dirty, the dirty flag is handed down to the
+*	  children in the pass and clean nodes are skipped, so only changed subtrees are recomputed
+*	- nodes are referred to by handles that stay valid when the arrays are reordered
+*/
+
+typedef struct hierarchy_t hierarchy_t;
+
+typedef struct heap_t heap_t;
+
+// No parent, the node is a root.
+#define HIERARCHY_NODE_NONE -1
+
+// Creates an empty hierarchy.
+//
+// RETURN: the new hierarchy
+hierarchy_t* hierarchyCreate(heap_t* heap);
+
+// Destroys the hierarchy.
+//
+void hierarchyDestroy(hierarchy_t* hierarchy);
+
+// Adds a node below parent (HIERARCHY_NODE_NONE for a root). When world_out is not NULL the world
+// transform is also written there whenever it is recomputed, e.g. to the transform component of an entity.
+// world_out has to stay valid until the node is removed.
+//
+// RETURN: handle of the new node
+int hierarchyNodeAdd(hierarchy_t* hierarchy, int parent, const transform_t* local, transform_t* world_out);
+
+// Removes the node and every node below it, their handles become invalid.
+//
+void hierarchyNodeRemove(hierarchy_t* hierarchy, int node);
+
+// Get the parent of a node.
+//
+// RETURN: the parent handle, HIERARCHY_NODE_NONE for a root
+int hierarchyNodeGetParent(hierarchy_t* hierarchy, int node);
+
+// Sets the local transform of a node and marks its subtree for the next update.
+//
+void hierarchySetLocal(hierarchy_t* hierarchy, int node, const transform_t* local);
+
+// Get the local transform of a node.
+//
+// RETURN: the local transform
+const transform_t* hierarchyGetLocal(hierarchy_t* hierarchy, int node);
+
+// Get the world transform of a node as of the last update.
+//
+// RETURN: the world transform
+const transform_t* hierarchyGetWorld(hierarchy_t* hierarchy, int node);
+
+// Recomputes the world transforms of every dirty subtree.
+//
+// RETURN: the number of recomputed nodes
+int hierarchyUpdate(hierarchy_t* hierarchy);
+
+#endif
@@ -0,0 +1,133 @@
+#include "job.h"
+
+#include "atomic.h"
+#include "heap.h"
+#include "semaphore.h"
+#include "thread.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+typedef struct job_worker_t {
+	job_pool_t* pool;
+	thread_t* thread;
+	int index;
+} job_worker_t;
+
+typedef struct job_pool_t {
+	heap_t* heap;
+	semaphore_t* start;
+	semaphore_t* done;
+	job_worker_t* workers;
+	int thread_count;
+	bool quit;
+
+	// current parallel for
+	job_func_t func;
+	void* user;
+	int count;
+	int chunk_size;
+	int next_chunk;
+} job_pool_t;
+
+static int jobWorkerThreadFunc(void* user);
+
+static void jobPoolRunChunks(job_pool_t* pool, int worker) {
+	while (true) {
+		int begin = atomicInc(&pool->next_chunk) * pool->chunk_size;
+		if (begin >= pool->count) {
+			break;
+		}
+		int end = begin + pool->chunk_size;
+		pool->func(pool->user, begin, end < pool->count ? end : pool->count, worker);
+	}
+}
+
+job_pool_t* jobPoolCreate(heap_t* heap, int worker_count) {
+	job_pool_t* pool = heapAlloc(heap, sizeof(job_pool_t), 8);
+	memset(pool, 0, sizeof(*pool));
+	pool->heap = heap;
+	pool->thread_count = worker_count > 1 ? worker_count - 1 : 0;
+
+	if (pool->thread_count > 0) {
+		pool->start = semaphoreCreate(0, pool->thread_count);
+		pool->done = semaphoreCreate(0, pool->thread_count);
+		pool->workers = heapAlloc(heap, sizeof(job_worker_t) * pool->thread_count, 8);
+		for (int x = 0; x < pool->thread_count; x++) {
+			pool->workers[x].pool = pool;
+			pool->workers[x].index = x + 1;
+			pool->workers[x].thread = threadCreate(jobWorkerThreadFunc, &pool->workers[x]);
+		}
+	}
+	return pool;
+}
+
+void jobPoolDestroy(job_pool_t* pool) {
+	if (pool->thread_count > 0) {
+		pool->quit = true;
+		for (int x = 0; x < pool->thread_count; x++) {
+			semaphoreRelease(pool->start);
+		}
+		for (int x = 0; x < pool->thread_count; x++) {
+			threadDestroy(pool->workers[x].thread);
+		}
+		heapFree(pool->heap, pool->workers);
+		semaphoreDestroy(pool->done);
+		semaphoreDestroy(pool->start);
+	}
+	heapFree(pool->heap, pool);
+}
+
+int jobPoolGetWorkerCount(job_pool_t* pool) {
+	return pool ? pool->thread_count + 1 : 1;
+}
+
+void jobPoolParallelFor(job_pool_t* pool, int count, int chunk_size, job_func_t func, void* user) {
+	if (count <= 0) {
+		return;
+	}
+	if (chunk_size <= 0) {
+		chunk_size = 1;
+	}
+
+	// not worth waking the workers for a single chunk
+	if (pool == NULL || pool->thread_count == 0 || count <= chunk_size) {
+		func(user, 0, count, 0);
+		return;
+	}
+
+	pool->func = func;
+	pool->user = user;
+	pool->count = count;
+	pool->chunk_size = chunk_size;
+	atomicWrite(&pool->next_chunk, 0);
+
+	int wake_count = (count + chunk_size - 1) / chunk_size - 1;
+	if (wake_count > pool->thread_count) {
+		wake_count = pool->thread_count;
+	}
+	for (int x = 0; x < wake_count; x++) {
+		semaphoreRelease(pool->start);
+	}
+
+	jobPoolRunChunks(pool, 0);
+
+	// every woken worker reports back once it runs out of chunks
+	for (int x = 0; x < wake_count; x++) {
+		semaphoreGet(pool->done);
+	}
+}
+
+static int jobWorkerThreadFunc(void* user) {
+	job_worker_t* worker = user;
+	job_pool_t* pool = worker->pool;
+	while (true) {
+		semaphoreGet(pool->start);
+		if (pool->quit) {
+			break;
+		}
+		jobPoolRunChunks(pool, worker->index);
+		semaphoreRelease(pool->done);
+	}
+	return 0;
+}
@@ -0,0 +1,36 @@
+#ifndef __JOB_H__
+#define __JOB_H__
+
+/* JOB POOL FOR DATA PARALLEL WORK
+*	- a fixed set of worker threads that split a range of work items into chunks
+*	- the calling thread works as worker 0, so a pool of 1 runs everything inline
+*	- jobPoolParallelFor blocks until every chunk has been processed
+*/
+
+typedef struct job_pool_t job_pool_t;
+
+typedef struct heap_t heap_t;
+
+// Processes the work items [begin, end) on the given worker (0 to worker count - 1).
+typedef void (*job_func_t)(void* user, int begin, int end, int worker);
+
+// Creates a job pool with worker_count workers (the calling thread included).
+//
+// RETURN: the new job pool
+job_pool_t* jobPoolCreate(heap_t* heap, int worker_count);
+
+// Waits for the worker threads to exit and destroys the pool.
+//
+void jobPoolDestroy(job_pool_t* pool);
+
+// Get the number of workers including the calling thread, a NULL pool has 1 worker.
+//
+// RETURN: worker count
+int jobPoolGetWorkerCount(job_pool_t* pool);
+
+// Splits count items into chunks of chunk_size and runs func on them across the workers.
+// A NULL pool runs func on the calling thread.
+//
+void jobPoolParallelFor(job_pool_t* pool, int count, int chunk_size, job_func_t func, void* user);
+
+#endif
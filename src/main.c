@@ -7,8 +7,12 @@
 #include "scene.h"
 
 #include "test.h"
+#include "bench.h"
 #include "debug.h"
 
+#include <stdlib.h>
+#include <string.h>
+
 int main(int argc, const char*argv[]) {
 
 	debugInstallExceptionHandler();
@@ -17,10 +21,46 @@ int main(int argc, const char*argv[]) {
 	timerStartup();
 
 	heap_t* heap = heapCreate(2 * 1024 * 1024); // 2 MB pool
-	wm_window_t* window = wmCreateWindow(heap);
 	fs_t* fs = fsCreate(heap, 8);
+
+	// pdb-sim -bench [report.json]: run the benchmarks headless and exit
+	if (argc > 1 && strcmp(argv[1], "-bench") == 0) {
+		benchPrimitives(heap, fs, argc > 2 ? argv[2] : "bench.json");
+		fsDestroy(fs);
+		heapDestroy(heap);
+		return 0;
+	}
+
+	// pdb-sim -bench-physics [report.json] [frames] [max particles]: run the physics scaling sweep headless and exit
+	if (argc > 1 && strcmp(argv[1], "-bench-physics") == 0) {
+		int frames = argc > 3 ? atoi(argv[3]) : 10;
+		int max_particles = argc > 4 ? atoi(argv[4]) : 1000000;
+		benchPhysicsScaling(heap, fs, argc > 2 ? argv[2] : "bench_physics.json", frames, max_particles);
+		fsDestroy(fs);
+		heapDestroy(heap);
+		return 0;
+	}
+
+	// pdb-sim -bench-renderer [report.json] [frames]: run the renderer benchmarks and exit
+	if (argc > 1 && strcmp(argv[1], "-bench-renderer") == 0) {
+#if defined(GPU_NULL)
+		wm_window_t* window = NULL;
+#else
+		wm_window_t* window = wmCreateWindow(heap);
+#endif
+		int frames = argc > 3 ? atoi(argv[3]) : 100;
+		benchRenderer(heap, fs, window, argc > 2 ? argv[2] : "bench_renderer.json", frames);
+		if (window) {
+			wmDestroyWindow(window);
+		}
+		fsDestroy(fs);
+		heapDestroy(heap);
+		return 0;
+	}
+
+	wm_window_t* window = wmCreateWindow(heap);
 	timer_object_t* root_time = timerObjectCreate(heap, NULL);
-	renderer_t* renderer = rendererCreate(heap, window);
+	renderer_t* renderer = rendererCreate(heap, fs, window);
 
 	scene_t* scene = sceneCreate(heap, fs, window, renderer);
 
@@ -29,6 +69,9 @@ int main(int argc, const char*argv[]) {
 		sceneUpdate(scene);
 	}
 
+	// the render thread finishes the queued frames (and saves the pipeline cache through fs) before the scene data goes
+	rendererDestroy(renderer);
+	sceneDestroy(scene);
 	timerObjectDestroy(root_time);
 	fsDestroy(fs);
 	wmDestroyWindow(window);
@@ -1,6 +1,5 @@
 #include "mat4f.h"
 
-#include "mat4f.h"
 #include "vec3f.h"
 #include "quatf.h"
 #include "debug.h"
@@ -8,7 +7,18 @@
 #include <stdbool.h>
 #include <string.h>
 
-#include <immintrin.h> // For SIMD intrinsics (if implementing)
+#if defined(__AVX__)
+#define MAT4F_AVX 1
+#define MAT4F_SSE 1
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#define MAT4F_AVX 0
+#define MAT4F_SSE 1
+#include <xmmintrin.h>
+#else
+#define MAT4F_AVX 0
+#define MAT4F_SSE 0
+#endif
 
 void mat4fZero(mat4f_t* m) {
 	memset(m, 0, sizeof(*m));
@@ -22,14 +32,14 @@ void mat4fMakeIdentity(mat4f_t* m) {
 	m->mat[3][3] = 1.0f;
 }
 
-void mat4fMakeTranslation(mat4f_t* m, vec3f_t* v) {
+void mat4fMakeTranslation(mat4f_t* m, const vec3f_t* v) {
 	mat4fMakeIdentity(m);
-	m->mat[0][3] = v->x;
-	m->mat[1][3] = v->y;
-	m->mat[2][3] = v->z;
+	m->mat[3][0] = v->x;
+	m->mat[3][1] = v->y;
+	m->mat[3][2] = v->z;
 }
 
-void mat4fMakeScaling(mat4f_t* m, vec3f_t* v) {
+void mat4fMakeScaling(mat4f_t* m, const vec3f_t* v) {
 	mat4fMakeIdentity(m);
 	m->mat[0][0] = v->x;
 	m->mat[1][1] = v->y;
@@ -37,19 +47,19 @@ void mat4fMakeScaling(mat4f_t* m, vec3f_t* v) {
 }
 
 void mat4fMakeRotation(mat4f_t* m, const quatf_t* q) {
-	m->mat[0][0] = 1.0f - 2.0f * (q->y * q->y - q->z * q->z);
-	m->mat[0][1] = 2.0f * (q->x * q->y - q->s * q->z);
-	m->mat[0][2] = 2.0f * (q->x * q->z + q->s * q->y);
+	m->mat[0][0] = 1.0f - 2.0f * (q->y * q->y + q->z * q->z);
+	m->mat[0][1] = 2.0f * (q->x * q->y + q->s * q->z);
+	m->mat[0][2] = 2.0f * (q->x * q->z - q->s * q->y);
 	m->mat[0][3] = 0.0f;
 	
-	m->mat[1][0] = 2.0f * (q->x * q->y + q->s * q->z);
-	m->mat[1][1] = 1.0f - 2.0f * (q->x * q->x - q->z * q->z);
+	m->mat[1][0] = 2.0f * (q->x * q->y - q->s * q->z);
+	m->mat[1][1] = 1.0f - 2.0f * (q->x * q->x + q->z * q->z);
 	m->mat[1][2] = 2.0f * (q->y * q->z + q->s * q->x);
 	m->mat[1][3] = 0.0f;
 
-	m->mat[2][0] = 2.0f * (q->x * q->z - q->s * q->y);
-	m->mat[2][1] = 2.0f * (q->y * q->z + q->s * q->x);
-	m->mat[2][2] = 1.0f - 2.0f * (q->x * q->x - q->y * q->y);
+	m->mat[2][0] = 2.0f * (q->x * q->z + q->s * q->y);
+	m->mat[2][1] = 2.0f * (q->y * q->z - q->s * q->x);
+	m->mat[2][2] = 1.0f - 2.0f * (q->x * q->x + q->y * q->y);
 	m->mat[2][3] = 0.0f;
 
 	m->mat[3][0] = 0.0f;
@@ -58,22 +68,65 @@ void mat4fMakeRotation(mat4f_t* m, const quatf_t* q) {
 	m->mat[3][3] = 1.0f;
 }
 
+// column c of a * b is the columns of a weighted by column c of b
 void mat4fMul(mat4f_t* res, const mat4f_t* a, const mat4f_t* b) {
-	float temp = 0.0f;
-	for (unsigned int x = 0; x < 4; x++) {
-		for (unsigned int y = 0; y < 4; y++) {
-			for (unsigned int z = 0; z < 4; z++) {
-				temp += a->mat[x][z] + b->mat[z][y];
-			}
-			res->mat[x][y] = temp;
-			temp = 0.0f;
+#if MAT4F_AVX
+	// two result columns per register, the weights of both are picked out of b with an in-lane permute
+	__m256 b01 = _mm256_loadu_ps(b->mat[0]);
+	__m256 b23 = _mm256_loadu_ps(b->mat[2]);
+	__m256 a0 = _mm256_broadcast_ps((const __m128*) a->mat[0]);
+	__m256 a1 = _mm256_broadcast_ps((const __m128*) a->mat[1]);
+	__m256 a2 = _mm256_broadcast_ps((const __m128*) a->mat[2]);
+	__m256 a3 = _mm256_broadcast_ps((const __m128*) a->mat[3]);
+
+	__m256 r01 = _mm256_mul_ps(a0, _mm256_permute_ps(b01, _MM_SHUFFLE(0, 0, 0, 0)));
+	r01 = _mm256_add_ps(r01, _mm256_mul_ps(a1, _mm256_permute_ps(b01, _MM_SHUFFLE(1, 1, 1, 1))));
+	r01 = _mm256_add_ps(r01, _mm256_mul_ps(a2, _mm256_permute_ps(b01, _MM_SHUFFLE(2, 2, 2, 2))));
+	r01 = _mm256_add_ps(r01, _mm256_mul_ps(a3, _mm256_permute_ps(b01, _MM_SHUFFLE(3, 3, 3, 3))));
+
+	__m256 r23 = _mm256_mul_ps(a0, _mm256_permute_ps(b23, _MM_SHUFFLE(0, 0, 0, 0)));
+	r23 = _mm256_add_ps(r23, _mm256_mul_ps(a1, _mm256_permute_ps(b23, _MM_SHUFFLE(1, 1, 1, 1))));
+	r23 = _mm256_add_ps(r23, _mm256_mul_ps(a2, _mm256_permute_ps(b23, _MM_SHUFFLE(2, 2, 2, 2))));
+	r23 = _mm256_add_ps(r23, _mm256_mul_ps(a3, _mm256_permute_ps(b23, _MM_SHUFFLE(3, 3, 3, 3))));
+
+	// stored last, res may be a or b
+	_mm256_storeu_ps(res->mat[0], r01);
+	_mm256_storeu_ps(res->mat[2], r23);
+#elif MAT4F_SSE
+	__m128 a0 = _mm_loadu_ps(a->mat[0]);
+	__m128 a1 = _mm_loadu_ps(a->mat[1]);
+	__m128 a2 = _mm_loadu_ps(a->mat[2]);
+	__m128 a3 = _mm_loadu_ps(a->mat[3]);
+
+	__m128 r[4];
+	for (int c = 0; c < 4; c++) {
+		__m128 b_col = _mm_loadu_ps(b->mat[c]);
+		__m128 col = _mm_mul_ps(a0, _mm_shuffle_ps(b_col, b_col, _MM_SHUFFLE(0, 0, 0, 0)));
+		col = _mm_add_ps(col, _mm_mul_ps(a1, _mm_shuffle_ps(b_col, b_col, _MM_SHUFFLE(1, 1, 1, 1))));
+		col = _mm_add_ps(col, _mm_mul_ps(a2, _mm_shuffle_ps(b_col, b_col, _MM_SHUFFLE(2, 2, 2, 2))));
+		col = _mm_add_ps(col, _mm_mul_ps(a3, _mm_shuffle_ps(b_col, b_col, _MM_SHUFFLE(3, 3, 3, 3))));
+		r[c] = col;
+	}
+	for (int c = 0; c < 4; c++) {
+		_mm_storeu_ps(res->mat[c], r[c]);
+	}
+#else
+	mat4f_t temp;
+	for (int c = 0; c < 4; c++) {
+		for (int r = 0; r < 4; r++) {
+			temp.mat[c][r] =
+				a->mat[0][r] * b->mat[c][0] +
+				a->mat[1][r] * b->mat[c][1] +
+				a->mat[2][r] * b->mat[c][2] +
+				a->mat[3][r] * b->mat[c][3];
 		}
 	}
+	*res = temp;
+#endif
 }
 
 void mat4fMulInplace(mat4f_t* res, const mat4f_t* a) {
-	mat4f_t temp = *res;
-	mat4fMul(res, &temp, a);
+	mat4fMul(res, res, a);
 }
 
 void mat4fTranslate(mat4f_t* m, const vec3f_t* v) {
@@ -83,14 +136,14 @@ void mat4fTranslate(mat4f_t* m, const vec3f_t* v) {
 }
 
 void mat4fTransform(const mat4f_t* m, const vec3f_t* in, vec3f_t* out) {
-	out->x = m->mat[0][0] * in->x + m->mat[0][1] * in->y + m->mat[0][2] * in->z;
-	out->y = m->mat[1][0] * in->x + m->mat[1][1] * in->y + m->mat[1][2] * in->z;
-	out->z = m->mat[2][0] * in->x + m->mat[2][1] * in->y + m->mat[2][2] * in->z;
+	vec3f_t temp = *in;
+	out->x = m->mat[0][0] * temp.x + m->mat[1][0] * temp.y + m->mat[2][0] * temp.z + m->mat[3][0];
+	out->y = m->mat[0][1] * temp.x + m->mat[1][1] * temp.y + m->mat[2][1] * temp.z + m->mat[3][1];
+	out->z = m->mat[0][2] * temp.x + m->mat[1][2] * temp.y + m->mat[2][2] * temp.z + m->mat[3][2];
 }
 
 void mat4fTransformInplace(const mat4f_t* m, vec3f_t* v) {
-	vec3f_t temp = *v;
-	mat4fTransform(m, &temp, v);
+	mat4fTransform(m, v, v);
 }
 
 float mat4fDet(const mat4f_t* a) {
@@ -126,9 +179,83 @@ float mat4fDet(const mat4f_t* a) {
 	return a_det;
 }
 
-// NOTE: inverse matrix is equal to the product of the 
-//		 reciprocal of the det and adj matrix
+#if MAT4F_SSE
+#define MAT4F_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps(a, b, _MM_SHUFFLE(w, z, y, x))
+#define MAT4F_SWIZZLE(v, x, y, z, w) _mm_shuffle_ps(v, v, _MM_SHUFFLE(w, z, y, x))
+
+// The 2x2 helpers work on 2x2 matrices stored as (m00, m01, m10, m11) in one register.
+
+// 2x2 a * b
+static inline __m128 mat2fMul(__m128 a, __m128 b) {
+	return _mm_add_ps(_mm_mul_ps(a, MAT4F_SWIZZLE(b, 0, 3, 0, 3)), _mm_mul_ps(MAT4F_SWIZZLE(a, 1, 0, 3, 2), MAT4F_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+// 2x2 adj(a) * b
+static inline __m128 mat2fAdjMul(__m128 a, __m128 b) {
+	return _mm_sub_ps(_mm_mul_ps(MAT4F_SWIZZLE(a, 3, 3, 0, 0), b), _mm_mul_ps(MAT4F_SWIZZLE(a, 1, 1, 2, 2), MAT4F_SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+// 2x2 a * adj(b)
+static inline __m128 mat2fMulAdj(__m128 a, __m128 b) {
+	return _mm_sub_ps(_mm_mul_ps(a, MAT4F_SWIZZLE(b, 3, 0, 3, 0)), _mm_mul_ps(MAT4F_SWIZZLE(a, 1, 0, 3, 2), MAT4F_SWIZZLE(b, 2, 1, 2, 1)));
+}
+#endif
+
+// NOTE: the inverse is the adjugate scaled by the reciprocal of the determinant. The SIMD version
+//		 builds it from the 2x2 blocks of the matrix (blockwise inversion), the transpose of a matrix
+//		 inverts to the transposed inverse so it does not matter that the blocks are taken from columns.
 bool mat4fInverse(const mat4f_t* a, mat4f_t* b) {
+#if MAT4F_SSE
+	__m128 c0 = _mm_loadu_ps(a->mat[0]);
+	__m128 c1 = _mm_loadu_ps(a->mat[1]);
+	__m128 c2 = _mm_loadu_ps(a->mat[2]);
+	__m128 c3 = _mm_loadu_ps(a->mat[3]);
+
+	// 2x2 blocks | A B |
+	//            | C D |
+	__m128 block_a = _mm_movelh_ps(c0, c1);
+	__m128 block_b = _mm_movehl_ps(c1, c0);
+	__m128 block_c = _mm_movelh_ps(c2, c3);
+	__m128 block_d = _mm_movehl_ps(c3, c2);
+
+	// block determinants as (|A|, |B|, |C|, |D|)
+	__m128 det_sub = _mm_sub_ps(
+		_mm_mul_ps(MAT4F_SHUFFLE(c0, c2, 0, 2, 0, 2), MAT4F_SHUFFLE(c1, c3, 1, 3, 1, 3)),
+		_mm_mul_ps(MAT4F_SHUFFLE(c0, c2, 1, 3, 1, 3), MAT4F_SHUFFLE(c1, c3, 0, 2, 0, 2)));
+	__m128 det_a = MAT4F_SWIZZLE(det_sub, 0, 0, 0, 0);
+	__m128 det_b = MAT4F_SWIZZLE(det_sub, 1, 1, 1, 1);
+	__m128 det_c = MAT4F_SWIZZLE(det_sub, 2, 2, 2, 2);
+	__m128 det_d = MAT4F_SWIZZLE(det_sub, 3, 3, 3, 3);
+
+	// the inverse is 1/|M| * | X Y |, the adjugates of X, Y, Z and W are built first
+	//                        | Z W |
+	__m128 d_c = mat2fAdjMul(block_d, block_c);
+	__m128 a_b = mat2fAdjMul(block_a, block_b);
+	__m128 x_adj = _mm_sub_ps(_mm_mul_ps(det_d, block_a), mat2fMul(block_b, d_c));
+	__m128 w_adj = _mm_sub_ps(_mm_mul_ps(det_a, block_d), mat2fMul(block_c, a_b));
+	__m128 y_adj = _mm_sub_ps(_mm_mul_ps(det_b, block_c), mat2fMulAdj(block_d, a_b));
+	__m128 z_adj = _mm_sub_ps(_mm_mul_ps(det_c, block_b), mat2fMulAdj(block_a, d_c));
+
+	// |M| = |A| |D| + |B| |C| - tr(adj(A) B adj(D) C)
+	__m128 trace = _mm_mul_ps(a_b, MAT4F_SWIZZLE(d_c, 0, 2, 1, 3));
+	trace = _mm_add_ps(trace, MAT4F_SWIZZLE(trace, 2, 3, 0, 1));
+	trace = _mm_add_ps(trace, MAT4F_SWIZZLE(trace, 1, 0, 3, 2));
+	__m128 det = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(det_a, det_d), _mm_mul_ps(det_b, det_c)), trace);
+	if (_mm_cvtss_f32(det) == 0.0f) { return false; }
+
+	__m128 inv_det = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+	x_adj = _mm_mul_ps(x_adj, inv_det);
+	y_adj = _mm_mul_ps(y_adj, inv_det);
+	z_adj = _mm_mul_ps(z_adj, inv_det);
+	w_adj = _mm_mul_ps(w_adj, inv_det);
+
+	// undo the adjugate swizzle while putting the blocks back together
+	_mm_storeu_ps(b->mat[0], MAT4F_SHUFFLE(x_adj, y_adj, 3, 1, 3, 1));
+	_mm_storeu_ps(b->mat[1], MAT4F_SHUFFLE(x_adj, y_adj, 2, 0, 2, 0));
+	_mm_storeu_ps(b->mat[2], MAT4F_SHUFFLE(z_adj, w_adj, 3, 1, 3, 1));
+	_mm_storeu_ps(b->mat[3], MAT4F_SHUFFLE(z_adj, w_adj, 2, 0, 2, 0));
+	return true;
+#else
 	float s[6] = { 0 };
 	s[0] = a->mat[0][0] * a->mat[1][1] - a->mat[1][0] * a->mat[0][1];
 	s[1] = a->mat[0][0] * a->mat[1][2] - a->mat[1][0] * a->mat[0][2];
@@ -170,6 +297,7 @@ bool mat4fInverse(const mat4f_t* a, mat4f_t* b) {
 	b->mat[3][3] = (a->mat[2][0] * s[3] - a->mat[2][1] * s[1] + a->mat[2][2] * s[0]) * inv_det;
 
 	return true;
+#endif
 }
 
 bool mat4fInverseInplace(mat4f_t* m) {	
@@ -189,11 +317,13 @@ void mat4fMakePerspective(mat4f_t* m, float angle, float aspect, float z_near, f
 	float fov = tanf(angle * 0.5f);
 	float inv_fov = 1.0f / fov;
 
-	m->mat[0][0] = aspect * inv_fov;
+	// maps view space z from -z_near .. -z_far to 0 .. 1 (Vulkan clip space), w becomes -z
+	mat4fZero(m);
+	m->mat[0][0] = inv_fov / aspect;
 	m->mat[1][1] = inv_fov;
-	m->mat[2][2] = -(z_far + z_near) / (z_far - z_near);
-	m->mat[2][3] = -(2.0f * z_far + z_near) / (z_far - z_near);
-	m->mat[3][2] = -1.0f;
+	m->mat[2][2] = z_far / (z_near - z_far);
+	m->mat[2][3] = -1.0f;
+	m->mat[3][2] = z_near * z_far / (z_near - z_far);
 }
 
 void mat4fMakeLookAt(mat4f_t* m, const vec3f_t* eye, const vec3f_t* center, const vec3f_t* up) {
@@ -204,17 +334,17 @@ void mat4fMakeLookAt(mat4f_t* m, const vec3f_t* eye, const vec3f_t* center, cons
 	m->mat[0][0] = x_axis.x;
 	m->mat[1][0] = x_axis.y;
 	m->mat[2][0] = x_axis.z;
-	m->mat[3][0] = vec3fDot(x_axis, *eye);
+	m->mat[3][0] = -vec3fDot(x_axis, *eye);
 
 	m->mat[0][1] = y_axis.x;
 	m->mat[1][1] = y_axis.y;
 	m->mat[2][1] = y_axis.z;
-	m->mat[3][1] = vec3fDot(y_axis, *eye);
+	m->mat[3][1] = -vec3fDot(y_axis, *eye);
 
 	m->mat[0][2] = z_axis.x;
 	m->mat[1][2] = z_axis.y;
 	m->mat[2][2] = z_axis.z;
-	m->mat[3][2] = vec3fDot(z_axis, *eye);
+	m->mat[3][2] = -vec3fDot(z_axis, *eye);
 
 	m->mat[0][3] = 0.0f;
 	m->mat[1][3] = 0.0f;
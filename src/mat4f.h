@@ -6,7 +6,10 @@
 typedef struct quatf_t quatf_t;		// quaternion
 typedef struct vec3f_t vec3f_t;		// vector3
 
-// Your typical 4x4 matrix.
+// Your typical 4x4 matrix, column major like the shaders read it: mat[column][row].
+// Vectors are columns and are multiplied on the right (m * v), the translation is in mat[3].
+//
+// Multiply and inverse use SSE (or AVX when the compiler targets it), picked at compile time.
 typedef struct mat4f_t {
 	float mat[4][4];
 } mat4f_t;
@@ -21,17 +24,17 @@ void mat4fMakeIdentity(mat4f_t* m);
 
 // Make a translation matrix.
 //
-void mat4fMakeTranslation(mat4f_t* m, vec3f_t* v);
+void mat4fMakeTranslation(mat4f_t* m, const vec3f_t* v);
 
 // Make a scaling matrix.
 //
-void mat4fMakeScaling(mat4f_t* m, vec3f_t* v);
+void mat4fMakeScaling(mat4f_t* m, const vec3f_t* v);
 
 // Make a rotation matrix with a quaternion.
 //
 void mat4fMakeRotation(mat4f_t* m, const quatf_t* q);
 
-// Multiply matrix a * b = res
+// Multiply matrix a * b = res (b is applied first), res may be a or b.
 //
 void mat4fMul(mat4f_t* res, const mat4f_t* a, const mat4f_t* b);
 
@@ -39,11 +42,11 @@ void mat4fMul(mat4f_t* res, const mat4f_t* a, const mat4f_t* b);
 //
 void mat4fMulInplace(mat4f_t* res, const mat4f_t* a);
 
-// Translate a vector.
+// Multiply the matrix by a translation matrix: m = m * translation(v).
 //
 void mat4fTranslate(mat4f_t* m, const vec3f_t* v);
 
-// Transform a vector.
+// Transform a point (w = 1, so the translation is applied).
 //
 void mat4fTransform(const mat4f_t* m, const vec3f_t* in, vec3f_t* out);
 
@@ -65,6 +68,7 @@ bool mat4fInverse(const mat4f_t* a, mat4f_t* b);
 bool mat4fInverseInplace(mat4f_t* m);
 
 // Given a field of view angle in radians, width/height aspect ratio, and depth near+far distances, compute a perspective projection matrix.
+// Depth maps to the 0 .. 1 range of Vulkan clip space.
 //
 void mat4fMakePerspective(mat4f_t* m, float angle, float aspect, float z_near, float z_far);
 
@@ -0,0 +1,334 @@
+#include "mesh_bvh.h"
+
+#include "gpu.h"
+#include "heap.h"
+#include "transform.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MESH_BVH_LEAF_SIZE 4						// triangles per leaf
+#define MESH_BVH_STACK_SIZE 64						// median splits keep the depth near log2(triangles / leaf size)
+
+// A leaf holds triangles[first .. first + count], an inner node has count 0 and its children at first and first + 1.
+typedef struct mesh_bvh_node_t {
+	vec3f_t min;
+	vec3f_t max;
+	int first;
+	int count;
+} mesh_bvh_node_t;
+
+typedef struct mesh_bvh_triangle_t {
+	vec3f_t corners[3];
+} mesh_bvh_triangle_t;
+
+typedef struct mesh_bvh_t {
+	heap_t* heap;
+	mesh_bvh_node_t* nodes;
+	int node_count;
+	mesh_bvh_triangle_t* triangles;					// in leaf order
+	int* triangle_ids;								// index in the mesh of every triangle
+	int triangle_count;
+} mesh_bvh_t;
+
+static void meshBvhBuild(mesh_bvh_t* bvh, vec3f_t* centers);
+
+mesh_bvh_t* meshBvhCreate(heap_t* heap, const gpu_mesh_info_t* mesh, const transform_t* transform) {
+	mesh_bvh_t* bvh = heapAlloc(heap, sizeof(mesh_bvh_t), 8);
+	memset(bvh, 0, sizeof(*bvh));
+	bvh->heap = heap;
+
+	// every layout starts its vertices with the position and has 16 bit indices
+	size_t stride = mesh->layout == GPU_MESH_LAYOUT_TRI_P444_C444_I2 ? 2 * sizeof(vec3f_t) : sizeof(vec3f_t);
+	const char* vtx_data = mesh->vtx_data;
+	const uint16_t* idx_data = mesh->idx_data;
+	int triangle_count = (int) (mesh->idx_data_size / sizeof(uint16_t) / 3);
+
+	bvh->triangle_count = triangle_count;
+	bvh->triangles = heapAlloc(heap, sizeof(mesh_bvh_triangle_t) * __max(triangle_count, 1), 16);
+	bvh->triangle_ids = heapAlloc(heap, sizeof(int) * __max(triangle_count, 1), 16);
+	bvh->nodes = heapAlloc(heap, sizeof(mesh_bvh_node_t) * __max(triangle_count * 2, 1), 16);
+	vec3f_t* centers = heapAlloc(heap, sizeof(vec3f_t) * __max(triangle_count, 1), 16);
+	for (int x = 0; x < triangle_count; x++) {
+		mesh_bvh_triangle_t* triangle = &bvh->triangles[x];
+		for (int k = 0; k < 3; k++) {
+			vec3f_t position = *(const vec3f_t*) (vtx_data + idx_data[x * 3 + k] * stride);
+			triangle->corners[k] = transform ? transformTransformVec3f(transform, position) : position;
+		}
+		centers[x] = vec3fScale(vec3fAdd(vec3fAdd(triangle->corners[0], triangle->corners[1]), triangle->corners[2]), 1.0f / 3.0f);
+		bvh->triangle_ids[x] = x;
+	}
+
+	meshBvhBuild(bvh, centers);
+	heapFree(heap, centers);
+	return bvh;
+}
+
+void meshBvhDestroy(mesh_bvh_t* bvh) {
+	heapFree(bvh->heap, bvh->nodes);
+	heapFree(bvh->heap, bvh->triangles);
+	heapFree(bvh->heap, bvh->triangle_ids);
+	heapFree(bvh->heap, bvh);
+}
+
+int meshBvhGetTriangleCount(mesh_bvh_t* bvh) {
+	return bvh->triangle_count;
+}
+
+//  --------------------------------------------------------------------------
+//								     BUILD
+//
+
+static void meshBvhSwap(mesh_bvh_t* bvh, vec3f_t* centers, int a, int b) {
+	mesh_bvh_triangle_t triangle = bvh->triangles[a];
+	bvh->triangles[a] = bvh->triangles[b];
+	bvh->triangles[b] = triangle;
+	int id = bvh->triangle_ids[a];
+	bvh->triangle_ids[a] = bvh->triangle_ids[b];
+	bvh->triangle_ids[b] = id;
+	vec3f_t center = centers[a];
+	centers[a] = centers[b];
+	centers[b] = center;
+}
+
+// Quickselect: moves the triangle with the nth center along the axis to nth, lower ones before it and higher ones after.
+static void meshBvhSelect(mesh_bvh_t* bvh, vec3f_t* centers, int begin, int end, int nth, int axis) {
+	while (end - begin > 1) {
+		float pivot = centers[(begin + end) / 2].v[axis];
+		int low = begin;
+		int high = end - 1;
+		while (low <= high) {
+			while (centers[low].v[axis] < pivot) {
+				low++;
+			}
+			while (centers[high].v[axis] > pivot) {
+				high--;
+			}
+			if (low <= high) {
+				meshBvhSwap(bvh, centers, low++, high--);
+			}
+		}
+		if (nth <= high) {
+			end = high + 1;
+		} else if (nth >= low) {
+			begin = low;
+		} else {
+			return;
+		}
+	}
+}
+
+static void meshBvhBuild(mesh_bvh_t* bvh, vec3f_t* centers) {
+	if (bvh->triangle_count == 0) {
+		return;
+	}
+
+	// nodes waiting to be split, children are allocated in pairs
+	int stack[MESH_BVH_STACK_SIZE];
+	int stack_count = 0;
+	bvh->nodes[0] = (mesh_bvh_node_t) { .first = 0, .count = bvh->triangle_count };
+	bvh->node_count = 1;
+	stack[stack_count++] = 0;
+	while (stack_count > 0) {
+		mesh_bvh_node_t* node = &bvh->nodes[stack[--stack_count]];
+		vec3f_t center_min = centers[node->first];
+		vec3f_t center_max = center_min;
+		node->min = bvh->triangles[node->first].corners[0];
+		node->max = node->min;
+		for (int x = node->first; x < node->first + node->count; x++) {
+			for (int k = 0; k < 3; k++) {
+				node->min = vec3fMin(node->min, bvh->triangles[x].corners[k]);
+				node->max = vec3fMax(node->max, bvh->triangles[x].corners[k]);
+			}
+			center_min = vec3fMin(center_min, centers[x]);
+			center_max = vec3fMax(center_max, centers[x]);
+		}
+		if (node->count <= MESH_BVH_LEAF_SIZE || stack_count + 2 > MESH_BVH_STACK_SIZE) {
+			continue;
+		}
+
+		vec3f_t extent = vec3fSub(center_max, center_min);
+		int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+		int half = node->count / 2;
+		meshBvhSelect(bvh, centers, node->first, node->first + node->count, node->first + half, axis);
+
+		int child = bvh->node_count;
+		bvh->nodes[child + 0] = (mesh_bvh_node_t) { .first = node->first, .count = half };
+		bvh->nodes[child + 1] = (mesh_bvh_node_t) { .first = node->first + half, .count = node->count - half };
+		bvh->node_count += 2;
+		node->first = child;
+		node->count = 0;
+		stack[stack_count++] = child + 0;
+		stack[stack_count++] = child + 1;
+	}
+}
+
+//  --------------------------------------------------------------------------
+//								     SWEEP
+//
+
+// Checks if the path start + move * t enters the box before max_time.
+static bool meshBvhSweepBox(vec3f_t start, vec3f_t move, vec3f_t min, vec3f_t max, float max_time) {
+	float enter = 0.0f;
+	float exit = max_time;
+	for (int axis = 0; axis < 3; axis++) {
+		if (fabsf(move.v[axis]) < FLT_MIN) {
+			if (start.v[axis] < min.v[axis] || start.v[axis] > max.v[axis]) {
+				return false;
+			}
+			continue;
+		}
+		float inv_move = 1.0f / move.v[axis];
+		float to_min = (min.v[axis] - start.v[axis]) * inv_move;
+		float to_max = (max.v[axis] - start.v[axis]) * inv_move;
+		enter = __max(enter, __min(to_min, to_max));
+		exit = __min(exit, __max(to_min, to_max));
+		if (enter > exit) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Keeps the contact if it comes before the best one so far, a sphere that starts touching only counts
+// while it moves towards the triangle.
+static inline bool meshBvhContact(float time, vec3f_t offset, vec3f_t point, vec3f_t move, vec3f_t side, mesh_bvh_hit_t* hit) {
+	if (time >= hit->time) {
+		return false;
+	}
+	float length = vec3fMagnitude(offset);
+	vec3f_t normal = length > FLT_EPSILON ? vec3fScale(offset, 1.0f / length) : side;
+	if (time == 0.0f && vec3fDot(move, normal) >= 0.0f) {
+		return false;
+	}
+	hit->time = time;
+	hit->normal = normal;
+	hit->point = point;
+	return true;
+}
+
+// Smallest root of a t^2 + b t + c in [0, max_time), -1 if there is none.
+static inline float meshBvhFirstRoot(float a, float b, float c, float max_time) {
+	if (a < FLT_MIN) {
+		return -1.0f;
+	}
+	float discriminant = b * b - 4.0f * a * c;
+	if (discriminant < 0.0f) {
+		return -1.0f;
+	}
+	float t = (-b - sqrtf(discriminant)) / (2.0f * a);
+	return t >= 0.0f && t < max_time ? t : -1.0f;
+}
+
+// The sphere first touches the face, then the edges, then the corners, so the face is tested first and
+// the edges and corners only if it is not hit inside.
+static bool meshBvhSweepTriangle(vec3f_t start, vec3f_t move, float radius, const mesh_bvh_triangle_t* triangle, mesh_bvh_hit_t* hit) {
+	const vec3f_t* corners = triangle->corners;
+	vec3f_t face = vec3fCross(vec3fSub(corners[1], corners[0]), vec3fSub(corners[2], corners[0]));
+	float face_length = vec3fMagnitude(face);
+	if (face_length < FLT_MIN) {
+		return false;
+	}
+	face = vec3fScale(face, 1.0f / face_length);
+
+	// two sided, the side the sphere starts on is the front
+	float distance = vec3fDot(vec3fSub(start, corners[0]), face);
+	vec3f_t side = distance < 0.0f ? vec3fNeg(face) : face;
+	distance = fabsf(distance);
+	float approach = -vec3fDot(move, side);
+
+	float face_time = -1.0f;
+	if (distance <= radius) {
+		face_time = 0.0f;
+	} else if (approach > 0.0f) {
+		face_time = (distance - radius) / approach;
+	}
+	if (face_time >= 0.0f && face_time < hit->time) {
+		vec3f_t center = vec3fAdd(start, vec3fScale(move, face_time));
+		vec3f_t point = vec3fSub(center, vec3fScale(side, vec3fDot(vec3fSub(center, corners[0]), side)));
+		bool inside = true;
+		for (int k = 0; k < 3; k++) {
+			vec3f_t edge = vec3fSub(corners[(k + 1) % 3], corners[k]);
+			inside &= vec3fDot(vec3fCross(edge, vec3fSub(point, corners[k])), face) >= 0.0f;
+		}
+		if (inside) {
+			return meshBvhContact(face_time, side, point, move, side, hit);
+		}
+	}
+
+	bool found = false;
+	const float move_sqrd = vec3fMagnitudeSqrd(move);
+	const float radius_sqrd = radius * radius;
+	for (int k = 0; k < 3; k++) {
+		// distance to the line through the edge: |s + m t|^2 - ((s + m t).e)^2 / |e|^2 = r^2, times |e|^2
+		vec3f_t edge = vec3fSub(corners[(k + 1) % 3], corners[k]);
+		vec3f_t offset = vec3fSub(start, corners[k]);
+		float edge_sqrd = vec3fMagnitudeSqrd(edge);
+		if (edge_sqrd < FLT_MIN) {
+			continue;
+		}
+		float offset_edge = vec3fDot(offset, edge);
+		float move_edge = vec3fDot(move, edge);
+		float a = edge_sqrd * move_sqrd - move_edge * move_edge;
+		float b = 2.0f * (edge_sqrd * vec3fDot(offset, move) - offset_edge * move_edge);
+		float c = edge_sqrd * vec3fMagnitudeSqrd(offset) - offset_edge * offset_edge - radius_sqrd * edge_sqrd;
+		float t = c <= 0.0f ? 0.0f : meshBvhFirstRoot(a, b, c, hit->time);
+		if (t < 0.0f) {
+			continue;
+		}
+		float along = (offset_edge + move_edge * t) / edge_sqrd;
+		if (along >= 0.0f && along <= 1.0f) {
+			vec3f_t point = vec3fAdd(corners[k], vec3fScale(edge, along));
+			vec3f_t center = vec3fAdd(start, vec3fScale(move, t));
+			found |= meshBvhContact(t, vec3fSub(center, point), point, move, side, hit);
+		}
+	}
+	for (int k = 0; k < 3; k++) {
+		vec3f_t offset = vec3fSub(start, corners[k]);
+		float c = vec3fMagnitudeSqrd(offset) - radius_sqrd;
+		float t = c <= 0.0f ? 0.0f : meshBvhFirstRoot(move_sqrd, 2.0f * vec3fDot(offset, move), c, hit->time);
+		if (t >= 0.0f) {
+			found |= meshBvhContact(t, vec3fAdd(offset, vec3fScale(move, t)), corners[k], move, side, hit);
+		}
+	}
+	return found;
+}
+
+bool meshBvhSweepSphere(const mesh_bvh_t* bvh, vec3f_t start, vec3f_t end, float radius, mesh_bvh_hit_t* hit) {
+	if (bvh->node_count == 0) {
+		return false;
+	}
+
+	vec3f_t move = vec3fSub(end, start);
+	vec3f_t grow = { .x = radius, .y = radius, .z = radius };
+	mesh_bvh_hit_t best = { .time = 1.0f };
+	bool found = false;
+
+	int stack[MESH_BVH_STACK_SIZE];
+	int stack_count = 0;
+	stack[stack_count++] = 0;
+	while (stack_count > 0) {
+		const mesh_bvh_node_t* node = &bvh->nodes[stack[--stack_count]];
+		if (!meshBvhSweepBox(start, move, vec3fSub(node->min, grow), vec3fAdd(node->max, grow), best.time)) {
+			continue;
+		}
+		if (node->count == 0) {
+			stack[stack_count++] = node->first + 1;
+			stack[stack_count++] = node->first;
+			continue;
+		}
+		for (int x = node->first; x < node->first + node->count; x++) {
+			if (meshBvhSweepTriangle(start, move, radius, &bvh->triangles[x], &best)) {
+				best.triangle = bvh->triangle_ids[x];
+				found = true;
+			}
+		}
+	}
+
+	if (found) {
+		*hit = best;
+	}
+	return found;
+}
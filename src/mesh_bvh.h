@@ -0,0 +1,53 @@
+#ifndef __MESH_BVH_H__
+#define __MESH_BVH_H__
+
+#include "vec3f.h"
+
+#include <stdbool.h>
+
+/* STATIC TRIANGLE MESH BVH
+*	- a bounding volume hierarchy over the triangles of a mesh that never moves, built once from the
+*	  vertex and index data of a gpu_mesh_info_t placed in the world by a transform
+*	- nodes are split at the median triangle along the longest axis of their triangle centers, the
+*	  triangles are stored in leaf order so every leaf is a contiguous range
+*	- spheres are swept against it for continuous collision detection: the swept path is tested
+*	  against the node boxes grown by the radius and only nodes entered before the closest hit so far
+*	  are opened
+*	- triangles are two sided, a sphere hits the side it starts on
+*/
+
+typedef struct mesh_bvh_t mesh_bvh_t;
+
+typedef struct heap_t heap_t;
+typedef struct gpu_mesh_info_t gpu_mesh_info_t;
+typedef struct transform_t transform_t;
+
+// First contact of a swept sphere.
+typedef struct mesh_bvh_hit_t {
+	float time;										// fraction of the sweep at the contact, 0 for a sphere that starts touching and moves closer
+	vec3f_t normal;									// from the triangle towards the sphere center at the contact
+	vec3f_t point;									// closest point of the triangle at the contact
+	int triangle;									// index of the triangle in the mesh
+} mesh_bvh_hit_t;
+
+// Builds the hierarchy over the triangles of a mesh, its vertices are moved into the world by transform.
+// The mesh data is copied, it does not have to outlive the hierarchy.
+//
+// RETURN: the new hierarchy
+mesh_bvh_t* meshBvhCreate(heap_t* heap, const gpu_mesh_info_t* mesh, const transform_t* transform);
+
+// Destroys the hierarchy.
+//
+void meshBvhDestroy(mesh_bvh_t* bvh);
+
+// Get the number of triangles.
+//
+// RETURN: triangle count
+int meshBvhGetTriangleCount(mesh_bvh_t* bvh);
+
+// Sweeps a sphere of the given radius from start to end and finds the first triangle it touches before end.
+//
+// RETURN: true if the sphere touches a triangle on the way, hit is written only then
+bool meshBvhSweepSphere(const mesh_bvh_t* bvh, vec3f_t start, vec3f_t end, float radius, mesh_bvh_hit_t* hit);
+
+#endif
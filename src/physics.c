@@ -1,15 +1,1576 @@
 #include "physics.h"
 #include "heap.h"
+#include "job.h"
+#include "debug.h"
+#include "mesh_bvh.h"
+#include "quatf.h"
+#include "sort.h"
+#include "spatial_hash.h"
+#include "transform.h"
+#include "vec3f_wide.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PHYSICS_MAX_COLORS 64						// the last color holds constraints that could not be colored
+#define PHYSICS_PARTICLE_CHUNK 2048					// particles per job
+#define PHYSICS_CONSTRAINT_CHUNK 1024				// constraints per job
+#define PHYSICS_INITIAL_CAPACITY 1024
+#define PHYSICS_MAX_CONTACTS 16						// contacts kept per particle, closely packed spheres touch 12
+#define PHYSICS_MORTON_BITS 10						// bits per axis of the Morton codes particles are reordered by
+#define PHYSICS_PI 3.14159265f
+#define PHYSICS_CLUSTER_CHUNK 64					// clusters per job
+#define PHYSICS_CLUSTER_ITERATIONS 4				// polar decomposition steps per substep, warm started
+#define PHYSICS_CLUSTER_PINNED_MASS 1e6f			// mass pinned particles count with in a cluster fit
+#define PHYSICS_CCD_SKIN 1e-3f						// particles keep this far from static meshes on top of their radius
+#define PHYSICS_CCD_ITERATIONS 4					// sweeps per particle and substep, a particle can slide into the next triangle
+
+// SoA table of one constraint type, solved in the order of the types. A constraint can have several rows
+// (scalar constraints with their own compliance and lambda) that are solved one after the other.
+typedef struct physics_table_t {
+	int arity;										// particles per constraint
+	int rows;
+	int rest_size;									// floats of rest state per constraint
+	job_func_t solve;								// solves a range of a batch (physics_batch_job_t)
+	int count;
+	int capacity;
+	int* particles;									// arity per constraint
+	float* rest;									// rest_size per constraint
+	float* compliance;								// rows per constraint
+	float* lambda;									// rows per constraint
+	int batch_offsets[PHYSICS_MAX_COLORS + 1];
+	int batch_awake_ends[PHYSICS_MAX_COLORS];		// every batch starts with the constraints of awake particles
+	bool dirty;										// constraints were added since the last coloring
+	bool jacobi;									// one batch solved against the positions of the last substep
+	int* jacobi_particles;							// every particle of the table once, ascending, only the Jacobi reduce reads them
+	int jacobi_particle_count;
+} physics_table_t;
+
+// Position correction of one particle summed up by one Jacobi slice.
+typedef struct physics_delta_t {
+	vec3f_t delta;
+	int count;
+} physics_delta_t;
 
 typedef struct physics_t {
-	void** data;
-	float acceleration;
+	heap_t* heap;
+	job_pool_t* pool;
+	vec3f_t gravity;
+	int substeps;
+
+	int particle_count;
+	int particle_capacity;
+	vec3f_t* positions;
+	vec3f_t* prev_positions;
+	vec3f_t* velocities;
+	float* inv_masses;
+	int* particle_ids;								// id physicsParticleAdd returned for every particle
+	int* particle_slots;							// current index of every particle id
+	int* particle_clusters;							// cluster of every particle id, -1 for none
+
+	// particles are sorted by Morton code every reorder_interval updates, 0 never reorders them
+	int reorder_interval;
+	int reorder_countdown;
+
+	// islands are the particles connected by constraints or contacts, pinned particles connect nothing.
+	// an island sleeps once none of its particles had a kinetic energy (per mass) above sleep_energy
+	// for sleep_frames updates
+	float sleep_energy;								// 0 disables sleeping
+	int sleep_frames;
+	int* island_parents;							// union-find over the constraints, grown as constraints are added
+	int* island_roots;								// island of every particle, the constraints and the last contacts
+	float* island_energies;							// per island, indexed by its root
+	int* island_calm_frames;						// per island, indexed by its root
+	int* calm_frames;								// updates the island of every particle has been calm
+	bool* asleep;
+	bool islands_dirty;								// island_parents has to be built from the constraints again
+	bool sleep_dirty;								// particles fell asleep or woke up, the batches are partitioned again
+
+	physics_table_t tables[PHYSICS_CONSTRAINT_TYPE_COUNT];
+
+	// Jacobi tables are split into one slice per worker, every slice adds its corrections to its own
+	// buffer and the buffers are summed per particle after, so no two threads write the same particle
+	physics_delta_t* deltas;						// delta_buffer_count buffers of delta_capacity particles
+	int delta_buffer_count;
+	int delta_capacity;
+
+	// shape matching clusters, solved after the constraint tables. clusters share no particles, so all
+	// of them are solved in parallel
+	int cluster_count;
+	int cluster_capacity;
+	int* cluster_offsets;							// cluster c holds cluster_particles[cluster_offsets[c] .. cluster_offsets[c + 1]]
+	float* cluster_stiffness;
+	vec3f_t* cluster_centers;						// center of mass of the last solve
+	quatf_t* cluster_rotations;						// rotation of the last solve, starts the next polar decomposition
+	transform_t* cluster_rest_transforms;			// transform at add, translation relative to the rest center of mass
+	transform_t** cluster_transforms;				// written after every update, NULL for none
+	int cluster_particle_count;
+	int cluster_particle_capacity;
+	int* cluster_particles;
+	vec3f_t* cluster_rest;							// rest position of every cluster particle relative to the rest center of mass
+
+	// particle collisions, every particle has up to PHYSICS_MAX_CONTACTS contacts of this substep
+	float particle_radius;							// 0 disables them
+	float contact_compliance;
+	spatial_hash_t* hash;
+	int* contacts;									// the other particle of every contact
+	int* contact_counts;
+	vec3f_t* contact_positions;						// positions the contacts were found at, the solve reads them
+	int contact_capacity;
+	int contact_particle_count;						// particle count of the last contact search
+
+	// static triangle meshes, particles are swept against them after every other solve of a substep
+	mesh_bvh_t** static_meshes;
+	int static_mesh_count;
+	int static_mesh_capacity;
+
+	float substep_dt;
 } physics_t;
 
+typedef struct physics_morton_job_t {
+	physics_t* physics;
+	vec3f_t min;
+	float scale;									// world to Morton grid
+	uint64_t* keys;
+	uint32_t* values;
+} physics_morton_job_t;
+
+typedef struct physics_batch_job_t {
+	physics_t* physics;
+	physics_table_t* table;
+	int offset;
+	bool wide;										// the batch shares no particles, so it can be solved VEC3F_XN_WIDTH at a time
+	bool jacobi;									// corrections go to the delta buffer of the worker (the slice)
+} physics_batch_job_t;
+
+typedef struct physics_jacobi_job_t {
+	physics_batch_job_t batch;
+	int count;
+	int slice_count;
+} physics_jacobi_job_t;
+
+static void* physicsGrow(heap_t* heap, void* array, size_t element_size, int count, int capacity);
+static void physicsPermute(heap_t* heap, void* array, size_t element_size, const int* perm, int count);
+static void physicsColorConstraints(physics_t* physics, const int* particles, int arity, int count, int* perm, int* batch_offsets);
+static void physicsColorTable(physics_t* physics, physics_table_t* table);
+static void physicsTablePermute(physics_t* physics, physics_table_t* table, const int* perm);
+static void physicsSolveDistanceJob(void* user, int begin, int end, int worker);
+static void physicsSolveVolumeJob(void* user, int begin, int end, int worker);
+static void physicsSolveBendingJob(void* user, int begin, int end, int worker);
+static void physicsSolveNeoHookeanJob(void* user, int begin, int end, int worker);
+static void physicsSolveClustersJob(void* user, int begin, int end, int worker);
+static void physicsClusterTransformsJob(void* user, int begin, int end, int worker);
+static void physicsSolveMeshContactsJob(void* user, int begin, int end, int worker);
+static float physicsDihedralAngle(const vec3f_t* positions, const int* particles, vec3f_t* gradients);
+static void physicsReorder(physics_t* physics);
+static void physicsUpdateIslands(physics_t* physics);
+static void physicsIslandUnion(int* parents, int a, int b);
+static void physicsWakeAll(physics_t* physics);
+static void physicsPartitionAwake(physics_t* physics);
 
 physics_t* physicsCreate(heap_t* heap) {
 	physics_t* phys = heapAlloc(heap, sizeof(physics_t), 8);
-	phys->acceleration = 9.81f;
+	memset(phys, 0, sizeof(*phys));
+	phys->heap = heap;
+	phys->gravity = (vec3f_t){ .x = 0.0f, .y = -9.81f, .z = 0.0f };
+	phys->substeps = 8;
+
+	// distance: rest length
+	// volume: rest volume
+	// bending: rest dihedral angle
+	// neo-hookean: inverse rest edge matrix (row major) and the rest stable volume ratio, a deviatoric and a hydrostatic row
+	static const struct { int arity; int rows; int rest_size; job_func_t solve; } layouts[PHYSICS_CONSTRAINT_TYPE_COUNT] = {
+		[PHYSICS_CONSTRAINT_DISTANCE] = { 2, 1, 1, physicsSolveDistanceJob },
+		[PHYSICS_CONSTRAINT_VOLUME] = { 4, 1, 1, physicsSolveVolumeJob },
+		[PHYSICS_CONSTRAINT_BENDING] = { 4, 1, 1, physicsSolveBendingJob },
+		[PHYSICS_CONSTRAINT_NEO_HOOKEAN] = { 4, 2, 10, physicsSolveNeoHookeanJob },
+	};
+	for (int type = 0; type < PHYSICS_CONSTRAINT_TYPE_COUNT; type++) {
+		phys->tables[type].arity = layouts[type].arity;
+		phys->tables[type].rows = layouts[type].rows;
+		phys->tables[type].rest_size = layouts[type].rest_size;
+		phys->tables[type].solve = layouts[type].solve;
+	}
 
 	return phys;
-}
\ No newline at end of file
+}
+
+void physicsDestroy(physics_t* physics) {
+	heapFree(physics->heap, physics->positions);
+	heapFree(physics->heap, physics->prev_positions);
+	heapFree(physics->heap, physics->velocities);
+	heapFree(physics->heap, physics->inv_masses);
+	heapFree(physics->heap, physics->particle_ids);
+	heapFree(physics->heap, physics->particle_slots);
+	heapFree(physics->heap, physics->particle_clusters);
+	heapFree(physics->heap, physics->island_parents);
+	heapFree(physics->heap, physics->island_roots);
+	heapFree(physics->heap, physics->island_energies);
+	heapFree(physics->heap, physics->island_calm_frames);
+	heapFree(physics->heap, physics->calm_frames);
+	heapFree(physics->heap, physics->asleep);
+
+	for (int type = 0; type < PHYSICS_CONSTRAINT_TYPE_COUNT; type++) {
+		heapFree(physics->heap, physics->tables[type].particles);
+		heapFree(physics->heap, physics->tables[type].rest);
+		heapFree(physics->heap, physics->tables[type].compliance);
+		heapFree(physics->heap, physics->tables[type].lambda);
+		heapFree(physics->heap, physics->tables[type].jacobi_particles);
+	}
+
+	if (physics->hash) {
+		spatialHashDestroy(physics->hash);
+	}
+	heapFree(physics->heap, physics->contacts);
+	heapFree(physics->heap, physics->contact_counts);
+	heapFree(physics->heap, physics->contact_positions);
+
+	heapFree(physics->heap, physics->deltas);
+
+	heapFree(physics->heap, physics->cluster_offsets);
+	heapFree(physics->heap, physics->cluster_stiffness);
+	heapFree(physics->heap, physics->cluster_centers);
+	heapFree(physics->heap, physics->cluster_rotations);
+	heapFree(physics->heap, physics->cluster_rest_transforms);
+	heapFree(physics->heap, physics->cluster_transforms);
+	heapFree(physics->heap, physics->cluster_particles);
+	heapFree(physics->heap, physics->cluster_rest);
+
+	for (int x = 0; x < physics->static_mesh_count; x++) {
+		meshBvhDestroy(physics->static_meshes[x]);
+	}
+	heapFree(physics->heap, physics->static_meshes);
+
+	heapFree(physics->heap, physics);
+}
+
+void physicsSetJobPool(physics_t* physics, job_pool_t* pool) {
+	physics->pool = pool;
+}
+
+void physicsSetSolverMode(physics_t* physics, physics_constraint_type_t type, physics_solver_mode_t mode) {
+	physics_table_t* table = &physics->tables[type];
+	if (table->jacobi != (mode == PHYSICS_SOLVER_JACOBI)) {
+		table->jacobi = mode == PHYSICS_SOLVER_JACOBI;
+		table->dirty = true;
+	}
+}
+
+void physicsSetSubsteps(physics_t* physics, int substeps) {
+	physics->substeps = substeps > 0 ? substeps : 1;
+}
+
+void physicsSetGravity(physics_t* physics, vec3f_t gravity) {
+	physics->gravity = gravity;
+
+	// resting particles are only at rest under the old gravity
+	physicsWakeAll(physics);
+}
+
+void physicsSetParticleCollision(physics_t* physics, float radius, float compliance) {
+	physics->particle_radius = __max(radius, 0.0f);
+	physics->contact_compliance = compliance;
+	physics->contact_particle_count = 0;
+	if (radius > 0.0f && !physics->hash) {
+		physics->hash = spatialHashCreate(physics->heap);
+	}
+}
+
+void physicsSetSleeping(physics_t* physics, float energy, int frames) {
+	physics->sleep_energy = __max(energy, 0.0f);
+	physics->sleep_frames = __max(frames, 1);
+	physicsWakeAll(physics);
+	if (physics->sleep_energy == 0.0f) {
+		// nothing would wake the sleeping particles anymore
+		for (int x = 0; x < physics->particle_count; x++) {
+			physics->asleep[x] = false;
+		}
+		for (int type = 0; type < PHYSICS_CONSTRAINT_TYPE_COUNT; type++) {
+			physics_table_t* table = &physics->tables[type];
+			memcpy(table->batch_awake_ends, table->batch_offsets + 1, sizeof(table->batch_awake_ends));
+		}
+	}
+}
+
+void physicsSetReorderInterval(physics_t* physics, int updates) {
+	physics->reorder_interval = __max(updates, 0);
+	physics->reorder_countdown = 0;
+}
+
+//  --------------------------------------------------------------------------
+//								   PARTICLES
+//
+
+static void physicsParticleReserve(physics_t* physics, int capacity) {
+	if (capacity <= physics->particle_capacity) {
+		return;
+	}
+	heap_t* heap = physics->heap;
+	int count = physics->particle_count;
+	physics->positions = physicsGrow(heap, physics->positions, sizeof(vec3f_t), count, capacity);
+	physics->prev_positions = physicsGrow(heap, physics->prev_positions, sizeof(vec3f_t), count, capacity);
+	physics->velocities = physicsGrow(heap, physics->velocities, sizeof(vec3f_t), count, capacity);
+	physics->inv_masses = physicsGrow(heap, physics->inv_masses, sizeof(float), count, capacity);
+	physics->particle_ids = physicsGrow(heap, physics->particle_ids, sizeof(int), count, capacity);
+	physics->particle_slots = physicsGrow(heap, physics->particle_slots, sizeof(int), count, capacity);
+	physics->particle_clusters = physicsGrow(heap, physics->particle_clusters, sizeof(int), count, capacity);
+	physics->island_parents = physicsGrow(heap, physics->island_parents, sizeof(int), count, capacity);
+	physics->island_roots = physicsGrow(heap, physics->island_roots, sizeof(int), 0, capacity);
+	physics->island_energies = physicsGrow(heap, physics->island_energies, sizeof(float), 0, capacity);
+	physics->island_calm_frames = physicsGrow(heap, physics->island_calm_frames, sizeof(int), 0, capacity);
+	physics->calm_frames = physicsGrow(heap, physics->calm_frames, sizeof(int), count, capacity);
+	physics->asleep = physicsGrow(heap, physics->asleep, sizeof(bool), count, capacity);
+	physics->particle_capacity = capacity;
+}
+
+static void physicsTableReserve(physics_t* physics, physics_table_t* table, int capacity) {
+	if (capacity <= table->capacity) {
+		return;
+	}
+	heap_t* heap = physics->heap;
+	table->particles = physicsGrow(heap, table->particles, sizeof(int) * table->arity, table->count, capacity);
+	table->rest = physicsGrow(heap, table->rest, sizeof(float) * table->rest_size, table->count, capacity);
+	table->compliance = physicsGrow(heap, table->compliance, sizeof(float) * table->rows, table->count, capacity);
+	table->lambda = physicsGrow(heap, table->lambda, sizeof(float) * table->rows, table->count, capacity);
+	table->capacity = capacity;
+}
+
+void physicsReserve(physics_t* physics, int particle_count, int constraint_count) {
+	physicsParticleReserve(physics, particle_count);
+	physicsTableReserve(physics, &physics->tables[PHYSICS_CONSTRAINT_DISTANCE], constraint_count);
+}
+
+int physicsParticleAdd(physics_t* physics, vec3f_t position, float inv_mass) {
+	if (physics->particle_count == physics->particle_capacity) {
+		physicsParticleReserve(physics, __max(PHYSICS_INITIAL_CAPACITY, physics->particle_capacity * 2));
+	}
+	int particle = physics->particle_count++;
+	physics->positions[particle] = position;
+	physics->prev_positions[particle] = position;
+	physics->velocities[particle] = vec3fZero();
+	physics->inv_masses[particle] = inv_mass;
+
+	// particles are never removed, so the ids are the indices the particles started at
+	physics->particle_ids[particle] = particle;
+	physics->particle_slots[particle] = particle;
+	physics->particle_clusters[particle] = -1;
+
+	physics->island_parents[particle] = particle;
+	physics->calm_frames[particle] = 0;
+	physics->asleep[particle] = false;
+	return particle;
+}
+
+void physicsParticleWake(physics_t* physics, int particle) {
+	// the island wakes up with the next update
+	physics->calm_frames[physics->particle_slots[particle]] = 0;
+}
+
+bool physicsParticleIsAsleep(physics_t* physics, int particle) {
+	return physics->asleep[physics->particle_slots[particle]];
+}
+
+vec3f_t physicsParticleGetPosition(physics_t* physics, int particle) {
+	return physics->positions[physics->particle_slots[particle]];
+}
+
+int physicsParticleGetIndex(physics_t* physics, int particle) {
+	return physics->particle_slots[particle];
+}
+
+int physicsGetParticleCount(physics_t* physics) {
+	return physics->particle_count;
+}
+
+//  --------------------------------------------------------------------------
+//								  CONSTRAINTS
+//
+
+// Adds a constraint between the particles (ids) to a table, wakes them and joins their islands.
+//
+// RETURN: index of the constraint, the caller fills in its rest state and compliance
+static int physicsTableAdd(physics_t* physics, physics_table_t* table, const int* particles) {
+	if (table->count == table->capacity) {
+		physicsTableReserve(physics, table, __max(PHYSICS_INITIAL_CAPACITY, table->capacity * 2));
+	}
+	int constraint = table->count++;
+	int* slots = table->particles + constraint * table->arity;
+	int first_moving = -1;
+	for (int k = 0; k < table->arity; k++) {
+		slots[k] = physics->particle_slots[particles[k]];
+		physics->calm_frames[slots[k]] = 0;
+		if (physics->inv_masses[slots[k]] == 0.0f || physics->islands_dirty) {
+			continue;
+		}
+		if (first_moving < 0) {
+			first_moving = slots[k];
+		} else {
+			physicsIslandUnion(physics->island_parents, first_moving, slots[k]);
+		}
+	}
+	memset(table->lambda + constraint * table->rows, 0, sizeof(float) * table->rows);
+	table->dirty = true;
+	return constraint;
+}
+
+void physicsDistanceConstraintAdd(physics_t* physics, int a, int b, float compliance) {
+	physics_table_t* table = &physics->tables[PHYSICS_CONSTRAINT_DISTANCE];
+	int constraint = physicsTableAdd(physics, table, (int[]) { a, b });
+	const int* p = table->particles + constraint * 2;
+	table->rest[constraint] = vec3fMagnitude(vec3fSub(physics->positions[p[0]], physics->positions[p[1]]));
+	table->compliance[constraint] = compliance;
+}
+
+void physicsVolumeConstraintAdd(physics_t* physics, int a, int b, int c, int d, float compliance) {
+	physics_table_t* table = &physics->tables[PHYSICS_CONSTRAINT_VOLUME];
+	int constraint = physicsTableAdd(physics, table, (int[]) { a, b, c, d });
+	const int* p = table->particles + constraint * 4;
+	vec3f_t e1 = vec3fSub(physics->positions[p[1]], physics->positions[p[0]]);
+	vec3f_t e2 = vec3fSub(physics->positions[p[2]], physics->positions[p[0]]);
+	vec3f_t e3 = vec3fSub(physics->positions[p[3]], physics->positions[p[0]]);
+	table->rest[constraint] = vec3fDot(vec3fCross(e1, e2), e3) / 6.0f;
+	table->compliance[constraint] = compliance;
+}
+
+void physicsNeoHookeanConstraintAdd(physics_t* physics, int a, int b, int c, int d, float deviatoric_compliance, float hydrostatic_compliance) {
+	physics_table_t* table = &physics->tables[PHYSICS_CONSTRAINT_NEO_HOOKEAN];
+	int constraint = physicsTableAdd(physics, table, (int[]) { a, b, c, d });
+	const int* p = table->particles + constraint * 4;
+	float* rest = table->rest + constraint * 10;
+	vec3f_t e1 = vec3fSub(physics->positions[p[1]], physics->positions[p[0]]);
+	vec3f_t e2 = vec3fSub(physics->positions[p[2]], physics->positions[p[0]]);
+	vec3f_t e3 = vec3fSub(physics->positions[p[3]], physics->positions[p[0]]);
+	float det = vec3fDot(vec3fCross(e1, e2), e3);
+	memset(rest, 0, sizeof(float) * 10);
+	float* compliance = table->compliance + constraint * 2;
+	compliance[0] = 0.0f;
+	compliance[1] = 0.0f;
+	if (fabsf(det) < FLT_EPSILON * FLT_EPSILON) {
+		// a flat tet has no rest shape, the zero matrix turns the constraint off
+		return;
+	}
+
+	// the rows of the inverse of the matrix with the edges as columns
+	vec3f_t rows[3] = { vec3fCross(e2, e3), vec3fCross(e3, e1), vec3fCross(e1, e2) };
+	for (int row = 0; row < 3; row++) {
+		rest[row * 3 + 0] = rows[row].x / det;
+		rest[row * 3 + 1] = rows[row].y / det;
+		rest[row * 3 + 2] = rows[row].z / det;
+	}
+
+	// gamma = 1 + mu / lambda keeps the rest shape free of stress, the compliances are per rest volume
+	float volume = fabsf(det) / 6.0f;
+	rest[9] = 1.0f + (deviatoric_compliance > 0.0f ? hydrostatic_compliance / deviatoric_compliance : 0.0f);
+	compliance[0] = deviatoric_compliance / volume;
+	compliance[1] = hydrostatic_compliance / volume;
+}
+
+void physicsBendingConstraintAdd(physics_t* physics, int a, int b, int c, int d, float compliance) {
+	physics_table_t* table = &physics->tables[PHYSICS_CONSTRAINT_BENDING];
+	int constraint = physicsTableAdd(physics, table, (int[]) { a, b, c, d });
+	vec3f_t gradients[4];
+	table->rest[constraint] = physicsDihedralAngle(physics->positions, table->particles + constraint * 4, gradients);
+	table->compliance[constraint] = compliance;
+}
+
+// Pinned particles take part in the fit with a large mass, so a cluster turns around them.
+static inline float physicsClusterMass(float inv_mass) {
+	return inv_mass != 0.0f ? 1.0f / inv_mass : PHYSICS_CLUSTER_PINNED_MASS;
+}
+
+int physicsClusterAdd(physics_t* physics, const int* particles, int count, float stiffness, transform_t* transform) {
+	if (physics->cluster_count == physics->cluster_capacity) {
+		heap_t* heap = physics->heap;
+		int capacity = __max(PHYSICS_INITIAL_CAPACITY, physics->cluster_capacity * 2);
+		int cluster_count = physics->cluster_count;
+		physics->cluster_offsets = physicsGrow(heap, physics->cluster_offsets, sizeof(int), cluster_count + 1, capacity + 1);
+		physics->cluster_stiffness = physicsGrow(heap, physics->cluster_stiffness, sizeof(float), cluster_count, capacity);
+		physics->cluster_centers = physicsGrow(heap, physics->cluster_centers, sizeof(vec3f_t), cluster_count, capacity);
+		physics->cluster_rotations = physicsGrow(heap, physics->cluster_rotations, sizeof(quatf_t), cluster_count, capacity);
+		physics->cluster_rest_transforms = physicsGrow(heap, physics->cluster_rest_transforms, sizeof(transform_t), cluster_count, capacity);
+		physics->cluster_transforms = physicsGrow(heap, physics->cluster_transforms, sizeof(transform_t*), cluster_count, capacity);
+		physics->cluster_capacity = capacity;
+		physics->cluster_offsets[0] = 0;
+	}
+	if (physics->cluster_particle_count + count > physics->cluster_particle_capacity) {
+		int capacity = __max(PHYSICS_INITIAL_CAPACITY, __max(physics->cluster_particle_capacity * 2, physics->cluster_particle_count + count));
+		physics->cluster_particles = physicsGrow(physics->heap, physics->cluster_particles, sizeof(int), physics->cluster_particle_count, capacity);
+		physics->cluster_rest = physicsGrow(physics->heap, physics->cluster_rest, sizeof(vec3f_t), physics->cluster_particle_count, capacity);
+		physics->cluster_particle_capacity = capacity;
+	}
+
+	int cluster = physics->cluster_count++;
+	int first = physics->cluster_particle_count;
+	int* slots = physics->cluster_particles + first;
+	int first_moving = -1;
+	float mass = 0.0f;
+	vec3f_t center = vec3fZero();
+	for (int x = 0; x < count; x++) {
+		// clusters are solved in parallel, a shared particle would be written by two threads
+		assert(physics->particle_clusters[particles[x]] < 0);
+		physics->particle_clusters[particles[x]] = cluster;
+		slots[x] = physics->particle_slots[particles[x]];
+		physics->calm_frames[slots[x]] = 0;
+		float particle_mass = physicsClusterMass(physics->inv_masses[slots[x]]);
+		mass += particle_mass;
+		center = vec3fAdd(center, vec3fScale(physics->positions[slots[x]], particle_mass));
+		if (physics->inv_masses[slots[x]] == 0.0f || physics->islands_dirty) {
+			continue;
+		}
+		if (first_moving < 0) {
+			first_moving = slots[x];
+		} else {
+			physicsIslandUnion(physics->island_parents, first_moving, slots[x]);
+		}
+	}
+	center = count > 0 ? vec3fScale(center, 1.0f / mass) : vec3fZero();
+	for (int x = 0; x < count; x++) {
+		physics->cluster_rest[first + x] = vec3fSub(physics->positions[slots[x]], center);
+	}
+	physics->cluster_particle_count += count;
+
+	physics->cluster_offsets[cluster + 1] = physics->cluster_particle_count;
+	physics->cluster_stiffness[cluster] = __min(__max(stiffness, 0.0f), 1.0f);
+	physics->cluster_centers[cluster] = center;
+	physics->cluster_rotations[cluster] = quatfIdentity();
+	physics->cluster_transforms[cluster] = transform;
+	transform_t* rest = &physics->cluster_rest_transforms[cluster];
+	if (transform) {
+		*rest = *transform;
+		rest->translation = vec3fSub(transform->translation, center);
+	} else {
+		transformIdentity(rest);
+	}
+	return cluster;
+}
+
+void physicsClusterSetTransform(physics_t* physics, int cluster, transform_t* transform) {
+	physics->cluster_transforms[cluster] = transform;
+}
+
+int physicsStaticMeshAdd(physics_t* physics, const gpu_mesh_info_t* mesh, const transform_t* transform) {
+	if (physics->static_mesh_count == physics->static_mesh_capacity) {
+		int capacity = __max(8, physics->static_mesh_capacity * 2);
+		physics->static_meshes = physicsGrow(physics->heap, physics->static_meshes, sizeof(mesh_bvh_t*), physics->static_mesh_count, capacity);
+		physics->static_mesh_capacity = capacity;
+	}
+	physics->static_meshes[physics->static_mesh_count] = meshBvhCreate(physics->heap, mesh, transform);
+	return physics->static_mesh_count++;
+}
+
+int physicsGetConstraintCount(physics_t* physics) {
+	int contact_count = 0;
+	for (int x = 0; x < physics->contact_particle_count; x++) {
+		contact_count += physics->contact_counts[x];
+	}
+	int count = contact_count + physics->cluster_count;
+	for (int type = 0; type < PHYSICS_CONSTRAINT_TYPE_COUNT; type++) {
+		count += physics->tables[type].count;
+	}
+	return count;
+}
+
+// Lists the particles of a Jacobi table, so the reduce only visits the particles the table can move.
+static void physicsJacobiParticles(physics_t* physics, physics_table_t* table) {
+	heapFree(physics->heap, table->jacobi_particles);
+	table->jacobi_particles = NULL;
+	table->jacobi_particle_count = 0;
+	if (!table->jacobi) {
+		return;
+	}
+
+	bool* used = heapAlloc(physics->heap, sizeof(bool) * __max(physics->particle_count, 1), 8);
+	memset(used, 0, sizeof(bool) * physics->particle_count);
+	int count = 0;
+	for (int x = 0; x < table->count * table->arity; x++) {
+		count += !used[table->particles[x]];
+		used[table->particles[x]] = true;
+	}
+	table->jacobi_particles = heapAlloc(physics->heap, sizeof(int) * __max(count, 1), 8);
+	for (int x = 0; x < physics->particle_count; x++) {
+		if (used[x]) {
+			table->jacobi_particles[table->jacobi_particle_count++] = x;
+		}
+	}
+	heapFree(physics->heap, used);
+}
+
+static void physicsColorTable(physics_t* physics, physics_table_t* table) {
+	if (table->jacobi) {
+		// Jacobi needs no colors, the whole table is one batch
+		table->batch_offsets[0] = 0;
+		for (int color = 1; color <= PHYSICS_MAX_COLORS; color++) {
+			table->batch_offsets[color] = table->count;
+		}
+	} else {
+		int* perm = heapAlloc(physics->heap, sizeof(int) * __max(table->count, 1), 8);
+		physicsColorConstraints(physics, table->particles, table->arity, table->count, perm, table->batch_offsets);
+
+		// store the table in solve order so every batch is a contiguous range
+		physicsTablePermute(physics, table, perm);
+		heapFree(physics->heap, perm);
+	}
+	physicsJacobiParticles(physics, table);
+	table->dirty = false;
+
+	// the coloring mixes awake and sleeping constraints again
+	memcpy(table->batch_awake_ends, table->batch_offsets + 1, sizeof(table->batch_awake_ends));
+	physics->sleep_dirty = true;
+}
+
+//  --------------------------------------------------------------------------
+//								    SOLVER
+//
+
+static void physicsIntegrateJob(void* user, int begin, int end, int worker) {
+	physics_t* physics = user;
+	const float h = physics->substep_dt;
+	const vec3f_t gravity_dt = vec3fScale(physics->gravity, h);
+	for (int x = begin; x < end; x++) {
+		if (physics->inv_masses[x] == 0.0f || physics->asleep[x]) {
+			continue;
+		}
+		physics->velocities[x] = vec3fAdd(physics->velocities[x], gravity_dt);
+		physics->prev_positions[x] = physics->positions[x];
+		physics->positions[x] = vec3fAdd(physics->positions[x], vec3fScale(physics->velocities[x], h));
+	}
+}
+
+static void physicsUpdateVelocitiesJob(void* user, int begin, int end, int worker) {
+	physics_t* physics = user;
+	const float inv_h = 1.0f / physics->substep_dt;
+	for (int x = begin; x < end; x++) {
+		if (physics->inv_masses[x] == 0.0f || physics->asleep[x]) {
+			continue;
+		}
+		physics->velocities[x] = vec3fScale(vec3fSub(physics->positions[x], physics->prev_positions[x]), inv_h);
+	}
+}
+
+// Moves a particle, or adds the move to the delta buffer of the worker in Jacobi mode.
+static inline void physicsMoveParticle(const physics_batch_job_t* job, int worker, int particle, vec3f_t delta) {
+	physics_t* physics = job->physics;
+	if (job->jacobi) {
+		physics_delta_t* slot = physics->deltas + (size_t) worker * physics->delta_capacity + particle;
+		slot->delta = vec3fAdd(slot->delta, delta);
+		slot->count++;
+	} else {
+		physics->positions[particle] = vec3fAdd(physics->positions[particle], delta);
+	}
+}
+
+static inline void physicsSolveDistance(const physics_batch_job_t* job, int worker, float inv_h2, int x) {
+	const physics_table_t* table = job->table;
+	const vec3f_t* positions = job->physics->positions;
+	const float* inv_masses = job->physics->inv_masses;
+	const int a = table->particles[x * 2 + 0];
+	const int b = table->particles[x * 2 + 1];
+	const float w = inv_masses[a] + inv_masses[b];
+	const float alpha = table->compliance[x] * inv_h2;
+	if (w + alpha == 0.0f) {
+		return;
+	}
+
+	vec3f_t delta = vec3fSub(positions[a], positions[b]);
+	float length = vec3fMagnitude(delta);
+	if (length < FLT_EPSILON) {
+		return;
+	}
+	vec3f_t normal = vec3fScale(delta, 1.0f / length);
+
+	// XPBD: dlambda = (-C - alpha * lambda) / (w + alpha)
+	float c = length - table->rest[x];
+	float dlambda = (-c - alpha * table->lambda[x]) / (w + alpha);
+	table->lambda[x] += dlambda;
+
+	physicsMoveParticle(job, worker, a, vec3fScale(normal, dlambda * inv_masses[a]));
+	physicsMoveParticle(job, worker, b, vec3fScale(normal, -dlambda * inv_masses[b]));
+}
+
+static void physicsSolveDistanceJob(void* user, int begin, int end, int worker) {
+	physics_batch_job_t* job = user;
+	physics_t* physics = job->physics;
+	physics_table_t* table = job->table;
+	vec3f_t* positions = physics->positions;
+	const float* inv_masses = physics->inv_masses;
+	const float inv_h2 = 1.0f / (physics->substep_dt * physics->substep_dt);
+	int x = job->offset + begin;
+
+#if VEC3F_XN_WIDTH
+	// same math as physicsSolveDistance, skipped constraints get a dlambda of 0
+	const float_xn_t zero = floatxnZero();
+	const float_xn_t epsilon = floatxnSplat(FLT_EPSILON);
+	const float_xn_t inv_h2_xn = floatxnSplat(inv_h2);
+	for (; job->wide && x + VEC3F_XN_WIDTH <= job->offset + end; x += VEC3F_XN_WIDTH) {
+		int a[VEC3F_XN_WIDTH], b[VEC3F_XN_WIDTH];
+		for (int lane = 0; lane < VEC3F_XN_WIDTH; lane++) {
+			a[lane] = table->particles[(x + lane) * 2 + 0];
+			b[lane] = table->particles[(x + lane) * 2 + 1];
+		}
+		vec3f_xn_t pos_a = vec3fxnGather(positions, a);
+		vec3f_xn_t pos_b = vec3fxnGather(positions, b);
+		float_xn_t inv_mass_a = floatxnGather(inv_masses, a);
+		float_xn_t inv_mass_b = floatxnGather(inv_masses, b);
+
+		float_xn_t alpha = floatxnMul(floatxnLoad(table->compliance + x), inv_h2_xn);
+		float_xn_t denom = floatxnAdd(floatxnAdd(inv_mass_a, inv_mass_b), alpha);
+		vec3f_xn_t delta = vec3fxnSub(pos_a, pos_b);
+		float_xn_t length = vec3fxnMagnitude(delta);
+		float_xn_t solve = floatxnSelect(floatxnCmpGe(length, epsilon), floatxnCmpGe(denom, floatxnSplat(FLT_MIN)), zero);
+		length = floatxnSelect(solve, length, floatxnSplat(1.0f));
+		denom = floatxnSelect(solve, denom, floatxnSplat(1.0f));
+		vec3f_xn_t normal = vec3fxnScale(delta, floatxnDiv(floatxnSplat(1.0f), length));
+
+		float_xn_t lambda = floatxnLoad(table->lambda + x);
+		float_xn_t c = floatxnSub(length, floatxnLoad(table->rest + x));
+		float_xn_t dlambda = floatxnDiv(floatxnSub(floatxnSub(zero, c), floatxnMul(alpha, lambda)), denom);
+		dlambda = floatxnSelect(solve, dlambda, zero);
+		floatxnStore(table->lambda + x, floatxnAdd(lambda, dlambda));
+
+		vec3fxnScatter(positions, a, vec3fxnAdd(pos_a, vec3fxnScale(normal, floatxnMul(dlambda, inv_mass_a))));
+		vec3fxnScatter(positions, b, vec3fxnSub(pos_b, vec3fxnScale(normal, floatxnMul(dlambda, inv_mass_b))));
+	}
+#endif
+
+	for (; x < job->offset + end; x++) {
+		physicsSolveDistance(job, worker, inv_h2, x);
+	}
+}
+
+// One XPBD step of a scalar constraint of 4 particles with value c and the given gradients.
+static inline void physicsSolveRow4(const physics_batch_job_t* job, int worker, const int* particles, const vec3f_t* gradients, float c, float alpha, float* lambda) {
+	const float* inv_masses = job->physics->inv_masses;
+	float w = 0.0f;
+	for (int k = 0; k < 4; k++) {
+		w += inv_masses[particles[k]] * vec3fMagnitudeSqrd(gradients[k]);
+	}
+	if (w + alpha == 0.0f) {
+		return;
+	}
+
+	// XPBD: dlambda = (-C - alpha * lambda) / (sum w_i |grad_i|^2 + alpha)
+	float dlambda = (-c - alpha * *lambda) / (w + alpha);
+	*lambda += dlambda;
+	for (int k = 0; k < 4; k++) {
+		physicsMoveParticle(job, worker, particles[k], vec3fScale(gradients[k], dlambda * inv_masses[particles[k]]));
+	}
+}
+
+// C = V - V0 with V = (x1 - x0) x (x2 - x0) . (x3 - x0) / 6.
+static void physicsSolveVolumeJob(void* user, int begin, int end, int worker) {
+	physics_batch_job_t* job = user;
+	physics_t* physics = job->physics;
+	physics_table_t* table = job->table;
+	vec3f_t* positions = physics->positions;
+	const float inv_h2 = 1.0f / (physics->substep_dt * physics->substep_dt);
+	for (int x = job->offset + begin; x < job->offset + end; x++) {
+		const int* p = table->particles + x * 4;
+		vec3f_t e1 = vec3fSub(positions[p[1]], positions[p[0]]);
+		vec3f_t e2 = vec3fSub(positions[p[2]], positions[p[0]]);
+		vec3f_t e3 = vec3fSub(positions[p[3]], positions[p[0]]);
+
+		vec3f_t gradients[4];
+		gradients[1] = vec3fScale(vec3fCross(e2, e3), 1.0f / 6.0f);
+		gradients[2] = vec3fScale(vec3fCross(e3, e1), 1.0f / 6.0f);
+		gradients[3] = vec3fScale(vec3fCross(e1, e2), 1.0f / 6.0f);
+		gradients[0] = vec3fNeg(vec3fAdd(vec3fAdd(gradients[1], gradients[2]), gradients[3]));
+		float volume = vec3fDot(gradients[3], e3);
+
+		physicsSolveRow4(job, worker, p, gradients, volume - table->rest[x], table->compliance[x] * inv_h2, &table->lambda[x]);
+	}
+}
+
+// The angle between the two triangles (x0, x1, x2) and (x1, x0, x3) around their shared edge x0 x1,
+// 0 when they are flat, with its gradients (Bridson et al. 2003), which stay finite when flat.
+static float physicsDihedralAngle(const vec3f_t* positions, const int* particles, vec3f_t* gradients) {
+	vec3f_t x0 = positions[particles[0]];
+	vec3f_t x1 = positions[particles[1]];
+	vec3f_t x2 = positions[particles[2]];
+	vec3f_t x3 = positions[particles[3]];
+	vec3f_t edge = vec3fSub(x1, x0);
+	vec3f_t normal1 = vec3fCross(vec3fSub(x2, x0), vec3fSub(x2, x1));
+	vec3f_t normal2 = vec3fCross(vec3fSub(x3, x1), vec3fSub(x3, x0));
+	float edge_length = vec3fMagnitude(edge);
+	float normal1_sqrd = vec3fMagnitudeSqrd(normal1);
+	float normal2_sqrd = vec3fMagnitudeSqrd(normal2);
+	if (edge_length < FLT_EPSILON || normal1_sqrd < FLT_MIN || normal2_sqrd < FLT_MIN) {
+		memset(gradients, 0, sizeof(vec3f_t) * 4);
+		return 0.0f;
+	}
+
+	vec3f_t mode1 = vec3fScale(normal1, -1.0f / normal1_sqrd);
+	vec3f_t mode2 = vec3fScale(normal2, -1.0f / normal2_sqrd);
+	float inv_edge_length = 1.0f / edge_length;
+	gradients[0] = vec3fAdd(vec3fScale(mode1, vec3fDot(vec3fSub(x2, x1), edge) * inv_edge_length), vec3fScale(mode2, vec3fDot(vec3fSub(x3, x1), edge) * inv_edge_length));
+	gradients[1] = vec3fNeg(vec3fAdd(vec3fScale(mode1, vec3fDot(vec3fSub(x2, x0), edge) * inv_edge_length), vec3fScale(mode2, vec3fDot(vec3fSub(x3, x0), edge) * inv_edge_length)));
+	gradients[2] = vec3fScale(mode1, edge_length);
+	gradients[3] = vec3fScale(mode2, edge_length);
+	return atan2f(vec3fDot(vec3fCross(normal1, normal2), edge) * inv_edge_length, vec3fDot(normal1, normal2));
+}
+
+// C = angle - rest angle, wrapped so the triangles take the short way back.
+static void physicsSolveBendingJob(void* user, int begin, int end, int worker) {
+	physics_batch_job_t* job = user;
+	physics_t* physics = job->physics;
+	physics_table_t* table = job->table;
+	const float inv_h2 = 1.0f / (physics->substep_dt * physics->substep_dt);
+	for (int x = job->offset + begin; x < job->offset + end; x++) {
+		const int* p = table->particles + x * 4;
+		vec3f_t gradients[4];
+		float c = physicsDihedralAngle(physics->positions, p, gradients) - table->rest[x];
+		if (c > PHYSICS_PI) {
+			c -= 2.0f * PHYSICS_PI;
+		} else if (c < -PHYSICS_PI) {
+			c += 2.0f * PHYSICS_PI;
+		}
+		physicsSolveRow4(job, worker, p, gradients, c, table->compliance[x] * inv_h2, &table->lambda[x]);
+	}
+}
+
+// Stable Neo-Hookean (Macklin and Mueller 2021) as two rows with F = [x1 - x0, x2 - x0, x3 - x0] * rest^-1:
+// deviatoric C = |F| (Frobenius) and hydrostatic C = det(F) - gamma, solved one after the other.
+static void physicsSolveNeoHookeanJob(void* user, int begin, int end, int worker) {
+	physics_batch_job_t* job = user;
+	physics_t* physics = job->physics;
+	physics_table_t* table = job->table;
+	vec3f_t* positions = physics->positions;
+	const float inv_h2 = 1.0f / (physics->substep_dt * physics->substep_dt);
+	for (int x = job->offset + begin; x < job->offset + end; x++) {
+		const int* p = table->particles + x * 4;
+		const float* inv_rest = table->rest + x * 10;
+		for (int row = 0; row < 2; row++) {
+			vec3f_t edges[3] = {
+				vec3fSub(positions[p[1]], positions[p[0]]),
+				vec3fSub(positions[p[2]], positions[p[0]]),
+				vec3fSub(positions[p[3]], positions[p[0]]),
+			};
+
+			// columns of F
+			vec3f_t f[3];
+			for (int col = 0; col < 3; col++) {
+				f[col] = vec3fAdd(vec3fAdd(vec3fScale(edges[0], inv_rest[0 * 3 + col]), vec3fScale(edges[1], inv_rest[1 * 3 + col])), vec3fScale(edges[2], inv_rest[2 * 3 + col]));
+			}
+
+			// columns of dC/dF
+			float c;
+			vec3f_t dc[3];
+			if (row == 0) {
+				c = sqrtf(vec3fMagnitudeSqrd(f[0]) + vec3fMagnitudeSqrd(f[1]) + vec3fMagnitudeSqrd(f[2]));
+				if (c < FLT_EPSILON) {
+					continue;
+				}
+				for (int col = 0; col < 3; col++) {
+					dc[col] = vec3fScale(f[col], 1.0f / c);
+				}
+			} else {
+				dc[0] = vec3fCross(f[1], f[2]);
+				dc[1] = vec3fCross(f[2], f[0]);
+				dc[2] = vec3fCross(f[0], f[1]);
+				c = vec3fDot(f[0], dc[0]) - inv_rest[9];
+			}
+
+			// dC/dx_i = dC/dF * rest^-T, x0 moves against the others
+			vec3f_t gradients[4];
+			for (int k = 0; k < 3; k++) {
+				gradients[k + 1] = vec3fAdd(vec3fAdd(vec3fScale(dc[0], inv_rest[k * 3 + 0]), vec3fScale(dc[1], inv_rest[k * 3 + 1])), vec3fScale(dc[2], inv_rest[k * 3 + 2]));
+			}
+			gradients[0] = vec3fNeg(vec3fAdd(vec3fAdd(gradients[1], gradients[2]), gradients[3]));
+
+			physicsSolveRow4(job, worker, p, gradients, c, table->compliance[x * 2 + row] * inv_h2, &table->lambda[x * 2 + row]);
+		}
+	}
+}
+
+static inline quatf_t physicsQuatNormalize(quatf_t q) {
+	float scale = 1.0f / sqrtf(q.s * q.s + q.x * q.x + q.y * q.y + q.z * q.z);
+	return (quatf_t) { .s = q.s * scale, .x = q.x * scale, .y = q.y * scale, .z = q.z * scale };
+}
+
+// Shape matching (Mueller et al. 2005): the particles are pulled towards their rest shape moved by the
+// rotation and translation that fit their current positions best. The rotation is the rotational part
+// of the covariance A = sum m (x - c) q^T, found by rotating the last one until its axes line up with
+// the columns of A (Mueller et al. 2016), which needs no eigen or singular value decomposition.
+static void physicsSolveClustersJob(void* user, int begin, int end, int worker) {
+	physics_t* physics = user;
+	vec3f_t* positions = physics->positions;
+	const float* inv_masses = physics->inv_masses;
+	for (int cluster = begin; cluster < end; cluster++) {
+		const int first = physics->cluster_offsets[cluster];
+		const int last = physics->cluster_offsets[cluster + 1];
+		const int* particles = physics->cluster_particles;
+		const vec3f_t* rest = physics->cluster_rest;
+
+		// the moving particles of a cluster are one island, they all sleep or none does
+		bool awake = false;
+		for (int x = first; x < last && !awake; x++) {
+			awake = inv_masses[particles[x]] != 0.0f && !physics->asleep[particles[x]];
+		}
+		if (!awake) {
+			continue;
+		}
+
+		float mass = 0.0f;
+		vec3f_t center = vec3fZero();
+		for (int x = first; x < last; x++) {
+			float particle_mass = physicsClusterMass(inv_masses[particles[x]]);
+			mass += particle_mass;
+			center = vec3fAdd(center, vec3fScale(positions[particles[x]], particle_mass));
+		}
+		center = vec3fScale(center, 1.0f / mass);
+
+		// columns of the covariance
+		vec3f_t columns[3] = { vec3fZero(), vec3fZero(), vec3fZero() };
+		for (int x = first; x < last; x++) {
+			float particle_mass = physicsClusterMass(inv_masses[particles[x]]);
+			vec3f_t offset = vec3fScale(vec3fSub(positions[particles[x]], center), particle_mass);
+			columns[0] = vec3fAdd(columns[0], vec3fScale(offset, rest[x].x));
+			columns[1] = vec3fAdd(columns[1], vec3fScale(offset, rest[x].y));
+			columns[2] = vec3fAdd(columns[2], vec3fScale(offset, rest[x].z));
+		}
+
+		quatf_t rotation = physics->cluster_rotations[cluster];
+		for (int iteration = 0; iteration < PHYSICS_CLUSTER_ITERATIONS; iteration++) {
+			vec3f_t axes[3] = { quatfRotateVec(rotation, vec3fX()), quatfRotateVec(rotation, vec3fY()), quatfRotateVec(rotation, vec3fZ()) };
+			vec3f_t torque = vec3fAdd(vec3fAdd(vec3fCross(axes[0], columns[0]), vec3fCross(axes[1], columns[1])), vec3fCross(axes[2], columns[2]));
+			float alignment = fabsf(vec3fDot(axes[0], columns[0]) + vec3fDot(axes[1], columns[1]) + vec3fDot(axes[2], columns[2]));
+			vec3f_t omega = vec3fScale(torque, 1.0f / (alignment + 1e-9f));
+			float angle = vec3fMagnitude(omega);
+			if (angle < 1e-9f) {
+				break;
+			}
+			float half_sin = sinf(angle * 0.5f) / angle;
+			quatf_t step = { .s = cosf(angle * 0.5f), .x = omega.x * half_sin, .y = omega.y * half_sin, .z = omega.z * half_sin };
+			rotation = physicsQuatNormalize(quatfMul(step, rotation));
+		}
+		physics->cluster_rotations[cluster] = rotation;
+		physics->cluster_centers[cluster] = center;
+
+		// the stiffness is per update, so the result does not depend on the substeps
+		float stiffness = 1.0f - powf(1.0f - physics->cluster_stiffness[cluster], 1.0f / physics->substeps);
+		for (int x = first; x < last; x++) {
+			int particle = particles[x];
+			if (inv_masses[particle] == 0.0f) {
+				continue;
+			}
+			vec3f_t goal = vec3fAdd(center, quatfRotateVec(rotation, rest[x]));
+			positions[particle] = vec3fAdd(positions[particle], vec3fScale(vec3fSub(goal, positions[particle]), stiffness));
+		}
+	}
+}
+
+// Writes the body transform of every cluster: the rest transform moved by the fit of the last solve.
+static void physicsClusterTransformsJob(void* user, int begin, int end, int worker) {
+	physics_t* physics = user;
+	for (int cluster = begin; cluster < end; cluster++) {
+		transform_t* transform = physics->cluster_transforms[cluster];
+		if (!transform) {
+			continue;
+		}
+		const transform_t* rest = &physics->cluster_rest_transforms[cluster];
+		quatf_t rotation = physics->cluster_rotations[cluster];
+		transform->translation = vec3fAdd(physics->cluster_centers[cluster], quatfRotateVec(rotation, rest->translation));
+		transform->rotation = quatfMul(rotation, rest->rotation);
+	}
+}
+
+// Sweeps every particle from where it started the substep to where the solve put it against the static
+// meshes. The first contact becomes a rigid contact constraint at the time of impact: the particle has to
+// stay radius in front of the contact point along the contact normal. It is the only particle of the
+// constraint, so it moves by all of -C. The corrected path is swept again, a particle pushed along one
+// triangle is still stopped by the next.
+static void physicsSolveMeshContactsJob(void* user, int begin, int end, int worker) {
+	physics_t* physics = user;
+	const float radius = physics->particle_radius + PHYSICS_CCD_SKIN;
+	for (int x = begin; x < end; x++) {
+		if (physics->inv_masses[x] == 0.0f || physics->asleep[x]) {
+			continue;
+		}
+		for (int iteration = 0; iteration < PHYSICS_CCD_ITERATIONS; iteration++) {
+			mesh_bvh_hit_t hit = { .time = 2.0f };
+			for (int mesh = 0; mesh < physics->static_mesh_count; mesh++) {
+				mesh_bvh_hit_t mesh_hit;
+				if (meshBvhSweepSphere(physics->static_meshes[mesh], physics->prev_positions[x], physics->positions[x], radius, &mesh_hit) && mesh_hit.time < hit.time) {
+					hit = mesh_hit;
+				}
+			}
+			if (hit.time > 1.0f) {
+				break;
+			}
+			float c = vec3fDot(vec3fSub(physics->positions[x], hit.point), hit.normal) - radius;
+			if (c >= 0.0f) {
+				break;
+			}
+			physics->positions[x] = vec3fSub(physics->positions[x], vec3fScale(hit.normal, c));
+		}
+	}
+}
+
+// Finds the contacts of every moving particle, pinned particles are only pushed against. Sleeping particles
+// keep the contacts they fell asleep with, which hold their island together.
+static void physicsFindContactsJob(void* user, int begin, int end, int worker) {
+	physics_t* physics = user;
+	const float diameter = physics->particle_radius * 2.0f;
+	int found[PHYSICS_MAX_CONTACTS + 1];
+	for (int x = begin; x < end; x++) {
+		physics->contact_positions[x] = physics->positions[x];
+		if (physics->asleep[x] && x < physics->contact_particle_count) {
+			continue;
+		}
+		int* contacts = physics->contacts + x * PHYSICS_MAX_CONTACTS;
+		int contact_count = 0;
+		if (physics->inv_masses[x] != 0.0f && !physics->asleep[x]) {
+			// the particle finds itself too
+			int found_count = __min(spatialHashQuery(physics->hash, physics->positions[x], diameter, found, _countof(found)), _countof(found));
+			for (int k = 0; k < found_count && contact_count < PHYSICS_MAX_CONTACTS; k++) {
+				if (found[k] != x) {
+					contacts[contact_count++] = found[k];
+				}
+			}
+		}
+		physics->contact_counts[x] = contact_count;
+	}
+}
+
+// Jacobi solve, every particle only moves itself by its share of each contact (averaged over its
+// contacts) and reads the positions the contacts were found at, so particles run in parallel.
+static void physicsSolveContactsJob(void* user, int begin, int end, int worker) {
+	physics_t* physics = user;
+	const vec3f_t* contact_positions = physics->contact_positions;
+	const float* inv_masses = physics->inv_masses;
+	const float diameter = physics->particle_radius * 2.0f;
+	const float alpha = physics->contact_compliance / (physics->substep_dt * physics->substep_dt);
+	for (int x = begin; x < end; x++) {
+		if (physics->asleep[x]) {
+			continue;
+		}
+		const int* contacts = physics->contacts + x * PHYSICS_MAX_CONTACTS;
+		const float inv_mass = inv_masses[x];
+		vec3f_t correction = vec3fZero();
+		int active = 0;
+		for (int k = 0; k < physics->contact_counts[x]; k++) {
+			vec3f_t delta = vec3fSub(contact_positions[x], contact_positions[contacts[k]]);
+			float length = vec3fMagnitude(delta);
+			float c = length - diameter;
+			if (c >= 0.0f || length < FLT_EPSILON) {
+				continue;
+			}
+
+			// XPBD: dlambda = -C / (w + alpha), lambda starts from zero every substep
+			float dlambda = -c / (inv_mass + inv_masses[contacts[k]] + alpha);
+			correction = vec3fAdd(correction, vec3fScale(delta, dlambda * inv_mass / length));
+			active++;
+		}
+		if (active) {
+			physics->positions[x] = vec3fAdd(contact_positions[x], vec3fScale(correction, 1.0f / active));
+		}
+	}
+}
+
+static void physicsSolveContacts(physics_t* physics) {
+	if (physics->contact_capacity < physics->particle_capacity) {
+		// sleeping particles keep the contacts of the last search, they have to survive the growth
+		heap_t* heap = physics->heap;
+		int count = physics->contact_particle_count;
+		physics->contact_capacity = physics->particle_capacity;
+		physics->contacts = physicsGrow(heap, physics->contacts, sizeof(int) * PHYSICS_MAX_CONTACTS, count, physics->contact_capacity);
+		physics->contact_counts = physicsGrow(heap, physics->contact_counts, sizeof(int), count, physics->contact_capacity);
+		physics->contact_positions = physicsGrow(heap, physics->contact_positions, sizeof(vec3f_t), 0, physics->contact_capacity);
+	}
+
+	// cells as large as a particle diameter, so every contact is in a neighboring cell
+	spatialHashBuild(physics->hash, physics->positions, physics->particle_count, physics->particle_radius * 2.0f, physics->pool);
+	jobPoolParallelFor(physics->pool, physics->particle_count, PHYSICS_PARTICLE_CHUNK, physicsFindContactsJob, physics);
+	jobPoolParallelFor(physics->pool, physics->particle_count, PHYSICS_PARTICLE_CHUNK, physicsSolveContactsJob, physics);
+	physics->contact_particle_count = physics->particle_count;
+}
+
+// Runs the solve of a Jacobi table on the constraints of every slice, the slice picks the delta buffer.
+static void physicsJacobiSliceJob(void* user, int begin, int end, int worker) {
+	physics_jacobi_job_t* job = user;
+	for (int slice = begin; slice < end; slice++) {
+		int slice_begin = (int) ((int64_t) job->count * slice / job->slice_count);
+		int slice_end = (int) ((int64_t) job->count * (slice + 1) / job->slice_count);
+		job->batch.table->solve(&job->batch, slice_begin, slice_end, slice);
+	}
+}
+
+// Sums the delta buffers in slice order, so the result does not depend on the threads, and clears them.
+// Only the particles of the table can have corrections.
+static void physicsJacobiReduceJob(void* user, int begin, int end, int worker) {
+	physics_jacobi_job_t* job = user;
+	physics_t* physics = job->batch.physics;
+	const int* particles = job->batch.table->jacobi_particles;
+	for (int p = begin; p < end; p++) {
+		int x = particles[p];
+		vec3f_t delta = vec3fZero();
+		int count = 0;
+		for (int buffer = 0; buffer < physics->delta_buffer_count; buffer++) {
+			physics_delta_t* slot = physics->deltas + (size_t) buffer * physics->delta_capacity + x;
+			delta = vec3fAdd(delta, slot->delta);
+			count += slot->count;
+			*slot = (physics_delta_t) { 0 };
+		}
+		if (count > 0) {
+			physics->positions[x] = vec3fAdd(physics->positions[x], vec3fScale(delta, 1.0f / count));
+		}
+	}
+}
+
+static void physicsSolveTableJacobi(physics_t* physics, physics_table_t* table) {
+	int count = table->batch_awake_ends[0];
+	if (count == 0) {
+		return;
+	}
+
+	int buffer_count = jobPoolGetWorkerCount(physics->pool);
+	if (buffer_count != physics->delta_buffer_count || physics->particle_count > physics->delta_capacity) {
+		heapFree(physics->heap, physics->deltas);
+		physics->delta_buffer_count = buffer_count;
+		physics->delta_capacity = physics->particle_capacity;
+		size_t size = sizeof(physics_delta_t) * buffer_count * physics->delta_capacity;
+		physics->deltas = heapAlloc(physics->heap, size, 16);
+		memset(physics->deltas, 0, size);
+	}
+
+	physics_jacobi_job_t job = {
+		.batch = { .physics = physics, .table = table, .offset = 0, .jacobi = true },
+		.count = count,
+		.slice_count = buffer_count,
+	};
+	jobPoolParallelFor(physics->pool, buffer_count, 1, physicsJacobiSliceJob, &job);
+	jobPoolParallelFor(physics->pool, table->jacobi_particle_count, PHYSICS_PARTICLE_CHUNK, physicsJacobiReduceJob, &job);
+}
+
+static void physicsSolveTable(physics_t* physics, physics_table_t* table) {
+	if (table->jacobi) {
+		physicsSolveTableJacobi(physics, table);
+		return;
+	}
+	for (int color = 0; color < PHYSICS_MAX_COLORS; color++) {
+		int begin = table->batch_offsets[color];
+		int count = table->batch_awake_ends[color] - begin;
+		if (count == 0) {
+			continue;
+		}
+		// the overflow color shares particles between constraints, solve it on one thread, one at a time
+		bool overflow = color == PHYSICS_MAX_COLORS - 1;
+		physics_batch_job_t job = {
+			.physics = physics,
+			.table = table,
+			.offset = begin,
+			.wide = !overflow && table == &physics->tables[PHYSICS_CONSTRAINT_DISTANCE],
+		};
+		job_pool_t* pool = overflow ? NULL : physics->pool;
+		jobPoolParallelFor(pool, count, PHYSICS_CONSTRAINT_CHUNK, table->solve, &job);
+	}
+}
+
+void physicsUpdate(physics_t* physics, float dt) {
+	if (physics->reorder_interval && physics->reorder_countdown-- == 0) {
+		physicsReorder(physics);
+		physics->reorder_countdown = physics->reorder_interval - 1;
+	}
+	for (int type = 0; type < PHYSICS_CONSTRAINT_TYPE_COUNT; type++) {
+		if (physics->tables[type].dirty) {
+			physicsColorTable(physics, &physics->tables[type]);
+		}
+	}
+	if (physics->sleep_energy > 0.0f) {
+		physicsUpdateIslands(physics);
+		if (physics->sleep_dirty) {
+			physicsPartitionAwake(physics);
+		}
+	}
+
+	physics->substep_dt = dt / physics->substeps;
+	for (int step = 0; step < physics->substeps; step++) {
+		jobPoolParallelFor(physics->pool, physics->particle_count, PHYSICS_PARTICLE_CHUNK, physicsIntegrateJob, physics);
+
+		if (physics->particle_radius > 0.0f) {
+			physicsSolveContacts(physics);
+		}
+
+		// one iteration per substep, so lambda starts from zero every substep
+		for (int type = 0; type < PHYSICS_CONSTRAINT_TYPE_COUNT; type++) {
+			physics_table_t* table = &physics->tables[type];
+			for (int x = 0; x < table->count * table->rows; x++) {
+				table->lambda[x] = 0.0f;
+			}
+			physicsSolveTable(physics, table);
+		}
+		jobPoolParallelFor(physics->pool, physics->cluster_count, PHYSICS_CLUSTER_CHUNK, physicsSolveClustersJob, physics);
+		if (physics->static_mesh_count > 0) {
+			jobPoolParallelFor(physics->pool, physics->particle_count, PHYSICS_PARTICLE_CHUNK, physicsSolveMeshContactsJob, physics);
+		}
+
+		jobPoolParallelFor(physics->pool, physics->particle_count, PHYSICS_PARTICLE_CHUNK, physicsUpdateVelocitiesJob, physics);
+	}
+
+	jobPoolParallelFor(physics->pool, physics->cluster_count, PHYSICS_CLUSTER_CHUNK, physicsClusterTransformsJob, physics);
+}
+
+//  --------------------------------------------------------------------------
+//								    ISLANDS
+//
+
+static int physicsIslandFind(int* parents, int x) {
+	while (parents[x] != x) {
+		parents[x] = parents[parents[x]];
+		x = parents[x];
+	}
+	return x;
+}
+
+// The lower root becomes the parent, so the islands only depend on the constraints and not on their order.
+static void physicsIslandUnion(int* parents, int a, int b) {
+	a = physicsIslandFind(parents, a);
+	b = physicsIslandFind(parents, b);
+	if (a != b) {
+		parents[__max(a, b)] = __min(a, b);
+	}
+}
+
+static void physicsWakeAll(physics_t* physics) {
+	for (int x = 0; x < physics->particle_count; x++) {
+		physics->calm_frames[x] = 0;
+	}
+}
+
+// Joins the constraint islands along the contacts of the last substep, then puts every island to sleep
+// that has been calm for sleep_frames updates. A sleeping island that touches an awake one becomes part
+// of it and wakes up with it.
+static void physicsUpdateIslands(physics_t* physics) {
+	const int count = physics->particle_count;
+	const float* inv_masses = physics->inv_masses;
+	int* roots = physics->island_roots;
+
+	// the constraints only add unions, a reorder renames the particles so they are joined again
+	if (physics->islands_dirty) {
+		for (int x = 0; x < count; x++) {
+			physics->island_parents[x] = x;
+		}
+		for (int type = 0; type < PHYSICS_CONSTRAINT_TYPE_COUNT; type++) {
+			const physics_table_t* table = &physics->tables[type];
+			for (int x = 0; x < table->count; x++) {
+				const int* particles = table->particles + x * table->arity;
+				int first = -1;
+				for (int k = 0; k < table->arity; k++) {
+					if (inv_masses[particles[k]] == 0.0f) {
+						continue;
+					}
+					if (first < 0) {
+						first = particles[k];
+					} else {
+						physicsIslandUnion(physics->island_parents, first, particles[k]);
+					}
+				}
+			}
+		}
+		for (int cluster = 0; cluster < physics->cluster_count; cluster++) {
+			int first = -1;
+			for (int x = physics->cluster_offsets[cluster]; x < physics->cluster_offsets[cluster + 1]; x++) {
+				int particle = physics->cluster_particles[x];
+				if (inv_masses[particle] == 0.0f) {
+					continue;
+				}
+				if (first < 0) {
+					first = particle;
+				} else {
+					physicsIslandUnion(physics->island_parents, first, particle);
+				}
+			}
+		}
+		physics->islands_dirty = false;
+	}
+
+	memcpy(roots, physics->island_parents, sizeof(int) * count);
+	for (int x = 0; x < physics->contact_particle_count; x++) {
+		const int* contacts = physics->contacts + x * PHYSICS_MAX_CONTACTS;
+		for (int k = 0; k < physics->contact_counts[x]; k++) {
+			if (inv_masses[contacts[k]] != 0.0f) {
+				physicsIslandUnion(roots, x, contacts[k]);
+			}
+		}
+	}
+
+	// an island is calm while none of its particles moves, it has been calm as long as its least calm particle
+	for (int x = 0; x < count; x++) {
+		roots[x] = physicsIslandFind(roots, x);
+		physics->island_energies[x] = 0.0f;
+		physics->island_calm_frames[x] = INT_MAX;
+	}
+	for (int x = 0; x < count; x++) {
+		if (inv_masses[x] == 0.0f) {
+			continue;
+		}
+		int root = roots[x];
+		float energy = 0.5f * vec3fMagnitudeSqrd(physics->velocities[x]);
+		physics->island_energies[root] = __max(physics->island_energies[root], energy);
+		physics->island_calm_frames[root] = __min(physics->island_calm_frames[root], physics->calm_frames[x]);
+	}
+	for (int x = 0; x < count; x++) {
+		if (roots[x] == x && physics->island_calm_frames[x] != INT_MAX) {
+			bool calm = physics->island_energies[x] < physics->sleep_energy;
+			physics->island_calm_frames[x] = calm ? __min(physics->island_calm_frames[x] + 1, physics->sleep_frames) : 0;
+		}
+	}
+
+	for (int x = 0; x < count; x++) {
+		if (inv_masses[x] == 0.0f) {
+			continue;
+		}
+		physics->calm_frames[x] = physics->island_calm_frames[roots[x]];
+		bool asleep = physics->calm_frames[x] >= physics->sleep_frames;
+		if (asleep != physics->asleep[x]) {
+			physics->asleep[x] = asleep;
+			physics->velocities[x] = vec3fZero();
+			physics->sleep_dirty = true;
+		}
+	}
+}
+
+// Moves the constraints of every batch that have an awake particle to its front, the solve stops at
+// batch_awake_ends. Keeps the order within both parts.
+static void physicsPartitionAwake(physics_t* physics) {
+	const float* inv_masses = physics->inv_masses;
+	const bool* asleep = physics->asleep;
+	for (int type = 0; type < PHYSICS_CONSTRAINT_TYPE_COUNT; type++) {
+		physics_table_t* table = &physics->tables[type];
+		int* perm = heapAlloc(physics->heap, sizeof(int) * __max(table->count, 1), 8);
+		for (int color = 0; color < PHYSICS_MAX_COLORS; color++) {
+			int cursor = table->batch_offsets[color];
+			for (int pass = 0; pass < 2; pass++) {
+				for (int x = table->batch_offsets[color]; x < table->batch_offsets[color + 1]; x++) {
+					const int* particles = table->particles + x * table->arity;
+					bool awake = false;
+					for (int k = 0; k < table->arity; k++) {
+						awake |= inv_masses[particles[k]] != 0.0f && !asleep[particles[k]];
+					}
+					if (awake == (pass == 0)) {
+						perm[cursor++] = x;
+					}
+				}
+				if (pass == 0) {
+					table->batch_awake_ends[color] = cursor;
+				}
+			}
+		}
+		physicsTablePermute(physics, table, perm);
+		heapFree(physics->heap, perm);
+	}
+	physics->sleep_dirty = false;
+}
+
+//  --------------------------------------------------------------------------
+//								    REORDER
+//
+
+static inline uint64_t physicsMortonExpand(uint32_t v) {
+	// spreads the low 10 bits of v so that there are 2 zero bits between them
+	v &= (1u << PHYSICS_MORTON_BITS) - 1;
+	v = (v | (v << 16)) & 0x030000ffu;
+	v = (v | (v << 8)) & 0x0300f00fu;
+	v = (v | (v << 4)) & 0x030c30c3u;
+	v = (v | (v << 2)) & 0x09249249u;
+	return v;
+}
+
+static void physicsMortonJob(void* user, int begin, int end, int worker) {
+	physics_morton_job_t* job = user;
+	const float max_cell = (float) ((1 << PHYSICS_MORTON_BITS) - 1);
+	for (int x = begin; x < end; x++) {
+		vec3f_t cell = vec3fScale(vec3fSub(job->physics->positions[x], job->min), job->scale);
+		uint32_t cell_x = (uint32_t) __min(__max(cell.x, 0.0f), max_cell);
+		uint32_t cell_y = (uint32_t) __min(__max(cell.y, 0.0f), max_cell);
+		uint32_t cell_z = (uint32_t) __min(__max(cell.z, 0.0f), max_cell);
+		job->keys[x] = physicsMortonExpand(cell_x) | (physicsMortonExpand(cell_y) << 1) | (physicsMortonExpand(cell_z) << 2);
+		job->values[x] = (uint32_t) x;
+	}
+}
+
+// Sorts the particles along a Morton curve through their bounds, so particles that are close in space
+// are close in memory, then sorts the constraints of every color by their particles so every
+// batch walks the particles in memory order. Ids stay valid through particle_slots.
+static void physicsReorder(physics_t* physics) {
+	heap_t* heap = physics->heap;
+	const int count = physics->particle_count;
+	if (count <= 1) {
+		return;
+	}
+
+	vec3f_t min = physics->positions[0];
+	vec3f_t max = physics->positions[0];
+	for (int x = 1; x < count; x++) {
+		min = vec3fMin(min, physics->positions[x]);
+		max = vec3fMax(max, physics->positions[x]);
+	}
+	vec3f_t extent = vec3fSub(max, min);
+	float max_extent = __max(__max(extent.x, extent.y), __max(extent.z, FLT_EPSILON));
+
+	int sort_count = count;
+	for (int type = 0; type < PHYSICS_CONSTRAINT_TYPE_COUNT; type++) {
+		sort_count = __max(sort_count, physics->tables[type].count);
+	}
+	uint64_t* keys = heapAlloc(heap, sizeof(uint64_t) * sort_count * 2, 16);
+	uint32_t* values = heapAlloc(heap, sizeof(uint32_t) * sort_count * 2, 16);
+	physics_morton_job_t job = {
+		.physics = physics,
+		.min = min,
+		.scale = (float) (1 << PHYSICS_MORTON_BITS) / max_extent,
+		.keys = keys,
+		.values = values,
+	};
+	jobPoolParallelFor(physics->pool, count, PHYSICS_PARTICLE_CHUNK, physicsMortonJob, &job);
+	sortRadix64Parallel(keys, values, keys + sort_count, values + sort_count, count, heap, physics->pool);
+
+	// values now map every new index to the old one
+	const int* perm = (const int*) values;
+	physicsPermute(heap, physics->positions, sizeof(vec3f_t), perm, count);
+	physicsPermute(heap, physics->prev_positions, sizeof(vec3f_t), perm, count);
+	physicsPermute(heap, physics->velocities, sizeof(vec3f_t), perm, count);
+	physicsPermute(heap, physics->inv_masses, sizeof(float), perm, count);
+	physicsPermute(heap, physics->particle_ids, sizeof(int), perm, count);
+	physicsPermute(heap, physics->calm_frames, sizeof(int), perm, count);
+	physicsPermute(heap, physics->asleep, sizeof(bool), perm, count);
+	for (int x = 0; x < count; x++) {
+		physics->particle_slots[physics->particle_ids[x]] = x;
+	}
+
+	// the old to new map goes to keys, which are no longer needed
+	int* remap = (int*) keys;
+	for (int x = 0; x < count; x++) {
+		remap[perm[x]] = x;
+	}
+
+	// sleeping particles keep their contacts, the islands are joined again with the next update
+	physics->islands_dirty = true;
+	if (physics->contact_particle_count == count) {
+		physicsPermute(heap, physics->contacts, sizeof(int) * PHYSICS_MAX_CONTACTS, perm, count);
+		physicsPermute(heap, physics->contact_counts, sizeof(int), perm, count);
+		for (int x = 0; x < count; x++) {
+			int* contacts = physics->contacts + x * PHYSICS_MAX_CONTACTS;
+			for (int k = 0; k < physics->contact_counts[x]; k++) {
+				contacts[k] = remap[contacts[k]];
+			}
+		}
+	} else {
+		physics->contact_particle_count = 0;
+	}
+
+	for (int type = 0; type < PHYSICS_CONSTRAINT_TYPE_COUNT; type++) {
+		physics_table_t* table = &physics->tables[type];
+		for (int x = 0; x < table->count * table->arity; x++) {
+			table->particles[x] = remap[table->particles[x]];
+		}
+	}
+	for (int x = 0; x < physics->cluster_particle_count; x++) {
+		physics->cluster_particles[x] = remap[physics->cluster_particles[x]];
+	}
+
+	// renaming the particles keeps the coloring valid, the constraints of every color are sorted by their
+	// lowest particle (a table that is colored again later is sorted as a whole)
+	for (int type = 0; type < PHYSICS_CONSTRAINT_TYPE_COUNT; type++) {
+		physics_table_t* table = &physics->tables[type];
+		for (int x = 0; x < table->count; x++) {
+			const int* particles = table->particles + x * table->arity;
+			int lowest = particles[0];
+			for (int k = 1; k < table->arity; k++) {
+				lowest = __min(lowest, particles[k]);
+			}
+			keys[x] = (uint32_t) lowest;
+			values[x] = (uint32_t) x;
+		}
+		for (int color = 0; color < PHYSICS_MAX_COLORS && !table->dirty; color++) {
+			for (int x = table->batch_offsets[color]; x < table->batch_offsets[color + 1]; x++) {
+				keys[x] |= (uint64_t) color << 32;
+			}
+		}
+		sortRadix64Parallel(keys, values, keys + sort_count, values + sort_count, table->count, heap, physics->pool);
+		physicsTablePermute(physics, table, perm);
+		if (!table->dirty) {
+			physicsJacobiParticles(physics, table);
+		}
+	}
+	physics->sleep_dirty = true;
+
+	heapFree(heap, values);
+	heapFree(heap, keys);
+}
+
+//  --------------------------------------------------------------------------
+//								     MISC
+//
+
+static void* physicsGrow(heap_t* heap, void* array, size_t element_size, int count, int capacity) {
+	void* grown = heapAlloc(heap, element_size * capacity, 16);
+	if (array) {
+		memcpy(grown, array, element_size * count);
+		heapFree(heap, array);
+	}
+	return grown;
+}
+
+// Reorders array so that array[x] = old_array[perm[x]].
+static void physicsTablePermute(physics_t* physics, physics_table_t* table, const int* perm) {
+	physicsPermute(physics->heap, table->particles, sizeof(int) * table->arity, perm, table->count);
+	physicsPermute(physics->heap, table->rest, sizeof(float) * table->rest_size, perm, table->count);
+	physicsPermute(physics->heap, table->compliance, sizeof(float) * table->rows, perm, table->count);
+	physicsPermute(physics->heap, table->lambda, sizeof(float) * table->rows, perm, table->count);
+}
+
+static void physicsPermute(heap_t* heap, void* array, size_t element_size, const int* perm, int count) {
+	if (count == 0) {
+		return;
+	}
+	char* temp = heapAlloc(heap, element_size * count, 16);
+	memcpy(temp, array, element_size * count);
+	for (int x = 0; x < count; x++) {
+		memcpy((char*) array + element_size * x, temp + element_size * perm[x], element_size);
+	}
+	heapFree(heap, temp);
+}
+
+// Greedy colors constraints (arity particles each) so that no two constraints in a color share a particle,
+// then counting sorts them by color. perm maps the sorted position to the original constraint and
+// batch_offsets[color] .. batch_offsets[color + 1] is the range of each color.
+static void physicsColorConstraints(physics_t* physics, const int* particles, int arity, int count, int* perm, int* batch_offsets) {
+	uint64_t* used = heapAlloc(physics->heap, sizeof(uint64_t) * __max(physics->particle_count, 1), 8);
+	uint8_t* colors = heapAlloc(physics->heap, __max(count, 1), 8);
+	memset(used, 0, sizeof(uint64_t) * physics->particle_count);
+	memset(batch_offsets, 0, sizeof(int) * (PHYSICS_MAX_COLORS + 1));
+
+	for (int x = 0; x < count; x++) {
+		uint64_t mask = 0;
+		for (int k = 0; k < arity; k++) {
+			mask |= used[particles[x * arity + k]];
+		}
+		int color = 0;
+		while (color < PHYSICS_MAX_COLORS - 1 && (mask & (1ULL << color))) {
+			color++;
+		}
+		if (color < PHYSICS_MAX_COLORS - 1) {
+			for (int k = 0; k < arity; k++) {
+				used[particles[x * arity + k]] |= 1ULL << color;
+			}
+		}
+		colors[x] = (uint8_t) color;
+		batch_offsets[color + 1]++;
+	}
+
+	for (int color = 0; color < PHYSICS_MAX_COLORS; color++) {
+		batch_offsets[color + 1] += batch_offsets[color];
+	}
+
+	int cursor[PHYSICS_MAX_COLORS];
+	memcpy(cursor, batch_offsets, sizeof(cursor));
+	for (int x = 0; x < count; x++) {
+		perm[cursor[colors[x]]++] = x;
+	}
+
+	heapFree(physics->heap, colors);
+	heapFree(physics->heap, used);
+}
@@ -1,17 +1,182 @@
 #ifndef __PHYSICS_H__
 #define __PHYSICS_H__
 
+#include "vec3f.h"
 
+#include <stdbool.h>
+
+/* XPBD PARTICLE PHYSICS
+*	- particles and constraints are stored as SoA tables, one table per constraint type (distance, tet
+*	  volume, dihedral bending, Neo-Hookean tets), every table keeps the compliance and lambda of its
+*	  constraints next to their particles and rest state and is colored into its own batches
+*	- each frame is split into substeps with one constraint iteration each (small steps XPBD)
+*	- constraints are greedy colored into batches that share no particles, every batch
+*	  is solved in parallel on the job pool
+*	- a constraint type can be solved with Jacobi iterations instead: the whole table is one batch
+*	  split into one slice per worker, every slice sums its position corrections into its own buffer
+*	  and the buffers are reduced in parallel per particle, which moves by the average of its
+*	  corrections. no atomics, no colors, and the load is balanced however the constraints connect
+*	- within a batch distance constraints are solved 8 (AVX) or 4 (SSE) at a time with the wide vector
+*	  types, gathering and scattering their particles
+*	- particle collisions rebuild a spatial hash every substep and generate contact constraints for
+*	  particles closer than twice their radius, contacts are solved per particle (Jacobi) in parallel
+*	- static triangle meshes are kept in a BVH each, at the end of every substep particles are swept as
+*	  spheres from their start to their end position against them and stopped at the first contact, so
+*	  fast particles do not tunnel through thin walls without more substeps
+*	- particles can be sorted by the Morton code of their position every few updates, so particles
+*	  that are close in space are close in memory, the constraints are sorted by their particles after
+*	- a particle keeps the index physicsParticleAdd returned as its id, whatever order it is stored in
+*	- rigid and soft bodies are shape matching clusters of particles: every substep the covariance of
+*	  a cluster gives its best fit rotation (polar decomposition by quaternion steps, warm started from
+*	  the last one) and translation, its particles are pulled towards the rest shape moved by them and
+*	  the body transform is written back after the update, e.g. to a transform_component_t
+*	- particles connected by constraints or touching each other form islands, an island that stays
+*	  at rest long enough falls asleep: its particles are not integrated and its constraints are moved
+*	  behind the awake ones of their batch and not solved until a contact or physicsParticleWake wakes it
+*/
 
 typedef struct physics_t physics_t;
 
 typedef struct heap_t heap_t;
 typedef struct ecs_t ecs_t;
+typedef struct job_pool_t job_pool_t;
+typedef struct transform_t transform_t;
+typedef struct gpu_mesh_info_t gpu_mesh_info_t;
+
+typedef enum physics_constraint_type_t {
+	PHYSICS_CONSTRAINT_DISTANCE,
+	PHYSICS_CONSTRAINT_VOLUME,
+	PHYSICS_CONSTRAINT_BENDING,
+	PHYSICS_CONSTRAINT_NEO_HOOKEAN,
+	PHYSICS_CONSTRAINT_TYPE_COUNT,
+} physics_constraint_type_t;
 
+typedef enum physics_solver_mode_t {
+	PHYSICS_SOLVER_GAUSS_SEIDEL,					// colored batches, converges faster
+	PHYSICS_SOLVER_JACOBI,							// averaged corrections, scales better on many cores
+} physics_solver_mode_t;
 
+// Creates an empty physics world.
+//
+// RETURN: the new physics world
 physics_t* physicsCreate(heap_t* heap);
 
-void physicsUpdate(physics_t* physics);
+// Destroys the physics world.
+//
+void physicsDestroy(physics_t* physics);
+
+// Sets the job pool used to run the solver, NULL runs everything on the calling thread.
+//
+void physicsSetJobPool(physics_t* physics, job_pool_t* pool);
+
+// Sets how the constraints of a type are solved (default Gauss-Seidel). A Jacobi table keeps one delta
+// buffer of the particle capacity per worker, the reduce after every substep only visits its own particles.
+//
+void physicsSetSolverMode(physics_t* physics, physics_constraint_type_t type, physics_solver_mode_t mode);
+
+// Sets the number of substeps per update (default 8).
+//
+void physicsSetSubsteps(physics_t* physics, int substeps);
+
+// Sets the gravity acceleration (default 9.81 down).
+//
+void physicsSetGravity(physics_t* physics, vec3f_t gravity);
+
+// Enables collisions between particles of the given radius, a radius of 0 (default) disables them.
+// Compliance is the inverse stiffness of the contacts (0 is rigid).
+//
+void physicsSetParticleCollision(physics_t* physics, float radius, float compliance);
+
+// Enables sleeping, islands whose particles all stay below the kinetic energy per mass (0.5 v^2) for
+// frames updates fall asleep. An energy of 0 (default) disables sleeping and wakes every particle.
+//
+void physicsSetSleeping(physics_t* physics, float energy, int frames);
+
+// Reorders the particles by Morton code every this many updates (and on the next one), 0 (default) never does.
+//
+void physicsSetReorderInterval(physics_t* physics, int updates);
+
+// Reserves space so that adding up to this many particles/constraints does not reallocate.
+//
+void physicsReserve(physics_t* physics, int particle_count, int constraint_count);
+
+// Adds a particle, an inverse mass of 0 pins the particle in place.
+//
+// RETURN: index of the particle
+int physicsParticleAdd(physics_t* physics, vec3f_t position, float inv_mass);
+
+// Get the position of a particle.
+//
+// RETURN: position
+vec3f_t physicsParticleGetPosition(physics_t* physics, int particle);
+
+// Get the index a particle is stored at, it changes whenever the particles are reordered.
+//
+// RETURN: storage index, between 0 and the particle count
+int physicsParticleGetIndex(physics_t* physics, int particle);
+
+// Wakes the island of a particle with the next update, e.g. after the user grabbed it.
+//
+void physicsParticleWake(physics_t* physics, int particle);
+
+// Get whether the island of a particle sleeps.
+//
+// RETURN: true if the particle is asleep
+bool physicsParticleIsAsleep(physics_t* physics, int particle);
+
+// Get the number of particles.
+//
+// RETURN: particle count
+int physicsGetParticleCount(physics_t* physics);
+
+// Adds a distance constraint between two particles, the rest length is their current distance.
+// Compliance is the inverse stiffness (0 is rigid).
+//
+void physicsDistanceConstraintAdd(physics_t* physics, int a, int b, float compliance);
+
+// Adds a constraint that keeps the signed volume of the tet a, b, c, d at its current volume.
+// Compliance is the inverse stiffness (0 is incompressible).
+//
+void physicsVolumeConstraintAdd(physics_t* physics, int a, int b, int c, int d, float compliance);
+
+// Adds a constraint on the dihedral angle of the triangles a, b, c and b, a, d around their shared edge a b,
+// the rest angle is their current angle. Compliance is the inverse bending stiffness (0 is rigid).
+//
+void physicsBendingConstraintAdd(physics_t* physics, int a, int b, int c, int d, float compliance);
+
+// Adds a stable Neo-Hookean tet (Macklin and Mueller 2021), the current shape is its rest shape. The
+// compliances are the inverse Lame parameters (1 / mu and 1 / lambda), they are scaled by the rest volume.
+//
+void physicsNeoHookeanConstraintAdd(physics_t* physics, int a, int b, int c, int d, float deviatoric_compliance, float hydrostatic_compliance);
+
+// Adds a shape matching cluster of count particles, their current positions are its rest shape. Stiffness
+// is how far the particles are pulled to the fitted shape every update, 1 is rigid. A particle can only be
+// part of one cluster. When transform is not NULL (e.g. the transform of a transform_component_t) its
+// current value is the rest pose and the body transform is written to it after every update.
+//
+// RETURN: index of the cluster
+int physicsClusterAdd(physics_t* physics, const int* particles, int count, float stiffness, transform_t* transform);
+
+// Sets the transform the body transform of a cluster is written to, NULL stops the writes (e.g. before the
+// entity that owns the transform is removed). The rest pose stays the one of physicsClusterAdd.
+//
+void physicsClusterSetTransform(physics_t* physics, int cluster, transform_t* transform);
+
+// Adds a static triangle mesh (vertex and index data of a gpu_mesh_info_t) moved into the world by
+// transform (NULL for none), particles collide with it as spheres of the collision radius. The mesh data
+// is copied.
+//
+// RETURN: index of the mesh
+int physicsStaticMeshAdd(physics_t* physics, const gpu_mesh_info_t* mesh, const transform_t* transform);
+
+// Get the number of constraints solved per substep, contacts of the last substep count once per particle
+// they move and clusters count once.
+//
+// RETURN: constraint count
+int physicsGetConstraintCount(physics_t* physics);
 
+// Steps the simulation forward by dt seconds.
+//
+void physicsUpdate(physics_t* physics, float dt);
 
-#endif
\ No newline at end of file
+#endif
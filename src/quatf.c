@@ -4,11 +4,44 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 
+#if defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#define QUATF_SSE 1
+#include <xmmintrin.h>
+#else
+#define QUATF_SSE 0
+#endif
+
+#if QUATF_SSE
+// (x, y, z, 0) of a vector
+static inline __m128 quatfLoadVec(vec3f_t v) {
+    return _mm_setr_ps(v.x, v.y, v.z, 0.0f);
+}
+
+// cross product of (x, y, z, _) vectors, w of the result is 0
+static inline __m128 quatfCross(__m128 a, __m128 b) {
+    __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+    return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+#endif
+
 quatf_t quatfIdentity() { return (quatf_t) { .s = 1.0f, .x = 0.0f, .y = 0.0f, .z = 0.0f }; }
 
 quatf_t quatfMul(quatf_t a, quatf_t b) {
     quatf_t result;
 
+#if QUATF_SSE
+    // lanes are (s, x, y, z), every component of a scales a signed swizzle of b
+    __m128 b_sxyz = _mm_loadu_ps(&b.s);
+    __m128 r = _mm_mul_ps(_mm_set1_ps(a.s), b_sxyz);
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a.x), _mm_mul_ps(_mm_shuffle_ps(b_sxyz, b_sxyz, _MM_SHUFFLE(2, 3, 0, 1)), _mm_setr_ps(-1.0f, 1.0f, -1.0f, 1.0f))));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a.y), _mm_mul_ps(_mm_shuffle_ps(b_sxyz, b_sxyz, _MM_SHUFFLE(1, 0, 3, 2)), _mm_setr_ps(-1.0f, 1.0f, 1.0f, -1.0f))));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a.z), _mm_mul_ps(_mm_shuffle_ps(b_sxyz, b_sxyz, _MM_SHUFFLE(0, 1, 2, 3)), _mm_setr_ps(-1.0f, -1.0f, 1.0f, 1.0f))));
+    _mm_storeu_ps(&result.s, r);
+    return result;
+#else
+
     result.v3 = vec3fCross(a.v3, b.v3);
     result.v3 = vec3fAdd(result.v3, vec3fScale(b.v3, a.w));
     result.v3 = vec3fAdd(result.v3, vec3fScale(a.v3, b.w));
@@ -16,6 +49,7 @@ quatf_t quatfMul(quatf_t a, quatf_t b) {
     result.w = (a.w * b.w) - vec3fDot(a.v3, b.v3);
 
     return result;
+#endif
 }
 
 quatf_t quatfConjugate(quatf_t q) {
@@ -26,8 +60,20 @@ quatf_t quatfConjugate(quatf_t q) {
 }
 
 vec3f_t quatfRotateVec(quatf_t q, vec3f_t v) {
+#if QUATF_SSE
+    __m128 q_v = quatfLoadVec(q.v3);
+    __m128 v_v = quatfLoadVec(v);
+    __m128 t = quatfCross(q_v, v_v);
+    t = _mm_add_ps(t, t);
+    __m128 r = _mm_add_ps(v_v, _mm_add_ps(_mm_mul_ps(t, _mm_set1_ps(q.w)), quatfCross(q_v, t)));
+
+    float result[4];
+    _mm_storeu_ps(result, r);
+    return (vec3f_t) { .x = result[0], .y = result[1], .z = result[2] };
+#else
     vec3f_t t = vec3fScale(vec3fCross(q.v3, v), 2.0f);
     return vec3fAdd(v, vec3fAdd(vec3fScale(t, q.w), vec3fCross(q.v3, t)));
+#endif
 }
 
 vec3f_t quatfToEuler(quatf_t q) {
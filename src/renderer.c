@@ -1,43 +1,78 @@
 #include "renderer.h"
 
+#include "atomic.h"
 #include "ecs.h"
 #include "gpu.h"
+#include "hashtable.h"
 #include "heap.h"
-#include "deque.h"
+#include "job.h"
+#include "semaphore.h"
+#include "sort.h"
 #include "thread.h"
 #include "wm.h"
 
 #include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
 enum {
-	RENDERER_MAX_DRAW_AMOUNT = 1024
+	RENDERER_INITIAL_CACHE_CAPACITY = 256,
+	RENDERER_INITIAL_LIST_DATA_SIZE = 64 * 1024,
+	RENDERER_RECORD_CHUNK_SIZE = 128		// model draws per secondary command buffer
 };
 
-typedef enum command_type_t {
-	RENDERER_COMMAND_FRAME_COMPLETE,
-	RENDERER_COMMAND_DRAW_MODEL
-} command_type_t;
-
 typedef struct command_model_t {
-	command_type_t type;
 	ecs_entity_t entity;
 	gpu_mesh_info_t* mesh;
 	gpu_shader_info_t* shader;
-	gpu_uniform_buffer_info_t uniform_buffer;
+	size_t uniform_offset;							// into the list data
+	size_t uniform_size;
+	float depth;
 } command_model_t;
 
-typedef struct command_frame_done_t {
-	command_type_t type;
-} command_frame_done_t;
+typedef struct command_instance_t {
+	gpu_mesh_info_t* mesh;
+	gpu_shader_info_t* shader;
+	size_t uniform_offset;							// shared by the batch, into the list data
+	size_t uniform_size;
+	size_t instance_offset;							// shader->instance_stride bytes, into the list data
+} command_instance_t;
+
+// Draws of one frame. The main thread fills one list while the render thread records the other,
+// they trade places in rendererFrameDone and keep their memory from frame to frame.
+typedef struct command_list_t {
+	command_model_t* models;
+	int model_count;
+	int model_capacity;
+	command_instance_t* instances;					// batched by (shader, mesh) when the frame is recorded
+	int instance_count;
+	int instance_capacity;
+	char* data;										// uniform and instance data, commands refer to it by offset
+	size_t data_size;
+	size_t data_capacity;
+} command_list_t;
 
 typedef struct draw_instance_t {
 	ecs_entity_t entity;
-	gpu_uniform_buffer_t** uniform_buffers;
-	gpu_descriptor_t** descriptors;
+	gpu_uniform_buffer_t* uniform_buffer;			// updates land in the gpu uniform ring, one per frame is not needed
+	gpu_descriptor_t* descriptor;
 	int frame_counter;
 } draw_instance_t;
 
+typedef struct draw_batch_key_t {
+	gpu_shader_info_t* shader_info;
+	gpu_mesh_info_t* mesh_info;
+} draw_batch_key_t;
+
+typedef struct draw_batch_t {
+	gpu_shader_info_t* shader_info;
+	gpu_mesh_info_t* mesh_info;
+	gpu_uniform_buffer_t* uniform_buffer;
+	gpu_descriptor_t* descriptor;
+	int frame_counter;
+} draw_batch_t;
+
 typedef struct draw_mesh_t {
 	gpu_mesh_info_t* info;
 	gpu_mesh_t* mesh;
@@ -51,142 +86,253 @@ typedef struct draw_shader_t {
 	int frame_counter;
 } draw_shader_t;
 
+// Draw items are sorted by pipeline, then mesh, then front to back, so a chunk rebinds as little as possible:
+//	[63..48] pipeline (shader cache index, descriptor set layouts belong to the shader so they sort along)
+//	[47..24] mesh (mesh cache index)
+//	[23..0]  depth (top bits of the non-negative float, which order like integers)
+#define RENDERER_SORT_PIPELINE_SHIFT 48
+#define RENDERER_SORT_MESH_SHIFT 24
+#define RENDERER_SORT_MESH_MASK 0xffffffULL
+
+// A model draw with its gpu objects resolved, ready to be recorded on any worker.
+typedef struct draw_item_t {
+	uint64_t key;
+	gpu_pipeline_t* pipeline;
+	gpu_mesh_t* mesh;
+	gpu_descriptor_t* descriptor;
+} draw_item_t;
+
 typedef struct renderer_t {
 	heap_t* heap;
+	fs_t* fs;
 	wm_window_t* window;
 	thread_t* thread;
 	gpu_t* gpu;
-	deque_t* queue;
+
+	command_list_t lists[2];
+	int write_list;							// list the main thread adds to, the render thread reads the other
+	semaphore_t* list_ready;				// a filled list was handed to the render thread
+	semaphore_t* list_free;					// the render thread is done with the list it was handed
+	int quit;
 
 	int frame_counter;
 	int gpu_frame_count;
+	int frames_done;						// frames handed to the gpu, read from other threads
+	gpu_stats_t gpu_stats;					// gpu counters as of the last finished frame
+	int draw_hash_enabled;
 
+	// gpu resource caches, dense arrays indexed through a hash table
+	// (entity, mesh info, shader info and (shader info, mesh info) keys to the array index)
 	int instance_count;
 	int mesh_count;
 	int shader_count;
-	draw_instance_t instances[RENDERER_MAX_DRAW_AMOUNT];
-	draw_mesh_t meshes[RENDERER_MAX_DRAW_AMOUNT];
-	draw_shader_t shaders[RENDERER_MAX_DRAW_AMOUNT];
+	int batch_count;
+	int instance_capacity;
+	int mesh_capacity;
+	int shader_capacity;
+	int batch_capacity;
+	draw_instance_t* instances;
+	draw_mesh_t* meshes;
+	draw_shader_t* shaders;
+	draw_batch_t* batches;
+	hasht_t* instance_map;
+	hasht_t* mesh_map;
+	hasht_t* shader_map;
+	hasht_t* batch_map;
+
+	// model draws of the frame being recorded, resolved into draw items, sorted by key and recorded
+	// in chunks of RENDERER_RECORD_CHUNK_SIZE into secondaries on the job pool
+	draw_item_t* draw_items;
+	draw_item_t* sorted_items;
+	int draw_item_count;
+	int draw_item_capacity;
+	uint64_t* sort_keys;					// keys and item indices, twice draw_item_capacity for the scratch half
+	uint32_t* sort_values;
+	int sort_capacity;
+	job_pool_t* record_pool;
+	gpu_cmd_buff_t** secondaries;			// one per chunk, in draw order
+	int secondary_capacity;
 } renderer_t;
 
 static int rendererThreadFunc(void* ID);
-static draw_shader_t* rendererShaderModelCommand(renderer_t* render, command_model_t* command);
-static draw_mesh_t* rendererMeshModelCommand(renderer_t* render, command_model_t* command);
-static draw_instance_t* rendererInstanceModelCommand(renderer_t* render, command_model_t* command, gpu_shader_t* shader);
+static void* rendererArrayAdd(renderer_t* render, void* array, int* count, int* capacity, size_t size);
+static size_t rendererListWrite(renderer_t* render, command_list_t* list, const void* data, size_t size);
+static draw_shader_t* rendererShaderGet(renderer_t* render, gpu_shader_info_t* info, gpu_mesh_layout_t mesh_layout);
+static draw_mesh_t* rendererMeshGet(renderer_t* render, gpu_mesh_info_t* info);
+static draw_instance_t* rendererInstanceModelCommand(renderer_t* render, command_model_t* command, gpu_uniform_buffer_info_t* uniform, gpu_shader_t* shader);
+static draw_batch_t* rendererBatchGet(renderer_t* render, command_instance_t* command, gpu_uniform_buffer_info_t* uniform, gpu_shader_t* shader);
+static gpu_cmd_buff_t* rendererDrawInstanceBatches(renderer_t* render, command_list_t* list);
+static void rendererRecordFrame(renderer_t* render, command_list_t* list, gpu_cmd_buff_t* cmd_buff);
+static void rendererRecordDrawItems(void* user, int begin, int end, int worker);
+static void rendererSortDrawItems(renderer_t* render);
 static void rendererDestroyStaleData(renderer_t* render);
 
-renderer_t* rendererCreate(heap_t* heap, wm_window_t* window) {
+renderer_t* rendererCreate(heap_t* heap, fs_t* fs, wm_window_t* window) {
 	renderer_t* render = heapAlloc(heap, sizeof(renderer_t), 8);
 	render->heap = heap;
+	render->fs = fs;
 	render->window = window;
-	render->queue = dequeCreate(heap, 3);
+	memset(render->lists, 0, sizeof(render->lists));
+	render->write_list = 0;
+	render->list_ready = semaphoreCreate(0, 1);
+	render->list_free = semaphoreCreate(1, 1);
+	render->quit = 0;
 	render->frame_counter = 0;
+	render->frames_done = 0;
+	memset(&render->gpu_stats, 0, sizeof(render->gpu_stats));
+	render->draw_hash_enabled = 0;
 	render->instance_count = 0;
 	render->mesh_count = 0;
 	render->shader_count = 0;
+	render->batch_count = 0;
+	render->instance_capacity = 0;
+	render->mesh_capacity = 0;
+	render->shader_capacity = 0;
+	render->batch_capacity = 0;
+	render->instances = NULL;
+	render->meshes = NULL;
+	render->shaders = NULL;
+	render->batches = NULL;
+	render->instance_map = hashTableCreate(heap, sizeof(ecs_entity_t), sizeof(int), RENDERER_INITIAL_CACHE_CAPACITY);
+	render->mesh_map = hashTableCreate(heap, sizeof(gpu_mesh_info_t*), sizeof(int), RENDERER_INITIAL_CACHE_CAPACITY);
+	render->shader_map = hashTableCreate(heap, sizeof(gpu_shader_info_t*), sizeof(int), RENDERER_INITIAL_CACHE_CAPACITY);
+	render->batch_map = hashTableCreate(heap, sizeof(draw_batch_key_t), sizeof(int), RENDERER_INITIAL_CACHE_CAPACITY);
+	render->draw_items = NULL;
+	render->sorted_items = NULL;
+	render->draw_item_count = 0;
+	render->draw_item_capacity = 0;
+	render->sort_keys = NULL;
+	render->sort_values = NULL;
+	render->sort_capacity = 0;
+	render->record_pool = jobPoolCreate(heap, __min(threadGetCoreCount(), GPU_MAX_RECORD_WORKERS));
+	render->secondaries = NULL;
+	render->secondary_capacity = 0;
 	render->thread = threadCreate(rendererThreadFunc, render);
 	return render;
 }
 
 void rendererDestroy(renderer_t* render) {
-	dequePushBack(render->queue, NULL);
+	// let the render thread finish the frames it was handed, draws added after the last rendererFrameDone are dropped
+	semaphoreGet(render->list_free);
+	atomicWrite(&render->quit, 1);
+	semaphoreRelease(render->list_ready);
 	threadDestroy(render->thread);
-	dequeDestroy(render->queue);
+	jobPoolDestroy(render->record_pool);
+	semaphoreDestroy(render->list_free);
+	semaphoreDestroy(render->list_ready);
+	for (int x = 0; x < _countof(render->lists); x++) {
+		heapFree(render->heap, render->lists[x].models);
+		heapFree(render->heap, render->lists[x].instances);
+		heapFree(render->heap, render->lists[x].data);
+	}
+	hashTableDestroy(render->batch_map);
+	hashTableDestroy(render->shader_map);
+	hashTableDestroy(render->mesh_map);
+	hashTableDestroy(render->instance_map);
+	heapFree(render->heap, render->batches);
+	heapFree(render->heap, render->shaders);
+	heapFree(render->heap, render->meshes);
+	heapFree(render->heap, render->instances);
+	heapFree(render->heap, render->draw_items);
+	heapFree(render->heap, render->sorted_items);
+	heapFree(render->heap, render->sort_keys);
+	heapFree(render->heap, render->sort_values);
+	heapFree(render->heap, render->secondaries);
 	heapFree(render->heap, render);
 }
 
-void rendererModelAdd(renderer_t* render, ecs_entity_t* entity, gpu_mesh_info_t* mesh, gpu_shader_info_t* shader, gpu_uniform_buffer_info_t* uniform) {
-	command_model_t* command = heapAlloc(render->heap, sizeof(command_model_t), 8);
-	command->type = RENDERER_COMMAND_DRAW_MODEL;
+void rendererModelAdd(renderer_t* render, ecs_entity_t* entity, gpu_mesh_info_t* mesh, gpu_shader_info_t* shader, gpu_uniform_buffer_info_t* uniform, float depth) {
+	command_list_t* list = &render->lists[render->write_list];
+	command_model_t* command = rendererArrayAdd(render, &list->models, &list->model_count, &list->model_capacity, sizeof(command_model_t));
 	command->entity = *entity;
 	command->mesh = mesh;
 	command->shader = shader;
-	command->uniform_buffer.size = uniform->size;
-	command->uniform_buffer.data = heapAlloc(render->heap, uniform->size, 8);
-	memcpy(command->uniform_buffer.data, uniform->data, uniform->size);
-	dequePushBack(render->queue, command);
+	command->uniform_offset = rendererListWrite(render, list, uniform->data, uniform->size);
+	command->uniform_size = uniform->size;
+	command->depth = depth;
+}
+
+void rendererModelInstanceAdd(renderer_t* render, gpu_mesh_info_t* mesh, gpu_shader_info_t* shader, gpu_uniform_buffer_info_t* uniform, const void* instance_data) {
+	command_list_t* list = &render->lists[render->write_list];
+	command_instance_t* command = rendererArrayAdd(render, &list->instances, &list->instance_count, &list->instance_capacity, sizeof(command_instance_t));
+	command->mesh = mesh;
+	command->shader = shader;
+	command->uniform_offset = rendererListWrite(render, list, uniform->data, uniform->size);
+	command->uniform_size = uniform->size;
+	command->instance_offset = rendererListWrite(render, list, instance_data, shader->instance_stride);
+}
+
+int rendererGetFrameCount(renderer_t* render) {
+	return atomicRead(&render->frames_done);
+}
+
+void rendererGetGpuStats(renderer_t* render, gpu_stats_t* stats) {
+	*stats = render->gpu_stats;
+}
+
+void rendererSetDrawHashEnabled(renderer_t* render, bool enabled) {
+	atomicWrite(&render->draw_hash_enabled, enabled);
 }
 
 void rendererFrameDone(renderer_t* render) {
-	command_frame_done_t* command = heapAlloc(render->heap, sizeof(command_frame_done_t), 8);
-	command->type = RENDERER_COMMAND_FRAME_COMPLETE;
-	dequePushBack(render->queue, command);
+	// the other list is only refilled once the render thread is done recording it
+	semaphoreGet(render->list_free);
+	semaphoreRelease(render->list_ready);
+	render->write_list ^= 1;
 }
 
 static int rendererThreadFunc(void* ID) {
 	renderer_t* render = ID;
-	render->gpu = gpuCreate(render->heap, render->window);
+	render->gpu = gpuCreate(render->heap, render->fs, render->window);
 	render->gpu_frame_count = gpuGetFrameCount(render->gpu);
 
-	gpu_cmd_buff_t* cmd_buff = NULL;
-	gpu_pipeline_t* p_pipeline = NULL;
-	gpu_mesh_t* p_mesh = NULL;
-	command_type_t* command_type = dequePopBack(render->queue);
-	int frame_index = 0;
-
-	while (command_type) {
-
-		if (cmd_buff == NULL) { cmd_buff = gpuBeginFrameUpdate(render->gpu); }
-
-		switch (*command_type) {
-			case RENDERER_COMMAND_FRAME_COMPLETE: // finish rendering the frame
-				gpuEndFrameUpdate(render->gpu);
-				cmd_buff = NULL;
-				p_pipeline = NULL;
-				p_mesh = NULL;
-				rendererDestroyStaleData(render);
-				++render->frame_counter;
-				frame_index = render->frame_counter % render->gpu_frame_count;
-				break;
-
-			case RENDERER_COMMAND_DRAW_MODEL: { // draw the model
-				command_model_t* model = (command_model_t*) command_type;
-				draw_shader_t* shader = rendererShaderModelCommand(render, model);
-				draw_mesh_t* mesh = rendererMeshModelCommand(render, model);
-				draw_instance_t* instance = rendererInstanceModelCommand(render, model, shader->shader);
-
-				heapFree(render->heap, model->uniform_buffer.data);
-
-				if (p_pipeline != shader->pipeline) {
-					gpuCommandBindPipeline(cmd_buff, shader->pipeline);
-					p_pipeline = shader->pipeline;
-				}
-				if (p_mesh != mesh->mesh) {
-					gpuCommandBindMesh(render->gpu, cmd_buff, mesh->mesh);
-					p_mesh = mesh->mesh;
-				}
-				gpuCommandBindDescriptorSets(cmd_buff, instance->descriptors[frame_index]);
-				gpuCommandDraw(render->gpu, cmd_buff);
-
-				break;
-			}
-		}
-
-		command_type = dequePopBack(render->queue);
+	int read_list = 0;
+	semaphoreGet(render->list_ready);
+
+	while (!atomicRead(&render->quit)) {
+		command_list_t* list = &render->lists[read_list];
+
+		gpuSetDrawHashEnabled(render->gpu, atomicRead(&render->draw_hash_enabled) != 0);
+		gpu_cmd_buff_t* cmd_buff = gpuBeginFrameUpdate(render->gpu);
+		rendererRecordFrame(render, list, cmd_buff);
+		gpuEndFrameUpdate(render->gpu);
+		rendererDestroyStaleData(render);
+		++render->frame_counter;
+		gpuGetStats(render->gpu, &render->gpu_stats);
+		atomicInc(&render->frames_done);
+
+		// hand the list back empty, the main thread fills it with the frame after the one it is on
+		list->model_count = 0;
+		list->instance_count = 0;
+		list->data_size = 0;
+		read_list ^= 1;
+		semaphoreRelease(render->list_free);
+		semaphoreGet(render->list_ready);
 	}
 
 	gpuQueueWaitIdle(render->gpu);
 	render->frame_counter += render->gpu_frame_count + 1;
 	rendererDestroyStaleData(render);
+	gpuGetStats(render->gpu, &render->gpu_stats);
 	gpuDestroy(render->gpu);
 	render->gpu = NULL;
 
 	return 0;
 }
 
-static draw_shader_t* rendererShaderModelCommand(renderer_t* render, command_model_t* command) {
+static draw_shader_t* rendererShaderGet(renderer_t* render, gpu_shader_info_t* info, gpu_mesh_layout_t mesh_layout) {
 	draw_shader_t* shader = NULL;
-	for (int x = 0; x < render->shader_count; x++) {
-		if (render->shaders[x].info == command->shader) { // got the right shader
-			shader = &render->shaders[x];
-			break;
-		}
-	}
-
-	if (shader == NULL) { // initialize a shader if it does not exist
-		assert(render->shader_count < _countof(render->shaders));
-		shader = &render->shaders[render->shader_count++];
-		shader->info = command->shader;
+	bool inserted;
+	int* index = hashTableInsert(render->shader_map, &info, &inserted);
+
+	if (inserted) { // initialize a shader if it does not exist
+		*index = render->shader_count;
+		shader = rendererArrayAdd(render, &render->shaders, &render->shader_count, &render->shader_capacity, sizeof(draw_shader_t));
+		shader->info = info;
+		shader->shader = NULL;
+		shader->pipeline = NULL;
+	} else {
+		shader = &render->shaders[*index];
 	}
 
 	if (shader->shader == NULL) {
@@ -196,7 +342,7 @@ static draw_shader_t* rendererShaderModelCommand(renderer_t* render, command_mod
 	if (shader->pipeline == NULL) {
 		gpu_pipeline_info_t pipeline_info = {
 			.shader = shader->shader,
-			.mesh_layout = command->mesh->layout
+			.mesh_layout = mesh_layout
 		};
 		shader->pipeline = gpuCreatePipeline(render->gpu, &pipeline_info);
 	}
@@ -204,19 +350,18 @@ static draw_shader_t* rendererShaderModelCommand(renderer_t* render, command_mod
 	return shader;
 }
 
-static draw_mesh_t* rendererMeshModelCommand(renderer_t* render, command_model_t* command) {
+static draw_mesh_t* rendererMeshGet(renderer_t* render, gpu_mesh_info_t* info) {
 	draw_mesh_t* mesh = NULL;
-	for (int x = 0; x < render->mesh_count; x++) {
-		if (render->meshes[x].info == command->mesh) { // found mesh
-			mesh = &render->meshes[x];
-			break;
-		}
-	}
-
-	if (mesh == NULL) {
-		assert(render->mesh_count < _countof(render->meshes));
-		mesh = &render->meshes[render->mesh_count++];
-		mesh->info = command->mesh;
+	bool inserted;
+	int* index = hashTableInsert(render->mesh_map, &info, &inserted);
+
+	if (inserted) {
+		*index = render->mesh_count;
+		mesh = rendererArrayAdd(render, &render->meshes, &render->mesh_count, &render->mesh_capacity, sizeof(draw_mesh_t));
+		mesh->info = info;
+		mesh->mesh = NULL;
+	} else {
+		mesh = &render->meshes[*index];
 	}
 
 	if (mesh->mesh == NULL) {
@@ -227,68 +372,337 @@ static draw_mesh_t* rendererMeshModelCommand(renderer_t* render, command_model_t
 	return mesh;
 }
 
-static draw_instance_t* rendererInstanceModelCommand(renderer_t* render, command_model_t* command, gpu_shader_t* shader) {
+static draw_instance_t* rendererInstanceModelCommand(renderer_t* render, command_model_t* command, gpu_uniform_buffer_info_t* uniform, gpu_shader_t* shader) {
 	draw_instance_t* instance = NULL;
-	for (int x = 0; x < render->instance_count; x++) {
-		if (memcmp(&render->instances[x].entity, &command->entity, sizeof(ecs_entity_t)) == 0) { // found instance
-			instance = &render->instances[x];
-			break;
-		}
-	}
+	bool inserted;
+	int* index = hashTableInsert(render->instance_map, &command->entity, &inserted);
 
-	if (instance == NULL) {
-		assert(render->instance_count < _countof(render->instances));
-		instance = &render->instances[render->instance_count++];
+	if (inserted) {
+		*index = render->instance_count;
+		instance = rendererArrayAdd(render, &render->instances, &render->instance_count, &render->instance_capacity, sizeof(draw_instance_t));
 		instance->entity = command->entity;
-		instance->uniform_buffers = heapAlloc(render->heap, sizeof(gpu_uniform_buffer_t*) * render->gpu_frame_count, 8);
-		instance->descriptors = heapAlloc(render->heap, sizeof(gpu_descriptor_t*) * render->gpu_frame_count, 8);
-		// assign the ubuffs and descriptors
-		for (int x = 0; x < render->gpu_frame_count; x++) {
-			instance->uniform_buffers[x] = gpuCreateUniformBuffer(render->gpu, &command->uniform_buffer);
-			gpu_descriptor_info_t descriptor_info = {
-				.shader = shader,
-				.uniform_buffers = &instance->uniform_buffers[x],
-				.uniform_buffer_count = 1
-			};
-			instance->descriptors[x] = gpuCreateDescriptorSets(render->gpu, &descriptor_info);
-		}
+		instance->uniform_buffer = gpuCreateUniformBuffer(render->gpu, uniform);
+		gpu_descriptor_info_t descriptor_info = {
+			.shader = shader,
+			.uniform_buffers = &instance->uniform_buffer,
+			.uniform_buffer_count = 1
+		};
+		instance->descriptor = gpuCreateDescriptorSets(render->gpu, &descriptor_info);
+	} else {
+		instance = &render->instances[*index];
+		gpuUpdateUniformBuffer(render->gpu, instance->uniform_buffer, uniform->data, uniform->size);
 	}
 
-	int frame_idx = render->frame_counter % render->gpu_frame_count;
-	gpuUpdateUniformBuffer(render->gpu, instance->uniform_buffers[frame_idx], command->uniform_buffer.data, command->uniform_buffer.size);
 	instance->frame_counter = render->frame_counter;
-	
+
 	return instance;
 }
 
+//  --------------------------------------------------------------------------
+//								   INSTANCING
+//
+
+static draw_batch_t* rendererBatchGet(renderer_t* render, command_instance_t* command, gpu_uniform_buffer_info_t* uniform, gpu_shader_t* shader) {
+	draw_batch_t* batch = NULL;
+	draw_batch_key_t key = { .shader_info = command->shader, .mesh_info = command->mesh };
+	bool inserted;
+	int* index = hashTableInsert(render->batch_map, &key, &inserted);
+
+	if (inserted) {
+		*index = render->batch_count;
+		batch = rendererArrayAdd(render, &render->batches, &render->batch_count, &render->batch_capacity, sizeof(draw_batch_t));
+		batch->shader_info = command->shader;
+		batch->mesh_info = command->mesh;
+		batch->uniform_buffer = gpuCreateUniformBuffer(render->gpu, uniform);
+		gpu_descriptor_info_t descriptor_info = {
+			.shader = shader,
+			.uniform_buffers = &batch->uniform_buffer,
+			.uniform_buffer_count = 1
+		};
+		batch->descriptor = gpuCreateDescriptorSets(render->gpu, &descriptor_info);
+	} else {
+		batch = &render->batches[*index];
+		gpuUpdateUniformBuffer(render->gpu, batch->uniform_buffer, uniform->data, uniform->size);
+	}
+
+	batch->frame_counter = render->frame_counter;
+	return batch;
+}
+
+// Instances of a batch keep the order they were added in, their data offsets only grow.
+static int rendererInstanceCompare(const void* a, const void* b) {
+	const command_instance_t* command_a = a;
+	const command_instance_t* command_b = b;
+	if (command_a->shader != command_b->shader) {
+		return (uintptr_t) command_a->shader < (uintptr_t) command_b->shader ? -1 : 1;
+	}
+	if (command_a->mesh != command_b->mesh) {
+		return (uintptr_t) command_a->mesh < (uintptr_t) command_b->mesh ? -1 : 1;
+	}
+	if (command_a->instance_offset != command_b->instance_offset) {
+		return command_a->instance_offset < command_b->instance_offset ? -1 : 1;
+	}
+	return 0;
+}
+
+// Groups the queued instances by (shader, mesh) and issues one instanced draw per group.
+// The shared uniform of a group is taken from its first instance. Instance data comes from the
+// uniform ring, so the batches are recorded on the render thread into a secondary of worker 0.
+//
+// RETURN: the ended secondary, NULL if no instances were queued
+static gpu_cmd_buff_t* rendererDrawInstanceBatches(renderer_t* render, command_list_t* list) {
+	command_instance_t* commands = list->instances;
+	int count = list->instance_count;
+	if (count == 0) {
+		return NULL;
+	}
+	gpu_cmd_buff_t* cmd_buff = gpuCommandBeginSecondary(render->gpu, 0);
+	qsort(commands, count, sizeof(command_instance_t), rendererInstanceCompare);
+
+	int begin = 0;
+	while (begin < count) {
+		command_instance_t* first = &commands[begin];
+		int end = begin + 1;
+		while (end < count && commands[end].shader == first->shader && commands[end].mesh == first->mesh) {
+			end++;
+		}
+
+		gpu_uniform_buffer_info_t uniform = { .data = list->data + first->uniform_offset, .size = first->uniform_size };
+		draw_shader_t* shader = rendererShaderGet(render, first->shader, first->mesh->layout);
+		draw_mesh_t* mesh = rendererMeshGet(render, first->mesh);
+		draw_batch_t* batch = rendererBatchGet(render, first, &uniform, shader->shader);
+		if (cmd_buff == NULL || !gpuMeshIsReady(render->gpu, mesh->mesh)) {
+			begin = end;
+			continue;
+		}
+
+		gpuCommandBindPipeline(cmd_buff, shader->pipeline);
+		gpuCommandBindMesh(render->gpu, cmd_buff, mesh->mesh);
+		gpuCommandBindDescriptorSets(cmd_buff, batch->descriptor);
+
+		size_t stride = first->shader->instance_stride;
+		char* instance_data = gpuCommandBindInstanceData(render->gpu, cmd_buff, stride * (end - begin));
+		if (instance_data) {
+			for (int x = begin; x < end; x++) {
+				memcpy(instance_data + stride * (x - begin), list->data + commands[x].instance_offset, stride);
+			}
+			gpuCommandDrawInstanced(render->gpu, cmd_buff, end - begin);
+		}
+
+		begin = end;
+	}
+
+	if (cmd_buff) {
+		gpuCommandEndSecondary(render->gpu, cmd_buff);
+	}
+	return cmd_buff;
+}
+
+//  --------------------------------------------------------------------------
+//								   RECORDING
+//
+
+// Resolves the model draws of the frame on the render thread (the caches, resource creation and
+// uniform updates are not thread safe), records them in chunks on the job pool and executes the
+// chunks followed by the instance batches into the frame's command buffer.
+static void rendererRecordFrame(renderer_t* render, command_list_t* list, gpu_cmd_buff_t* cmd_buff) {
+	render->draw_item_count = 0;
+	for (int x = 0; x < list->model_count; x++) {
+		command_model_t* model = &list->models[x];
+		gpu_uniform_buffer_info_t uniform = { .data = list->data + model->uniform_offset, .size = model->uniform_size };
+		draw_shader_t* shader = rendererShaderGet(render, model->shader, model->mesh->layout);
+		draw_mesh_t* mesh = rendererMeshGet(render, model->mesh);
+		draw_instance_t* instance = rendererInstanceModelCommand(render, model, &uniform, shader->shader);
+
+		// still uploading, draws from a later frame
+		if (!gpuMeshIsReady(render->gpu, mesh->mesh)) {
+			continue;
+		}
+
+		// cache indices stay put until the stale data of this frame is destroyed
+		uint32_t depth_bits = 0;
+		if (model->depth > 0.0f) {
+			memcpy(&depth_bits, &model->depth, sizeof(depth_bits));
+		}
+		uint64_t shader_index = shader - render->shaders;
+		uint64_t mesh_index = mesh - render->meshes;
+
+		draw_item_t* item = rendererArrayAdd(render, &render->draw_items, &render->draw_item_count, &render->draw_item_capacity, sizeof(draw_item_t));
+		item->key = (shader_index << RENDERER_SORT_PIPELINE_SHIFT) | ((mesh_index & RENDERER_SORT_MESH_MASK) << RENDERER_SORT_MESH_SHIFT) | (depth_bits >> 8);
+		item->pipeline = shader->pipeline;
+		item->mesh = mesh->mesh;
+		item->descriptor = instance->descriptor;
+	}
+	rendererSortDrawItems(render);
+
+	// the chunk a secondary holds does not depend on the worker that recorded it, so the draw order is stable
+	int chunk_count = (render->draw_item_count + RENDERER_RECORD_CHUNK_SIZE - 1) / RENDERER_RECORD_CHUNK_SIZE;
+	if (chunk_count + 1 > render->secondary_capacity) {
+		heapFree(render->heap, render->secondaries);
+		render->secondary_capacity = __max(render->secondary_capacity * 2, chunk_count + 1);
+		render->secondaries = heapAlloc(render->heap, sizeof(gpu_cmd_buff_t*) * render->secondary_capacity, 8);
+	}
+	jobPoolParallelFor(render->record_pool, render->draw_item_count, RENDERER_RECORD_CHUNK_SIZE, rendererRecordDrawItems, render);
+
+	int secondary_count = chunk_count;
+	gpu_cmd_buff_t* batches = rendererDrawInstanceBatches(render, list);
+	if (batches) {
+		render->secondaries[secondary_count++] = batches;
+	}
+	gpuCommandExecuteSecondaries(render->gpu, cmd_buff, render->secondaries, secondary_count);
+}
+
+// Radix sorts the draw items by key, the sorted items replace the unsorted ones.
+static void rendererSortDrawItems(renderer_t* render) {
+	int count = render->draw_item_count;
+	if (count <= 1) {
+		return;
+	}
+
+	if (render->sort_capacity < render->draw_item_capacity) {
+		heapFree(render->heap, render->sorted_items);
+		heapFree(render->heap, render->sort_keys);
+		heapFree(render->heap, render->sort_values);
+		render->sort_capacity = render->draw_item_capacity;
+		render->sorted_items = heapAlloc(render->heap, sizeof(draw_item_t) * render->sort_capacity, 8);
+		render->sort_keys = heapAlloc(render->heap, sizeof(uint64_t) * render->sort_capacity * 2, 8);
+		render->sort_values = heapAlloc(render->heap, sizeof(uint32_t) * render->sort_capacity * 2, 8);
+	}
+
+	for (int x = 0; x < count; x++) {
+		render->sort_keys[x] = render->draw_items[x].key;
+		render->sort_values[x] = x;
+	}
+	sortRadix64(render->sort_keys, render->sort_values, render->sort_keys + render->sort_capacity, render->sort_values + render->sort_capacity, count);
+	for (int x = 0; x < count; x++) {
+		render->sorted_items[x] = render->draw_items[render->sort_values[x]];
+	}
+
+	draw_item_t* items = render->draw_items;
+	render->draw_items = render->sorted_items;
+	render->sorted_items = items;
+}
+
+// Records draw items into a secondary of the worker per chunk, runs on the job pool.
+// A pool that runs inline hands over the whole range, so chunks are split here again.
+static void rendererRecordDrawItems(void* user, int begin, int end, int worker) {
+	renderer_t* render = user;
+	for (int chunk_begin = begin; chunk_begin < end; chunk_begin += RENDERER_RECORD_CHUNK_SIZE) {
+		int chunk_end = __min(chunk_begin + RENDERER_RECORD_CHUNK_SIZE, end);
+		gpu_cmd_buff_t* cmd_buff = gpuCommandBeginSecondary(render->gpu, worker);
+		render->secondaries[chunk_begin / RENDERER_RECORD_CHUNK_SIZE] = cmd_buff;
+		if (cmd_buff == NULL) {
+			continue;
+		}
+
+		gpu_pipeline_t* p_pipeline = NULL;
+		gpu_mesh_t* p_mesh = NULL;
+		for (int x = chunk_begin; x < chunk_end; x++) {
+			draw_item_t* item = &render->draw_items[x];
+			if (p_pipeline != item->pipeline) {
+				gpuCommandBindPipeline(cmd_buff, item->pipeline);
+				p_pipeline = item->pipeline;
+			}
+			if (p_mesh != item->mesh) {
+				gpuCommandBindMesh(render->gpu, cmd_buff, item->mesh);
+				p_mesh = item->mesh;
+			}
+			gpuCommandBindDescriptorSets(cmd_buff, item->descriptor);
+			gpuCommandDraw(render->gpu, cmd_buff);
+		}
+		gpuCommandEndSecondary(render->gpu, cmd_buff);
+	}
+}
+
+// Appends an uninitialized entry to a growable array, doubling the array when it is full.
+//
+// RETURN: the new entry
+static void* rendererArrayAdd(renderer_t* render, void* array, int* count, int* capacity, size_t size) {
+	char** entries = array;
+	if (*count == *capacity) {
+		int new_capacity = __max(*capacity * 2, RENDERER_INITIAL_CACHE_CAPACITY);
+		char* new_entries = heapAlloc(render->heap, size * new_capacity, 8);
+		if (*entries) {
+			memcpy(new_entries, *entries, size * *count);
+			heapFree(render->heap, *entries);
+		}
+		*entries = new_entries;
+		*capacity = new_capacity;
+	}
+	return *entries + size * (*count)++;
+}
+
+// Copies data to the end of the list data (16 byte aligned), growing it when it is full.
+//
+// RETURN: offset of the copy
+static size_t rendererListWrite(renderer_t* render, command_list_t* list, const void* data, size_t size) {
+	size_t offset = (list->data_size + 15) & ~(size_t) 15;
+	if (offset + size > list->data_capacity) {
+		size_t capacity = __max(list->data_capacity * 2, RENDERER_INITIAL_LIST_DATA_SIZE);
+		while (capacity < offset + size) {
+			capacity *= 2;
+		}
+		char* new_data = heapAlloc(render->heap, capacity, 16);
+		if (list->data) {
+			memcpy(new_data, list->data, list->data_size);
+			heapFree(render->heap, list->data);
+		}
+		list->data = new_data;
+		list->data_capacity = capacity;
+	}
+	memcpy(list->data + offset, data, size);
+	list->data_size = offset + size;
+	return offset;
+}
+
+// Entries are removed by moving the last one into their place, the moved entry's index is fixed in the map.
 static void rendererDestroyStaleData(renderer_t* render) {
-	for (int x = render->instance_count; x >= 0; x--) { // past frames (used instance value)
+	for (int x = render->instance_count - 1; x >= 0; x--) { // past frames (used instance value)
 		if (render->instances[x].frame_counter + render->gpu_frame_count <= render->frame_counter) {
-			for (int frame = 0; frame < render->gpu_frame_count; frame++) {
-				gpuDestroyDescriptorSets(render->gpu, render->instances[x].descriptors[frame]);
-				gpuDestroyUniformBuffer(render->gpu, render->instances[x].uniform_buffers[frame]);
+			gpuDestroyDescriptorSets(render->gpu, render->instances[x].descriptor);
+			gpuDestroyUniformBuffer(render->gpu, render->instances[x].uniform_buffer);
+			hashTableRemove(render->instance_map, &render->instances[x].entity);
+			render->instances[x] = render->instances[--render->instance_count];
+			if (x < render->instance_count) {
+				hashTableSet(render->instance_map, &render->instances[x].entity, &x);
 			}
-			heapFree(render->heap, render->instances[x].descriptors);
-			heapFree(render->heap, render->instances[x].uniform_buffers);
-			render->instances[x] = render->instances[render->instance_count - 1];
-			render->instance_count--;
 		}
 	}
 
-	for (int x = render->mesh_count; x >= 0; x--) {
+	for (int x = render->batch_count - 1; x >= 0; x--) {
+		if (render->batches[x].frame_counter + render->gpu_frame_count <= render->frame_counter) {
+			gpuDestroyDescriptorSets(render->gpu, render->batches[x].descriptor);
+			gpuDestroyUniformBuffer(render->gpu, render->batches[x].uniform_buffer);
+			draw_batch_key_t key = { .shader_info = render->batches[x].shader_info, .mesh_info = render->batches[x].mesh_info };
+			hashTableRemove(render->batch_map, &key);
+			render->batches[x] = render->batches[--render->batch_count];
+			if (x < render->batch_count) {
+				key = (draw_batch_key_t){ .shader_info = render->batches[x].shader_info, .mesh_info = render->batches[x].mesh_info };
+				hashTableSet(render->batch_map, &key, &x);
+			}
+		}
+	}
+
+	for (int x = render->mesh_count - 1; x >= 0; x--) {
 		if (render->meshes[x].frame_counter + render->gpu_frame_count <= render->frame_counter) {
 			gpuDestroyMesh(render->gpu, render->meshes[x].mesh);
-			render->meshes[x] = render->meshes[render->mesh_count - 1];
-			render->mesh_count--;
+			hashTableRemove(render->mesh_map, &render->meshes[x].info);
+			render->meshes[x] = render->meshes[--render->mesh_count];
+			if (x < render->mesh_count) {
+				hashTableSet(render->mesh_map, &render->meshes[x].info, &x);
+			}
 		}
 	}
 
-	for (int x = render->shader_count; x >= 0; x--) {
+	for (int x = render->shader_count - 1; x >= 0; x--) {
 		if (render->shaders[x].frame_counter + render->gpu_frame_count <= render->frame_counter) {
 			gpuDestroyPipeline(render->gpu, render->shaders[x].pipeline);
 			gpuDestroyShader(render->gpu, render->shaders[x].shader);
-			render->shaders[x] = render->shaders[render->shader_count - 1];
-			render->shader_count--;
+			hashTableRemove(render->shader_map, &render->shaders[x].info);
+			render->shaders[x] = render->shaders[--render->shader_count];
+			if (x < render->shader_count) {
+				hashTableSet(render->shader_map, &render->shaders[x].info, &x);
+			}
 		}
 	}
 }
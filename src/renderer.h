@@ -1,25 +1,46 @@
 #ifndef __RENDERER_H__
 #define __RENDERER_H__
 
+#include <stdbool.h>
+
 typedef struct renderer_t renderer_t;
 
 
 typedef struct heap_t heap_t;
+typedef struct fs_t fs_t;
 typedef struct wm_window_t wm_window_t;
 
 typedef struct ecs_entity_t ecs_entity_t;
 typedef struct gpu_uniform_buffer_info_t gpu_uniform_buffer_info_t;
 typedef struct gpu_mesh_info_t gpu_mesh_info_t;
 typedef struct gpu_shader_info_t gpu_shader_info_t;
+typedef struct gpu_stats_t gpu_stats_t;
 
-renderer_t* rendererCreate(heap_t* heap, wm_window_t* window);
+// Creates the renderer and its render thread, fs is used by the gpu to load and save its pipeline cache
+renderer_t* rendererCreate(heap_t* heap, fs_t* fs, wm_window_t* window);
 
 void rendererDestroy(renderer_t* render);
 
-// Add a model to the renderer queue
-void rendererModelAdd(renderer_t* render, ecs_entity_t* entity, gpu_mesh_info_t* mesh, gpu_shader_info_t* shader, gpu_uniform_buffer_info_t* uniform);
+// Add a model to the command list of the frame being built. Draws are sorted to share pipeline and mesh binds,
+// depth (the distance to the camera, 0 if unknown) orders the draws of a pipeline and mesh front to back.
+void rendererModelAdd(renderer_t* render, ecs_entity_t* entity, gpu_mesh_info_t* mesh, gpu_shader_info_t* shader, gpu_uniform_buffer_info_t* uniform, float depth);
+
+// Add one instance of a mesh to the command list of the frame being built, every instance of the same (mesh, shader) in a frame
+// is packed into one instanced draw. The shader needs an instance stride, instance_data holds that many bytes
+// and the uniform is shared by the whole batch.
+void rendererModelInstanceAdd(renderer_t* render, gpu_mesh_info_t* mesh, gpu_shader_info_t* shader, gpu_uniform_buffer_info_t* uniform, const void* instance_data);
 
-// Finished rendering the frame
+// Hands the frame's command list to the render thread and starts the next one. Commands are double buffered,
+// this only blocks while the render thread is still recording the frame before the one handed over.
 void rendererFrameDone(renderer_t* render);
 
+// Get the number of frames the render thread has finished recording and handed to the gpu
+int rendererGetFrameCount(renderer_t* render);
+
+// Get the gpu counters as of the last finished frame, only stable while no frame is being recorded
+void rendererGetGpuStats(renderer_t* render, gpu_stats_t* stats);
+
+// Hash the draw stream into gpu_stats_t.draw_hash from the next frame on (null gpu backend only)
+void rendererSetDrawHashEnabled(renderer_t* render, bool enabled);
+
 #endif
\ No newline at end of file
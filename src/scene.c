@@ -11,12 +11,20 @@
 #include "vec3f.h"
 #include "ecs.h"
 #include "component.h"
+#include "cull.h"
+#include "job.h"
+#include "thread.h"
 
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <string.h>
 #include <stdint.h>
 
+// a model that passed the query, it is drawn when its bounding sphere is visible
+typedef struct scene_draw_t {
+	ecs_entity_t entity;
+	model_component_t* model;
+} scene_draw_t;
 
 typedef struct scene_t {
 	heap_t* heap;
@@ -33,6 +41,15 @@ typedef struct scene_t {
 	int name_type;
 	ecs_entity_t camera_entity;
 
+	// frustum culling
+	job_pool_t* job_pool;
+	cull_t* cull;
+	scene_draw_t* draws;
+	transform_t* draw_transforms;		// per draw, converted to draw_matrices in one batch
+	mat4f_t* draw_matrices;
+	int draw_count;
+	int draw_capacity;
+
 	gpu_mesh_info_t cube_mesh;
 	gpu_shader_info_t cube_shader;
 	fs_work_t* vert_shader_work;
@@ -51,6 +68,13 @@ scene_t* sceneCreate(heap_t* heap, fs_t* fs, wm_window_t* window, renderer_t* re
 	scene->window = window;
 	scene->render = render;
 	scene->timer = timerObjectCreate(heap, NULL);
+	scene->job_pool = jobPoolCreate(heap, threadGetCoreCount());
+	scene->cull = cullCreate(heap);
+	scene->draws = NULL;
+	scene->draw_transforms = NULL;
+	scene->draw_matrices = NULL;
+	scene->draw_count = 0;
+	scene->draw_capacity = 0;
 
 	scene->ecs = ecsCreate(heap);
 	scene->transform_type = ecsComponentRegister(scene->ecs, "transform", sizeof(transform_component_t), _Alignof(transform_component_t));
@@ -68,6 +92,11 @@ void sceneDestroy(scene_t* scene) {
 	ecsDestroy(scene->ecs);
 	timerObjectDestroy(scene->timer);
 	unloadResources(scene);
+	heapFree(scene->heap, scene->draws);
+	heapFree(scene->heap, scene->draw_transforms);
+	heapFree(scene->heap, scene->draw_matrices);
+	cullDestroy(scene->cull);
+	jobPoolDestroy(scene->job_pool);
 	heapFree(scene->heap, scene);
 }
 
@@ -79,14 +108,15 @@ void sceneUpdate(scene_t* scene) {
 }
 
 static void loadResources(scene_t* scene) {
-	scene->vert_shader_work = fsRead(scene->fs, "shaders/triangle.vert.spv", scene->heap, false, false);
+	scene->vert_shader_work = fsRead(scene->fs, "shaders/triangle_instanced.vert.spv", scene->heap, false, false);
 	scene->frag_shader_work = fsRead(scene->fs, "shaders/triangle.frag.spv", scene->heap, false, false);
 	scene->cube_shader = (gpu_shader_info_t){
 		.vtx_shader_data = fsWorkGetBuffer(scene->vert_shader_work),
 		.vtx_shader_size = fsWorkGetSize(scene->vert_shader_work),
 		.frag_shader_data = fsWorkGetBuffer(scene->frag_shader_work),
 		.frag_shader_size = fsWorkGetSize(scene->frag_shader_work),
-		.uniform_buffer_count = 1
+		.uniform_buffer_count = 1,
+		.instance_stride = sizeof(mat4f_t),
 	};
 	
 	static vec3f_t cube_vtx[] = {
@@ -123,8 +153,7 @@ static void loadResources(scene_t* scene) {
 }
 
 static void unloadResources(scene_t* scene) {
-	heapFree(scene->heap, fsWorkGetBuffer(scene->vert_shader_work));
-	heapFree(scene->heap, fsWorkGetBuffer(scene->frag_shader_work));
+	// the works own the shader buffers
 	fsWorkDestroy(scene->vert_shader_work);
 	fsWorkDestroy(scene->frag_shader_work);
 }
@@ -140,22 +169,89 @@ static void spawnCamera(scene_t* scene) {
 
 }
 
+// World space bounding sphere of a model.
+static void modelWorldBounds(const transform_t* transform, const model_component_t* model, vec3f_t* center, float* radius) {
+	float scale = __max(fabsf(transform->scale.x), __max(fabsf(transform->scale.y), fabsf(transform->scale.z)));
+	*center = transformTransformVec3f(transform, model->bounds_center);
+	*radius = model->bounds_radius * scale;
+}
+
+static void* drawGrowArray(scene_t* scene, void* array, size_t element_size, int capacity) {
+	void* new_array = heapAlloc(scene->heap, element_size * capacity, 16);
+	if (array) {
+		memcpy(new_array, array, element_size * scene->draw_count);
+		heapFree(scene->heap, array);
+	}
+	return new_array;
+}
+
+static void drawAdd(scene_t* scene, ecs_entity_t entity, const transform_t* transform, model_component_t* model) {
+	if (scene->draw_count == scene->draw_capacity) {
+		int capacity = __max(scene->draw_capacity * 2, 64);
+		scene->draws = drawGrowArray(scene, scene->draws, sizeof(scene_draw_t), capacity);
+		scene->draw_transforms = drawGrowArray(scene, scene->draw_transforms, sizeof(transform_t), capacity);
+		// matrices are rebuilt every frame, nothing to keep
+		heapFree(scene->heap, scene->draw_matrices);
+		scene->draw_matrices = heapAlloc(scene->heap, sizeof(mat4f_t) * capacity, 16);
+		scene->draw_capacity = capacity;
+	}
+	scene->draws[scene->draw_count] = (scene_draw_t){ .entity = entity, .model = model };
+	scene->draw_transforms[scene->draw_count] = *transform;
+	scene->draw_count++;
+}
+
 static void drawModels(scene_t* scene) {
+	// gather every model with its world space bounding sphere
+	scene->draw_count = 0;
+	cullClear(scene->cull);
+	uint64_t QUERY_MODEL_MASK = (1ULL << scene->transform_type) | (1ULL << scene->model_type);
+	for (ecs_query_t query = ecsQueryCreate(scene->ecs, QUERY_MODEL_MASK);
+		ecsQueryValid(scene->ecs, &query);
+		ecsQueryNext(scene->ecs, &query)) {
+
+		transform_component_t* transform_comp = ecsQueryGetComponent(scene->ecs, &query, scene->transform_type);
+		model_component_t* model_comp = ecsQueryGetComponent(scene->ecs, &query, scene->model_type);
+		const transform_t* transform = &transform_comp->transform;
+		drawAdd(scene, ecsQueryGetEntity(scene->ecs, &query), transform, model_comp);
+
+		vec3f_t center;
+		float radius;
+		modelWorldBounds(transform, model_comp, &center, &radius);
+		cullSphereAdd(scene->cull, center, radius);
+	}
+	transformConvertToMatricesParallel(scene->job_pool, scene->draw_transforms, sizeof(transform_t), scene->draw_matrices, scene->draw_count);
+
 	uint64_t QUERY_CAMERA_MASK = (1ULL << scene->camera_type);
 	for (ecs_query_t camera_query = ecsQueryCreate(scene->ecs, QUERY_CAMERA_MASK);
 		ecsQueryValid(scene->ecs, &camera_query);
 		ecsQueryNext(scene->ecs, &camera_query)) {
 			
 		camera_component_t* camera_component = ecsQueryGetComponent(scene->ecs, &camera_query, scene->camera_type);
-		uint64_t QUERY_MODEL_MASK = (1ULL << scene->transform_type) | (1ULL << scene->model_type);
 
-		for (ecs_query_t query = ecsQueryCreate(scene->ecs, QUERY_MODEL_MASK);
-			ecsQueryValid(scene->ecs, &query);
-			ecsQueryNext(scene->ecs, &query)) {
-			
-			transform_component_t* transform_comp = ecsQueryGetComponent(scene->ecs, &query, scene->transform_type);
-			model_component_t* model_comp = ecsQueryGetComponent(scene->ecs, &query, scene->model_type);
-			ecs_entity_t ent = ecsQueryGetEntity(scene->ecs, &query);
+		cull_frustum_t frustum;
+		cullFrustumFromMatrices(&frustum, &camera_component->projection, &camera_component->view);
+		int visible_count = cullRun(scene->cull, &frustum, scene->job_pool);
+		const int* visible = cullGetVisible(scene->cull);
+
+		// shared by every instanced draw, instanced shaders read the model matrix per instance
+		struct {
+			mat4f_t projection;
+			mat4f_t view;
+		} batch_data;
+		batch_data.projection = camera_component->projection;
+		batch_data.view = camera_component->view;
+		gpu_uniform_buffer_info_t batch_info = {
+			.data = &batch_data, sizeof(batch_data)
+		};
+
+		for (int x = 0; x < visible_count; x++) {
+			int draw_index = visible[x];
+			scene_draw_t* draw = &scene->draws[draw_index];
+			if (draw->model->shader_info->instance_stride == sizeof(mat4f_t)) {
+				// the renderer packs every instance of the mesh into one draw
+				rendererModelInstanceAdd(scene->render, draw->model->mesh_info, draw->model->shader_info, &batch_info, &scene->draw_matrices[draw_index]);
+				continue;
+			}
 
 			struct {
 				mat4f_t projection;
@@ -165,11 +261,12 @@ static void drawModels(scene_t* scene) {
 
 			uniform_data.projection = camera_component->projection;
 			uniform_data.view = camera_component->view;
-			transformConvertToMatrix(&transform_comp->transform, &uniform_data.model);
+			uniform_data.model = scene->draw_matrices[draw_index];
 			gpu_uniform_buffer_info_t uniform_info = {
 				.data = &uniform_data, sizeof(uniform_data)
 			};
-			rendererModelAdd(scene->render, &ent, model_comp->mesh_info, model_comp->shader_info, &uniform_info);
+			float depth = cullFrustumDepth(&frustum, scene->draw_transforms[draw_index].translation);
+			rendererModelAdd(scene->render, &draw->entity, draw->model->mesh_info, draw->model->shader_info, &uniform_info, depth);
 		}
 	}
-}
\ No newline at end of file
+}
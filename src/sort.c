@@ -0,0 +1,190 @@
+#include "sort.h"
+
+#include "heap.h"
+#include "job.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SORT_RADIX_BITS 8
+#define SORT_RADIX_SIZE (1 << SORT_RADIX_BITS)
+#define SORT_RADIX_PASSES (64 / SORT_RADIX_BITS)
+#define SORT_RADIX_BLOCK 16384						// keys per block of the parallel sort
+
+typedef struct sort_radix_job_t {
+	uint64_t* src_keys;
+	uint32_t* src_values;
+	uint64_t* dst_keys;
+	uint32_t* dst_values;
+	int count;
+	int shift;
+	uint32_t* block_histograms;						// SORT_RADIX_SIZE per block, then the scatter offsets of every block
+	uint64_t* block_bits;							// or and and of the keys of every block
+} sort_radix_job_t;
+
+static void sortRadixBitsJob(void* user, int begin, int end, int worker);
+static void sortRadixHistogramJob(void* user, int begin, int end, int worker);
+static void sortRadixScatterJob(void* user, int begin, int end, int worker);
+
+void sortRadix64(uint64_t* keys, uint32_t* values, uint64_t* keys_tmp, uint32_t* values_tmp, int count) {
+	if (count <= 1) {
+		return;
+	}
+
+	uint32_t histograms[SORT_RADIX_PASSES][SORT_RADIX_SIZE];
+	memset(histograms, 0, sizeof(histograms));
+	for (int x = 0; x < count; x++) {
+		uint64_t key = keys[x];
+		for (int pass = 0; pass < SORT_RADIX_PASSES; pass++) {
+			histograms[pass][(key >> (pass * SORT_RADIX_BITS)) & (SORT_RADIX_SIZE - 1)]++;
+		}
+	}
+
+	uint64_t* src_keys = keys;
+	uint32_t* src_values = values;
+	uint64_t* dst_keys = keys_tmp;
+	uint32_t* dst_values = values_tmp;
+
+	for (int pass = 0; pass < SORT_RADIX_PASSES; pass++) {
+		uint32_t* histogram = histograms[pass];
+		int shift = pass * SORT_RADIX_BITS;
+
+		// every key lands in the same bucket, this digit does not change the order
+		if (histogram[(src_keys[0] >> shift) & (SORT_RADIX_SIZE - 1)] == (uint32_t) count) {
+			continue;
+		}
+
+		uint32_t offset = 0;
+		for (int digit = 0; digit < SORT_RADIX_SIZE; digit++) {
+			uint32_t digit_count = histogram[digit];
+			histogram[digit] = offset;
+			offset += digit_count;
+		}
+
+		for (int x = 0; x < count; x++) {
+			uint32_t dst = histogram[(src_keys[x] >> shift) & (SORT_RADIX_SIZE - 1)]++;
+			dst_keys[dst] = src_keys[x];
+			dst_values[dst] = src_values[x];
+		}
+
+		uint64_t* swap_keys = src_keys;
+		src_keys = dst_keys;
+		dst_keys = swap_keys;
+		uint32_t* swap_values = src_values;
+		src_values = dst_values;
+		dst_values = swap_values;
+	}
+
+	// an odd number of passes leaves the result in the scratch arrays
+	if (src_keys != keys) {
+		memcpy(keys, src_keys, sizeof(uint64_t) * count);
+		memcpy(values, src_values, sizeof(uint32_t) * count);
+	}
+}
+
+void sortRadix64Parallel(uint64_t* keys, uint32_t* values, uint64_t* keys_tmp, uint32_t* values_tmp, int count, heap_t* heap, job_pool_t* pool) {
+	if (count <= SORT_RADIX_BLOCK) {
+		sortRadix64(keys, values, keys_tmp, values_tmp, count);
+		return;
+	}
+
+	int block_count = (count + SORT_RADIX_BLOCK - 1) / SORT_RADIX_BLOCK;
+	sort_radix_job_t job = {
+		.count = count,
+		.block_histograms = heapAlloc(heap, sizeof(uint32_t) * SORT_RADIX_SIZE * block_count, 16),
+		.block_bits = heapAlloc(heap, sizeof(uint64_t) * 2 * block_count, 16),
+	};
+
+	// a digit has to be sorted on only if some key bits in it differ
+	job.src_keys = keys;
+	jobPoolParallelFor(pool, block_count, 1, sortRadixBitsJob, &job);
+	uint64_t any = 0;
+	uint64_t all = ~0ULL;
+	for (int block = 0; block < block_count; block++) {
+		any |= job.block_bits[block * 2 + 0];
+		all &= job.block_bits[block * 2 + 1];
+	}
+	uint64_t differing = any ^ all;
+
+	job.src_values = values;
+	job.dst_keys = keys_tmp;
+	job.dst_values = values_tmp;
+	for (int pass = 0; pass < SORT_RADIX_PASSES; pass++) {
+		job.shift = pass * SORT_RADIX_BITS;
+		if (!((differing >> job.shift) & (SORT_RADIX_SIZE - 1))) {
+			continue;
+		}
+
+		// digit by digit, every block gets its keys after those of the blocks before it
+		jobPoolParallelFor(pool, block_count, 1, sortRadixHistogramJob, &job);
+		uint32_t offset = 0;
+		for (int digit = 0; digit < SORT_RADIX_SIZE; digit++) {
+			for (int block = 0; block < block_count; block++) {
+				uint32_t* histogram = job.block_histograms + block * SORT_RADIX_SIZE;
+				uint32_t digit_count = histogram[digit];
+				histogram[digit] = offset;
+				offset += digit_count;
+			}
+		}
+		jobPoolParallelFor(pool, block_count, 1, sortRadixScatterJob, &job);
+
+		uint64_t* swap_keys = job.src_keys;
+		job.src_keys = job.dst_keys;
+		job.dst_keys = swap_keys;
+		uint32_t* swap_values = job.src_values;
+		job.src_values = job.dst_values;
+		job.dst_values = swap_values;
+	}
+
+	if (job.src_keys != keys) {
+		memcpy(keys, job.src_keys, sizeof(uint64_t) * count);
+		memcpy(values, job.src_values, sizeof(uint32_t) * count);
+	}
+
+	heapFree(heap, job.block_bits);
+	heapFree(heap, job.block_histograms);
+}
+
+//  --------------------------------------------------------------------------
+//								      JOBS
+//
+
+static void sortRadixBitsJob(void* user, int begin, int end, int worker) {
+	sort_radix_job_t* job = user;
+	for (int block = begin; block < end; block++) {
+		int key_end = __min((block + 1) * SORT_RADIX_BLOCK, job->count);
+		uint64_t any = 0;
+		uint64_t all = ~0ULL;
+		for (int x = block * SORT_RADIX_BLOCK; x < key_end; x++) {
+			any |= job->src_keys[x];
+			all &= job->src_keys[x];
+		}
+		job->block_bits[block * 2 + 0] = any;
+		job->block_bits[block * 2 + 1] = all;
+	}
+}
+
+static void sortRadixHistogramJob(void* user, int begin, int end, int worker) {
+	sort_radix_job_t* job = user;
+	for (int block = begin; block < end; block++) {
+		uint32_t* histogram = job->block_histograms + block * SORT_RADIX_SIZE;
+		memset(histogram, 0, sizeof(uint32_t) * SORT_RADIX_SIZE);
+		int key_end = __min((block + 1) * SORT_RADIX_BLOCK, job->count);
+		for (int x = block * SORT_RADIX_BLOCK; x < key_end; x++) {
+			histogram[(job->src_keys[x] >> job->shift) & (SORT_RADIX_SIZE - 1)]++;
+		}
+	}
+}
+
+static void sortRadixScatterJob(void* user, int begin, int end, int worker) {
+	sort_radix_job_t* job = user;
+	for (int block = begin; block < end; block++) {
+		uint32_t* offsets = job->block_histograms + block * SORT_RADIX_SIZE;
+		int key_end = __min((block + 1) * SORT_RADIX_BLOCK, job->count);
+		for (int x = block * SORT_RADIX_BLOCK; x < key_end; x++) {
+			uint32_t dst = offsets[(job->src_keys[x] >> job->shift) & (SORT_RADIX_SIZE - 1)]++;
+			job->dst_keys[dst] = job->src_keys[x];
+			job->dst_values[dst] = job->src_values[x];
+		}
+	}
+}
@@ -0,0 +1,27 @@
+#ifndef __SORT_H__
+#define __SORT_H__
+
+#include <stdint.h>
+
+/* SORTING
+*	- LSD radix sort of 64 bit keys with a 32 bit value each (usually the index of what the key was built from)
+*	- 8 bit digits, all digit histograms are built in one pass over the keys and passes where
+*	  every key has the same digit are skipped, so keys that only use their low bits sort in few passes
+*	- stable, equal keys keep their order
+*	- the parallel sort splits the keys into blocks, every block builds its own histogram and scatters
+*	  its keys to offsets that come after those of the blocks before it, which keeps the sort stable
+*/
+
+typedef struct heap_t heap_t;
+typedef struct job_pool_t job_pool_t;
+
+// Sorts count keys ascending and moves their values along with them. keys_tmp and values_tmp
+// are scratch space of count entries, the result always ends up in keys and values.
+//
+void sortRadix64(uint64_t* keys, uint32_t* values, uint64_t* keys_tmp, uint32_t* values_tmp, int count);
+
+// Same as sortRadix64, but every pass runs on the job pool (NULL runs on the calling thread).
+//
+void sortRadix64Parallel(uint64_t* keys, uint32_t* values, uint64_t* keys_tmp, uint32_t* values_tmp, int count, heap_t* heap, job_pool_t* pool);
+
+#endif
@@ -0,0 +1,224 @@
+#include "spatial_hash.h"
+
+#include "atomic.h"
+#include "heap.h"
+#include "job.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SPATIAL_HASH_CHUNK 2048						// points per job
+#define SPATIAL_HASH_BLOCK 4096						// buckets per prefix sum block
+
+typedef struct spatial_hash_t {
+	heap_t* heap;
+	const vec3f_t* positions;
+	int count;
+	float cell_size;
+	float inv_cell_size;
+
+	int* point_buckets;								// bucket of every point
+	int* entries;									// point indices sorted by bucket
+	int point_capacity;
+
+	// bucket b holds entries[bucket_starts[b] .. bucket_starts[b + 1]]
+	int* bucket_starts;
+	int* bucket_cursors;							// counts, then the scatter position of every bucket
+	int bucket_count;								// power of 2
+	int bucket_capacity;
+
+	int* block_sums;								// bucket count sum per block, then the offset of every block
+} spatial_hash_t;
+
+static void spatialHashCountJob(void* user, int begin, int end, int worker);
+static void spatialHashBlockSumJob(void* user, int begin, int end, int worker);
+static void spatialHashBlockScanJob(void* user, int begin, int end, int worker);
+static void spatialHashScatterJob(void* user, int begin, int end, int worker);
+static void spatialHashSortJob(void* user, int begin, int end, int worker);
+
+spatial_hash_t* spatialHashCreate(heap_t* heap) {
+	spatial_hash_t* hash = heapAlloc(heap, sizeof(spatial_hash_t), 8);
+	memset(hash, 0, sizeof(*hash));
+	hash->heap = heap;
+	return hash;
+}
+
+void spatialHashDestroy(spatial_hash_t* hash) {
+	heapFree(hash->heap, hash->point_buckets);
+	heapFree(hash->heap, hash->entries);
+	heapFree(hash->heap, hash->bucket_starts);
+	heapFree(hash->heap, hash->bucket_cursors);
+	heapFree(hash->heap, hash->block_sums);
+	heapFree(hash->heap, hash);
+}
+
+static inline int spatialHashCell(const spatial_hash_t* hash, float v) {
+	return (int) floorf(v * hash->inv_cell_size);
+}
+
+static inline int spatialHashBucket(const spatial_hash_t* hash, int x, int y, int z) {
+	uint32_t h = ((uint32_t) x * 92837111u) ^ ((uint32_t) y * 689287499u) ^ ((uint32_t) z * 283923481u);
+	return (int) (h & (uint32_t) (hash->bucket_count - 1));
+}
+
+void spatialHashBuild(spatial_hash_t* hash, const vec3f_t* positions, int count, float cell_size, job_pool_t* pool) {
+	hash->positions = positions;
+	hash->count = count;
+	hash->cell_size = cell_size;
+	hash->inv_cell_size = 1.0f / cell_size;
+
+	// the content is rebuilt every time, so arrays that are too small are replaced and not grown
+	heap_t* heap = hash->heap;
+	if (count > hash->point_capacity) {
+		heapFree(heap, hash->point_buckets);
+		heapFree(heap, hash->entries);
+		hash->point_capacity = __max(count, hash->point_capacity * 2);
+		hash->point_buckets = heapAlloc(heap, sizeof(int) * hash->point_capacity, 16);
+		hash->entries = heapAlloc(heap, sizeof(int) * hash->point_capacity, 16);
+	}
+
+	int bucket_count = 1;
+	while (bucket_count < count * 2) {
+		bucket_count <<= 1;
+	}
+	int block_count = (bucket_count + SPATIAL_HASH_BLOCK - 1) / SPATIAL_HASH_BLOCK;
+	if (bucket_count + 1 > hash->bucket_capacity) {
+		heapFree(heap, hash->bucket_starts);
+		heapFree(heap, hash->bucket_cursors);
+		heapFree(heap, hash->block_sums);
+		hash->bucket_capacity = bucket_count + 1;
+		hash->bucket_starts = heapAlloc(heap, sizeof(int) * hash->bucket_capacity, 16);
+		hash->bucket_cursors = heapAlloc(heap, sizeof(int) * hash->bucket_capacity, 16);
+		hash->block_sums = heapAlloc(heap, sizeof(int) * block_count, 16);
+	}
+	hash->bucket_count = bucket_count;
+
+	// counting sort: count, prefix sum per block, prefix sum of the blocks, offset every block, scatter
+	memset(hash->bucket_cursors, 0, sizeof(int) * bucket_count);
+	jobPoolParallelFor(pool, count, SPATIAL_HASH_CHUNK, spatialHashCountJob, hash);
+	jobPoolParallelFor(pool, bucket_count, SPATIAL_HASH_BLOCK, spatialHashBlockSumJob, hash);
+	int offset = 0;
+	for (int block = 0; block < block_count; block++) {
+		int block_sum = hash->block_sums[block];
+		hash->block_sums[block] = offset;
+		offset += block_sum;
+	}
+	jobPoolParallelFor(pool, bucket_count, SPATIAL_HASH_BLOCK, spatialHashBlockScanJob, hash);
+	hash->bucket_starts[bucket_count] = count;
+	jobPoolParallelFor(pool, count, SPATIAL_HASH_CHUNK, spatialHashScatterJob, hash);
+
+	// the scatter order depends on the threads, sorting every bucket makes it deterministic
+	jobPoolParallelFor(pool, bucket_count, SPATIAL_HASH_BLOCK, spatialHashSortJob, hash);
+}
+
+int spatialHashQuery(const spatial_hash_t* hash, vec3f_t center, float radius, int* results, int max_results) {
+	if (hash->count == 0) {
+		return 0;
+	}
+
+	// a radius up to the cell size touches 3 cells per axis, 4 when rounding puts both ends on a cell border
+	radius = __min(radius, hash->cell_size);
+	const float radius_sqrd = radius * radius;
+	const int min_x = spatialHashCell(hash, center.x - radius), max_x = spatialHashCell(hash, center.x + radius);
+	const int min_y = spatialHashCell(hash, center.y - radius), max_y = spatialHashCell(hash, center.y + radius);
+	const int min_z = spatialHashCell(hash, center.z - radius), max_z = spatialHashCell(hash, center.z + radius);
+
+	int visited[64];
+	int visited_count = 0;
+	int found = 0;
+	for (int z = min_z; z <= max_z; z++) {
+		for (int y = min_y; y <= max_y; y++) {
+			for (int x = min_x; x <= max_x; x++) {
+				// cells that share a bucket are searched once
+				int bucket = spatialHashBucket(hash, x, y, z);
+				bool seen = false;
+				for (int v = 0; v < visited_count; v++) {
+					seen |= visited[v] == bucket;
+				}
+				if (seen) {
+					continue;
+				}
+				visited[visited_count++] = bucket;
+
+				for (int e = hash->bucket_starts[bucket]; e < hash->bucket_starts[bucket + 1]; e++) {
+					int point = hash->entries[e];
+					if (vec3fDistanceSqrd(center, hash->positions[point]) <= radius_sqrd) {
+						if (found < max_results) {
+							results[found] = point;
+						}
+						found++;
+					}
+				}
+			}
+		}
+	}
+	return found;
+}
+
+//  --------------------------------------------------------------------------
+//								      JOBS
+//
+
+static void spatialHashCountJob(void* user, int begin, int end, int worker) {
+	spatial_hash_t* hash = user;
+	for (int x = begin; x < end; x++) {
+		vec3f_t position = hash->positions[x];
+		int bucket = spatialHashBucket(hash, spatialHashCell(hash, position.x), spatialHashCell(hash, position.y), spatialHashCell(hash, position.z));
+		hash->point_buckets[x] = bucket;
+		atomicInc(&hash->bucket_cursors[bucket]);
+	}
+}
+
+// A pool that runs inline hands over the whole range, the block jobs split it into blocks again.
+static void spatialHashBlockSumJob(void* user, int begin, int end, int worker) {
+	spatial_hash_t* hash = user;
+	for (int block_begin = begin; block_begin < end; block_begin += SPATIAL_HASH_BLOCK) {
+		int block_end = __min(block_begin + SPATIAL_HASH_BLOCK, end);
+		int sum = 0;
+		for (int x = block_begin; x < block_end; x++) {
+			sum += hash->bucket_cursors[x];
+		}
+		hash->block_sums[block_begin / SPATIAL_HASH_BLOCK] = sum;
+	}
+}
+
+static void spatialHashBlockScanJob(void* user, int begin, int end, int worker) {
+	spatial_hash_t* hash = user;
+	for (int block_begin = begin; block_begin < end; block_begin += SPATIAL_HASH_BLOCK) {
+		int block_end = __min(block_begin + SPATIAL_HASH_BLOCK, end);
+		int offset = hash->block_sums[block_begin / SPATIAL_HASH_BLOCK];
+		for (int x = block_begin; x < block_end; x++) {
+			int bucket_count = hash->bucket_cursors[x];
+			hash->bucket_starts[x] = offset;
+			hash->bucket_cursors[x] = offset;
+			offset += bucket_count;
+		}
+	}
+}
+
+static void spatialHashScatterJob(void* user, int begin, int end, int worker) {
+	spatial_hash_t* hash = user;
+	for (int x = begin; x < end; x++) {
+		hash->entries[atomicInc(&hash->bucket_cursors[hash->point_buckets[x]])] = x;
+	}
+}
+
+// Buckets hold about two points, insertion sort is enough.
+static void spatialHashSortJob(void* user, int begin, int end, int worker) {
+	spatial_hash_t* hash = user;
+	for (int bucket = begin; bucket < end; bucket++) {
+		int* entries = hash->entries + hash->bucket_starts[bucket];
+		int count = hash->bucket_starts[bucket + 1] - hash->bucket_starts[bucket];
+		for (int x = 1; x < count; x++) {
+			int point = entries[x];
+			int y = x;
+			while (y > 0 && entries[y - 1] > point) {
+				entries[y] = entries[y - 1];
+				y--;
+			}
+			entries[y] = point;
+		}
+	}
+}
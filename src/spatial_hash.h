@@ -0,0 +1,41 @@
+#ifndef __SPATIAL_HASH_H__
+#define __SPATIAL_HASH_H__
+
+#include "vec3f.h"
+
+/* SPATIAL HASH
+*	- an infinite uniform grid of cubic cells hashed into a table of twice as many buckets as points,
+*	  so memory only depends on the point count and not on the extent of the points
+*	- a build is a counting sort of the point indices by bucket, run in parallel on a job pool:
+*	  bucket counts (atomic), blocked prefix sum, scatter (atomic), then each bucket is sorted by index
+*	  so the result does not depend on thread timing
+*	- the table is meant to be rebuilt whenever the points move (e.g. every physics substep)
+*	- different cells can share a bucket, queries always check the actual distance
+*/
+
+typedef struct spatial_hash_t spatial_hash_t;
+
+typedef struct heap_t heap_t;
+typedef struct job_pool_t job_pool_t;
+
+// Creates an empty spatial hash.
+//
+// RETURN: the new spatial hash
+spatial_hash_t* spatialHashCreate(heap_t* heap);
+
+// Destroys the spatial hash.
+//
+void spatialHashDestroy(spatial_hash_t* hash);
+
+// Sorts count points into cells of cell_size on the job pool (NULL runs on the calling thread).
+// The positions are referenced until the next build, they must stay valid for the queries.
+//
+void spatialHashBuild(spatial_hash_t* hash, const vec3f_t* positions, int count, float cell_size, job_pool_t* pool);
+
+// Finds the points within radius (at most the cell size) of center, the order only depends on the
+// positions. Safe to call from several threads at once.
+//
+// RETURN: the number of points found, only the first max_results are written to results
+int spatialHashQuery(const spatial_hash_t* hash, vec3f_t center, float radius, int* results, int max_results);
+
+#endif
@@ -8,8 +8,23 @@
 #include "thread.h"
 #include "heap.h"
 #include "fs.h"
+#include "hashtable.h"
+#include "sort.h"
+#include "cull.h"
+#include "job.h"
+#include "mat4f.h"
+#include "transform.h"
+#include "hierarchy.h"
+#include "vec3f_wide.h"
+#include "spatial_hash.h"
+#include "physics.h"
+#include "aabb_tree.h"
+#include "mesh_bvh.h"
+#include "gpu.h"
 
 #include <assert.h>
+#include <float.h>
+#include <math.h>
 #include <stdbool.h>
 
 #include <windows.h>
@@ -142,6 +157,1279 @@ void testLeakedHeapAllocation() {
 	// assert(!debugBacktraceManually());
 }
 
+// ================================================
+//					HASH TABLE TEST
+// ================================================
+void testHashTable(heap_t* heap) {
+	hasht_t* ht = hashTableCreate(heap, sizeof(int), sizeof(int), 4);
+
+	// grows several times past the reserved capacity
+	for (int x = 0; x < 10000; x++) {
+		int value = x * 3;
+		hashTableSet(ht, &x, &value);
+	}
+	assert(hashTableGetCount(ht) == 10000);
+	for (int x = 0; x < 10000; x++) {
+		int* value = hashTableGet(ht, &x);
+		assert(value && *value == x * 3);
+	}
+
+	// remove every other key, the rest must still be reachable past the tombstones
+	for (int x = 0; x < 10000; x += 2) {
+		assert(hashTableRemove(ht, &x));
+	}
+	assert(!hashTableRemove(ht, &(int){ 0 }));
+	assert(hashTableGetCount(ht) == 5000);
+	for (int x = 0; x < 10000; x++) {
+		int* value = hashTableGet(ht, &x);
+		assert((x & 1) ? (value && *value == x * 3) : value == NULL);
+	}
+
+	// reinserting reuses the freed slots
+	bool inserted;
+	for (int x = 0; x < 10000; x += 2) {
+		*(int*) hashTableInsert(ht, &x, &inserted) = -x;
+		assert(inserted);
+	}
+	hashTableInsert(ht, &(int){ 1 }, &inserted);
+	assert(!inserted && hashTableGetCount(ht) == 10000);
+
+	// every key is visited exactly once
+	int iterator = 0;
+	int visited = 0;
+	void* key;
+	void* value;
+	while (hashTableIterate(ht, &iterator, &key, &value)) {
+		int x = *(int*) key;
+		assert(*(int*) value == ((x & 1) ? x * 3 : -x));
+		visited++;
+	}
+	assert(visited == 10000);
+
+	hashTableClear(ht);
+	assert(hashTableGetCount(ht) == 0 && hashTableGet(ht, &(int){ 1 }) == NULL);
+	hashTableDestroy(ht);
+
+	// churn through far more keys than the table ever holds, deleted slots must be reclaimed
+	ht = hashTableCreate(heap, sizeof(int), sizeof(int), 64);
+	for (int x = 0; x < 100000; x++) {
+		hashTableSet(ht, &x, &x);
+		if (x >= 64) {
+			assert(hashTableRemove(ht, &(int){ x - 64 }));
+		}
+	}
+	assert(hashTableGetCount(ht) == 64);
+	for (int x = 100000 - 64; x < 100000; x++) {
+		int* value = hashTableGet(ht, &x);
+		assert(value && *value == x);
+	}
+	hashTableDestroy(ht);
+
+	debugPrint(DEBUG_PRINT_INFO, "Hash Table Test Success!\n");
+}
+
+// ================================================
+//					SORT TEST
+// ================================================
+void testSort(heap_t* heap) {
+	const int count = 10000;
+	uint64_t* keys = heapAlloc(heap, sizeof(uint64_t) * count * 2, 8);
+	uint32_t* values = heapAlloc(heap, sizeof(uint32_t) * count * 2, 8);
+
+	// few distinct keys spread over every byte, equal keys have to keep their order
+	uint64_t state = 0x9e3779b97f4a7c15ULL;
+	for (int x = 0; x < count; x++) {
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		keys[x] = (state >> 60) * 0x0101010101010101ULL;
+		values[x] = x;
+	}
+	sortRadix64(keys, values, keys + count, values + count, count);
+	for (int x = 1; x < count; x++) {
+		assert(keys[x - 1] < keys[x] || (keys[x - 1] == keys[x] && values[x - 1] < values[x]));
+	}
+
+	// keys that only differ in their low byte sort in a single pass (the result ends up in the scratch half first)
+	for (int x = 0; x < count; x++) {
+		keys[x] = 0xab00000000000000ULL | (uint64_t) ((count - x) & 0xff);
+		values[x] = x;
+	}
+	sortRadix64(keys, values, keys + count, values + count, count);
+	for (int x = 1; x < count; x++) {
+		assert(keys[x - 1] < keys[x] || (keys[x - 1] == keys[x] && values[x - 1] < values[x]));
+	}
+
+	heapFree(heap, values);
+	heapFree(heap, keys);
+
+	// the parallel sort gives the same result as the serial one, blocks keep equal keys in order too
+	const int parallel_count = 100000;
+	job_pool_t* pool = jobPoolCreate(heap, 4);
+	uint64_t* parallel_keys = heapAlloc(heap, sizeof(uint64_t) * parallel_count * 2, 8);
+	uint32_t* parallel_values = heapAlloc(heap, sizeof(uint32_t) * parallel_count * 2, 8);
+	uint64_t* serial_keys = heapAlloc(heap, sizeof(uint64_t) * parallel_count * 2, 8);
+	uint32_t* serial_values = heapAlloc(heap, sizeof(uint32_t) * parallel_count * 2, 8);
+	for (int x = 0; x < parallel_count; x++) {
+		state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+		parallel_keys[x] = serial_keys[x] = (state >> 20) & 0x00ff00ff0000ffffULL;
+		parallel_values[x] = serial_values[x] = x;
+	}
+	sortRadix64Parallel(parallel_keys, parallel_values, parallel_keys + parallel_count, parallel_values + parallel_count, parallel_count, heap, pool);
+	sortRadix64(serial_keys, serial_values, serial_keys + parallel_count, serial_values + parallel_count, parallel_count);
+	assert(memcmp(parallel_keys, serial_keys, sizeof(uint64_t) * parallel_count) == 0);
+	assert(memcmp(parallel_values, serial_values, sizeof(uint32_t) * parallel_count) == 0);
+
+	heapFree(heap, serial_values);
+	heapFree(heap, serial_keys);
+	heapFree(heap, parallel_values);
+	heapFree(heap, parallel_keys);
+	jobPoolDestroy(pool);
+
+	debugPrint(DEBUG_PRINT_INFO, "Sort Test Success!\n");
+}
+
+// ================================================
+//					MATH TEST
+// ================================================
+static uint32_t s_test_math_state = 4242;
+
+static float testRandom(uint32_t* state, float min, float max) {
+	*state = *state * 1664525u + 1013904223u;
+	return min + ((*state >> 8) / (float) (1 << 24)) * (max - min);
+}
+
+static float testMathRandom(float min, float max) {
+	return testRandom(&s_test_math_state, min, max);
+}
+
+// A result is within ulps units in the last place of the double precision reference, measured
+// at scale (the magnitude of the terms that were summed) so values that cancel to near zero pass.
+static bool testMathWithinUlps(float result, double reference, double scale, int ulps) {
+	return fabs((double) result - reference) <= ulps * (double) FLT_EPSILON * __max(fabs(reference), scale);
+}
+
+// Gauss-Jordan elimination with partial pivoting in double precision.
+static void testMathInverseReference(const mat4f_t* m, double inverse[4][4]) {
+	double work[4][8];
+	for (int r = 0; r < 4; r++) {
+		for (int c = 0; c < 4; c++) {
+			work[r][c] = m->mat[c][r];
+			work[r][c + 4] = r == c ? 1.0 : 0.0;
+		}
+	}
+	for (int c = 0; c < 4; c++) {
+		int pivot = c;
+		for (int r = c + 1; r < 4; r++) {
+			if (fabs(work[r][c]) > fabs(work[pivot][c])) {
+				pivot = r;
+			}
+		}
+		for (int k = 0; k < 8; k++) {
+			double swap = work[c][k];
+			work[c][k] = work[pivot][k];
+			work[pivot][k] = swap;
+		}
+		double inv_pivot = 1.0 / work[c][c];
+		for (int k = 0; k < 8; k++) {
+			work[c][k] *= inv_pivot;
+		}
+		for (int r = 0; r < 4; r++) {
+			if (r != c) {
+				double factor = work[r][c];
+				for (int k = 0; k < 8; k++) {
+					work[r][k] -= factor * work[c][k];
+				}
+			}
+		}
+	}
+	for (int r = 0; r < 4; r++) {
+		for (int c = 0; c < 4; c++) {
+			inverse[c][r] = work[r][c + 4];
+		}
+	}
+}
+
+static void testMathRandomTransform(transform_t* transform) {
+	transform->translation = (vec3f_t) { testMathRandom(-10.0f, 10.0f), testMathRandom(-10.0f, 10.0f), testMathRandom(-10.0f, 10.0f) };
+	transform->scale = (vec3f_t) { testMathRandom(0.5f, 2.0f), testMathRandom(0.5f, 2.0f), testMathRandom(0.5f, 2.0f) };
+	transform->rotation = quatfFromEuler((vec3f_t) { testMathRandom(-3.0f, 3.0f), testMathRandom(-3.0f, 3.0f), testMathRandom(-3.0f, 3.0f) });
+}
+
+void testMath() {
+	const int rounds = 1000;
+	for (int round = 0; round < rounds; round++) {
+		// mat4fMul against a double precision product
+		mat4f_t a, b, res;
+		for (int c = 0; c < 4; c++) {
+			for (int r = 0; r < 4; r++) {
+				a.mat[c][r] = testMathRandom(-2.0f, 2.0f);
+				b.mat[c][r] = testMathRandom(-2.0f, 2.0f);
+			}
+		}
+		mat4fMul(&res, &a, &b);
+		for (int c = 0; c < 4; c++) {
+			for (int r = 0; r < 4; r++) {
+				double reference = 0.0, scale = 0.0;
+				for (int k = 0; k < 4; k++) {
+					reference += (double) a.mat[k][r] * b.mat[c][k];
+					scale += fabs((double) a.mat[k][r] * b.mat[c][k]);
+				}
+				assert(testMathWithinUlps(res.mat[c][r], reference, scale, 4));
+			}
+		}
+
+		// in place multiply on either side
+		mat4f_t in_place = a;
+		mat4fMul(&in_place, &in_place, &b);
+		assert(memcmp(&in_place, &res, sizeof(res)) == 0);
+		in_place = b;
+		mat4fMul(&in_place, &a, &in_place);
+		assert(memcmp(&in_place, &res, sizeof(res)) == 0);
+
+		// mat4fInverse of a well conditioned matrix against double precision Gauss-Jordan
+		transform_t transform;
+		testMathRandomTransform(&transform);
+		mat4f_t m, inverse;
+		transformConvertToMatrix(&transform, &m);
+		assert(mat4fInverse(&m, &inverse));
+		double reference[4][4];
+		testMathInverseReference(&m, reference);
+		double inverse_scale = 0.0;
+		for (int c = 0; c < 4; c++) {
+			for (int r = 0; r < 4; r++) {
+				inverse_scale = __max(inverse_scale, fabs(reference[c][r]));
+			}
+		}
+		for (int c = 0; c < 4; c++) {
+			for (int r = 0; r < 4; r++) {
+				assert(testMathWithinUlps(inverse.mat[c][r], reference[c][r], inverse_scale, 64));
+			}
+		}
+
+		// quatfMul against a double precision Hamilton product
+		quatf_t qa = quatfFromEuler((vec3f_t) { testMathRandom(-3.0f, 3.0f), testMathRandom(-3.0f, 3.0f), testMathRandom(-3.0f, 3.0f) });
+		quatf_t qb = quatfFromEuler((vec3f_t) { testMathRandom(-3.0f, 3.0f), testMathRandom(-3.0f, 3.0f), testMathRandom(-3.0f, 3.0f) });
+		quatf_t q = quatfMul(qa, qb);
+		double q_reference[4] = {
+			(double) qa.s * qb.s - (double) qa.x * qb.x - (double) qa.y * qb.y - (double) qa.z * qb.z,
+			(double) qa.s * qb.x + (double) qa.x * qb.s + (double) qa.y * qb.z - (double) qa.z * qb.y,
+			(double) qa.s * qb.y - (double) qa.x * qb.z + (double) qa.y * qb.s + (double) qa.z * qb.x,
+			(double) qa.s * qb.z + (double) qa.x * qb.y - (double) qa.y * qb.x + (double) qa.z * qb.s,
+		};
+		assert(testMathWithinUlps(q.s, q_reference[0], 1.0, 4));
+		assert(testMathWithinUlps(q.x, q_reference[1], 1.0, 4));
+		assert(testMathWithinUlps(q.y, q_reference[2], 1.0, 4));
+		assert(testMathWithinUlps(q.z, q_reference[3], 1.0, 4));
+
+		// quatfRotateVec against the rotation matrix of the quaternion, in double precision
+		vec3f_t v = { testMathRandom(-5.0f, 5.0f), testMathRandom(-5.0f, 5.0f), testMathRandom(-5.0f, 5.0f) };
+		vec3f_t rotated = quatfRotateVec(q, v);
+		double w = q.s, x = q.x, y = q.y, z = q.z;
+		double rotation[3][3] = {
+			{ 1.0 - 2.0 * (y * y + z * z), 2.0 * (x * y - w * z), 2.0 * (x * z + w * y) },
+			{ 2.0 * (x * y + w * z), 1.0 - 2.0 * (x * x + z * z), 2.0 * (y * z - w * x) },
+			{ 2.0 * (x * z - w * y), 2.0 * (y * z + w * x), 1.0 - 2.0 * (x * x + y * y) },
+		};
+		double v_scale = vec3fMagnitude(v);
+		for (int r = 0; r < 3; r++) {
+			double reference_r = rotation[r][0] * v.x + rotation[r][1] * v.y + rotation[r][2] * v.z;
+			assert(testMathWithinUlps(rotated.v[r], reference_r, v_scale, 16));
+		}
+
+		// the matrix of a rotation moves a point like the quaternion does
+		mat4f_t rotation_matrix;
+		mat4fMakeRotation(&rotation_matrix, &q);
+		vec3f_t matrix_rotated;
+		mat4fTransform(&rotation_matrix, &v, &matrix_rotated);
+		assert(vec3fDistance(rotated, matrix_rotated) < 1e-4f);
+
+		// translation * model matches the model moved by the translation, and the inverse undoes it
+		mat4f_t translation, combined;
+		mat4fMakeTranslation(&translation, &v);
+		mat4fMul(&combined, &translation, &m);
+		vec3f_t point = { testMathRandom(-1.0f, 1.0f), testMathRandom(-1.0f, 1.0f), testMathRandom(-1.0f, 1.0f) };
+		vec3f_t moved, expected;
+		mat4fTransform(&combined, &point, &moved);
+		expected = vec3fAdd(transformTransformVec3f(&transform, point), v);
+		assert(vec3fDistance(moved, expected) < 1e-4f);
+		vec3f_t model_point = vec3fSub(expected, v);
+		mat4fTransformInplace(&inverse, &model_point);
+		assert(vec3fDistance(model_point, point) < 1e-4f);
+
+		// vec3f ops against double precision
+		vec3f_t u = { testMathRandom(-5.0f, 5.0f), testMathRandom(-5.0f, 5.0f), testMathRandom(-5.0f, 5.0f) };
+		vec3f_t neg = vec3fNeg(u);
+		assert(neg.x == -u.x && neg.y == -u.y && neg.z == -u.z);
+		double dx = (double) v.x - u.x, dy = (double) v.y - u.y, dz = (double) v.z - u.z;
+		assert(testMathWithinUlps(vec3fDistanceSqrd(u, v), dx * dx + dy * dy + dz * dz, 0.0, 4));
+		vec3f_t cross = vec3fCross(u, v);
+		assert(testMathWithinUlps(cross.x, (double) u.y * v.z - (double) u.z * v.y, fabs((double) u.y * v.z) + fabs((double) u.z * v.y), 2));
+		assert(testMathWithinUlps(cross.y, (double) u.z * v.x - (double) u.x * v.z, fabs((double) u.z * v.x) + fabs((double) u.x * v.z), 2));
+		assert(testMathWithinUlps(cross.z, (double) u.x * v.y - (double) u.y * v.x, fabs((double) u.x * v.y) + fabs((double) u.y * v.x), 2));
+	}
+
+	// a singular matrix has no inverse
+	mat4f_t singular, unused;
+	mat4fZero(&singular);
+	assert(!mat4fInverse(&singular, &unused));
+
+	debugPrint(DEBUG_PRINT_INFO, "Math Test Success!\n");
+}
+
+// ================================================
+//					WIDE VECTOR TEST
+// ================================================
+static bool testVec3fWideEqual(vec3f_t a, vec3f_t b) {
+	return almostEqualf(a.x, b.x) && almostEqualf(a.y, b.y) && almostEqualf(a.z, b.z);
+}
+
+void testVec3fWide() {
+#if VEC3F_XN_WIDTH
+	enum { count = 64 };
+	vec3f_t a[count], b[count], res[count];
+	float f[count];
+	int indices[count];
+	for (int x = 0; x < count; x++) {
+		a[x] = (vec3f_t) { testMathRandom(-10.0f, 10.0f), testMathRandom(-10.0f, 10.0f), testMathRandom(-10.0f, 10.0f) };
+		b[x] = (vec3f_t) { testMathRandom(-10.0f, 10.0f), testMathRandom(-10.0f, 10.0f), testMathRandom(-10.0f, 10.0f) };
+		f[x] = testMathRandom(0.0f, 1.0f);
+		indices[x] = x;
+	}
+	a[5] = vec3fZero();
+	// scattered indices, every index once
+	for (int x = count - 1; x > 0; x--) {
+		int y = (int) testMathRandom(0.0f, (float) x + 0.99f);
+		int swap = indices[x];
+		indices[x] = indices[y];
+		indices[y] = swap;
+	}
+
+	// every lane matches the scalar op on the same vectors
+	for (int x = 0; x < count; x += VEC3F_XN_WIDTH) {
+		vec3f_xn_t wide_a = vec3fxnGather(a, indices + x);
+		vec3f_xn_t wide_b = vec3fxnLoad(b + x);
+		float_xn_t wide_f = floatxnGather(f, indices + x);
+		vec3f_t lanes[VEC3F_XN_WIDTH];
+		float lanes_f[VEC3F_XN_WIDTH];
+
+#define TEST_VEC3F_WIDE_LANES(wide_op, scalar_op) \
+		vec3fxnStore(lanes, wide_op); \
+		for (int lane = 0; lane < VEC3F_XN_WIDTH; lane++) { \
+			vec3f_t va = a[indices[x + lane]], vb = b[x + lane]; float vf = f[indices[x + lane]]; \
+			assert(testVec3fWideEqual(lanes[lane], scalar_op)); \
+		}
+#define TEST_VEC3F_WIDE_LANES_F(wide_op, scalar_op) \
+		floatxnStore(lanes_f, wide_op); \
+		for (int lane = 0; lane < VEC3F_XN_WIDTH; lane++) { \
+			vec3f_t va = a[indices[x + lane]], vb = b[x + lane]; \
+			assert(almostEqualf(lanes_f[lane], scalar_op)); \
+		}
+
+		TEST_VEC3F_WIDE_LANES(wide_a, va);
+		TEST_VEC3F_WIDE_LANES(vec3fxnSplat(b[0]), b[0]);
+		TEST_VEC3F_WIDE_LANES(vec3fxnNeg(wide_a), vec3fNeg(va));
+		TEST_VEC3F_WIDE_LANES(vec3fxnAdd(wide_a, wide_b), vec3fAdd(va, vb));
+		TEST_VEC3F_WIDE_LANES(vec3fxnSub(wide_a, wide_b), vec3fSub(va, vb));
+		TEST_VEC3F_WIDE_LANES(vec3fxnMul(wide_a, wide_b), vec3fMul(va, vb));
+		TEST_VEC3F_WIDE_LANES(vec3fxnMin(wide_a, wide_b), vec3fMin(va, vb));
+		TEST_VEC3F_WIDE_LANES(vec3fxnMax(wide_a, wide_b), vec3fMax(va, vb));
+		TEST_VEC3F_WIDE_LANES(vec3fxnScale(wide_a, wide_f), vec3fScale(va, vf));
+		TEST_VEC3F_WIDE_LANES(vec3fxnLerp(wide_a, wide_b, wide_f), vec3fLerp(va, vb, vf));
+		TEST_VEC3F_WIDE_LANES(vec3fxnCross(wide_a, wide_b), vec3fCross(va, vb));
+		TEST_VEC3F_WIDE_LANES(vec3fxnNorm(wide_a), vec3fNorm(va));
+		TEST_VEC3F_WIDE_LANES_F(vec3fxnDot(wide_a, wide_b), vec3fDot(va, vb));
+		TEST_VEC3F_WIDE_LANES_F(vec3fxnMagnitude(wide_a), vec3fMagnitude(va));
+		TEST_VEC3F_WIDE_LANES_F(vec3fxnDistanceSqrd(wide_a, wide_b), vec3fDistanceSqrd(va, vb));
+		TEST_VEC3F_WIDE_LANES_F(vec3fxnDistance(wide_a, wide_b), vec3fDistance(va, vb));
+
+#undef TEST_VEC3F_WIDE_LANES
+#undef TEST_VEC3F_WIDE_LANES_F
+
+		// scatter writes every lane back to the index it was gathered from
+		vec3fxnScatter(res, indices + x, wide_a);
+	}
+	for (int x = 0; x < count; x++) {
+		assert(memcmp(&res[x], &a[x], sizeof(vec3f_t)) == 0);
+	}
+#endif
+
+	debugPrint(DEBUG_PRINT_INFO, "Wide Vector Test Success!\n");
+}
+
+// ================================================
+//					CULL TEST
+// ================================================
+void testCull(heap_t* heap) {
+	cull_t* cull = cullCreate(heap);
+	job_pool_t* pool = jobPoolCreate(heap, 4);
+
+	// identity matrices give the clip space box as frustum, -1 to 1 in x and y and 0 to 1 in z
+	mat4f_t identity;
+	mat4fMakeIdentity(&identity);
+	cull_frustum_t frustum;
+	cullFrustumFromMatrices(&frustum, &identity, &identity);
+
+	// enough spheres for several chunks and a SIMD tail
+	const int count = 5003;
+	uint32_t state = 12345;
+	for (int x = 0; x < count; x++) {
+		vec3f_t center;
+		float* components = &center.x;
+		for (int c = 0; c < 3; c++) {
+			state = state * 1664525u + 1013904223u;
+			components[c] = ((state >> 8) / (float) (1 << 24)) * 6.0f - 3.0f;
+		}
+		state = state * 1664525u + 1013904223u;
+		cullSphereAdd(cull, center, ((state >> 8) / (float) (1 << 24)) * 0.5f);
+	}
+
+	int visible_count = cullRun(cull, &frustum, pool);
+	const int* visible = cullGetVisible(cull);
+	assert(visible_count > 0 && visible_count < count);
+
+	// same result as testing every sphere against the cube one by one, in ascending order
+	state = 12345;
+	int expected_count = 0;
+	for (int x = 0; x < count; x++) {
+		float center[3];
+		for (int c = 0; c < 3; c++) {
+			state = state * 1664525u + 1013904223u;
+			center[c] = ((state >> 8) / (float) (1 << 24)) * 6.0f - 3.0f;
+		}
+		state = state * 1664525u + 1013904223u;
+		float radius = ((state >> 8) / (float) (1 << 24)) * 0.5f;
+
+		bool inside = center[2] >= -radius && center[2] <= 1.0f + radius;
+		for (int c = 0; c < 2; c++) {
+			inside &= fabsf(center[c]) <= 1.0f + radius;
+		}
+		if (inside) {
+			assert(expected_count < visible_count && visible[expected_count] == x);
+			expected_count++;
+		}
+	}
+	assert(expected_count == visible_count);
+
+	// a box just outside of the right plane, then one that touches it
+	cullClear(cull);
+	cullBoxAdd(cull, (vec3f_t) { 1.5f, -0.1f, -0.1f }, (vec3f_t) { 1.7f, 0.1f, 0.1f });
+	cullBoxAdd(cull, (vec3f_t) { 0.9f, -0.1f, -0.1f }, (vec3f_t) { 1.1f, 0.1f, 0.1f });
+	assert(cullRun(cull, &frustum, NULL) == 1);
+	assert(cullGetVisible(cull)[0] == 1);
+
+	// the near plane is z = 0 in this frustum
+	assert(fabsf(cullFrustumDepth(&frustum, (vec3f_t) { 0.0f, 0.0f, 0.5f }) - 0.5f) < 1e-6f);
+
+	// a perspective camera keeps what lies between its near and far distance in front of it
+	mat4f_t projection;
+	mat4fMakePerspective(&projection, 1.0f, 1.0f, 0.5f, 10.0f);
+	cullFrustumFromMatrices(&frustum, &projection, &identity);
+	cullClear(cull);
+	cullSphereAdd(cull, (vec3f_t) { 0.0f, 0.0f, -0.6f }, 0.05f);
+	cullSphereAdd(cull, (vec3f_t) { 0.0f, 0.0f, -0.3f }, 0.05f);
+	cullSphereAdd(cull, (vec3f_t) { 0.0f, 0.0f, -9.0f }, 0.05f);
+	cullSphereAdd(cull, (vec3f_t) { 0.0f, 0.0f, -11.0f }, 0.05f);
+	assert(cullRun(cull, &frustum, NULL) == 2);
+	assert(cullGetVisible(cull)[0] == 0 && cullGetVisible(cull)[1] == 2);
+	assert(fabsf(cullFrustumDepth(&frustum, (vec3f_t) { 0.0f, 0.0f, -2.5f }) - 2.0f) < 1e-5f);
+
+	jobPoolDestroy(pool);
+	cullDestroy(cull);
+
+	debugPrint(DEBUG_PRINT_INFO, "Cull Test Success!\n");
+}
+
+// ================================================
+//					TRANSFORM TEST
+// ================================================
+void testTransform(heap_t* heap) {
+	// a count that leaves a tail for every SIMD width, read through a stride larger than a transform
+	const int count = 1003;
+	typedef struct padded_transform_t {
+		transform_t transform;
+		int padding;
+	} padded_transform_t;
+	padded_transform_t* transforms = heapAlloc(heap, sizeof(padded_transform_t) * count, 8);
+	mat4f_t* matrices = heapAlloc(heap, sizeof(mat4f_t) * count, 16);
+	mat4f_t* parallel_matrices = heapAlloc(heap, sizeof(mat4f_t) * count, 16);
+
+	uint32_t state = 777;
+	float values[10];
+	for (int x = 0; x < count; x++) {
+		for (int v = 0; v < _countof(values); v++) {
+			state = state * 1664525u + 1013904223u;
+			values[v] = ((state >> 8) / (float) (1 << 24)) * 4.0f - 2.0f;
+		}
+		transform_t* transform = &transforms[x].transform;
+		transform->translation = (vec3f_t) { values[0], values[1], values[2] };
+		transform->scale = (vec3f_t) { values[3], values[4], values[5] };
+		transform->rotation = quatfFromEuler((vec3f_t) { values[6], values[7], values[8] });
+	}
+
+	transformConvertToMatrices(&transforms[0].transform, sizeof(padded_transform_t), matrices, count);
+	job_pool_t* pool = jobPoolCreate(heap, 4);
+	transformConvertToMatricesParallel(pool, &transforms[0].transform, sizeof(padded_transform_t), parallel_matrices, count);
+	jobPoolDestroy(pool);
+
+	for (int x = 0; x < count; x++) {
+		// the batch matches the single conversion
+		mat4f_t single;
+		transformConvertToMatrix(&transforms[x].transform, &single);
+		for (int c = 0; c < 4; c++) {
+			for (int r = 0; r < 4; r++) {
+				assert(fabsf(single.mat[c][r] - matrices[x].mat[c][r]) < 1e-5f);
+				assert(parallel_matrices[x].mat[c][r] == matrices[x].mat[c][r]);
+			}
+		}
+
+		// and a point moved by the matrix (column major) ends up where the transform puts it
+		vec3f_t point = { 0.5f, -1.0f, 2.0f };
+		vec3f_t expected = transformTransformVec3f(&transforms[x].transform, point);
+		float* expected_components = &expected.x;
+		for (int r = 0; r < 3; r++) {
+			float result = single.mat[0][r] * point.x + single.mat[1][r] * point.y + single.mat[2][r] * point.z + single.mat[3][r];
+			assert(fabsf(result - expected_components[r]) < 1e-4f);
+		}
+	}
+
+	heapFree(heap, parallel_matrices);
+	heapFree(heap, matrices);
+	heapFree(heap, transforms);
+
+	debugPrint(DEBUG_PRINT_INFO, "Transform Test Success!\n");
+}
+
+// ================================================
+//					HIERARCHY TEST
+// ================================================
+static void testHierarchyCheckPoint(const transform_t* world, const transform_t** chain, int chain_count) {
+	// the world transform moves a point like the local transforms do one after another (child first)
+	vec3f_t point = { 0.25f, 1.0f, -0.5f };
+	vec3f_t expected = point;
+	for (int x = chain_count - 1; x >= 0; x--) {
+		expected = transformTransformVec3f(chain[x], expected);
+	}
+	vec3f_t result = transformTransformVec3f(world, point);
+	assert(vec3fDistance(result, expected) < 1e-4f);
+}
+
+void testHierarchy(heap_t* heap) {
+	hierarchy_t* hierarchy = hierarchyCreate(heap);
+
+	transform_t root_local = { .translation = { 1.0f, 2.0f, 3.0f }, .scale = { 2.0f, 2.0f, 2.0f }, .rotation = quatfFromEuler((vec3f_t) { 0.3f, 0.0f, 1.2f }) };
+	transform_t child_local = { .translation = { 0.0f, 1.0f, 0.0f }, .scale = { 0.5f, 0.5f, 0.5f }, .rotation = quatfFromEuler((vec3f_t) { 0.0f, 0.7f, 0.0f }) };
+	transform_t grandchild_local = { .translation = { 2.0f, 0.0f, -1.0f }, .scale = { 1.0f, 3.0f, 1.0f }, .rotation = quatfFromEuler((vec3f_t) { 1.0f, 0.5f, -0.2f }) };
+	transform_t other_local;
+	transformIdentity(&other_local);
+	other_local.translation = (vec3f_t) { -4.0f, 0.0f, 0.0f };
+
+	// added depth first, the update puts them in breadth-first order
+	transform_t grandchild_out;
+	int root = hierarchyNodeAdd(hierarchy, HIERARCHY_NODE_NONE, &root_local, NULL);
+	int child = hierarchyNodeAdd(hierarchy, root, &child_local, NULL);
+	int grandchild = hierarchyNodeAdd(hierarchy, child, &grandchild_local, &grandchild_out);
+	int other = hierarchyNodeAdd(hierarchy, HIERARCHY_NODE_NONE, &other_local, NULL);
+	assert(hierarchyNodeGetParent(hierarchy, grandchild) == child);
+	assert(hierarchyNodeGetParent(hierarchy, other) == HIERARCHY_NODE_NONE);
+
+	assert(hierarchyUpdate(hierarchy) == 4);
+	assert(hierarchyNodeGetParent(hierarchy, grandchild) == child);
+	const transform_t* chain[] = { &root_local, &child_local, &grandchild_local };
+	testHierarchyCheckPoint(hierarchyGetWorld(hierarchy, grandchild), chain, 3);
+	assert(memcmp(&grandchild_out, hierarchyGetWorld(hierarchy, grandchild), sizeof(transform_t)) == 0);
+
+	// nothing changed, nothing is recomputed
+	assert(hierarchyUpdate(hierarchy) == 0);
+
+	// only the changed subtree is recomputed
+	child_local.translation = (vec3f_t) { 0.0f, -2.0f, 5.0f };
+	hierarchySetLocal(hierarchy, child, &child_local);
+	assert(hierarchyUpdate(hierarchy) == 2);
+	testHierarchyCheckPoint(hierarchyGetWorld(hierarchy, grandchild), chain, 3);
+	assert(memcmp(&grandchild_out, hierarchyGetWorld(hierarchy, grandchild), sizeof(transform_t)) == 0);
+
+	// removing the child takes the grandchild with it, the other handles stay valid
+	hierarchyNodeRemove(hierarchy, child);
+	assert(hierarchyUpdate(hierarchy) == 0);
+	assert(hierarchyGetWorld(hierarchy, other)->translation.x == -4.0f);
+	testHierarchyCheckPoint(hierarchyGetWorld(hierarchy, root), chain, 1);
+
+	// freed handles are reused
+	int new_child = hierarchyNodeAdd(hierarchy, other, &child_local, NULL);
+	assert(new_child == child || new_child == grandchild);
+	assert(hierarchyUpdate(hierarchy) == 1);
+	const transform_t* other_chain[] = { &other_local, &child_local };
+	testHierarchyCheckPoint(hierarchyGetWorld(hierarchy, new_child), other_chain, 2);
+
+	hierarchyDestroy(hierarchy);
+
+	debugPrint(DEBUG_PRINT_INFO, "Hierarchy Test Success!\n");
+}
+
+// ================================================
+//					SPATIAL HASH TEST
+// ================================================
+static int testSpatialHashCompare(const void* a, const void* b) {
+	return *(const int*) a - *(const int*) b;
+}
+
+void testSpatialHash(heap_t* heap) {
+	spatial_hash_t* hash = spatialHashCreate(heap);
+	spatial_hash_t* hash_serial = spatialHashCreate(heap);
+	job_pool_t* pool = jobPoolCreate(heap, 4);
+
+	// enough points for several jobs, also at negative cell coordinates
+	const int count = 6007;
+	const float cell_size = 0.25f;
+	vec3f_t* positions = heapAlloc(heap, sizeof(vec3f_t) * count, 8);
+	for (int x = 0; x < count; x++) {
+		positions[x] = (vec3f_t) { testMathRandom(-2.0f, 2.0f), testMathRandom(-2.0f, 2.0f), testMathRandom(-2.0f, 2.0f) };
+	}
+	spatialHashBuild(hash, positions, count, cell_size, pool);
+	spatialHashBuild(hash_serial, positions, count, cell_size, NULL);
+
+	int found[256], found_serial[256], expected[256];
+	for (int query = 0; query < 500; query++) {
+		vec3f_t center = positions[(query * 37) % count];
+		center.x += testMathRandom(-0.1f, 0.1f);
+		float radius = testMathRandom(0.0f, cell_size);
+		int found_count = spatialHashQuery(hash, center, radius, found, _countof(found));
+		int expected_count = 0;
+		for (int x = 0; x < count; x++) {
+			if (vec3fDistanceSqrd(center, positions[x]) <= radius * radius) {
+				expected[expected_count++] = x;
+			}
+		}
+		assert(found_count == expected_count && found_count <= _countof(found));
+
+		// the threads do not change the order
+		assert(spatialHashQuery(hash_serial, center, radius, found_serial, _countof(found_serial)) == found_count);
+		assert(memcmp(found, found_serial, sizeof(int) * found_count) == 0);
+
+		qsort(found, found_count, sizeof(int), testSpatialHashCompare);
+		assert(memcmp(found, expected, sizeof(int) * found_count) == 0);
+	}
+
+	// results beyond max_results are counted but not written
+	assert(spatialHashQuery(hash, positions[0], cell_size, found, 0) >= 1);
+
+	// overlapping particles are pushed apart to touch each other, a pinned one does not move
+	physics_t* physics = physicsCreate(heap);
+	physicsSetGravity(physics, vec3fZero());
+	physicsSetSubsteps(physics, 1);
+	physicsSetParticleCollision(physics, 0.5f, 0.0f);
+	int a = physicsParticleAdd(physics, (vec3f_t) { 0.0f, 0.0f, 0.0f }, 1.0f);
+	int b = physicsParticleAdd(physics, (vec3f_t) { 0.6f, 0.0f, 0.0f }, 1.0f);
+	int pinned = physicsParticleAdd(physics, (vec3f_t) { 5.0f, 0.0f, 0.0f }, 0.0f);
+	int pushed = physicsParticleAdd(physics, (vec3f_t) { 5.8f, 0.0f, 0.0f }, 1.0f);
+	physicsUpdate(physics, 1.0f / 60.0f);
+	assert(fabsf(physicsParticleGetPosition(physics, a).x + 0.2f) < 1e-5f);
+	assert(fabsf(physicsParticleGetPosition(physics, b).x - 0.8f) < 1e-5f);
+	assert(physicsParticleGetPosition(physics, pinned).x == 5.0f);
+	assert(fabsf(physicsParticleGetPosition(physics, pushed).x - 6.0f) < 1e-5f);
+	assert(physicsGetConstraintCount(physics) == 3);
+	physicsDestroy(physics);
+
+	heapFree(heap, positions);
+	jobPoolDestroy(pool);
+	spatialHashDestroy(hash_serial);
+	spatialHashDestroy(hash);
+
+	debugPrint(DEBUG_PRINT_INFO, "Spatial Hash Test Success!\n");
+}
+
+// ================================================
+//				PHYSICS REORDER TEST
+// ================================================
+// Adds the same pendulums in random places to both worlds, every one only depends on itself. Both worlds
+// are updated for frames updates and every particle has to end up within tolerance (0 for bit identical).
+static void testPhysicsPendulums(physics_t* physics[2], int pendulum_count, int frames, float tolerance) {
+	for (int x = 0; x < pendulum_count; x++) {
+		vec3f_t pivot = { testMathRandom(0.0f, 100.0f), testMathRandom(0.0f, 100.0f), testMathRandom(0.0f, 100.0f) };
+		vec3f_t bob = vec3fAdd(pivot, (vec3f_t) { 0.5f, 0.0f, 0.0f });
+		for (int p = 0; p < 2; p++) {
+			int a = physicsParticleAdd(physics[p], pivot, 0.0f);
+			int b = physicsParticleAdd(physics[p], bob, 1.0f);
+			assert(a == x * 2 && b == x * 2 + 1);
+			physicsDistanceConstraintAdd(physics[p], a, b, 0.0f);
+		}
+	}
+	for (int frame = 0; frame < frames; frame++) {
+		for (int p = 0; p < 2; p++) {
+			physicsUpdate(physics[p], 1.0f / 60.0f);
+		}
+	}
+	for (int x = 0; x < pendulum_count * 2; x++) {
+		vec3f_t a = physicsParticleGetPosition(physics[0], x);
+		vec3f_t b = physicsParticleGetPosition(physics[1], x);
+		assert(tolerance > 0.0f ? vec3fDistance(a, b) < tolerance : memcmp(&a, &b, sizeof(vec3f_t)) == 0);
+	}
+}
+
+// Average distance between particles stored next to each other.
+static float testPhysicsNeighborDistance(heap_t* heap, physics_t* physics) {
+	int count = physicsGetParticleCount(physics);
+	int* ids = heapAlloc(heap, sizeof(int) * count, 8);
+	for (int x = 0; x < count; x++) {
+		ids[physicsParticleGetIndex(physics, x)] = x;
+	}
+	double distance = 0.0;
+	for (int x = 1; x < count; x++) {
+		distance += vec3fDistance(physicsParticleGetPosition(physics, ids[x - 1]), physicsParticleGetPosition(physics, ids[x]));
+	}
+	heapFree(heap, ids);
+	return (float) (distance / (count - 1));
+}
+
+void testPhysicsReorder(heap_t* heap) {
+	// the result is the same in any order and the ids stay valid through every reorder
+	const int pendulum_count = 20000;
+	job_pool_t* pool = jobPoolCreate(heap, 4);
+	physics_t* physics[2];
+	for (int p = 0; p < 2; p++) {
+		physics[p] = physicsCreate(heap);
+		physicsSetJobPool(physics[p], pool);
+		physicsSetReorderInterval(physics[p], p * 2);
+	}
+	testPhysicsPendulums(physics, pendulum_count, 5, 0.0f);
+	assert(physicsGetConstraintCount(physics[1]) == pendulum_count);
+
+	// Morton order puts particles close in space next to each other, the random order does not
+	float random_distance = testPhysicsNeighborDistance(heap, physics[0]);
+	float morton_distance = testPhysicsNeighborDistance(heap, physics[1]);
+	assert(morton_distance * 5.0f < random_distance);
+
+	physicsDestroy(physics[1]);
+	physicsDestroy(physics[0]);
+	jobPoolDestroy(pool);
+
+	debugPrint(DEBUG_PRINT_INFO, "Physics Reorder Test Success!\n");
+}
+
+// ================================================
+//				PHYSICS SLEEPING TEST
+// ================================================
+void testPhysicsSleeping(heap_t* heap) {
+	const float radius = 0.5f;
+	physics_t* physics = physicsCreate(heap);
+	physicsSetParticleCollision(physics, radius, 0.0f);
+	physicsSetSleeping(physics, 1e-4f, 10);
+	physicsSetReorderInterval(physics, 7);
+
+	// two stacks of particles resting on a pinned floor particle, far enough apart to be separate islands
+	int stacks[2][4];
+	for (int stack = 0; stack < 2; stack++) {
+		for (int y = 0; y < _countof(stacks[stack]); y++) {
+			vec3f_t position = { stack * 10.0f, y * radius * 2.0f, 0.0f };
+			stacks[stack][y] = physicsParticleAdd(physics, position, y == 0 ? 0.0f : 1.0f);
+		}
+	}
+
+	// a pendulum that keeps swinging never falls asleep
+	int pivot = physicsParticleAdd(physics, (vec3f_t) { 20.0f, 5.0f, 0.0f }, 0.0f);
+	int bob = physicsParticleAdd(physics, (vec3f_t) { 21.0f, 5.0f, 0.0f }, 1.0f);
+	physicsDistanceConstraintAdd(physics, pivot, bob, 0.0f);
+
+	for (int frame = 0; frame < 60; frame++) {
+		physicsUpdate(physics, 1.0f / 60.0f);
+	}
+	for (int stack = 0; stack < 2; stack++) {
+		for (int y = 1; y < _countof(stacks[stack]); y++) {
+			assert(physicsParticleIsAsleep(physics, stacks[stack][y]));
+		}
+	}
+	assert(!physicsParticleIsAsleep(physics, pivot) && !physicsParticleIsAsleep(physics, bob));
+
+	// sleeping particles do not move at all
+	vec3f_t top = physicsParticleGetPosition(physics, stacks[0][3]);
+	physicsUpdate(physics, 1.0f / 60.0f);
+	vec3f_t top_after = physicsParticleGetPosition(physics, stacks[0][3]);
+	assert(memcmp(&top, &top_after, sizeof(vec3f_t)) == 0);
+
+	// waking a particle wakes its island, but not the other stack
+	physicsParticleWake(physics, stacks[0][3]);
+	physicsUpdate(physics, 1.0f / 60.0f);
+	assert(!physicsParticleIsAsleep(physics, stacks[0][1]));
+	assert(physicsParticleIsAsleep(physics, stacks[1][1]));
+
+	// a particle dropped onto the other stack wakes it when they touch
+	int dropped = physicsParticleAdd(physics, vec3fAdd(physicsParticleGetPosition(physics, stacks[1][3]), (vec3f_t) { 0.0f, 3.0f, 0.0f }), 1.0f);
+	bool woke = false;
+	for (int frame = 0; frame < 60 && !woke; frame++) {
+		physicsUpdate(physics, 1.0f / 60.0f);
+		woke = !physicsParticleIsAsleep(physics, stacks[1][1]);
+	}
+	assert(woke);
+	assert(physicsParticleGetPosition(physics, dropped).y > physicsParticleGetPosition(physics, stacks[1][3]).y + radius);
+	physicsDestroy(physics);
+
+	// particles added past the capacity while others sleep, the sleeping ones keep their contacts
+	const int stack_count = 125;
+	physics = physicsCreate(heap);
+	physicsReserve(physics, stack_count * 4, 0);
+	physicsSetParticleCollision(physics, radius, 0.0f);
+	physicsSetSleeping(physics, 1e-4f, 10);
+	physicsSetReorderInterval(physics, 7);
+	for (int stack = 0; stack < stack_count; stack++) {
+		for (int y = 0; y < 4; y++) {
+			vec3f_t position = { (stack % 16) * 10.0f, y * radius * 2.0f, (stack / 16) * 10.0f };
+			physicsParticleAdd(physics, position, y == 0 ? 0.0f : 1.0f);
+		}
+	}
+	for (int frame = 0; frame < 60; frame++) {
+		physicsUpdate(physics, 1.0f / 60.0f);
+	}
+	int resting_count = physicsGetConstraintCount(physics);
+	assert(physicsParticleIsAsleep(physics, 3));
+	for (int x = 0; x < 100; x++) {
+		physicsParticleAdd(physics, (vec3f_t) { x * 10.0f, 100.0f, -100.0f }, 1.0f);
+	}
+	for (int frame = 0; frame < 10; frame++) {
+		physicsUpdate(physics, 1.0f / 60.0f);
+		assert(physicsGetConstraintCount(physics) == resting_count);
+	}
+	for (int x = 0; x < stack_count * 4; x++) {
+		assert(x % 4 == 0 || physicsParticleIsAsleep(physics, x));
+	}
+	physicsDestroy(physics);
+
+	debugPrint(DEBUG_PRINT_INFO, "Physics Sleeping Test Success!\n");
+}
+
+// ================================================
+//				PHYSICS SOFT BODY TEST
+// ================================================
+void testPhysicsSoftBody(heap_t* heap) {
+	// a tet standing on its pinned base, the volume only stays the same if the apex keeps its height
+	const vec3f_t base[3] = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+	const vec3f_t apex = { 0.25f, 1.0f, 0.25f };
+	for (int type = 0; type < 2; type++) {
+		physics_t* physics = physicsCreate(heap);
+		for (int k = 0; k < 3; k++) {
+			physicsParticleAdd(physics, base[k], 0.0f);
+		}
+		int top = physicsParticleAdd(physics, apex, 1.0f);
+		if (type == 0) {
+			physicsVolumeConstraintAdd(physics, 0, 1, 2, top, 0.0f);
+		} else {
+			// the rest shape is free of stress, without gravity nothing moves
+			physicsNeoHookeanConstraintAdd(physics, 0, 1, 2, top, 1e-4f, 1e-5f);
+			physicsSetGravity(physics, vec3fZero());
+		}
+		for (int frame = 0; frame < 60; frame++) {
+			physicsUpdate(physics, 1.0f / 60.0f);
+		}
+		assert(vec3fDistance(physicsParticleGetPosition(physics, top), apex) < 1e-3f);
+		assert(physicsGetConstraintCount(physics) == 1);
+
+		// a stiff Neo-Hookean tet carries its apex with little sag
+		if (type == 1) {
+			physicsSetGravity(physics, (vec3f_t) { 0.0f, -9.81f, 0.0f });
+			for (int frame = 0; frame < 120; frame++) {
+				physicsUpdate(physics, 1.0f / 60.0f);
+			}
+			vec3f_t position = physicsParticleGetPosition(physics, top);
+			assert(position.y > 0.95f && position.y <= 1.0f);
+		}
+		physicsDestroy(physics);
+	}
+
+	// two flat triangles hinged on a pinned edge, the free corner is held flat by bending alone
+	physics_t* physics = physicsCreate(heap);
+	int a = physicsParticleAdd(physics, (vec3f_t) { 0.0f, 0.0f, 0.0f }, 0.0f);
+	int b = physicsParticleAdd(physics, (vec3f_t) { 1.0f, 0.0f, 1.0f }, 0.0f);
+	int c = physicsParticleAdd(physics, (vec3f_t) { 1.0f, 0.0f, 0.0f }, 0.0f);
+	int d = physicsParticleAdd(physics, (vec3f_t) { 0.0f, 0.0f, 1.0f }, 1.0f);
+	physicsDistanceConstraintAdd(physics, a, d, 0.0f);
+	physicsDistanceConstraintAdd(physics, b, d, 0.0f);
+	physicsBendingConstraintAdd(physics, a, b, c, d, 0.0f);
+	for (int frame = 0; frame < 60; frame++) {
+		physicsUpdate(physics, 1.0f / 60.0f);
+	}
+	vec3f_t corner = physicsParticleGetPosition(physics, d);
+	assert(fabsf(corner.y) < 1e-2f && vec3fDistance(corner, (vec3f_t) { 0.0f, 0.0f, 1.0f }) < 1e-2f);
+	physicsDestroy(physics);
+
+	debugPrint(DEBUG_PRINT_INFO, "Physics Soft Body Test Success!\n");
+}
+
+// ================================================
+//				PHYSICS CLUSTER TEST
+// ================================================
+void testPhysicsClusters(heap_t* heap) {
+	// a rigid cube falling freely and one hanging from a pinned corner, reordered on the way
+	for (int pinned = 0; pinned < 2; pinned++) {
+		physics_t* physics = physicsCreate(heap);
+		physicsSetReorderInterval(physics, 3);
+
+		transform_t transform;
+		transformIdentity(&transform);
+		transform.translation = (vec3f_t) { 5.0f, 2.0f, 0.0f };
+		transform.rotation = quatfFromEuler((vec3f_t) { 0.3f, 0.5f, 0.1f });
+		const transform_t rest = transform;
+
+		vec3f_t locals[27];
+		int particles[27];
+		for (int x = 0; x < 27; x++) {
+			locals[x] = (vec3f_t) { (x % 3) * 0.1f, (x / 3 % 3) * 0.1f, (x / 9) * 0.1f };
+			particles[x] = physicsParticleAdd(physics, transformTransformVec3f(&transform, locals[x]), pinned && x == 0 ? 0.0f : 1.0f);
+		}
+		physicsClusterAdd(physics, particles, 27, 1.0f, &transform);
+		assert(physicsGetConstraintCount(physics) == 1);
+
+		for (int frame = 0; frame < 60; frame++) {
+			physicsUpdate(physics, 1.0f / 60.0f);
+		}
+
+		// the cube keeps its shape and the body transform puts it where its particles are
+		for (int x = 0; x < 27; x++) {
+			vec3f_t position = physicsParticleGetPosition(physics, particles[x]);
+			assert(vec3fDistance(position, transformTransformVec3f(&transform, locals[x])) < 1e-3f);
+			float rest_distance = vec3fDistance(transformTransformVec3f(&rest, locals[x]), transformTransformVec3f(&rest, locals[0]));
+			assert(fabsf(vec3fDistance(position, physicsParticleGetPosition(physics, particles[0])) - rest_distance) < 1e-3f);
+		}
+
+		// falling freely it does not turn, hanging from the corner at its origin it swings in place
+		float turn = fabsf(quatfMul(transform.rotation, quatfConjugate(rest.rotation)).s);
+		float drop = rest.translation.y - transform.translation.y;
+		assert(pinned ? turn < 0.999f && fabsf(drop) < 1e-3f : turn > 0.9999f && drop > 1.0f);
+
+		// a detached transform is not written anymore
+		physicsClusterSetTransform(physics, 0, NULL);
+		const transform_t detached = transform;
+		physicsUpdate(physics, 1.0f / 60.0f);
+		assert(memcmp(&detached, &transform, sizeof(transform_t)) == 0);
+		physicsDestroy(physics);
+	}
+
+	debugPrint(DEBUG_PRINT_INFO, "Physics Cluster Test Success!\n");
+}
+
+// ================================================
+//				PHYSICS JACOBI TEST
+// ================================================
+void testPhysicsJacobi(heap_t* heap) {
+	// pendulums share no particles, so averaging changes nothing and Jacobi matches Gauss-Seidel
+	const int pendulum_count = 5000;
+	job_pool_t* pool = jobPoolCreate(heap, 4);
+	physics_t* physics[2];
+	for (int p = 0; p < 2; p++) {
+		physics[p] = physicsCreate(heap);
+		physicsSetJobPool(physics[p], pool);
+	}
+	physicsSetSolverMode(physics[1], PHYSICS_CONSTRAINT_DISTANCE, PHYSICS_SOLVER_JACOBI);
+	testPhysicsPendulums(physics, pendulum_count, 10, 1e-4f);
+	physicsDestroy(physics[1]);
+	physicsDestroy(physics[0]);
+
+	// a hanging cloth gives the same result on every run with the same workers and keeps its shape
+	const int side = 32;
+	vec3f_t results[2][32 * 32];
+	for (int run = 0; run < 2; run++) {
+		physics_t* cloth = physicsCreate(heap);
+		physicsSetJobPool(cloth, pool);
+		physicsSetSolverMode(cloth, PHYSICS_CONSTRAINT_DISTANCE, PHYSICS_SOLVER_JACOBI);
+		for (int y = 0; y < side; y++) {
+			for (int x = 0; x < side; x++) {
+				physicsParticleAdd(cloth, (vec3f_t) { x * 0.1f, 0.0f, y * 0.1f }, y == 0 ? 0.0f : 1.0f);
+			}
+		}
+		for (int y = 0; y < side; y++) {
+			for (int x = 0; x < side; x++) {
+				int p = y * side + x;
+				if (x + 1 < side) { physicsDistanceConstraintAdd(cloth, p, p + 1, 0.0f); }
+				if (y + 1 < side) { physicsDistanceConstraintAdd(cloth, p, p + side, 0.0f); }
+			}
+		}
+		for (int frame = 0; frame < 60; frame++) {
+			physicsUpdate(cloth, 1.0f / 60.0f);
+		}
+		for (int x = 0; x < side * side; x++) {
+			results[run][x] = physicsParticleGetPosition(cloth, x);
+			assert(isfinite(results[run][x].y));
+		}
+		float bottom = physicsParticleGetPosition(cloth, side * (side - 1)).y;
+		assert(bottom < -1.0f && bottom > -(side - 1) * 0.1f * 1.5f);
+		physicsDestroy(cloth);
+	}
+	assert(memcmp(results[0], results[1], sizeof(results[0])) == 0);
+	jobPoolDestroy(pool);
+
+	debugPrint(DEBUG_PRINT_INFO, "Physics Jacobi Test Success!\n");
+}
+
+// ================================================
+//					AABB TREE TEST
+// ================================================
+static int testAabbTreePairCompare(const void* a, const void* b) {
+	const aabb_tree_pair_t* pair_a = a;
+	const aabb_tree_pair_t* pair_b = b;
+	return pair_a->proxy_a != pair_b->proxy_a ? pair_a->proxy_a - pair_b->proxy_a : pair_a->proxy_b - pair_b->proxy_b;
+}
+
+// The pair list holds exactly the overlapping fat boxes of the live proxies.
+static void testAabbTreeCheckPairs(heap_t* heap, aabb_tree_t* tree, const int* proxies, int count) {
+	int pair_count = aabbTreeUpdatePairs(tree);
+	aabb_tree_pair_t* pairs = heapAlloc(heap, sizeof(aabb_tree_pair_t) * (pair_count + 1), 8);
+	memcpy(pairs, aabbTreeGetPairs(tree), sizeof(aabb_tree_pair_t) * pair_count);
+	qsort(pairs, pair_count, sizeof(aabb_tree_pair_t), testAabbTreePairCompare);
+
+	int expected_count = 0;
+	for (int x = 0; x < count; x++) {
+		for (int y = 0; y < count; y++) {
+			if (proxies[x] == AABB_TREE_NULL || proxies[y] == AABB_TREE_NULL || proxies[x] >= proxies[y]) {
+				continue;
+			}
+			vec3f_t min_a, max_a, min_b, max_b;
+			aabbTreeProxyGetBounds(tree, proxies[x], &min_a, &max_a);
+			aabbTreeProxyGetBounds(tree, proxies[y], &min_b, &max_b);
+			if (min_a.x <= max_b.x && min_b.x <= max_a.x && min_a.y <= max_b.y && min_b.y <= max_a.y && min_a.z <= max_b.z && min_b.z <= max_a.z) {
+				aabb_tree_pair_t expected = { proxies[x], proxies[y] };
+				assert(bsearch(&expected, pairs, pair_count, sizeof(aabb_tree_pair_t), testAabbTreePairCompare));
+				expected_count++;
+			}
+		}
+	}
+	assert(expected_count == pair_count);
+	heapFree(heap, pairs);
+}
+
+void testAabbTree(heap_t* heap) {
+	aabb_tree_t* tree = aabbTreeCreate(heap, 0.1f);
+	assert(aabbTreeGetHeight(tree) == -1);
+
+	// small and large boxes mixed, the case a uniform grid does badly on
+	enum { count = 1000 };
+	int proxies[count];
+	vec3f_t centers[count], extents[count];
+	for (int x = 0; x < count; x++) {
+		centers[x] = (vec3f_t) { testMathRandom(-20.0f, 20.0f), testMathRandom(-20.0f, 20.0f), testMathRandom(-20.0f, 20.0f) };
+		float size = x % 50 == 0 ? testMathRandom(2.0f, 8.0f) : testMathRandom(0.05f, 0.5f);
+		extents[x] = (vec3f_t) { size, size * testMathRandom(0.5f, 1.5f), size };
+		proxies[x] = aabbTreeProxyAdd(tree, vec3fSub(centers[x], extents[x]), vec3fAdd(centers[x], extents[x]), x);
+		assert(aabbTreeProxyGetUser(tree, proxies[x]) == x);
+	}
+	// rotations keep the tree close to balanced, log2(1000) is about 10
+	assert(aabbTreeGetHeight(tree) <= 20);
+	testAabbTreeCheckPairs(heap, tree, proxies, count);
+
+	// a query finds every fat box it overlaps
+	int found[count];
+	vec3f_t query_min = { -5.0f, -5.0f, -5.0f }, query_max = { 5.0f, 5.0f, 5.0f };
+	int found_count = aabbTreeQuery(tree, query_min, query_max, found, count);
+	int expected_count = 0;
+	for (int x = 0; x < count; x++) {
+		vec3f_t min, max;
+		aabbTreeProxyGetBounds(tree, proxies[x], &min, &max);
+		expected_count += min.x <= query_max.x && query_min.x <= max.x && min.y <= query_max.y && query_min.y <= max.y && min.z <= query_max.z && query_min.z <= max.z;
+	}
+	assert(found_count == expected_count);
+
+	// moves inside the fat box leave the tree alone, the others are inserted again
+	for (int x = 0; x < count; x++) {
+		vec3f_t offset = x % 3 == 0 ? (vec3f_t) { testMathRandom(-3.0f, 3.0f), 0.0f, 0.0f } : (vec3f_t) { 0.05f, 0.0f, 0.0f };
+		centers[x] = vec3fAdd(centers[x], offset);
+		bool reinserted = aabbTreeProxyMove(tree, proxies[x], vec3fSub(centers[x], extents[x]), vec3fAdd(centers[x], extents[x]));
+		assert(reinserted == (fabsf(offset.x) > 0.1f));
+	}
+	testAabbTreeCheckPairs(heap, tree, proxies, count);
+
+	// removed proxies take their pairs with them, freed proxies are reused
+	for (int x = 0; x < count; x += 7) {
+		aabbTreeProxyRemove(tree, proxies[x]);
+		proxies[x] = AABB_TREE_NULL;
+	}
+	testAabbTreeCheckPairs(heap, tree, proxies, count);
+	for (int x = 0; x < count; x += 14) {
+		proxies[x] = aabbTreeProxyAdd(tree, vec3fSub(centers[x], extents[x]), vec3fAdd(centers[x], extents[x]), x);
+	}
+	testAabbTreeCheckPairs(heap, tree, proxies, count);
+
+	// a proxy removed and added again before the pair update gets a new proxy while the old one still has pairs
+	for (int x = 1; x < count; x += 11) {
+		int removed = proxies[x];
+		if (removed == AABB_TREE_NULL) {
+			continue;
+		}
+		aabbTreeProxyRemove(tree, removed);
+		proxies[x] = aabbTreeProxyAdd(tree, vec3fSub(centers[x], extents[x]), vec3fAdd(centers[x], extents[x]), x);
+		assert(proxies[x] != removed);
+	}
+	testAabbTreeCheckPairs(heap, tree, proxies, count);
+
+	// nothing moved, nothing changes
+	int pair_count = aabbTreeUpdatePairs(tree);
+	assert(aabbTreeUpdatePairs(tree) == pair_count);
+
+	aabbTreeDestroy(tree);
+
+	debugPrint(DEBUG_PRINT_INFO, "AABB Tree Test Success!\n");
+}
+
+// ================================================
+//				MESH BVH TEST
+// ================================================
+void testMeshBvh(heap_t* heap) {
+	// a quad one unit up, swept through from above
+	vec3f_t quad_vtx[4] = { { -1.0f, 0.0f, -1.0f }, { 1.0f, 0.0f, -1.0f }, { 1.0f, 0.0f, 1.0f }, { -1.0f, 0.0f, 1.0f } };
+	uint16_t quad_idx[6] = { 0, 1, 2, 0, 2, 3 };
+	gpu_mesh_info_t quad = {
+		.layout = GPU_MESH_LAYOUT_TRI_P444_I2,
+		.vtx_data = quad_vtx,
+		.idx_data = quad_idx,
+		.vtx_data_size = sizeof(quad_vtx),
+		.idx_data_size = sizeof(quad_idx),
+	};
+	transform_t transform;
+	transformIdentity(&transform);
+	transform.translation = (vec3f_t) { 0.0f, 1.0f, 0.0f };
+	mesh_bvh_t* bvh = meshBvhCreate(heap, &quad, &transform);
+	assert(meshBvhGetTriangleCount(bvh) == 2);
+
+	mesh_bvh_hit_t hit;
+	assert(meshBvhSweepSphere(bvh, (vec3f_t) { 0.5f, 3.0f, 0.5f }, (vec3f_t) { 0.5f, -3.0f, 0.5f }, 0.25f, &hit));
+	assert(fabsf(hit.time - 1.75f / 6.0f) < 1e-5f);
+	assert(vec3fDistance(hit.normal, vec3fUp()) < 1e-5f && vec3fDistance(hit.point, (vec3f_t) { 0.5f, 1.0f, 0.5f }) < 1e-5f);
+
+	// two sided, past the edge only the rim is hit, touching and moving away is no hit
+	assert(meshBvhSweepSphere(bvh, (vec3f_t) { 0.5f, -3.0f, 0.5f }, (vec3f_t) { 0.5f, 3.0f, 0.5f }, 0.25f, &hit));
+	assert(vec3fDistance(hit.normal, vec3fDown()) < 1e-5f);
+	assert(meshBvhSweepSphere(bvh, (vec3f_t) { 1.1f, 3.0f, 0.0f }, (vec3f_t) { 1.1f, -3.0f, 0.0f }, 0.25f, &hit));
+	assert(fabsf(hit.point.x - 1.0f) < 1e-5f && hit.normal.x > 0.0f && hit.normal.y > 0.0f);
+	assert(!meshBvhSweepSphere(bvh, (vec3f_t) { 1.3f, 3.0f, 0.0f }, (vec3f_t) { 1.3f, -3.0f, 0.0f }, 0.25f, &hit));
+	assert(!meshBvhSweepSphere(bvh, (vec3f_t) { 0.0f, 1.25f, 0.0f }, (vec3f_t) { 0.0f, 2.0f, 0.0f }, 0.25f, &hit));
+	meshBvhDestroy(bvh);
+
+	// a triangle soup against every triangle on its own, seeded here so the soup does not depend on the tests run before
+	uint32_t state = 4242;
+	const int triangle_count = 300;
+	vec3f_t* vtx = heapAlloc(heap, sizeof(vec3f_t) * triangle_count * 3, 16);
+	uint16_t* idx = heapAlloc(heap, sizeof(uint16_t) * triangle_count * 3, 16);
+	for (int x = 0; x < triangle_count; x++) {
+		vec3f_t corner = { testRandom(&state, 0.0f, 10.0f), testRandom(&state, 0.0f, 10.0f), testRandom(&state, 0.0f, 10.0f) };
+		for (int k = 0; k < 3; k++) {
+			vtx[x * 3 + k] = vec3fAdd(corner, (vec3f_t) { testRandom(&state, -1.0f, 1.0f), testRandom(&state, -1.0f, 1.0f), testRandom(&state, -1.0f, 1.0f) });
+			idx[x * 3 + k] = (uint16_t) (x * 3 + k);
+		}
+	}
+	gpu_mesh_info_t soup = {
+		.layout = GPU_MESH_LAYOUT_TRI_P444_I2,
+		.vtx_data = vtx,
+		.idx_data = idx,
+		.vtx_data_size = sizeof(vec3f_t) * triangle_count * 3,
+		.idx_data_size = sizeof(uint16_t) * triangle_count * 3,
+	};
+	bvh = meshBvhCreate(heap, &soup, NULL);
+	mesh_bvh_t** singles = heapAlloc(heap, sizeof(mesh_bvh_t*) * triangle_count, 8);
+	for (int x = 0; x < triangle_count; x++) {
+		gpu_mesh_info_t single = soup;
+		single.idx_data = idx + x * 3;
+		single.idx_data_size = sizeof(uint16_t) * 3;
+		singles[x] = meshBvhCreate(heap, &single, NULL);
+	}
+
+	int hit_count = 0;
+	for (int sweep = 0; sweep < 500; sweep++) {
+		vec3f_t start = { testRandom(&state, 0.0f, 10.0f), testRandom(&state, 0.0f, 10.0f), testRandom(&state, 0.0f, 10.0f) };
+		vec3f_t end = vec3fAdd(start, (vec3f_t) { testRandom(&state, -3.0f, 3.0f), testRandom(&state, -3.0f, 3.0f), testRandom(&state, -3.0f, 3.0f) });
+		float radius = testRandom(&state, 0.0f, 0.3f);
+
+		mesh_bvh_hit_t expected = { .time = 2.0f, .triangle = -1 };
+		for (int x = 0; x < triangle_count; x++) {
+			mesh_bvh_hit_t single_hit;
+			if (meshBvhSweepSphere(singles[x], start, end, radius, &single_hit) && single_hit.time < expected.time) {
+				expected = single_hit;
+				expected.triangle = x;
+			}
+		}
+		bool found = meshBvhSweepSphere(bvh, start, end, radius, &hit);
+		assert(found == (expected.triangle >= 0));
+		if (found) {
+			// several triangles share the time when the sphere starts touching them, any of them will do
+			mesh_bvh_hit_t single_hit;
+			assert(hit.time == expected.time && hit.triangle >= 0 && hit.triangle < triangle_count);
+			assert(meshBvhSweepSphere(singles[hit.triangle], start, end, radius, &single_hit) && single_hit.time == hit.time);
+			hit_count++;
+		}
+	}
+	assert(hit_count > 0);
+
+	for (int x = 0; x < triangle_count; x++) {
+		meshBvhDestroy(singles[x]);
+	}
+	heapFree(heap, singles);
+	meshBvhDestroy(bvh);
+	heapFree(heap, idx);
+	heapFree(heap, vtx);
+
+	debugPrint(DEBUG_PRINT_INFO, "Mesh BVH Test Success!\n");
+}
+
+// ================================================
+//				PHYSICS CCD TEST
+// ================================================
+void testPhysicsCcd(heap_t* heap) {
+	// a floor quad and a wall quad, with the gravity used here particles move further than a unit per frame
+	vec3f_t floor_vtx[4] = { { -10.0f, 0.0f, -10.0f }, { 10.0f, 0.0f, -10.0f }, { 10.0f, 0.0f, 10.0f }, { -10.0f, 0.0f, 10.0f } };
+	vec3f_t wall_vtx[4] = { { 1.0f, -10.0f, -10.0f }, { 1.0f, 10.0f, -10.0f }, { 1.0f, 10.0f, 10.0f }, { 1.0f, -10.0f, 10.0f } };
+	uint16_t quad_idx[6] = { 0, 1, 2, 0, 2, 3 };
+	gpu_mesh_info_t floor = {
+		.layout = GPU_MESH_LAYOUT_TRI_P444_I2,
+		.vtx_data = floor_vtx,
+		.idx_data = quad_idx,
+		.vtx_data_size = sizeof(floor_vtx),
+		.idx_data_size = sizeof(quad_idx),
+	};
+	gpu_mesh_info_t wall = floor;
+	wall.vtx_data = wall_vtx;
+
+	// particles dropped with one substep stay on the floor, without it they fall through
+	const int particle_count = 100;
+	physics_t* physics[2];
+	for (int p = 0; p < 2; p++) {
+		physics[p] = physicsCreate(heap);
+		physicsSetSubsteps(physics[p], 1);
+		physicsSetGravity(physics[p], (vec3f_t) { 0.0f, -1000.0f, 0.0f });
+	}
+	assert(physicsStaticMeshAdd(physics[0], &floor, NULL) == 0);
+	for (int x = 0; x < particle_count; x++) {
+		vec3f_t position = { testMathRandom(-5.0f, 5.0f), 1.0f, testMathRandom(-5.0f, 5.0f) };
+		for (int p = 0; p < 2; p++) {
+			physicsParticleAdd(physics[p], position, 1.0f);
+		}
+	}
+	for (int frame = 0; frame < 60; frame++) {
+		for (int p = 0; p < 2; p++) {
+			physicsUpdate(physics[p], 1.0f / 60.0f);
+		}
+	}
+	for (int x = 0; x < particle_count; x++) {
+		assert(physicsParticleGetPosition(physics[0], x).y > 0.0f);
+		assert(physicsParticleGetPosition(physics[0], x).y < 0.01f);
+		assert(physicsParticleGetPosition(physics[1], x).y < -10.0f);
+	}
+	physicsDestroy(physics[1]);
+	physicsDestroy(physics[0]);
+
+	// pushed into the corner of two meshes, the particle slides along the floor into the wall and stays there
+	physics_t* corner = physicsCreate(heap);
+	physicsSetSubsteps(corner, 1);
+	physicsSetGravity(corner, (vec3f_t) { 1000.0f, -1000.0f, 0.0f });
+	physicsSetParticleCollision(corner, 0.1f, 0.0f);
+	physicsStaticMeshAdd(corner, &floor, NULL);
+	physicsStaticMeshAdd(corner, &wall, NULL);
+	int particle = physicsParticleAdd(corner, (vec3f_t) { -5.0f, 0.5f, 0.0f }, 1.0f);
+	for (int frame = 0; frame < 60; frame++) {
+		physicsUpdate(corner, 1.0f / 60.0f);
+		vec3f_t position = physicsParticleGetPosition(corner, particle);
+		assert(position.x < 0.9f && position.y > 0.1f);
+	}
+	vec3f_t position = physicsParticleGetPosition(corner, particle);
+	assert(fabsf(position.x - 0.9f) < 0.01f && fabsf(position.y - 0.1f) < 0.01f);
+	physicsDestroy(corner);
+
+	debugPrint(DEBUG_PRINT_INFO, "Physics CCD Test Success!\n");
+}
+
 // ================================================
 //					THREADING TEST
 // ================================================
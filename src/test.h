@@ -17,6 +17,38 @@ void testReadWriteAndCompression(heap_t* heap, fs_t* fs);
 
 void testLeakedHeapAllocation();
 
+void testHashTable(heap_t* heap);
+
+void testSort(heap_t* heap);
+
+void testMath();
+
+void testVec3fWide();
+
+void testCull(heap_t* heap);
+
+void testTransform(heap_t* heap);
+
+void testHierarchy(heap_t* heap);
+
+void testSpatialHash(heap_t* heap);
+
+void testPhysicsReorder(heap_t* heap);
+
+void testPhysicsSleeping(heap_t* heap);
+
+void testPhysicsSoftBody(heap_t* heap);
+
+void testPhysicsClusters(heap_t* heap);
+
+void testPhysicsJacobi(heap_t* heap);
+
+void testAabbTree(heap_t* heap);
+
+void testMeshBvh(heap_t* heap);
+
+void testPhysicsCcd(heap_t* heap);
+
 typedef struct thread_data_t thread_data_t;
 typedef struct performance_counter_t performance_counter_t;
 
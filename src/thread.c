@@ -34,3 +34,9 @@ int	threadRun(thread_t* thread) {
 void threadSleep(uint32_t ms){
 	Sleep(ms);
 }
+
+int threadGetCoreCount() {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int) info.dwNumberOfProcessors;
+}
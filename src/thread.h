@@ -24,4 +24,9 @@ int threadRun(thread_t* thread);
 // 
 void threadSleep(uint32_t ms);
 
+// Get the number of logical processors on the machine.
+// 
+// RETURN: logical processor count
+int threadGetCoreCount();
+
 #endif
\ No newline at end of file
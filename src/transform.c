@@ -1,5 +1,28 @@
 #include "transform.h"
 
+#include "job.h"
+
+#if defined(__AVX__)
+#define TRANSFORM_AVX 1
+#define TRANSFORM_SSE 1
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#define TRANSFORM_AVX 0
+#define TRANSFORM_SSE 1
+#include <xmmintrin.h>
+#else
+#define TRANSFORM_AVX 0
+#define TRANSFORM_SSE 0
+#endif
+
+#define TRANSFORM_PARALLEL_CHUNK_SIZE 512
+
+typedef struct transform_convert_job_t {
+	const char* transforms;
+	size_t transform_stride;
+	mat4f_t* matrices;
+} transform_convert_job_t;
+
 void transformIdentity(transform_t* transform) {
 	transform->rotation = quatfIdentity();
 	transform->translation = vec3fZero();
@@ -7,14 +30,176 @@ void transformIdentity(transform_t* transform) {
 }
 
 void transformConvertToMatrix(const transform_t* transform, mat4f_t* m) {
-	// TODO LATER
+	const quatf_t q = transform->rotation;
+	const float x2 = q.x + q.x, y2 = q.y + q.y, z2 = q.z + q.z;
+	const float xx = q.x * x2, yy = q.y * y2, zz = q.z * z2;
+	const float xy = q.x * y2, xz = q.x * z2, yz = q.y * z2;
+	const float wx = q.s * x2, wy = q.s * y2, wz = q.s * z2;
+	const vec3f_t s = transform->scale;
+
+	m->mat[0][0] = (1.0f - (yy + zz)) * s.x;
+	m->mat[0][1] = (xy + wz) * s.x;
+	m->mat[0][2] = (xz - wy) * s.x;
+	m->mat[0][3] = 0.0f;
+
+	m->mat[1][0] = (xy - wz) * s.y;
+	m->mat[1][1] = (1.0f - (xx + zz)) * s.y;
+	m->mat[1][2] = (yz + wx) * s.y;
+	m->mat[1][3] = 0.0f;
+
+	m->mat[2][0] = (xz + wy) * s.z;
+	m->mat[2][1] = (yz - wx) * s.z;
+	m->mat[2][2] = (1.0f - (xx + yy)) * s.z;
+	m->mat[2][3] = 0.0f;
+
+	m->mat[3][0] = transform->translation.x;
+	m->mat[3][1] = transform->translation.y;
+	m->mat[3][2] = transform->translation.z;
+	m->mat[3][3] = 1.0f;
+}
+
+#if TRANSFORM_SSE
+// Loads 4 transforms as 10 lanes: tx, ty, tz, sx, sy, sz, qs, qx, qy, qz.
+// A transform_t is 10 packed floats, so 3 overlapping loads of 4 floats transposed cover it.
+static inline void transformLoad4(const char* src, size_t stride, __m128 lanes[10]) {
+	__m128 a0 = _mm_loadu_ps((const float*) (src + 0 * stride));
+	__m128 a1 = _mm_loadu_ps((const float*) (src + 1 * stride));
+	__m128 a2 = _mm_loadu_ps((const float*) (src + 2 * stride));
+	__m128 a3 = _mm_loadu_ps((const float*) (src + 3 * stride));
+	_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+
+	__m128 b0 = _mm_loadu_ps((const float*) (src + 0 * stride) + 4);
+	__m128 b1 = _mm_loadu_ps((const float*) (src + 1 * stride) + 4);
+	__m128 b2 = _mm_loadu_ps((const float*) (src + 2 * stride) + 4);
+	__m128 b3 = _mm_loadu_ps((const float*) (src + 3 * stride) + 4);
+	_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+
+	__m128 c0 = _mm_loadu_ps((const float*) (src + 0 * stride) + 6);
+	__m128 c1 = _mm_loadu_ps((const float*) (src + 1 * stride) + 6);
+	__m128 c2 = _mm_loadu_ps((const float*) (src + 2 * stride) + 6);
+	__m128 c3 = _mm_loadu_ps((const float*) (src + 3 * stride) + 6);
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+	lanes[0] = a0; lanes[1] = a1; lanes[2] = a2; lanes[3] = a3;
+	lanes[4] = b0; lanes[5] = b1;
+	lanes[6] = c0; lanes[7] = c1; lanes[8] = c2; lanes[9] = c3;
+}
+
+// Stores 4 matrices from their columns as lanes: columns[column][row], rows 0 to 2 (row 3 is 0 0 0 1).
+static inline void transformStore4(mat4f_t* m, __m128 columns[4][3]) {
+	for (int c = 0; c < 4; c++) {
+		__m128 r0 = columns[c][0];
+		__m128 r1 = columns[c][1];
+		__m128 r2 = columns[c][2];
+		__m128 r3 = c == 3 ? _mm_set1_ps(1.0f) : _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(m[0].mat[c], r0);
+		_mm_storeu_ps(m[1].mat[c], r1);
+		_mm_storeu_ps(m[2].mat[c], r2);
+		_mm_storeu_ps(m[3].mat[c], r3);
+	}
+}
+#endif
+
+#if TRANSFORM_AVX
+#define TRANSFORM_WIDTH 8
+typedef __m256 transform_lane_t;
+#define transformLaneAdd _mm256_add_ps
+#define transformLaneSub _mm256_sub_ps
+#define transformLaneMul _mm256_mul_ps
+#define transformLaneOne() _mm256_set1_ps(1.0f)
+#elif TRANSFORM_SSE
+#define TRANSFORM_WIDTH 4
+typedef __m128 transform_lane_t;
+#define transformLaneAdd _mm_add_ps
+#define transformLaneSub _mm_sub_ps
+#define transformLaneMul _mm_mul_ps
+#define transformLaneOne() _mm_set1_ps(1.0f)
+#endif
+
+void transformConvertToMatrices(const transform_t* transforms, size_t transform_stride, mat4f_t* matrices, int count) {
+	const char* src = (const char*) transforms;
+	int x = 0;
+
+#if TRANSFORM_SSE
+	for (; x + TRANSFORM_WIDTH <= count; x += TRANSFORM_WIDTH) {
+		// gather the transforms into lanes, an AVX lane is 2 SSE loads side by side
+		transform_lane_t lanes[10];
+#if TRANSFORM_AVX
+		__m128 lo[10], hi[10];
+		transformLoad4(src + x * transform_stride, transform_stride, lo);
+		transformLoad4(src + (x + 4) * transform_stride, transform_stride, hi);
+		for (int l = 0; l < 10; l++) {
+			lanes[l] = _mm256_insertf128_ps(_mm256_castps128_ps256(lo[l]), hi[l], 1);
+		}
+#else
+		transformLoad4(src + x * transform_stride, transform_stride, lanes);
+#endif
+
+		const transform_lane_t qs = lanes[6], qx = lanes[7], qy = lanes[8], qz = lanes[9];
+		const transform_lane_t x2 = transformLaneAdd(qx, qx), y2 = transformLaneAdd(qy, qy), z2 = transformLaneAdd(qz, qz);
+		const transform_lane_t xx = transformLaneMul(qx, x2), yy = transformLaneMul(qy, y2), zz = transformLaneMul(qz, z2);
+		const transform_lane_t xy = transformLaneMul(qx, y2), xz = transformLaneMul(qx, z2), yz = transformLaneMul(qy, z2);
+		const transform_lane_t wx = transformLaneMul(qs, x2), wy = transformLaneMul(qs, y2), wz = transformLaneMul(qs, z2);
+		const transform_lane_t one = transformLaneOne();
+
+		transform_lane_t columns[4][3] = {
+			{
+				transformLaneMul(transformLaneSub(one, transformLaneAdd(yy, zz)), lanes[3]),
+				transformLaneMul(transformLaneAdd(xy, wz), lanes[3]),
+				transformLaneMul(transformLaneSub(xz, wy), lanes[3]),
+			},
+			{
+				transformLaneMul(transformLaneSub(xy, wz), lanes[4]),
+				transformLaneMul(transformLaneSub(one, transformLaneAdd(xx, zz)), lanes[4]),
+				transformLaneMul(transformLaneAdd(yz, wx), lanes[4]),
+			},
+			{
+				transformLaneMul(transformLaneAdd(xz, wy), lanes[5]),
+				transformLaneMul(transformLaneSub(yz, wx), lanes[5]),
+				transformLaneMul(transformLaneSub(one, transformLaneAdd(xx, yy)), lanes[5]),
+			},
+			{ lanes[0], lanes[1], lanes[2] },
+		};
+
+#if TRANSFORM_AVX
+		__m128 columns_lo[4][3], columns_hi[4][3];
+		for (int c = 0; c < 4; c++) {
+			for (int r = 0; r < 3; r++) {
+				columns_lo[c][r] = _mm256_castps256_ps128(columns[c][r]);
+				columns_hi[c][r] = _mm256_extractf128_ps(columns[c][r], 1);
+			}
+		}
+		transformStore4(matrices + x, columns_lo);
+		transformStore4(matrices + x + 4, columns_hi);
+#else
+		transformStore4(matrices + x, columns);
+#endif
+	}
+#endif
+
+	for (; x < count; x++) {
+		transformConvertToMatrix((const transform_t*) (src + x * transform_stride), &matrices[x]);
+	}
+}
+
+static void transformConvertJobFunc(void* user, int begin, int end, int worker) {
+	transform_convert_job_t* job = user;
+	transformConvertToMatrices((const transform_t*) (job->transforms + begin * job->transform_stride), job->transform_stride, job->matrices + begin, end - begin);
+}
+
+void transformConvertToMatricesParallel(job_pool_t* pool, const transform_t* transforms, size_t transform_stride, mat4f_t* matrices, int count) {
+	transform_convert_job_t job = {
+		.transforms = (const char*) transforms,
+		.transform_stride = transform_stride,
+		.matrices = matrices,
+	};
+	jobPoolParallelFor(pool, count, TRANSFORM_PARALLEL_CHUNK_SIZE, transformConvertJobFunc, &job);
 }
 
 void transformMul(const transform_t* a, transform_t* b) {
-	const vec3f_t trans_scale = vec3fMul(a->translation, a->scale);
-	const vec3f_t rot_scale = quatfRotateVec(a->rotation, a->scale);
-	
-	b->translation = vec3fAdd(rot_scale, a->translation);
+	// b's translation is moved into a's space the same way a point is (scale, rotate, translate)
+	b->translation = transformTransformVec3f(a, b->translation);
 	b->rotation = quatfMul(a->rotation, b->rotation);
 	b->scale = vec3fMul(b->scale, a->scale);
 }
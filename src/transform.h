@@ -5,16 +5,30 @@
 #include "quatf.h"
 #include "mat4f.h"
 
+#include <stddef.h>
+
 typedef struct transform_t {
 	vec3f_t translation;
 	vec3f_t scale;
 	quatf_t rotation;
 } transform_t;
 
+typedef struct job_pool_t job_pool_t;
+
 void transformIdentity(transform_t* transform);
 
+// Builds the model matrix translation * rotation * scale, column major (m->mat[column][row]) like the shaders read it.
 void transformConvertToMatrix(const transform_t* transform, mat4f_t* m);
 
+// Converts count transforms into matrices, 8 (AVX) or 4 (SSE) at a time. Transforms are read every
+// transform_stride bytes, so a component array that embeds a transform_t can be passed directly.
+void transformConvertToMatrices(const transform_t* transforms, size_t transform_stride, mat4f_t* matrices, int count);
+
+// Same as transformConvertToMatrices, split into chunks over the job pool (NULL runs on the calling thread).
+void transformConvertToMatricesParallel(job_pool_t* pool, const transform_t* transforms, size_t transform_stride, mat4f_t* matrices, int count);
+
+// Combines a parent transform a with a child transform b into b = a * b. Scale is composed per axis,
+// which is exact as long as the parent scale is uniform.
 void transformMul(const transform_t* a, transform_t* b);
 
 void transformInvert(transform_t* transform);
@@ -0,0 +1,387 @@
+#ifndef __VEC_3F_WIDE_H__
+#define __VEC_3F_WIDE_H__
+
+#include "vec3f.h"
+
+/*        WIDE VECTORS
+*	- vec3f_x4_t (SSE) and vec3f_x8_t (AVX) hold 4 or 8 vectors as one register per component (SoA),
+*	  every operation works on all lanes at once
+*	- the operation set follows vec3f.h, vec3fAdd becomes vec3fx4Add / vec3fx8Add and floats become
+*	  float_x4_t / float_x8_t
+*	- Load/Store move contiguous vec3f_t arrays in and out, Gather/Scatter go through an index array
+*	  (e.g. the particles of a constraint batch), scattered indices must not repeat
+*	- vec3f_xn_t and the vec3fxn* names pick the widest type the compiler targets, so a kernel
+*	  written with them gets the full width, VEC3F_XN_WIDTH is its lane count
+*	- without SSE none of this is available (VEC3F_XN_WIDTH is 0), callers keep a scalar path
+*/
+
+#if defined(__AVX__)
+#define VEC3F_X4 1
+#define VEC3F_X8 1
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#define VEC3F_X4 1
+#define VEC3F_X8 0
+#include <xmmintrin.h>
+#else
+#define VEC3F_X4 0
+#define VEC3F_X8 0
+#endif
+
+#if VEC3F_X4
+//  --------------------------------------------------------------------------
+//								   4 LANES
+//
+
+typedef __m128 float_x4_t;
+
+typedef struct vec3f_x4_t {
+    float_x4_t x, y, z;
+} vec3f_x4_t;
+
+// Every lane set to the same vector
+//
+__forceinline vec3f_x4_t vec3fx4Splat(vec3f_t v) { return (vec3f_x4_t) { _mm_set1_ps(v.x), _mm_set1_ps(v.y), _mm_set1_ps(v.z) }; }
+
+__forceinline vec3f_x4_t vec3fx4Zero() { return (vec3f_x4_t) { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() }; }
+
+// Load 4 contiguous vectors
+//
+__forceinline vec3f_x4_t vec3fx4Load(const vec3f_t* v) {
+    return (vec3f_x4_t) {
+        _mm_setr_ps(v[0].x, v[1].x, v[2].x, v[3].x),
+        _mm_setr_ps(v[0].y, v[1].y, v[2].y, v[3].y),
+        _mm_setr_ps(v[0].z, v[1].z, v[2].z, v[3].z),
+    };
+}
+
+// Load the vectors at 4 indices
+//
+__forceinline vec3f_x4_t vec3fx4Gather(const vec3f_t* v, const int* idx) {
+    return (vec3f_x4_t) {
+        _mm_setr_ps(v[idx[0]].x, v[idx[1]].x, v[idx[2]].x, v[idx[3]].x),
+        _mm_setr_ps(v[idx[0]].y, v[idx[1]].y, v[idx[2]].y, v[idx[3]].y),
+        _mm_setr_ps(v[idx[0]].z, v[idx[1]].z, v[idx[2]].z, v[idx[3]].z),
+    };
+}
+
+// Store 4 contiguous vectors
+//
+__forceinline void vec3fx4Store(vec3f_t* v, vec3f_x4_t a) {
+    float x[4], y[4], z[4];
+    _mm_storeu_ps(x, a.x);
+    _mm_storeu_ps(y, a.y);
+    _mm_storeu_ps(z, a.z);
+    for (int l = 0; l < 4; l++) {
+        v[l] = (vec3f_t) { .x = x[l], .y = y[l], .z = z[l] };
+    }
+}
+
+// Store the vectors to 4 indices
+//
+__forceinline void vec3fx4Scatter(vec3f_t* v, const int* idx, vec3f_x4_t a) {
+    float x[4], y[4], z[4];
+    _mm_storeu_ps(x, a.x);
+    _mm_storeu_ps(y, a.y);
+    _mm_storeu_ps(z, a.z);
+    for (int l = 0; l < 4; l++) {
+        v[idx[l]] = (vec3f_t) { .x = x[l], .y = y[l], .z = z[l] };
+    }
+}
+
+// Load the floats at 4 indices
+//
+__forceinline float_x4_t floatx4Gather(const float* f, const int* idx) { return _mm_setr_ps(f[idx[0]], f[idx[1]], f[idx[2]], f[idx[3]]); }
+
+// Lane mask of a >= b
+//
+__forceinline float_x4_t floatx4CmpGe(float_x4_t a, float_x4_t b) { return _mm_cmpge_ps(a, b); }
+
+// Per lane mask ? a : b
+//
+__forceinline float_x4_t floatx4Select(float_x4_t mask, float_x4_t a, float_x4_t b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+
+__forceinline float_x4_t floatx4And(float_x4_t a, float_x4_t b) { return _mm_and_ps(a, b); }
+
+// Bit l set when lane l of the mask is set
+//
+__forceinline int floatx4MaskBits(float_x4_t mask) { return _mm_movemask_ps(mask); }
+
+__forceinline vec3f_x4_t vec3fx4Neg(vec3f_x4_t a) {
+    const float_x4_t zero = _mm_setzero_ps();
+    return (vec3f_x4_t) { _mm_sub_ps(zero, a.x), _mm_sub_ps(zero, a.y), _mm_sub_ps(zero, a.z) };
+}
+
+__forceinline vec3f_x4_t vec3fx4Add(vec3f_x4_t a, vec3f_x4_t b) { return (vec3f_x4_t) { _mm_add_ps(a.x, b.x), _mm_add_ps(a.y, b.y), _mm_add_ps(a.z, b.z) }; }
+
+__forceinline vec3f_x4_t vec3fx4Sub(vec3f_x4_t a, vec3f_x4_t b) { return (vec3f_x4_t) { _mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z) }; }
+
+// NOTE: THIS IS NOT DOT
+//
+__forceinline vec3f_x4_t vec3fx4Mul(vec3f_x4_t a, vec3f_x4_t b) { return (vec3f_x4_t) { _mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y), _mm_mul_ps(a.z, b.z) }; }
+
+__forceinline vec3f_x4_t vec3fx4Min(vec3f_x4_t a, vec3f_x4_t b) { return (vec3f_x4_t) { _mm_min_ps(a.x, b.x), _mm_min_ps(a.y, b.y), _mm_min_ps(a.z, b.z) }; }
+
+__forceinline vec3f_x4_t vec3fx4Max(vec3f_x4_t a, vec3f_x4_t b) { return (vec3f_x4_t) { _mm_max_ps(a.x, b.x), _mm_max_ps(a.y, b.y), _mm_max_ps(a.z, b.z) }; }
+
+// Every lane scaled by its own float
+//
+__forceinline vec3f_x4_t vec3fx4Scale(vec3f_x4_t a, float_x4_t f) { return (vec3f_x4_t) { _mm_mul_ps(a.x, f), _mm_mul_ps(a.y, f), _mm_mul_ps(a.z, f) }; }
+
+__forceinline vec3f_x4_t vec3fx4Lerp(vec3f_x4_t a, vec3f_x4_t b, float_x4_t f) {
+    const float_x4_t inv_f = _mm_sub_ps(_mm_set1_ps(1.0f), f);
+    return vec3fx4Add(vec3fx4Scale(a, inv_f), vec3fx4Scale(b, f));
+}
+
+__forceinline float_x4_t vec3fx4Dot(vec3f_x4_t a, vec3f_x4_t b) {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+__forceinline vec3f_x4_t vec3fx4Cross(vec3f_x4_t a, vec3f_x4_t b) {
+    return (vec3f_x4_t) {
+        _mm_sub_ps(_mm_mul_ps(a.y, b.z), _mm_mul_ps(a.z, b.y)),
+        _mm_sub_ps(_mm_mul_ps(a.z, b.x), _mm_mul_ps(a.x, b.z)),
+        _mm_sub_ps(_mm_mul_ps(a.x, b.y), _mm_mul_ps(a.y, b.x)),
+    };
+}
+
+__forceinline float_x4_t vec3fx4MagnitudeSqrd(vec3f_x4_t v) { return vec3fx4Dot(v, v); }
+
+__forceinline float_x4_t vec3fx4Magnitude(vec3f_x4_t v) { return _mm_sqrt_ps(vec3fx4Dot(v, v)); }
+
+__forceinline float_x4_t vec3fx4DistanceSqrd(vec3f_x4_t a, vec3f_x4_t b) { return vec3fx4MagnitudeSqrd(vec3fx4Sub(b, a)); }
+
+__forceinline float_x4_t vec3fx4Distance(vec3f_x4_t a, vec3f_x4_t b) { return vec3fx4Magnitude(vec3fx4Sub(b, a)); }
+
+// Lanes with a magnitude of (almost) 0 are returned as they are, like vec3fNorm
+//
+__forceinline vec3f_x4_t vec3fx4Norm(vec3f_x4_t v) {
+    const float_x4_t m = vec3fx4Magnitude(v);
+    const float_x4_t zero_mask = _mm_cmple_ps(m, _mm_set1_ps(FLT_EPSILON * 1000.0f));
+    const float_x4_t inv_m = floatx4Select(zero_mask, _mm_set1_ps(1.0f), _mm_div_ps(_mm_set1_ps(1.0f), m));
+    return vec3fx4Scale(v, inv_m);
+}
+#endif
+
+#if VEC3F_X8
+//  --------------------------------------------------------------------------
+//								   8 LANES
+//
+
+typedef __m256 float_x8_t;
+
+typedef struct vec3f_x8_t {
+    float_x8_t x, y, z;
+} vec3f_x8_t;
+
+// Every lane set to the same vector
+//
+__forceinline vec3f_x8_t vec3fx8Splat(vec3f_t v) { return (vec3f_x8_t) { _mm256_set1_ps(v.x), _mm256_set1_ps(v.y), _mm256_set1_ps(v.z) }; }
+
+__forceinline vec3f_x8_t vec3fx8Zero() { return (vec3f_x8_t) { _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() }; }
+
+// Load 8 contiguous vectors
+//
+__forceinline vec3f_x8_t vec3fx8Load(const vec3f_t* v) {
+    return (vec3f_x8_t) {
+        _mm256_setr_ps(v[0].x, v[1].x, v[2].x, v[3].x, v[4].x, v[5].x, v[6].x, v[7].x),
+        _mm256_setr_ps(v[0].y, v[1].y, v[2].y, v[3].y, v[4].y, v[5].y, v[6].y, v[7].y),
+        _mm256_setr_ps(v[0].z, v[1].z, v[2].z, v[3].z, v[4].z, v[5].z, v[6].z, v[7].z),
+    };
+}
+
+// Load the vectors at 8 indices
+//
+__forceinline vec3f_x8_t vec3fx8Gather(const vec3f_t* v, const int* idx) {
+    return (vec3f_x8_t) {
+        _mm256_setr_ps(v[idx[0]].x, v[idx[1]].x, v[idx[2]].x, v[idx[3]].x, v[idx[4]].x, v[idx[5]].x, v[idx[6]].x, v[idx[7]].x),
+        _mm256_setr_ps(v[idx[0]].y, v[idx[1]].y, v[idx[2]].y, v[idx[3]].y, v[idx[4]].y, v[idx[5]].y, v[idx[6]].y, v[idx[7]].y),
+        _mm256_setr_ps(v[idx[0]].z, v[idx[1]].z, v[idx[2]].z, v[idx[3]].z, v[idx[4]].z, v[idx[5]].z, v[idx[6]].z, v[idx[7]].z),
+    };
+}
+
+// Store 8 contiguous vectors
+//
+__forceinline void vec3fx8Store(vec3f_t* v, vec3f_x8_t a) {
+    float x[8], y[8], z[8];
+    _mm256_storeu_ps(x, a.x);
+    _mm256_storeu_ps(y, a.y);
+    _mm256_storeu_ps(z, a.z);
+    for (int l = 0; l < 8; l++) {
+        v[l] = (vec3f_t) { .x = x[l], .y = y[l], .z = z[l] };
+    }
+}
+
+// Store the vectors to 8 indices
+//
+__forceinline void vec3fx8Scatter(vec3f_t* v, const int* idx, vec3f_x8_t a) {
+    float x[8], y[8], z[8];
+    _mm256_storeu_ps(x, a.x);
+    _mm256_storeu_ps(y, a.y);
+    _mm256_storeu_ps(z, a.z);
+    for (int l = 0; l < 8; l++) {
+        v[idx[l]] = (vec3f_t) { .x = x[l], .y = y[l], .z = z[l] };
+    }
+}
+
+// Load the floats at 8 indices
+//
+__forceinline float_x8_t floatx8Gather(const float* f, const int* idx) {
+    return _mm256_setr_ps(f[idx[0]], f[idx[1]], f[idx[2]], f[idx[3]], f[idx[4]], f[idx[5]], f[idx[6]], f[idx[7]]);
+}
+
+// Lane mask of a >= b
+//
+__forceinline float_x8_t floatx8CmpGe(float_x8_t a, float_x8_t b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+
+// Per lane mask ? a : b
+//
+__forceinline float_x8_t floatx8Select(float_x8_t mask, float_x8_t a, float_x8_t b) { return _mm256_blendv_ps(b, a, mask); }
+
+__forceinline float_x8_t floatx8And(float_x8_t a, float_x8_t b) { return _mm256_and_ps(a, b); }
+
+// Bit l set when lane l of the mask is set
+//
+__forceinline int floatx8MaskBits(float_x8_t mask) { return _mm256_movemask_ps(mask); }
+
+__forceinline vec3f_x8_t vec3fx8Neg(vec3f_x8_t a) {
+    const float_x8_t zero = _mm256_setzero_ps();
+    return (vec3f_x8_t) { _mm256_sub_ps(zero, a.x), _mm256_sub_ps(zero, a.y), _mm256_sub_ps(zero, a.z) };
+}
+
+__forceinline vec3f_x8_t vec3fx8Add(vec3f_x8_t a, vec3f_x8_t b) { return (vec3f_x8_t) { _mm256_add_ps(a.x, b.x), _mm256_add_ps(a.y, b.y), _mm256_add_ps(a.z, b.z) }; }
+
+__forceinline vec3f_x8_t vec3fx8Sub(vec3f_x8_t a, vec3f_x8_t b) { return (vec3f_x8_t) { _mm256_sub_ps(a.x, b.x), _mm256_sub_ps(a.y, b.y), _mm256_sub_ps(a.z, b.z) }; }
+
+// NOTE: THIS IS NOT DOT
+//
+__forceinline vec3f_x8_t vec3fx8Mul(vec3f_x8_t a, vec3f_x8_t b) { return (vec3f_x8_t) { _mm256_mul_ps(a.x, b.x), _mm256_mul_ps(a.y, b.y), _mm256_mul_ps(a.z, b.z) }; }
+
+__forceinline vec3f_x8_t vec3fx8Min(vec3f_x8_t a, vec3f_x8_t b) { return (vec3f_x8_t) { _mm256_min_ps(a.x, b.x), _mm256_min_ps(a.y, b.y), _mm256_min_ps(a.z, b.z) }; }
+
+__forceinline vec3f_x8_t vec3fx8Max(vec3f_x8_t a, vec3f_x8_t b) { return (vec3f_x8_t) { _mm256_max_ps(a.x, b.x), _mm256_max_ps(a.y, b.y), _mm256_max_ps(a.z, b.z) }; }
+
+// Every lane scaled by its own float
+//
+__forceinline vec3f_x8_t vec3fx8Scale(vec3f_x8_t a, float_x8_t f) { return (vec3f_x8_t) { _mm256_mul_ps(a.x, f), _mm256_mul_ps(a.y, f), _mm256_mul_ps(a.z, f) }; }
+
+__forceinline vec3f_x8_t vec3fx8Lerp(vec3f_x8_t a, vec3f_x8_t b, float_x8_t f) {
+    const float_x8_t inv_f = _mm256_sub_ps(_mm256_set1_ps(1.0f), f);
+    return vec3fx8Add(vec3fx8Scale(a, inv_f), vec3fx8Scale(b, f));
+}
+
+__forceinline float_x8_t vec3fx8Dot(vec3f_x8_t a, vec3f_x8_t b) {
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a.x, b.x), _mm256_mul_ps(a.y, b.y)), _mm256_mul_ps(a.z, b.z));
+}
+
+__forceinline vec3f_x8_t vec3fx8Cross(vec3f_x8_t a, vec3f_x8_t b) {
+    return (vec3f_x8_t) {
+        _mm256_sub_ps(_mm256_mul_ps(a.y, b.z), _mm256_mul_ps(a.z, b.y)),
+        _mm256_sub_ps(_mm256_mul_ps(a.z, b.x), _mm256_mul_ps(a.x, b.z)),
+        _mm256_sub_ps(_mm256_mul_ps(a.x, b.y), _mm256_mul_ps(a.y, b.x)),
+    };
+}
+
+__forceinline float_x8_t vec3fx8MagnitudeSqrd(vec3f_x8_t v) { return vec3fx8Dot(v, v); }
+
+__forceinline float_x8_t vec3fx8Magnitude(vec3f_x8_t v) { return _mm256_sqrt_ps(vec3fx8Dot(v, v)); }
+
+__forceinline float_x8_t vec3fx8DistanceSqrd(vec3f_x8_t a, vec3f_x8_t b) { return vec3fx8MagnitudeSqrd(vec3fx8Sub(b, a)); }
+
+__forceinline float_x8_t vec3fx8Distance(vec3f_x8_t a, vec3f_x8_t b) { return vec3fx8Magnitude(vec3fx8Sub(b, a)); }
+
+// Lanes with a magnitude of (almost) 0 are returned as they are, like vec3fNorm
+//
+__forceinline vec3f_x8_t vec3fx8Norm(vec3f_x8_t v) {
+    const float_x8_t m = vec3fx8Magnitude(v);
+    const float_x8_t zero_mask = _mm256_cmp_ps(m, _mm256_set1_ps(FLT_EPSILON * 1000.0f), _CMP_LE_OQ);
+    const float_x8_t inv_m = floatx8Select(zero_mask, _mm256_set1_ps(1.0f), _mm256_div_ps(_mm256_set1_ps(1.0f), m));
+    return vec3fx8Scale(v, inv_m);
+}
+#endif
+
+//  --------------------------------------------------------------------------
+//								 WIDEST LANES
+//
+
+#if VEC3F_X8
+#define VEC3F_XN_WIDTH 8
+typedef float_x8_t float_xn_t;
+typedef vec3f_x8_t vec3f_xn_t;
+#define floatxnSplat _mm256_set1_ps
+#define floatxnAdd _mm256_add_ps
+#define floatxnSub _mm256_sub_ps
+#define floatxnMul _mm256_mul_ps
+#define floatxnDiv _mm256_div_ps
+#define floatxnLoad _mm256_loadu_ps
+#define floatxnStore _mm256_storeu_ps
+#define floatxnGather floatx8Gather
+#define floatxnZero _mm256_setzero_ps
+#define floatxnCmpGe floatx8CmpGe
+#define floatxnSelect floatx8Select
+#define floatxnAnd floatx8And
+#define floatxnMaskBits floatx8MaskBits
+#define vec3fxnSplat vec3fx8Splat
+#define vec3fxnZero vec3fx8Zero
+#define vec3fxnLoad vec3fx8Load
+#define vec3fxnGather vec3fx8Gather
+#define vec3fxnStore vec3fx8Store
+#define vec3fxnScatter vec3fx8Scatter
+#define vec3fxnNeg vec3fx8Neg
+#define vec3fxnAdd vec3fx8Add
+#define vec3fxnSub vec3fx8Sub
+#define vec3fxnMul vec3fx8Mul
+#define vec3fxnMin vec3fx8Min
+#define vec3fxnMax vec3fx8Max
+#define vec3fxnScale vec3fx8Scale
+#define vec3fxnLerp vec3fx8Lerp
+#define vec3fxnDot vec3fx8Dot
+#define vec3fxnCross vec3fx8Cross
+#define vec3fxnMagnitudeSqrd vec3fx8MagnitudeSqrd
+#define vec3fxnMagnitude vec3fx8Magnitude
+#define vec3fxnDistanceSqrd vec3fx8DistanceSqrd
+#define vec3fxnDistance vec3fx8Distance
+#define vec3fxnNorm vec3fx8Norm
+#elif VEC3F_X4
+#define VEC3F_XN_WIDTH 4
+typedef float_x4_t float_xn_t;
+typedef vec3f_x4_t vec3f_xn_t;
+#define floatxnSplat _mm_set1_ps
+#define floatxnAdd _mm_add_ps
+#define floatxnSub _mm_sub_ps
+#define floatxnMul _mm_mul_ps
+#define floatxnDiv _mm_div_ps
+#define floatxnLoad _mm_loadu_ps
+#define floatxnStore _mm_storeu_ps
+#define floatxnGather floatx4Gather
+#define floatxnZero _mm_setzero_ps
+#define floatxnCmpGe floatx4CmpGe
+#define floatxnSelect floatx4Select
+#define floatxnAnd floatx4And
+#define floatxnMaskBits floatx4MaskBits
+#define vec3fxnSplat vec3fx4Splat
+#define vec3fxnZero vec3fx4Zero
+#define vec3fxnLoad vec3fx4Load
+#define vec3fxnGather vec3fx4Gather
+#define vec3fxnStore vec3fx4Store
+#define vec3fxnScatter vec3fx4Scatter
+#define vec3fxnNeg vec3fx4Neg
+#define vec3fxnAdd vec3fx4Add
+#define vec3fxnSub vec3fx4Sub
+#define vec3fxnMul vec3fx4Mul
+#define vec3fxnMin vec3fx4Min
+#define vec3fxnMax vec3fx4Max
+#define vec3fxnScale vec3fx4Scale
+#define vec3fxnLerp vec3fx4Lerp
+#define vec3fxnDot vec3fx4Dot
+#define vec3fxnCross vec3fx4Cross
+#define vec3fxnMagnitudeSqrd vec3fx4MagnitudeSqrd
+#define vec3fxnMagnitude vec3fx4Magnitude
+#define vec3fxnDistanceSqrd vec3fx4DistanceSqrd
+#define vec3fxnDistance vec3fx4Distance
+#define vec3fxnNorm vec3fx4Norm
+#else
+#define VEC3F_XN_WIDTH 0
+#endif
+
+#endif